@@ -0,0 +1,147 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-arena.c: Memory that lives as long as a handle
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "rsvg-arena.h"
+
+/* Documents with many nodes allocate a few hundred kilobytes per
+ * thousand nodes; the chunks grow up to this size.
+ */
+#define MIN_CHUNK_SIZE (16 * 1024)
+#define MAX_CHUNK_SIZE (1024 * 1024)
+
+/* Enough for doubles and pointers, which is all that goes in here */
+#define ALIGNMENT 16
+
+typedef struct _Chunk Chunk;
+
+struct _Chunk {
+    Chunk *next;
+    gsize size;
+    gsize used;
+    /* the memory follows, aligned to ALIGNMENT */
+};
+
+#define CHUNK_HEADER_SIZE ((sizeof (Chunk) + ALIGNMENT - 1) & ~(gsize) (ALIGNMENT - 1))
+#define CHUNK_DATA(chunk) ((guint8 *) (chunk) + CHUNK_HEADER_SIZE)
+
+struct _RsvgArena {
+    Chunk *chunks;              /* the one being filled comes first */
+    gsize next_size;
+};
+
+RsvgArena *
+rsvg_arena_new (void)
+{
+    RsvgArena *arena;
+
+    arena = g_new (RsvgArena, 1);
+    arena->chunks = NULL;
+    arena->next_size = MIN_CHUNK_SIZE;
+
+    return arena;
+}
+
+void
+rsvg_arena_free (RsvgArena *arena)
+{
+    Chunk *chunk, *next;
+
+    for (chunk = arena->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        g_free (chunk);
+    }
+
+    g_free (arena);
+}
+
+static Chunk *
+add_chunk (RsvgArena *arena, gsize size)
+{
+    Chunk *chunk;
+    gsize chunk_size = arena->next_size;
+
+    if (chunk_size < size)
+        chunk_size = size;
+
+    chunk = g_malloc (CHUNK_HEADER_SIZE + chunk_size);
+    chunk->size = chunk_size;
+    chunk->used = 0;
+
+    /* A chunk for a single large block goes behind the current one, so
+     * that the rest of the current one is still used. */
+    if (chunk_size > arena->next_size && arena->chunks) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+    } else {
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+
+        if (arena->next_size < MAX_CHUNK_SIZE)
+            arena->next_size *= 2;
+    }
+
+    return chunk;
+}
+
+gpointer
+rsvg_arena_alloc (RsvgArena *arena, gsize size)
+{
+    Chunk *chunk = arena->chunks;
+    gpointer mem;
+
+    size = (size + ALIGNMENT - 1) & ~(gsize) (ALIGNMENT - 1);
+
+    if (chunk == NULL || chunk->size - chunk->used < size)
+        chunk = add_chunk (arena, size);
+
+    mem = CHUNK_DATA (chunk) + chunk->used;
+    chunk->used += size;
+
+    return mem;
+}
+
+gpointer
+rsvg_arena_alloc0 (RsvgArena *arena, gsize size)
+{
+    return memset (rsvg_arena_alloc (arena, size), 0, size);
+}
+
+char *
+rsvg_arena_strdup (RsvgArena *arena, const char *str)
+{
+    gsize len;
+
+    if (str == NULL)
+        return NULL;
+
+    len = strlen (str) + 1;
+
+    return memcpy (rsvg_arena_alloc (arena, len), str, len);
+}
+
+void
+rsvg_arena_free_nothing (gpointer mem)
+{
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-arena.h: Memory that lives as long as a handle
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef RSVG_ARENA_H
+#define RSVG_ARENA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RsvgArena RsvgArena;
+
+/* A bump allocator.  Memory from an arena can't be freed by itself; all
+ * of it goes away at once with rsvg_arena_free().
+ */
+G_GNUC_INTERNAL
+RsvgArena *rsvg_arena_new     (void);
+G_GNUC_INTERNAL
+void       rsvg_arena_free    (RsvgArena *arena);
+G_GNUC_INTERNAL
+gpointer   rsvg_arena_alloc   (RsvgArena *arena, gsize size);
+G_GNUC_INTERNAL
+gpointer   rsvg_arena_alloc0  (RsvgArena *arena, gsize size);
+G_GNUC_INTERNAL
+char      *rsvg_arena_strdup  (RsvgArena *arena, const char *str);
+
+#define rsvg_arena_new0(arena, type) ((type *) rsvg_arena_alloc0 ((arena), sizeof (type)))
+
+/* A free function for things whose memory belongs to an arena */
+G_GNUC_INTERNAL
+void       rsvg_arena_free_nothing (gpointer mem);
+
+G_END_DECLS
+
+#endif /* RSVG_ARENA_H */
@@ -30,6 +30,7 @@
 #include "rsvg.h"
 #include "rsvg-compat.h"
 #include "rsvg-private.h"
+#include "rsvg-stylesheet.h"
 #include "rsvg-css.h"
 #include "rsvg-styles.h"
 #include "rsvg-shapes.h"
@@ -41,6 +42,9 @@
 #include "rsvg-mask.h"
 #include "rsvg-marker.h"
 #include "rsvg-cairo-render.h"
+#include "rsvg-cairo-draw.h"
+#include "rsvg-spatial-index.h"
+#include "rsvg-name-table.h"
 
 #include <libxml/uri.h>
 #include <libxml/parser.h>
@@ -202,7 +206,7 @@ register_node_in_defs (RsvgHandle *ctx, RsvgNode *node, RsvgPropertyBag *atts)
 {
     const char *id;
 
-    id = rsvg_property_bag_lookup (atts, "id");
+    id = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_ID);
     if (id) {
         rsvg_defs_register_node_by_id (ctx->priv->defs, id, node);
     }
@@ -213,6 +217,10 @@ push_element_name (RsvgHandle *ctx, const char *name)
 {
     /* libxml holds on to the name while parsing; we won't dup the name here */
     ctx->priv->element_name_stack = g_slist_prepend (ctx->priv->element_name_stack, (void *) name);
+
+    /* The new element has no text yet; the parent's is restored when it ends */
+    ctx->priv->chars_node_stack = g_slist_prepend (ctx->priv->chars_node_stack, ctx->priv->last_chars_node);
+    ctx->priv->last_chars_node = NULL;
 }
 
 static gboolean
@@ -230,6 +238,10 @@ static void
 pop_element_name (RsvgHandle *ctx)
 {
     ctx->priv->element_name_stack = g_slist_delete_link (ctx->priv->element_name_stack, ctx->priv->element_name_stack);
+    rsvg_style_ancestors_pop (ctx->priv->style_ancestors);
+
+    ctx->priv->last_chars_node = ctx->priv->chars_node_stack->data;
+    ctx->priv->chars_node_stack = g_slist_delete_link (ctx->priv->chars_node_stack, ctx->priv->chars_node_stack);
 }
 
 static void
@@ -237,9 +249,14 @@ free_element_name_stack (RsvgHandle *ctx)
 {
     g_slist_free (ctx->priv->element_name_stack);
     ctx->priv->element_name_stack = NULL;
+    rsvg_style_ancestors_clear (ctx->priv->style_ancestors);
+
+    g_slist_free (ctx->priv->chars_node_stack);
+    ctx->priv->chars_node_stack = NULL;
+    ctx->priv->last_chars_node = NULL;
 }
 
-typedef RsvgNode *(* CreateNodeFn) (const char *element_name, RsvgNode *parent);
+typedef RsvgNode *(* CreateNodeFn) (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 typedef struct {
     const char   *element_name;
@@ -247,7 +264,8 @@ typedef struct {
     CreateNodeFn  create_fn;
 } NodeCreator;
 
-/* Keep these sorted by element_name!
+/* Keep these sorted by element_name, so that the list is easy to read;
+ * they are looked up with a perfect hash.
  *
  * Lines in comments are elements that we don't support.
  */
@@ -343,36 +361,18 @@ static const NodeCreator node_creators[] = {
  */
 static const NodeCreator default_node_creator = { NULL, TRUE, rsvg_node_group_new };
 
-/* Used from bsearch() */
-static int
-compare_node_creators_fn (const void *a, const void *b)
-{
-    const NodeCreator *na = a;
-    const NodeCreator *nb = b;
-
-    return strcmp (na->element_name, nb->element_name);
-}
+static RsvgNameTable node_creators_table = RSVG_NAME_TABLE_INIT (node_creators);
 
 static const NodeCreator *
 get_node_creator_for_element_name (const char *name)
 {
-    NodeCreator key;
-    const NodeCreator *result;
-
-    key.element_name = name;
-    key.supports_class_attribute = FALSE;
-    key.create_fn = NULL;
-
-    result = bsearch (&key,
-                      node_creators,
-                      G_N_ELEMENTS (node_creators),
-                      sizeof (NodeCreator),
-                      compare_node_creators_fn);
+    gint i;
 
-    if (result == NULL)
-        result = &default_node_creator;
+    i = rsvg_name_table_lookup (&node_creators_table, name, -1);
+    if (i < 0)
+        return &default_node_creator;
 
-    return result;
+    return &node_creators[i];
 }
 
 static void
@@ -392,7 +392,7 @@ node_set_atts (RsvgNode * node, RsvgHandle * ctx, const NodeCreator *creator, Rs
             id = rsvg_property_bag_lookup (atts, "id");
 
             if (creator->supports_class_attribute)
-                klazz = rsvg_property_bag_lookup (atts, "class");
+                klazz = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_CLASS);
             else
                 klazz = NULL;
 
@@ -401,6 +401,45 @@ node_set_atts (RsvgNode * node, RsvgHandle * ctx, const NodeCreator *creator, Rs
     }
 }
 
+/* Starts reading the files that images and <use> elements refer to, so
+ * that they are ready by the time they are needed.
+ */
+static void
+prefetch_external_href (RsvgHandle *handle, RsvgNode *node, RsvgPropertyBag *atts)
+{
+    const char *href;
+    const char *fragment;
+    char *url;
+
+    switch (rsvg_node_get_type (node)) {
+    case RSVG_NODE_TYPE_IMAGE:
+    case RSVG_NODE_TYPE_FILTER_PRIMITIVE_IMAGE:
+    case RSVG_NODE_TYPE_USE:
+        break;
+
+    default:
+        return;
+    }
+
+    href = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_XLINK_HREF);
+    if (href == NULL || href[0] == '#' || href[0] == '\0')
+        return;
+
+    /* Images that were decoded already won't need their file */
+    if (rsvg_node_get_type (node) != RSVG_NODE_TYPE_USE && rsvg_image_is_cached (handle, href))
+        return;
+
+    /* References to elements of other documents load the whole document */
+    fragment = strrchr (href, '#');
+    if (fragment && !g_str_has_prefix (href, "data:"))
+        url = g_strndup (href, fragment - href);
+    else
+        url = g_strdup (href);
+
+    _rsvg_handle_prefetch (handle, url);
+    g_free (url);
+}
+
 static void
 rsvg_standard_element_start (RsvgHandle * ctx, const char *name, RsvgPropertyBag * atts)
 {
@@ -410,11 +449,17 @@ rsvg_standard_element_start (RsvgHandle * ctx, const char *name, RsvgPropertyBag
     creator = get_node_creator_for_element_name (name);
     g_assert (creator != NULL && creator->create_fn != NULL);
 
-    newnode = creator->create_fn (name, ctx->priv->currentnode);
+    newnode = creator->create_fn (name, ctx->priv->currentnode,
+                                  rsvg_state_new_in_arena (ctx->priv->arena),
+                                  ctx->priv->arena);
 
     if (newnode) {
         g_assert (rsvg_node_get_type (newnode) != RSVG_NODE_TYPE_INVALID);
 
+        /* Text after a tspan goes in a new chars node */
+        if (rsvg_node_get_type (newnode) == RSVG_NODE_TYPE_TSPAN)
+            ctx->priv->last_chars_node = NULL;
+
         push_element_name (ctx, name);
 
         add_node_to_handle (ctx, newnode);
@@ -429,8 +474,19 @@ rsvg_standard_element_start (RsvgHandle * ctx, const char *name, RsvgPropertyBag
 
         ctx->priv->currentnode = rsvg_node_ref (newnode);
 
+        prefetch_external_href (ctx, newnode, atts);
+
         node_set_atts (newnode, ctx, creator, atts);
 
+        /* Once its own style is known, the element is an ancestor for the
+         * selectors of the elements inside it */
+        rsvg_style_ancestors_push (ctx->priv->style_ancestors,
+                                   name,
+                                   (creator->supports_class_attribute
+                                    ? rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_CLASS)
+                                    : NULL),
+                                   rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_ID));
+
         newnode = rsvg_node_unref (newnode);
     }
 }
@@ -467,14 +523,7 @@ rsvg_extra_handler_characters (RsvgSaxHandler * self, const char *ch, int len)
     if (!ch || !len)
         return;
 
-    if (!g_utf8_validate ((char *) ch, len, NULL)) {
-        char *utf8;
-        utf8 = rsvg_make_valid_utf8 ((char *) ch, len);
-        g_string_append (z->string, utf8);
-        g_free (utf8);
-    } else {
-        g_string_append_len (z->string, (char *) ch, len);
-    }
+    rsvg_string_append_valid_utf8 (z->string, (char *) ch, len);
 }
 
 static void
@@ -779,15 +828,15 @@ rsvg_start_xinclude (RsvgHandle * ctx, RsvgPropertyBag * atts)
 static void
 rsvg_start_element (void *data, const xmlChar * name, const xmlChar ** atts)
 {
-    RsvgPropertyBag *bag;
+    RsvgPropertyBag bag;
     RsvgHandle *ctx = (RsvgHandle *) data;
 
-    bag = rsvg_property_bag_new ((const char **) atts);
+    rsvg_property_bag_init (&bag, (const char **) atts);
 
     if (ctx->priv->handler) {
         ctx->priv->handler_nest++;
         if (ctx->priv->handler->start_element != NULL)
-            ctx->priv->handler->start_element (ctx->priv->handler, (const char *) name, bag);
+            ctx->priv->handler->start_element (ctx->priv->handler, (const char *) name, &bag);
     } else {
         const char *tempname;
         for (tempname = (const char *) name; *tempname != '\0'; tempname++)
@@ -795,7 +844,7 @@ rsvg_start_element (void *data, const xmlChar * name, const xmlChar ** atts)
                 name = (const xmlChar *) (tempname + 1);
 
         if (!strcmp ((const char *) name, "style"))
-            rsvg_start_style (ctx, bag);
+            rsvg_start_style (ctx, &bag);
         else if (!strcmp ((const char *) name, "title"))
             rsvg_start_title (ctx);
         else if (!strcmp ((const char *) name, "desc"))
@@ -803,12 +852,12 @@ rsvg_start_element (void *data, const xmlChar * name, const xmlChar ** atts)
         else if (!strcmp ((const char *) name, "metadata"))
             rsvg_start_metadata (ctx);
         else if (!strcmp ((const char *) name, "include"))      /* xi:include */
-            rsvg_start_xinclude (ctx, bag);
+            rsvg_start_xinclude (ctx, &bag);
         else
-            rsvg_standard_element_start (ctx, (const char *) name, bag);
+            rsvg_standard_element_start (ctx, (const char *) name, &bag);
     }
 
-    rsvg_property_bag_free (bag);
+    rsvg_property_bag_clear (&bag);
 }
 
 static void
@@ -866,29 +915,21 @@ rsvg_node_chars_free (gpointer impl)
 {
     RsvgNodeChars *self = impl;
     g_string_free (self->contents, TRUE);
-    g_free (self);
 }
 
 static RsvgNode *
 rsvg_new_node_chars (const char *text,
                      int len,
-                     RsvgNode *parent)
+                     RsvgNode *parent,
+                     RsvgState *state,
+                     RsvgArena *arena)
 {
     RsvgNodeChars *self;
-    RsvgState *state;
-
-    self = g_new0 (RsvgNodeChars, 1);
 
-    if (!g_utf8_validate (text, len, NULL)) {
-        char *utf8;
-        utf8 = rsvg_make_valid_utf8 (text, len);
-        self->contents = g_string_new (utf8);
-        g_free (utf8);
-    } else {
-        self->contents = g_string_new_len (text, len);
-    }
+    self = rsvg_arena_new0 (arena, RsvgNodeChars);
+    self->contents = g_string_sized_new (len);
+    rsvg_string_append_valid_utf8 (self->contents, text, len);
 
-    state = rsvg_state_new ();
     state->cond_true = FALSE;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_CHARS,
@@ -900,22 +941,6 @@ rsvg_new_node_chars (const char *text,
                                 rsvg_node_chars_free);
 }
 
-static gboolean
-find_last_chars_node (RsvgNode *node, gpointer data)
-{
-    RsvgNode **dest;
-
-    dest = data;
-
-    if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_CHARS) {
-        *dest = rsvg_node_ref (node);
-    } else if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_TSPAN) {
-        *dest = rsvg_node_unref (*dest); /* Discard the last chars node we found */
-    }
-
-    return TRUE;
-}
-
 static void
 rsvg_characters_impl (RsvgHandle * ctx, const xmlChar * ch, int len)
 {
@@ -929,39 +954,32 @@ rsvg_characters_impl (RsvgHandle * ctx, const xmlChar * ch, int len)
         if (type == RSVG_NODE_TYPE_TSPAN || type == RSVG_NODE_TYPE_TEXT) {
             RsvgNodeChars *self;
 
-            /* find the last CHARS node in the text or tspan node, so that we
-               can coalesce the text, and thus avoid screwing up the Pango layouts */
-            node = NULL;
-            rsvg_node_foreach_child (ctx->priv->currentnode,
-                                     find_last_chars_node,
-                                     &node);
+            /* append to the last CHARS node in the text or tspan node, so that we
+               coalesce the text, and thus avoid screwing up the Pango layouts */
+            node = ctx->priv->last_chars_node;
 
             if (node) {
                 g_assert (rsvg_node_get_type (node) == RSVG_NODE_TYPE_CHARS);
                 self = rsvg_rust_cnode_get_impl (node);
 
-                if (!g_utf8_validate ((char *) ch, len, NULL)) {
-                    char *utf8;
-                    utf8 = rsvg_make_valid_utf8 ((char *) ch, len);
-                    g_string_append (self->contents, utf8);
-                    g_free (utf8);
-                } else {
-                    g_string_append_len (self->contents, (char *)ch, len);
-                }
-
-                node = rsvg_node_unref (node);
+                rsvg_string_append_valid_utf8 (self->contents, (char *) ch, len);
                 return;
             }
         }
     }
 
-    node = rsvg_new_node_chars ((char *) ch, len, ctx->priv->currentnode);
+    node = rsvg_new_node_chars ((char *) ch, len, ctx->priv->currentnode,
+                                rsvg_state_new_in_arena (ctx->priv->arena),
+                                ctx->priv->arena);
 
     add_node_to_handle (ctx, node);
 
     if (ctx->priv->currentnode)
         rsvg_node_add_child (ctx->priv->currentnode, node);
 
+    /* all_nodes keeps it alive */
+    ctx->priv->last_chars_node = node;
+
     node = rsvg_node_unref (node);
 }
 
@@ -1390,7 +1408,7 @@ rsvg_drawing_ctx_free (RsvgDrawingCtx * handle)
 {
     rsvg_render_free (handle->render);
 
-    rsvg_state_free_all (handle->state);
+    rsvg_state_free_stack (handle);
 
 	g_slist_free_full (handle->drawsub_stack, (GDestroyNotify) rsvg_node_unref);
 
@@ -1475,6 +1493,149 @@ rsvg_handle_get_desc (RsvgHandle * handle)
         return NULL;
 }
 
+/* The bounding box of a node only depends on the document, which can't
+ * change once it is loaded, and on the initial parameters of the drawing
+ * context it is measured with.  Those are mostly the same from one query
+ * to the next, except that measuring the toplevel viewport happens with a
+ * dummy 1x1 viewport (see rsvg_handle_get_dimensions()), so we keep two
+ * entries per node.
+ */
+typedef struct {
+    cairo_matrix_t affine;
+    double vb_width;
+    double vb_height;
+    double dpi_x;
+    double dpi_y;
+    gboolean is_testing;
+    RsvgBbox bbox;
+} RsvgBboxCacheEntry;
+
+typedef struct {
+    RsvgBboxCacheEntry entries[2];
+    guint n_entries;
+    guint next;
+} RsvgNodeBboxCache;
+
+static void
+bbox_cache_entry_init (RsvgBboxCacheEntry *entry, RsvgDrawingCtx *draw)
+{
+    entry->affine = rsvg_current_state (draw)->affine;
+    entry->vb_width = draw->vb.rect.width;
+    entry->vb_height = draw->vb.rect.height;
+    entry->dpi_x = draw->dpi_x;
+    entry->dpi_y = draw->dpi_y;
+    entry->is_testing = draw->is_testing;
+}
+
+static gboolean
+bbox_cache_entry_matches (RsvgBboxCacheEntry *a, RsvgBboxCacheEntry *b)
+{
+    return (memcmp (&a->affine, &b->affine, sizeof (cairo_matrix_t)) == 0
+            && a->vb_width == b->vb_width
+            && a->vb_height == b->vb_height
+            && a->dpi_x == b->dpi_x
+            && a->dpi_y == b->dpi_y
+            && a->is_testing == b->is_testing);
+}
+
+/* Computes the bounding box of @node, in the coordinate space of the
+ * toplevel viewport, by walking the node and its ancestors with a render
+ * that only accumulates bounding boxes.  Results are cached once the
+ * document is fully loaded.
+ */
+gboolean
+_rsvg_handle_get_node_bbox (RsvgHandle *handle, RsvgNode *node, RsvgBbox *bbox)
+{
+    cairo_surface_t *target;
+    cairo_t *cr;
+    RsvgDrawingCtx *draw;
+    RsvgNodeBboxCache *cache = NULL;
+    RsvgBboxCacheEntry key;
+    guint i;
+
+    g_assert (node != NULL);
+
+    if (!handle->priv->treebase)
+        return FALSE;
+
+    target = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 1, 1);
+    cr = cairo_create (target);
+
+    draw = rsvg_cairo_new_bbox_drawing_ctx (cr, handle);
+    if (!draw) {
+        cairo_destroy (cr);
+        cairo_surface_destroy (target);
+        return FALSE;
+    }
+
+    if (handle->priv->finished) {
+        bbox_cache_entry_init (&key, draw);
+
+        cache = g_hash_table_lookup (handle->priv->bbox_cache, rsvg_node_get_state (node));
+        if (cache) {
+            for (i = 0; i < cache->n_entries; i++) {
+                if (bbox_cache_entry_matches (&cache->entries[i], &key)) {
+                    *bbox = cache->entries[i].bbox;
+                    goto out;
+                }
+            }
+        } else {
+            cache = g_new0 (RsvgNodeBboxCache, 1);
+            g_hash_table_insert (handle->priv->bbox_cache, rsvg_node_get_state (node), cache);
+        }
+    }
+
+    rsvg_drawing_ctx_add_node_and_ancestors_to_stack (draw, node);
+
+    rsvg_drawing_ctx_draw_node_from_stack (draw, handle->priv->treebase, 0);
+    *bbox = RSVG_CAIRO_RENDER (draw->render)->bbox;
+
+    if (cache) {
+        key.bbox = *bbox;
+        cache->entries[cache->next] = key;
+        cache->next = (cache->next + 1) % G_N_ELEMENTS (cache->entries);
+        cache->n_entries = MIN (cache->n_entries + 1, G_N_ELEMENTS (cache->entries));
+    }
+
+out:
+    rsvg_drawing_ctx_free (draw);
+    cairo_destroy (cr);
+    cairo_surface_destroy (target);
+
+    return TRUE;
+}
+
+/* Like _rsvg_handle_get_node_bbox(), but rounds the bounding box outwards
+ * to whole pixels.  Returns %FALSE if the node doesn't paint anything.
+ */
+gboolean
+_rsvg_handle_get_node_pixel_extents (RsvgHandle *handle, RsvgNode *node, cairo_rectangle_int_t *extents)
+{
+    RsvgBbox bbox;
+    double x0, y0, x1, y1;
+
+    if (!_rsvg_handle_get_node_bbox (handle, node, &bbox))
+        return FALSE;
+
+    if (bbox.virgin)
+        return FALSE;
+
+    x0 = floor (bbox.rect.x);
+    y0 = floor (bbox.rect.y);
+    x1 = ceil (bbox.rect.x + bbox.rect.width);
+    y1 = ceil (bbox.rect.y + bbox.rect.height);
+
+    if (x1 <= x0 || y1 <= y0)
+        return FALSE;
+
+    extents->x = (int) x0;
+    extents->y = (int) y0;
+    extents->width = (int) (x1 - x0);
+    extents->height = (int) (y1 - y0);
+
+    return TRUE;
+}
+
 /**
  * rsvg_handle_get_dimensions:
  * @handle: A #RsvgHandle
@@ -1517,9 +1678,6 @@ rsvg_handle_get_dimensions (RsvgHandle * handle, RsvgDimensionData * dimension_d
 gboolean
 rsvg_handle_get_dimensions_sub (RsvgHandle * handle, RsvgDimensionData * dimension_data, const char *id)
 {
-    cairo_t *cr;
-    cairo_surface_t *target;
-    RsvgDrawingCtx *draw;
     RsvgNode *sself = NULL;
     RsvgBbox bbox;
     RsvgLength root_width, root_height;
@@ -1563,28 +1721,10 @@ rsvg_handle_get_dimensions_sub (RsvgHandle * handle, RsvgDimensionData * dimensi
     }
 
     if (handle_subelement == TRUE) {
-        target = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-                                             1, 1);
-        cr = cairo_create  (target);
-
-        draw = rsvg_cairo_new_drawing_ctx (cr, handle);
-
-        if (!draw) {
-            cairo_destroy (cr);
-            cairo_surface_destroy (target);
-
-            return FALSE;
-        }
-
         g_assert (sself != NULL);
-        rsvg_drawing_ctx_add_node_and_ancestors_to_stack (draw, sself);
-
-        rsvg_drawing_ctx_draw_node_from_stack (draw, handle->priv->treebase, 0);
-        bbox = RSVG_CAIRO_RENDER (draw->render)->bbox;
 
-        rsvg_drawing_ctx_free (draw);
-        cairo_destroy (cr);
-        cairo_surface_destroy (target);
+        if (!_rsvg_handle_get_node_bbox (handle, sself, &bbox))
+            return FALSE;
 
         dimension_data->width = bbox.rect.width;
         dimension_data->height = bbox.rect.height;
@@ -1608,6 +1748,58 @@ rsvg_handle_get_dimensions_sub (RsvgHandle * handle, RsvgDimensionData * dimensi
     return TRUE;
 }
 
+/**
+ * rsvg_handle_get_dimensions_sub_cropped:
+ * @handle: A #RsvgHandle
+ * @dimension_data: (out): A place to store the element's size
+ * @id: (nullable): An element's id within the SVG, or %NULL for the
+ *   whole SVG.  For example, if you have a layer called "layer1" for
+ *   that you want to get the dimension, pass "##layer1" as the id.
+ *
+ * Gets the size of the surface that rsvg_handle_render_cairo_sub_cropped()
+ * and rsvg_handle_get_pixbuf_sub_cropped() draw the element to: its
+ * bounding box, rounded outwards to whole pixels.  This can be one pixel
+ * wider or taller than what rsvg_handle_get_dimensions_sub() returns
+ * for an element at a fractional position.
+ *
+ * Returns: %FALSE if there is no such element, or if it doesn't paint
+ *   anything.
+ *
+ * Since: 2.42
+ */
+gboolean
+rsvg_handle_get_dimensions_sub_cropped (RsvgHandle * handle, RsvgDimensionData * dimension_data, const char *id)
+{
+    RsvgNode *node;
+    cairo_rectangle_int_t extents;
+
+    g_return_val_if_fail (handle, FALSE);
+    g_return_val_if_fail (dimension_data, FALSE);
+
+    memset (dimension_data, 0, sizeof (RsvgDimensionData));
+
+    if (!handle->priv->finished)
+        return FALSE;
+
+    if (id && *id)
+        node = rsvg_defs_lookup (handle->priv->defs, id);
+    else
+        node = handle->priv->treebase;
+
+    if (node == NULL)
+        return FALSE;
+
+    if (!_rsvg_handle_get_node_pixel_extents (handle, node, &extents))
+        return FALSE;
+
+    dimension_data->width = extents.width;
+    dimension_data->height = extents.height;
+    dimension_data->em = extents.width;
+    dimension_data->ex = extents.height;
+
+    return TRUE;
+}
+
 /**
  * rsvg_handle_get_position_sub:
  * @handle: A #RsvgHandle
@@ -1624,13 +1816,9 @@ rsvg_handle_get_dimensions_sub (RsvgHandle * handle, RsvgDimensionData * dimensi
 gboolean
 rsvg_handle_get_position_sub (RsvgHandle * handle, RsvgPositionData * position_data, const char *id)
 {
-    RsvgDrawingCtx		*draw;
     RsvgNode			*node;
     RsvgBbox			 bbox;
     RsvgDimensionData    dimension_data;
-    cairo_surface_t		*target = NULL;
-    cairo_t				*cr = NULL;
-    gboolean			 ret = FALSE;
 
     g_return_val_if_fail (handle, FALSE);
     g_return_val_if_fail (position_data, FALSE);
@@ -1658,19 +1846,8 @@ rsvg_handle_get_position_sub (RsvgHandle * handle, RsvgPositionData * position_d
     if (!handle->priv->treebase)
         return FALSE;
 
-    target = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 1, 1);
-    cr = cairo_create  (target);
-    draw = rsvg_cairo_new_drawing_ctx (cr, handle);
-    if (!draw)
-        goto bail;
-
-    g_assert (node != NULL);
-    rsvg_drawing_ctx_add_node_and_ancestors_to_stack (draw, node);
-
-    rsvg_drawing_ctx_draw_node_from_stack (draw, handle->priv->treebase, 0);
-    bbox = RSVG_CAIRO_RENDER (draw->render)->bbox;
-
-    rsvg_drawing_ctx_free (draw);
+    if (!_rsvg_handle_get_node_bbox (handle, node, &bbox))
+        return FALSE;
 
     position_data->x = bbox.rect.x;
     position_data->y = bbox.rect.y;
@@ -1684,15 +1861,7 @@ rsvg_handle_get_position_sub (RsvgHandle * handle, RsvgPositionData * position_d
         (*handle->priv->size_func) (&dimension_data.width, &dimension_data.height,
                                     handle->priv->user_data);
 
-    ret = TRUE;
-
-bail:
-    if (cr)
-        cairo_destroy (cr);
-    if (target)
-        cairo_surface_destroy (target);
-
-    return ret;
+    return TRUE;
 }
 
 /**
@@ -1718,6 +1887,297 @@ rsvg_handle_has_sub (RsvgHandle * handle,
     return rsvg_defs_lookup (handle->priv->defs, id) != NULL;
 }
 
+typedef struct {
+    GHashTable *ids_by_state;
+    GPtrArray *ids;
+} GroupIdsClosure;
+
+static void
+add_group_to_table (gpointer key, gpointer value, gpointer data)
+{
+    const char *id = key;
+    RsvgNode *node = value;
+    GroupIdsClosure *closure = data;
+
+    /* Nodes don't know their own id, and each node owns exactly one
+     * RsvgState, so we use that as a key to find the id of the groups
+     * we run into while walking the tree.
+     */
+    if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_GROUP)
+        g_hash_table_insert (closure->ids_by_state, rsvg_node_get_state (node), (gpointer) id);
+}
+
+static gboolean
+collect_group_ids (RsvgNode *node, gpointer data)
+{
+    GroupIdsClosure *closure = data;
+    const char *id;
+
+    switch (rsvg_node_get_type (node)) {
+    case RSVG_NODE_TYPE_GROUP:
+        id = g_hash_table_lookup (closure->ids_by_state, rsvg_node_get_state (node));
+        if (id)
+            g_ptr_array_add (closure->ids, g_strconcat ("#", id, NULL));
+
+        /* fall through */
+
+    case RSVG_NODE_TYPE_SVG:
+    case RSVG_NODE_TYPE_SWITCH:
+        rsvg_node_foreach_child (node, collect_group_ids, closure);
+        break;
+
+    default:
+        /* Everything else is either a leaf, or a container like <defs>
+         * or <symbol> whose children don't get rendered by themselves.
+         */
+        break;
+    }
+
+    return TRUE;
+}
+
+/**
+ * rsvg_handle_get_group_ids:
+ * @handle: a #RsvgHandle
+ *
+ * Gets the ids of all the groups (&lt;g&gt; elements) which have an id
+ * and which get rendered as part of the document, i.e. which are not
+ * inside &lt;defs&gt;, &lt;symbol&gt;, and the like.  The ids are in
+ * document order and have a "#" prepended to them, so they can be
+ * passed directly to rsvg_handle_get_pixbuf_sub_cropped() or
+ * rsvg_handle_foreach_pixbuf_sub_cropped().
+ *
+ * This is useful to extract all the icons from a sprite sheet.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): a %NULL-terminated
+ * array of ids; free it with g_strfreev().
+ *
+ * Since: 2.42
+ */
+gchar **
+rsvg_handle_get_group_ids (RsvgHandle *handle)
+{
+    GroupIdsClosure closure;
+
+    g_return_val_if_fail (handle, NULL);
+
+    closure.ids_by_state = g_hash_table_new (g_direct_hash, g_direct_equal);
+    closure.ids = g_ptr_array_new ();
+
+    if (handle->priv->treebase) {
+        rsvg_defs_foreach (handle->priv->defs, add_group_to_table, &closure);
+        collect_group_ids (handle->priv->treebase, &closure);
+    }
+
+    g_hash_table_destroy (closure.ids_by_state);
+
+    g_ptr_array_add (closure.ids, NULL);
+
+    return (gchar **) g_ptr_array_free (closure.ids, FALSE);
+}
+
+typedef struct {
+    const char *id;
+    gboolean drawn;
+    RsvgBbox bbox;
+} ElementBounds;
+
+struct _RsvgBoundsCollector {
+    GHashTable *bounds_by_state; /* RsvgState of a node -> ElementBounds */
+    GPtrArray *drawn;            /* ElementBounds, in painting order */
+    cairo_matrix_t affine;       /* of the toplevel bounding box */
+};
+
+static void
+add_element_to_collector (gpointer key, gpointer value, gpointer data)
+{
+    RsvgNode *node = value;
+    RsvgBoundsCollector *collector = data;
+    ElementBounds *bounds;
+
+    bounds = g_new0 (ElementBounds, 1);
+    bounds->id = key;
+
+    g_hash_table_insert (collector->bounds_by_state, rsvg_node_get_state (node), bounds);
+}
+
+/* Computes the bounds of all the elements with an id in a single walk of
+ * the tree, and keeps them in a spatial index for hit-testing.  The index
+ * lives until something that affects geometry changes on the handle.
+ */
+static RsvgSpatialIndex *
+get_element_bounds_index (RsvgHandle *handle)
+{
+    cairo_surface_t *target;
+    cairo_t *cr;
+    RsvgDrawingCtx *draw;
+    RsvgBoundsCollector collector;
+    RsvgSpatialIndex *spatial_index;
+    guint i;
+
+    if (handle->priv->element_bounds)
+        return handle->priv->element_bounds;
+
+    if (!handle->priv->finished || !handle->priv->treebase)
+        return NULL;
+
+    target = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 1, 1);
+    cr = cairo_create (target);
+
+    draw = rsvg_cairo_new_bbox_drawing_ctx (cr, handle);
+    if (!draw) {
+        cairo_destroy (cr);
+        cairo_surface_destroy (target);
+        return NULL;
+    }
+
+    collector.bounds_by_state = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    collector.drawn = g_ptr_array_new ();
+    collector.affine = RSVG_CAIRO_RENDER (draw->render)->bbox.affine;
+
+    rsvg_defs_foreach (handle->priv->defs, add_element_to_collector, &collector);
+
+    draw->bounds_collector = &collector;
+    rsvg_drawing_ctx_draw_node_from_stack (draw, handle->priv->treebase, 0);
+    draw->bounds_collector = NULL;
+
+    spatial_index = rsvg_spatial_index_new (g_free);
+
+    for (i = 0; i < collector.drawn->len; i++) {
+        ElementBounds *bounds = g_ptr_array_index (collector.drawn, i);
+
+        if (!bounds->bbox.virgin)
+            rsvg_spatial_index_insert (spatial_index, &bounds->bbox.rect, g_strconcat ("#", bounds->id, NULL));
+    }
+
+    g_ptr_array_free (collector.drawn, TRUE);
+    g_hash_table_destroy (collector.bounds_by_state);
+
+    rsvg_drawing_ctx_free (draw);
+    cairo_destroy (cr);
+    cairo_surface_destroy (target);
+
+    handle->priv->element_bounds = spatial_index;
+
+    return spatial_index;
+}
+
+static void
+invalidate_element_bounds (RsvgHandle *handle)
+{
+    if (handle->priv->element_bounds) {
+        rsvg_spatial_index_free (handle->priv->element_bounds);
+        handle->priv->element_bounds = NULL;
+    }
+}
+
+static void
+add_bounds_to_table (const cairo_rectangle_t *rect, gpointer data, gpointer user_data)
+{
+    GHashTable *table = user_data;
+    RsvgRectangle *bounds;
+
+    bounds = g_new (RsvgRectangle, 1);
+    bounds->x = rect->x;
+    bounds->y = rect->y;
+    bounds->width = rect->width;
+    bounds->height = rect->height;
+
+    g_hash_table_insert (table, g_strdup (data), bounds);
+}
+
+/**
+ * rsvg_handle_get_element_bounds:
+ * @handle: a #RsvgHandle
+ *
+ * Gets the bounding boxes of all the elements which have an id and which
+ * get rendered, in a single pass over the document.  This is much faster
+ * than calling rsvg_handle_get_position_sub() and
+ * rsvg_handle_get_dimensions_sub() for each element.
+ *
+ * The ids have a "#" prepended to them, and the bounding boxes are in the
+ * same coordinate space as rsvg_handle_get_position_sub().  They take
+ * transformations and strokes into account.  Elements which are hidden,
+ * or which are inside &lt;defs&gt; and not referenced by a &lt;use&gt;,
+ * are left out.
+ *
+ * Returns: (transfer full) (element-type utf8 RsvgRectangle): a table which
+ * maps ids to #RsvgRectangle, or %NULL if the document isn't fully loaded.
+ * Free it with g_hash_table_destroy().
+ *
+ * Since: 2.42
+ */
+GHashTable *
+rsvg_handle_get_element_bounds (RsvgHandle *handle)
+{
+    RsvgSpatialIndex *spatial_index;
+    GHashTable *table;
+
+    g_return_val_if_fail (handle, NULL);
+
+    spatial_index = get_element_bounds_index (handle);
+    if (!spatial_index)
+        return NULL;
+
+    table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    rsvg_spatial_index_foreach (spatial_index, add_bounds_to_table, table);
+
+    return table;
+}
+
+/**
+ * rsvg_handle_pick:
+ * @handle: a #RsvgHandle
+ * @area: the area to test, in the same coordinate space as
+ *   rsvg_handle_get_position_sub().  Use a width and height of zero to
+ *   test a single point.
+ *
+ * Finds the elements with an id whose bounding box intersects @area, for
+ * example to find out what is under the pointer in an interactive
+ * document.  The bounding boxes are computed once and kept in a spatial
+ * index, so calling this repeatedly is cheap.
+ *
+ * Hit-testing happens at the level of bounding boxes, including strokes;
+ * elements which aren't rendered are never picked.  See
+ * rsvg_handle_get_element_bounds() for details.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): a %NULL-terminated
+ * array of ids, with a "#" prepended to them, topmost element first.  Free
+ * it with g_strfreev().
+ *
+ * Since: 2.42
+ */
+gchar **
+rsvg_handle_pick (RsvgHandle *handle, const RsvgRectangle *area)
+{
+    RsvgSpatialIndex *spatial_index;
+    GPtrArray *hits;
+    cairo_rectangle_t rect;
+    guint i;
+
+    g_return_val_if_fail (handle, NULL);
+    g_return_val_if_fail (area, NULL);
+
+    hits = g_ptr_array_new ();
+
+    spatial_index = get_element_bounds_index (handle);
+    if (spatial_index) {
+        rect.x = area->x;
+        rect.y = area->y;
+        rect.width = area->width;
+        rect.height = area->height;
+
+        rsvg_spatial_index_query (spatial_index, &rect, hits);
+
+        for (i = 0; i < hits->len; i++)
+            g_ptr_array_index (hits, i) = g_strdup (g_ptr_array_index (hits, i));
+    }
+
+    g_ptr_array_add (hits, NULL);
+
+    return (gchar **) g_ptr_array_free (hits, FALSE);
+}
+
 /**
  * rsvg_set_default_dpi:
  * @dpi: Dots Per Inch (aka Pixels Per Inch)
@@ -1802,6 +2262,8 @@ rsvg_handle_set_dpi_x_y (RsvgHandle * handle, double dpi_x, double dpi_y)
         handle->priv->dpi_y = rsvg_internal_dpi_y;
     else
         handle->priv->dpi_y = dpi_y;
+
+    invalidate_element_bounds (handle);
 }
 
 /**
@@ -1857,6 +2319,8 @@ rsvg_handle_set_size_callback (RsvgHandle * handle,
     handle->priv->size_func = size_func;
     handle->priv->user_data = user_data;
     handle->priv->user_data_destroy = user_data_destroy;
+
+    invalidate_element_bounds (handle);
 }
 
 /**
@@ -2148,6 +2612,8 @@ rsvg_handle_internal_set_testing (RsvgHandle *handle, gboolean testing)
     g_return_if_fail (RSVG_IS_HANDLE (handle));
 
     handle->priv->is_testing = testing ? TRUE : FALSE;
+
+    invalidate_element_bounds (handle);
 }
 
 /**
@@ -2180,13 +2646,16 @@ rsvg_term (void)
  * rsvg_cleanup:
  *
  * This function should not be called from normal programs.
- * See xmlCleanupParser() for more information.
+ * See xmlCleanupParser() for more information.  It also drops the
+ * images and style sheets that librsvg keeps for reuse by other handles.
  *
  * Since: 2.36
  **/
 void
 rsvg_cleanup (void)
 {
+    rsvg_image_cache_clear ();
+    rsvg_stylesheet_cache_clear ();
     xmlCleanupParser ();
 }
 
@@ -2314,6 +2783,42 @@ rsvg_drawing_ctx_add_node_and_ancestors_to_stack (RsvgDrawingCtx *draw_ctx, Rsvg
     }
 }
 
+/* Draws @node with a fresh bounding box, so that we can record the bounds
+ * of the node itself before merging them into those of its parent.
+ */
+static void
+draw_node_collecting_bounds (RsvgDrawingCtx *ctx, RsvgNode *node, int dominate)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgBoundsCollector *collector = ctx->bounds_collector;
+    ElementBounds *bounds;
+    RsvgBbox parent_bbox;
+
+    bounds = g_hash_table_lookup (collector->bounds_by_state, rsvg_node_get_state (node));
+
+    /* Elements which get drawn more than once, like those referenced
+     * by several <use>, keep the bounds of the first instance.
+     */
+    if (bounds == NULL || bounds->drawn) {
+        rsvg_node_draw (node, ctx, dominate);
+        return;
+    }
+
+    bounds->drawn = TRUE;
+    g_ptr_array_add (collector->drawn, bounds);
+
+    parent_bbox = render->bbox;
+    rsvg_bbox_init (&render->bbox, &parent_bbox.affine);
+
+    rsvg_node_draw (node, ctx, dominate);
+
+    rsvg_bbox_init (&bounds->bbox, &collector->affine);
+    rsvg_bbox_insert (&bounds->bbox, &render->bbox);
+
+    rsvg_bbox_insert (&parent_bbox, &render->bbox);
+    render->bbox = parent_bbox;
+}
+
 void
 rsvg_drawing_ctx_draw_node_from_stack (RsvgDrawingCtx *ctx, RsvgNode *node, int dominate)
 {
@@ -2335,7 +2840,10 @@ rsvg_drawing_ctx_draw_node_from_stack (RsvgDrawingCtx *ctx, RsvgNode *node, int
     if (state->visible) {
         rsvg_state_push (ctx);
 
-        rsvg_node_draw (node, ctx, dominate);
+        if (ctx->bounds_collector)
+            draw_node_collecting_bounds (ctx, node, dominate);
+        else
+            rsvg_node_draw (node, ctx, dominate);
 
         rsvg_state_pop (ctx);
     }
@@ -2343,6 +2851,161 @@ rsvg_drawing_ctx_draw_node_from_stack (RsvgDrawingCtx *ctx, RsvgNode *node, int
     ctx->drawsub_stack = stacksave;
 }
 
+/* Elements which are <use>d many times, like the symbols of icon sets or
+ * CAD exports, are recorded the first time they are drawn with a given
+ * scale and inherited style, and replayed after that.  The recordings
+ * live in the handle, so they are reused across renders.
+ */
+typedef struct {
+    RsvgState *inherited;       /* copy of the state the element inherited from */
+    double scale;
+    double vb_width;
+    double vb_height;
+    double dpi_x;
+    double dpi_y;
+    gboolean is_testing;
+    cairo_surface_t *surface;   /* NULL if the element draws nothing */
+    cairo_rectangle_t extents;
+} RsvgInstance;
+
+struct _RsvgNodeInstances {
+    gboolean recordable;
+    RsvgInstance entries[8];
+    guint n_entries;
+    guint next;
+};
+
+static void
+instance_clear (RsvgInstance *instance)
+{
+    rsvg_state_free (instance->inherited);
+
+    if (instance->surface)
+        cairo_surface_destroy (instance->surface);
+}
+
+void
+rsvg_node_instances_free (RsvgNodeInstances *instances)
+{
+    guint i;
+
+    for (i = 0; i < instances->n_entries; i++)
+        instance_clear (&instances->entries[i]);
+
+    g_free (instances);
+}
+
+static RsvgNodeInstances *
+get_node_instances (RsvgDrawingCtx *ctx, RsvgNode *node)
+{
+    RsvgNodeInstances *instances;
+
+    if (ctx->instances == NULL || !rsvg_cairo_can_record (ctx))
+        return NULL;
+
+    instances = g_hash_table_lookup (ctx->instances, rsvg_node_get_state (node));
+    if (instances == NULL) {
+        instances = g_new0 (RsvgNodeInstances, 1);
+        instances->recordable = rsvg_cairo_subtree_can_be_recorded (node);
+        g_hash_table_insert (ctx->instances, rsvg_node_get_state (node), instances);
+    }
+
+    return instances->recordable ? instances : NULL;
+}
+
+static gboolean
+instance_matches (RsvgInstance *instance, RsvgDrawingCtx *ctx, double scale)
+{
+    return (instance->scale == scale
+            && instance->vb_width == ctx->vb.rect.width
+            && instance->vb_height == ctx->vb.rect.height
+            && instance->dpi_x == ctx->dpi_x
+            && instance->dpi_y == ctx->dpi_y
+            && instance->is_testing == ctx->is_testing
+            && rsvg_state_inherits_equal (instance->inherited, rsvg_current_state (ctx)));
+}
+
+/* Whether @node can be drawn through rsvg_drawing_ctx_lookup_instance()
+ * in this drawing context.
+ */
+gboolean
+rsvg_drawing_ctx_can_instance (RsvgDrawingCtx *ctx, RsvgNode *node)
+{
+    return get_node_instances (ctx, node) != NULL;
+}
+
+/* Looks for a recording of @node that was made with the current state as
+ * the inherited style, and with @scale as the uniform scale of the
+ * current transformation.  On success, @surface gets the recording,
+ * which may be %NULL if the node draws nothing, and @extents gets its
+ * bounding box.
+ */
+gboolean
+rsvg_drawing_ctx_lookup_instance (RsvgDrawingCtx *ctx,
+                                  RsvgNode *node,
+                                  double scale,
+                                  cairo_surface_t **surface,
+                                  cairo_rectangle_t *extents)
+{
+    RsvgNodeInstances *instances;
+    guint i;
+
+    instances = get_node_instances (ctx, node);
+    if (instances == NULL)
+        return FALSE;
+
+    for (i = 0; i < instances->n_entries; i++) {
+        RsvgInstance *instance = &instances->entries[i];
+
+        if (instance_matches (instance, ctx, scale)) {
+            *surface = instance->surface;
+            *extents = instance->extents;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Stores a recording of @node, as made by rsvg_cairo_pop_recording(), for
+ * rsvg_drawing_ctx_lookup_instance() to find.
+ */
+void
+rsvg_drawing_ctx_add_instance (RsvgDrawingCtx *ctx,
+                               RsvgNode *node,
+                               double scale,
+                               cairo_surface_t *surface,
+                               const cairo_rectangle_t *extents)
+{
+    RsvgNodeInstances *instances;
+    RsvgInstance *instance;
+
+    instances = get_node_instances (ctx, node);
+    if (instances == NULL)
+        return;
+
+    instance = &instances->entries[instances->next];
+
+    if (instances->n_entries == G_N_ELEMENTS (instances->entries))
+        instance_clear (instance);
+
+    instance->inherited = rsvg_state_new ();
+    rsvg_state_clone (instance->inherited, rsvg_current_state (ctx));
+    instance->scale = scale;
+    instance->vb_width = ctx->vb.rect.width;
+    instance->vb_height = ctx->vb.rect.height;
+    instance->dpi_x = ctx->dpi_x;
+    instance->dpi_y = ctx->dpi_y;
+    instance->is_testing = ctx->is_testing;
+    instance->surface = surface ? cairo_surface_reference (surface) : NULL;
+
+    if (surface)
+        instance->extents = *extents;
+
+    instances->next = (instances->next + 1) % G_N_ELEMENTS (instances->entries);
+    instances->n_entries = MIN (instances->n_entries + 1, G_N_ELEMENTS (instances->entries));
+}
+
 cairo_matrix_t
 rsvg_drawing_ctx_get_current_state_affine (RsvgDrawingCtx *ctx)
 {
@@ -2376,7 +3039,7 @@ rsvg_get_normalized_stroke_width (RsvgDrawingCtx *ctx)
 {
     RsvgState *state = rsvg_current_state (ctx);
 
-    return rsvg_length_normalize (&state->stroke_width, ctx);
+    return rsvg_length_normalize (&state->paint->stroke_width, ctx);
 }
 
 
@@ -2385,7 +3048,7 @@ rsvg_get_start_marker (RsvgDrawingCtx *ctx)
 {
     RsvgState *state = rsvg_current_state (ctx);
 
-    return state->startMarker;
+    return state->paint->startMarker;
 }
 
 const char *
@@ -2393,7 +3056,7 @@ rsvg_get_middle_marker (RsvgDrawingCtx *ctx)
 {
     RsvgState *state = rsvg_current_state (ctx);
 
-    return state->middleMarker;
+    return state->paint->middleMarker;
 }
 
 const char *
@@ -2401,7 +3064,7 @@ rsvg_get_end_marker (RsvgDrawingCtx *ctx)
 {
     RsvgState *state = rsvg_current_state (ctx);
 
-    return state->endMarker;
+    return state->paint->endMarker;
 }
 
 void
@@ -2602,6 +3265,238 @@ _rsvg_handle_resolve_uri (RsvgHandle *handle,
     return resolved_uri;
 }
 
+/* Resolves @url relative to the handle's base URI, and checks that the
+ * handle may load it.  Returns the resolved URI, or %NULL if it can't be
+ * loaded.
+ */
+char *
+_rsvg_handle_resolve_allowed_uri (RsvgHandle *handle,
+                                  const char *url,
+                                  GError **error)
+{
+    char *uri;
+
+    uri = _rsvg_handle_resolve_uri (handle, url);
+
+    if (!_rsvg_handle_allow_load (handle, uri, error)) {
+        g_free (uri);
+        return NULL;
+    }
+
+    return uri;
+}
+
+/* External resources that the document refers to, like the files of
+ * <image> elements or of the documents that <use> pulls elements from,
+ * are read by worker threads as soon as the parser sees them, while
+ * parsing goes on, and after it.  _rsvg_handle_acquire_data() picks up
+ * the results, waiting only for the one it needs.  Loading them still
+ * goes through the handle's policy and cancellable.
+ */
+typedef struct {
+    volatile gint ref_count;
+    char *uri;
+    char *base_uri;
+    GCancellable *cancellable;
+
+    /* Set by the worker; protected by the prefetch lock once done */
+    gboolean done;
+    char *data;
+    gsize len;
+    char *mime_type;
+    GError *error;
+} RsvgPrefetch;
+
+G_LOCK_DEFINE_STATIC (prefetch);
+static GCond prefetch_cond;
+
+static void
+rsvg_prefetch_unref (RsvgPrefetch *prefetch)
+{
+    if (!g_atomic_int_dec_and_test (&prefetch->ref_count))
+        return;
+
+    g_free (prefetch->uri);
+    g_free (prefetch->base_uri);
+    g_clear_object (&prefetch->cancellable);
+    g_free (prefetch->data);
+    g_free (prefetch->mime_type);
+    g_clear_error (&prefetch->error);
+    g_free (prefetch);
+}
+
+static void
+prefetch_thread (gpointer data, gpointer user_data)
+{
+    RsvgPrefetch *prefetch = data;
+    char *contents, *mime_type = NULL;
+    gsize len = 0;
+    GError *error = NULL;
+
+    contents = _rsvg_io_acquire_data (prefetch->uri,
+                                      prefetch->base_uri,
+                                      &mime_type,
+                                      &len,
+                                      prefetch->cancellable,
+                                      &error);
+
+    G_LOCK (prefetch);
+
+    prefetch->data = contents;
+    prefetch->len = len;
+    prefetch->mime_type = mime_type;
+    prefetch->error = error;
+    prefetch->done = TRUE;
+    g_cond_broadcast (&prefetch_cond);
+
+    G_UNLOCK (prefetch);
+
+    rsvg_prefetch_unref (prefetch);
+}
+
+static GThreadPool *
+get_prefetch_pool (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool)) {
+        GThreadPool *p;
+
+        p = g_thread_pool_new (prefetch_thread, NULL, g_get_num_processors (), FALSE, NULL);
+        g_once_init_leave (&pool, (gsize) p);
+    }
+
+    return (GThreadPool *) pool;
+}
+
+static void
+rsvg_prefetch_wait (RsvgPrefetch *prefetch)
+{
+    G_LOCK (prefetch);
+
+    while (!prefetch->done)
+        g_cond_wait (&prefetch_cond, &G_LOCK_NAME (prefetch));
+
+    G_UNLOCK (prefetch);
+}
+
+/* Starts reading @url in the background, if the handle may load it */
+void
+_rsvg_handle_prefetch (RsvgHandle *handle, const char *url)
+{
+    RsvgHandlePrivate *priv = handle->priv;
+    RsvgPrefetch *prefetch;
+    char *uri;
+
+    uri = _rsvg_handle_resolve_allowed_uri (handle, url, NULL);
+    if (uri == NULL)
+        return;
+
+    if (priv->prefetches == NULL)
+        priv->prefetches = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                  (GDestroyNotify) rsvg_prefetch_unref);
+
+    if (g_hash_table_lookup (priv->prefetches, uri)) {
+        g_free (uri);
+        return;
+    }
+
+    prefetch = g_new0 (RsvgPrefetch, 1);
+    prefetch->ref_count = 2; /* one for the table, one for the worker */
+    prefetch->uri = uri;
+    prefetch->base_uri = g_strdup (rsvg_handle_get_base_uri (handle));
+    prefetch->cancellable = priv->cancellable ? g_object_ref (priv->cancellable) : NULL;
+
+    g_hash_table_insert (priv->prefetches, prefetch->uri, prefetch);
+
+    g_thread_pool_push (get_prefetch_pool (), prefetch, NULL);
+}
+
+/* Waits for all the resources that are being read in the background */
+static void
+join_prefetches (RsvgHandle *handle)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (handle->priv->prefetches == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, handle->priv->prefetches);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        rsvg_prefetch_wait (value);
+}
+
+/* Drops what was read ahead for @uri, if anything; a read that is still
+ * going on finishes in the background and frees its result.
+ */
+void
+_rsvg_handle_drop_prefetch (RsvgHandle *handle, const char *uri)
+{
+    if (handle->priv->prefetches)
+        g_hash_table_remove (handle->priv->prefetches, uri);
+}
+
+/* Drops everything that was read ahead and not used yet */
+void
+_rsvg_handle_drop_prefetches (RsvgHandle *handle)
+{
+    if (handle->priv->prefetches)
+        g_hash_table_remove_all (handle->priv->prefetches);
+}
+
+/* Waits for the background reads and drops whatever they read */
+void
+_rsvg_handle_free_prefetches (RsvgHandle *handle)
+{
+    join_prefetches (handle);
+    g_clear_pointer (&handle->priv->prefetches, g_hash_table_destroy);
+}
+
+/* Hands over the data that was read in the background for @uri, if any.
+ * Returns FALSE if @uri wasn't prefetched.
+ */
+static gboolean
+take_prefetched_data (RsvgHandle *handle,
+                      const char *uri,
+                      char **data,
+                      char **content_type,
+                      gsize *len,
+                      GError **error)
+{
+    RsvgPrefetch *prefetch;
+    gpointer key;
+
+    if (handle->priv->prefetches == NULL)
+        return FALSE;
+
+    if (!g_hash_table_lookup_extended (handle->priv->prefetches, uri, &key, (gpointer *) &prefetch))
+        return FALSE;
+
+    g_hash_table_steal (handle->priv->prefetches, uri);
+
+    rsvg_prefetch_wait (prefetch);
+
+    *data = prefetch->data;
+    prefetch->data = NULL;
+
+    if (*data) {
+        *len = prefetch->len;
+
+        if (content_type) {
+            *content_type = prefetch->mime_type;
+            prefetch->mime_type = NULL;
+        }
+    } else if (prefetch->error) {
+        g_propagate_error (error, prefetch->error);
+        prefetch->error = NULL;
+    }
+
+    rsvg_prefetch_unref (prefetch);
+
+    return TRUE;
+}
+
 char *
 _rsvg_handle_acquire_data (RsvgHandle *handle,
                            const char *url,
@@ -2612,19 +3507,22 @@ _rsvg_handle_acquire_data (RsvgHandle *handle,
     char *uri;
     char *data;
 
-    uri = _rsvg_handle_resolve_uri (handle, url);
+    uri = _rsvg_handle_resolve_allowed_uri (handle, url, error);
+    if (uri == NULL)
+        return NULL;
 
-    if (_rsvg_handle_allow_load (handle, uri, error)) {
-        data = _rsvg_io_acquire_data (uri,
-                                      rsvg_handle_get_base_uri (handle),
-                                      content_type,
-                                      len,
-                                      handle->priv->cancellable,
-                                      error);
-    } else {
-        data = NULL;
+    if (take_prefetched_data (handle, uri, &data, content_type, len, error)) {
+        g_free (uri);
+        return data;
     }
 
+    data = _rsvg_io_acquire_data (uri,
+                                  rsvg_handle_get_base_uri (handle),
+                                  content_type,
+                                  len,
+                                  handle->priv->cancellable,
+                                  error);
+
     g_free (uri);
     return data;
 }
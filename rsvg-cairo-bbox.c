@@ -0,0 +1,170 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-cairo-bbox.c: Bounding box computation with the cairo backend
+
+   Copyright (C) 2005 Dom Lachowicz <cinamod@hotmail.com>
+   Caleb Moore <c.moore@student.unsw.edu.au>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+/* This render walks the tree exactly like the cairo render does, but it
+ * only accumulates bounding boxes: nothing gets painted, no intermediate
+ * surfaces are allocated, and filters, masks, clipping paths and paint
+ * servers are never evaluated, since none of them affect the bounding box.
+ */
+
+#include "rsvg-cairo-bbox.h"
+#include "rsvg-cairo-draw.h"
+#include "rsvg-styles.h"
+#include "rsvg-mask.h"
+
+/* Layers must be mirrored here, since a layer's bounding box is accumulated
+ * in the layer's own coordinate system before being merged into its parent.
+ */
+static gboolean
+rsvg_cairo_bbox_needs_layer (RsvgDrawingCtx * ctx)
+{
+    RsvgState *state = rsvg_current_state (ctx);
+    gboolean lateclip = FALSE;
+
+    if (state->clip_path) {
+        RsvgNode *node;
+        node = rsvg_drawing_ctx_acquire_node_of_type (ctx, state->clip_path, RSVG_NODE_TYPE_CLIP_PATH);
+        if (node) {
+            RsvgClipPath *clip_path = rsvg_rust_cnode_get_impl (node);
+
+            lateclip = (clip_path->units == objectBoundingBox);
+            rsvg_drawing_ctx_release_node (ctx, node);
+        }
+    }
+
+    return rsvg_cairo_state_needs_layer (state, lateclip);
+}
+
+static void
+rsvg_cairo_bbox_push_discrete_layer (RsvgDrawingCtx * ctx)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgBbox *bbox;
+
+    if (!rsvg_cairo_bbox_needs_layer (ctx))
+        return;
+
+    bbox = g_new0 (RsvgBbox, 1);
+    *bbox = render->bbox;
+    render->bb_stack = g_list_prepend (render->bb_stack, bbox);
+    rsvg_bbox_init (&render->bbox, &rsvg_current_state (ctx)->affine);
+}
+
+static void
+rsvg_cairo_bbox_pop_discrete_layer (RsvgDrawingCtx * ctx)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+
+    if (!rsvg_cairo_bbox_needs_layer (ctx))
+        return;
+
+    rsvg_bbox_insert ((RsvgBbox *) render->bb_stack->data, &render->bbox);
+
+    render->bbox = *((RsvgBbox *) render->bb_stack->data);
+
+    g_free (render->bb_stack->data);
+    render->bb_stack = g_list_delete_link (render->bb_stack, render->bb_stack);
+}
+
+static void
+rsvg_cairo_bbox_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgBbox bbox;
+
+    rsvg_cairo_bbox_push_discrete_layer (ctx);
+
+    rsvg_cairo_add_path_and_get_bbox (ctx, builder, &bbox);
+    cairo_new_path (render->cr);
+
+    rsvg_bbox_insert (&render->bbox, &bbox);
+
+    rsvg_cairo_bbox_pop_discrete_layer (ctx);
+}
+
+static void
+rsvg_cairo_bbox_render_pango_layout (RsvgDrawingCtx * ctx, PangoLayout * layout, double x, double y)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgState *state = rsvg_current_state (ctx);
+    RsvgBbox bbox;
+
+    if (!state->paint->fill && !state->paint->stroke)
+        return;
+
+    if (rsvg_cairo_get_pango_layout_bbox (ctx, layout, x, y, &bbox))
+        rsvg_bbox_insert (&render->bbox, &bbox);
+}
+
+static void
+rsvg_cairo_bbox_render_surface (RsvgDrawingCtx *ctx,
+                                cairo_surface_t *surface,
+                                double src_x,
+                                double src_y,
+                                double w,
+                                double h)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgState *state = rsvg_current_state (ctx);
+    RsvgBbox bbox;
+
+    if (surface == NULL)
+        return;
+
+    if (cairo_image_surface_get_width (surface) == 0
+        || cairo_image_surface_get_height (surface) == 0)
+        return;
+
+    rsvg_bbox_init (&bbox, &state->affine);
+    bbox.rect.x = src_x;
+    bbox.rect.y = src_y;
+    bbox.rect.width = w;
+    bbox.rect.height = h;
+    bbox.virgin = 0;
+
+    rsvg_bbox_insert (&render->bbox, &bbox);
+}
+
+static void
+rsvg_cairo_bbox_add_clipping_rect (RsvgDrawingCtx * ctx, double x, double y, double w, double h)
+{
+}
+
+RsvgCairoRender *
+rsvg_cairo_bbox_render_new (cairo_t * cr, double width, double height)
+{
+    RsvgCairoRender *cairo_render = rsvg_cairo_render_new (cr, width, height);
+    RsvgRender *render = &cairo_render->super;
+
+    render->type = RSVG_RENDER_TYPE_CAIRO_BBOX;
+    render->render_pango_layout = rsvg_cairo_bbox_render_pango_layout;
+    render->render_surface = rsvg_cairo_bbox_render_surface;
+    render->render_path_builder = rsvg_cairo_bbox_render_path_builder;
+    render->pop_discrete_layer = rsvg_cairo_bbox_pop_discrete_layer;
+    render->push_discrete_layer = rsvg_cairo_bbox_push_discrete_layer;
+    render->add_clipping_rect = rsvg_cairo_bbox_add_clipping_rect;
+    render->get_surface_of_node = NULL;
+
+    return cairo_render;
+}
@@ -0,0 +1,38 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-cairo-bbox.h: Bounding box computation with the cairo backend
+
+   Copyright (C) 2005 Dom Lachowicz <cinamod@hotmail.com>
+   Caleb Moore <c.moore@student.unsw.edu.au>
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef RSVG_CAIRO_BBOX_H
+#define RSVG_CAIRO_BBOX_H
+
+#include "rsvg-cairo-render.h"
+#include <cairo.h>
+
+G_BEGIN_DECLS 
+
+G_GNUC_INTERNAL
+RsvgCairoRender *rsvg_cairo_bbox_render_new (cairo_t * cr, double width, double height);
+
+G_END_DECLS
+
+#endif
@@ -73,7 +73,7 @@ rsvg_cairo_clip_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *buil
 
     rsvg_cairo_clip_apply_affine (render, &state->affine);
 
-    cairo_set_fill_rule (cr, rsvg_current_state (ctx)->clip_rule);
+    cairo_set_fill_rule (cr, rsvg_current_state (ctx)->paint->clip_rule);
 
     rsvg_path_builder_add_to_cairo_context (builder, cr);
 }
@@ -138,17 +138,124 @@ rsvg_cairo_clip_render_new (cairo_t * cr, RsvgCairoRender *parent)
     return render;
 }
 
+/* Whether @path is a single rectangle with axis-aligned sides, as for a
+ * <rect> without rounded corners and without rotation.  Clipping to a
+ * box is much cheaper than clipping to a general path.
+ */
+static gboolean
+path_is_box (cairo_path_t *path, cairo_rectangle_t *box)
+{
+    double x[5], y[5];
+    int n_points = 0;
+    int i;
+
+    for (i = 0; i < path->num_data; i += path->data[i].header.length) {
+        cairo_path_data_t *data = &path->data[i];
+
+        switch (data->header.type) {
+        case CAIRO_PATH_MOVE_TO:
+            /* cairo adds a move-to after a close-path */
+            if (n_points != 0 && i + data->header.length < path->num_data)
+                return FALSE;
+            if (n_points == 0) {
+                x[0] = data[1].point.x;
+                y[0] = data[1].point.y;
+                n_points = 1;
+            }
+            break;
+
+        case CAIRO_PATH_LINE_TO:
+            if (n_points == 0 || n_points == 5)
+                return FALSE;
+            x[n_points] = data[1].point.x;
+            y[n_points] = data[1].point.y;
+            n_points++;
+            break;
+
+        case CAIRO_PATH_CLOSE_PATH:
+            break;
+
+        default:
+            return FALSE;
+        }
+    }
+
+    /* An explicit line back to the start is the same as closing the path */
+    if (n_points == 5) {
+        if (x[4] != x[0] || y[4] != y[0])
+            return FALSE;
+        n_points = 4;
+    }
+
+    if (n_points != 4)
+        return FALSE;
+
+    if (!((x[0] == x[1] && y[1] == y[2] && x[2] == x[3] && y[3] == y[0])
+          || (y[0] == y[1] && x[1] == x[2] && y[2] == y[3] && x[3] == x[0])))
+        return FALSE;
+
+    box->x = MIN (x[0], x[2]);
+    box->y = MIN (y[0], y[2]);
+    box->width = fabs (x[2] - x[0]);
+    box->height = fabs (y[2] - y[0]);
+
+    return TRUE;
+}
+
+/* Sets up @cr so that paths given in canvas coordinates end up in the
+ * right place on the target, which may be offset for the initial cr.
+ */
+static void
+set_canvas_matrix (RsvgCairoRender *render, cairo_t *cr)
+{
+    gboolean nest = cr != render->initial_cr;
+
+    cairo_identity_matrix (cr);
+    cairo_translate (cr,
+                     nest ? 0 : render->offset_x,
+                     nest ? 0 : render->offset_y);
+}
+
+static void
+apply_cached_clip (RsvgCairoRender *render, RsvgCairoClipMask *clip)
+{
+    cairo_t *cr = render->cr;
+
+    set_canvas_matrix (render, cr);
+    cairo_new_path (cr);
+
+    if (clip->is_box) {
+        cairo_rectangle (cr, clip->box.x, clip->box.y, clip->box.width, clip->box.height);
+    } else {
+        cairo_append_path (cr, clip->path);
+        cairo_set_fill_rule (cr, clip->fill_rule);
+    }
+
+    cairo_clip (cr);
+}
+
 void
 rsvg_cairo_clip (RsvgDrawingCtx * ctx, RsvgNode *node_clip_path, RsvgBbox * bbox)
 {
     RsvgClipPath *clip;
     RsvgCairoRender *save = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgCairoClipMask *cached;
     cairo_matrix_t affinesave;
     RsvgState *clip_path_state;
+    cairo_path_t *path;
 
     g_assert (rsvg_node_get_type (node_clip_path) == RSVG_NODE_TYPE_CLIP_PATH);
     clip = rsvg_rust_cnode_get_impl (node_clip_path);
 
+    if (clip->units != objectBoundingBox)
+        bbox = NULL;
+
+    cached = rsvg_cairo_lookup_clip_mask (ctx, node_clip_path, bbox, 0xff);
+    if (cached) {
+        apply_cached_clip (save, cached);
+        return;
+    }
+
     ctx->render = rsvg_cairo_clip_render_new (save->cr, save);
 
     clip_path_state = rsvg_node_get_state (node_clip_path);
@@ -175,6 +282,24 @@ rsvg_cairo_clip (RsvgDrawingCtx * ctx, RsvgNode *node_clip_path, RsvgBbox * bbox
         clip_path_state->affine = affinesave;
 
     g_free (ctx->render);
-    cairo_clip (save->cr);
     ctx->render = &save->super;
+
+    /* Keep the path in canvas coordinates for other elements */
+    set_canvas_matrix (save, save->cr);
+    path = cairo_copy_path (save->cr);
+
+    if (path->status == CAIRO_STATUS_SUCCESS) {
+        cached = rsvg_cairo_add_clip_mask (ctx, node_clip_path, bbox, 0xff);
+        cached->fill_rule = cairo_get_fill_rule (save->cr);
+        cached->is_box = path_is_box (path, &cached->box);
+
+        if (cached->is_box)
+            cairo_path_destroy (path);
+        else
+            cached->path = path;
+    } else {
+        cairo_path_destroy (path);
+    }
+
+    cairo_clip (save->cr);
 }
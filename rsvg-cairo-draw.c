@@ -128,32 +128,67 @@ rsvg_gradient_node_to_rust_gradient (RsvgNode *node)
     }
 }
 
-static void
-_set_source_rsvg_linear_gradient (RsvgDrawingCtx *ctx,
-                                  RsvgNode *node,
-                                  guint8 opacity, RsvgBbox bbox)
+static RsvgGradientCache *
+get_gradient_cache (RsvgNode *node)
 {
-    Gradient *gradient;
-
-    gradient = linear_gradient_to_rust (node);
-
-    gradient_resolve_fallbacks_and_set_pattern (gradient, ctx, opacity, bbox);
+    if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_LINEAR_GRADIENT) {
+        RsvgLinearGradient *linear = rsvg_rust_cnode_get_impl (node);
+        return &linear->cache;
+    } else {
+        RsvgRadialGradient *radial = rsvg_rust_cnode_get_impl (node);
 
-    gradient_destroy (gradient);
+        g_assert (rsvg_node_get_type (node) == RSVG_NODE_TYPE_RADIAL_GRADIENT);
+        return &radial->cache;
+    }
 }
 
 static void
-_set_source_rsvg_radial_gradient (RsvgDrawingCtx * ctx,
-                                  RsvgNode *node,
-                                  guint8 opacity, RsvgBbox bbox)
+_set_source_rsvg_gradient (RsvgDrawingCtx *ctx,
+                           RsvgNode *node,
+                           guint8 opacity, RsvgBbox bbox)
 {
-    Gradient *gradient;
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgGradientCache *cache = get_gradient_cache (node);
+    double font_size;
 
-    gradient = radial_gradient_to_rust (node);
+    if (cache->resolved == NULL) {
+        Gradient *gradient;
 
-    gradient_resolve_fallbacks_and_set_pattern (gradient, ctx, opacity, bbox);
+        gradient = rsvg_gradient_node_to_rust_gradient (node);
+        cache->resolved = gradient_resolve_fallbacks (gradient, ctx);
+        gradient_destroy (gradient);
+    }
 
-    gradient_destroy (gradient);
+    if (!gradient_is_user_space_on_use (cache->resolved)) {
+        gradient_set_pattern (cache->resolved, ctx, opacity, bbox);
+        return;
+    }
+
+    font_size = rsvg_drawing_ctx_get_normalized_font_size (ctx);
+
+    if (cache->pattern != NULL
+        && cache->opacity == opacity
+        && cache->dpi_x == ctx->dpi_x
+        && cache->dpi_y == ctx->dpi_y
+        && cache->vb_width == ctx->vb.rect.width
+        && cache->vb_height == ctx->vb.rect.height
+        && cache->font_size == font_size) {
+        cairo_set_source (render->cr, cache->pattern);
+        return;
+    }
+
+    gradient_set_pattern (cache->resolved, ctx, opacity, bbox);
+
+    if (cache->pattern)
+        cairo_pattern_destroy (cache->pattern);
+
+    cache->pattern = cairo_pattern_reference (cairo_get_source (render->cr));
+    cache->opacity = opacity;
+    cache->dpi_x = ctx->dpi_x;
+    cache->dpi_y = ctx->dpi_y;
+    cache->vb_width = ctx->vb.rect.width;
+    cache->vb_height = ctx->vb.rect.height;
+    cache->font_size = font_size;
 }
 
 static void
@@ -196,11 +231,9 @@ _set_source_rsvg_paint_server (RsvgDrawingCtx * ctx,
         node = rsvg_drawing_ctx_acquire_node (ctx, ps->core.iri->iri_str);
         if (node == NULL) {
             use_alternate = TRUE;
-        } else if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_LINEAR_GRADIENT) {
-            _set_source_rsvg_linear_gradient (ctx, node, opacity, bbox);
-            had_paint_server = TRUE;
-        } else if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_RADIAL_GRADIENT) {
-            _set_source_rsvg_radial_gradient (ctx, node, opacity, bbox);
+        } else if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_LINEAR_GRADIENT
+                   || rsvg_node_get_type (node) == RSVG_NODE_TYPE_RADIAL_GRADIENT) {
+            _set_source_rsvg_gradient (ctx, node, opacity, bbox);
             had_paint_server = TRUE;
         } else if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_PATTERN) {
             if (pattern_resolve_fallbacks_and_set_pattern (node, ctx, bbox)) {
@@ -326,58 +359,74 @@ static void
 setup_cr_for_stroke (cairo_t *cr, RsvgDrawingCtx *ctx, RsvgState *state)
 {
     cairo_set_line_width (cr, rsvg_get_normalized_stroke_width (ctx));
-    cairo_set_miter_limit (cr, state->miter_limit);
-    cairo_set_line_cap (cr, (cairo_line_cap_t) state->cap);
-    cairo_set_line_join (cr, (cairo_line_join_t) state->join);
-    cairo_set_dash (cr, state->dash.dash, state->dash.n_dash,
-                    rsvg_length_normalize (&state->dash.offset, ctx));
+    cairo_set_miter_limit (cr, state->paint->miter_limit);
+    cairo_set_line_cap (cr, (cairo_line_cap_t) state->paint->cap);
+    cairo_set_line_join (cr, (cairo_line_join_t) state->paint->join);
+    cairo_set_dash (cr, state->paint->dash.dash, state->paint->dash.n_dash,
+                    rsvg_length_normalize (&state->paint->dash.offset, ctx));
 }
 
-void
-rsvg_cairo_render_pango_layout (RsvgDrawingCtx * ctx, PangoLayout * layout, double x, double y)
+/* Computes the bounding box of the ink in @layout, when drawn at (@x, @y)
+ * with the current state.  Returns %FALSE if the layout doesn't have any ink.
+ */
+gboolean
+rsvg_cairo_get_pango_layout_bbox (RsvgDrawingCtx * ctx, PangoLayout * layout, double x, double y,
+                                  RsvgBbox * bbox)
 {
-    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
     RsvgState *state = rsvg_current_state (ctx);
     PangoRectangle ink;
-    RsvgBbox bbox;
     PangoGravity gravity = pango_context_get_gravity (pango_layout_get_context (layout));
-    double rotation;
 
     pango_layout_get_extents (layout, &ink, NULL);
 
     if (ink.width == 0 || ink.height == 0) {
-        return;
+        return FALSE;
     }
 
-    cairo_set_antialias (render->cr, state->text_rendering_type);
-
-    _set_rsvg_affine (render, &state->affine);
-
-    rsvg_bbox_init (&bbox, &state->affine);
+    rsvg_bbox_init (bbox, &state->affine);
     if (PANGO_GRAVITY_IS_VERTICAL (gravity)) {
-        bbox.rect.x = x + (ink.x - ink.height) / (double)PANGO_SCALE;
-        bbox.rect.y = y + ink.y / (double)PANGO_SCALE;
-        bbox.rect.width = ink.height / (double)PANGO_SCALE;
-        bbox.rect.height = ink.width / (double)PANGO_SCALE;
+        bbox->rect.x = x + (ink.x - ink.height) / (double)PANGO_SCALE;
+        bbox->rect.y = y + ink.y / (double)PANGO_SCALE;
+        bbox->rect.width = ink.height / (double)PANGO_SCALE;
+        bbox->rect.height = ink.width / (double)PANGO_SCALE;
     } else {
-        bbox.rect.x = x + ink.x / (double)PANGO_SCALE;
-        bbox.rect.y = y + ink.y / (double)PANGO_SCALE;
-        bbox.rect.width = ink.width / (double)PANGO_SCALE;
-        bbox.rect.height = ink.height / (double)PANGO_SCALE;
+        bbox->rect.x = x + ink.x / (double)PANGO_SCALE;
+        bbox->rect.y = y + ink.y / (double)PANGO_SCALE;
+        bbox->rect.width = ink.width / (double)PANGO_SCALE;
+        bbox->rect.height = ink.height / (double)PANGO_SCALE;
     }
-    bbox.virgin = 0;
+    bbox->virgin = 0;
+
+    return TRUE;
+}
+
+void
+rsvg_cairo_render_pango_layout (RsvgDrawingCtx * ctx, PangoLayout * layout, double x, double y)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgState *state = rsvg_current_state (ctx);
+    RsvgBbox bbox;
+    PangoGravity gravity = pango_context_get_gravity (pango_layout_get_context (layout));
+    double rotation;
+
+    if (!rsvg_cairo_get_pango_layout_bbox (ctx, layout, x, y, &bbox))
+        return;
+
+    cairo_set_antialias (render->cr, state->text->text_rendering_type);
+
+    _set_rsvg_affine (render, &state->affine);
 
     rotation = pango_gravity_to_rotation (gravity);
-    if (state->fill) {
+    if (state->paint->fill) {
         cairo_save (render->cr);
         cairo_move_to (render->cr, x, y);
         rsvg_bbox_insert (&render->bbox, &bbox);
 
         if (_set_source_rsvg_paint_server (ctx,
-                                           state->current_color,
-                                           state->fill,
-                                           state->fill_opacity,
-                                           bbox, rsvg_current_state (ctx)->current_color)) {
+                                           state->paint->current_color,
+                                           state->paint->fill,
+                                           state->paint->fill_opacity,
+                                           bbox, rsvg_current_state (ctx)->paint->current_color)) {
             if (rotation != 0.)
                 cairo_rotate (render->cr, -rotation);
             pango_cairo_show_layout (render->cr, layout);
@@ -386,16 +435,16 @@ rsvg_cairo_render_pango_layout (RsvgDrawingCtx * ctx, PangoLayout * layout, doub
         cairo_restore (render->cr);
     }
 
-    if (state->stroke) {
+    if (state->paint->stroke) {
         cairo_save (render->cr);
         cairo_move_to (render->cr, x, y);
         rsvg_bbox_insert (&render->bbox, &bbox);
 
         if (_set_source_rsvg_paint_server (ctx,
-                                           state->current_color,
-                                           state->stroke,
-                                           state->stroke_opacity,
-                                           bbox, rsvg_current_state (ctx)->current_color)) {
+                                           state->paint->current_color,
+                                           state->paint->stroke,
+                                           state->paint->stroke_opacity,
+                                           bbox, rsvg_current_state (ctx)->paint->current_color)) {
             if (rotation != 0.)
                 cairo_rotate (render->cr, -rotation);
             pango_cairo_layout_path (render->cr, layout);
@@ -411,28 +460,25 @@ rsvg_cairo_render_pango_layout (RsvgDrawingCtx * ctx, PangoLayout * layout, doub
 
 
 
+/* Sets up the render's cairo_t for the current state, adds the path from
+ * @builder to it, and computes the bounding box of the path's fill and
+ * stroke.  The path is left in the cairo_t.
+ */
 void
-rsvg_cairo_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder)
+rsvg_cairo_add_path_and_get_bbox (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder, RsvgBbox *bbox)
 {
     RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
     RsvgState *state = rsvg_current_state (ctx);
-    cairo_t *cr;
-    RsvgBbox bbox;
+    cairo_t *cr = render->cr;
     double backup_tolerance;
 
-    rsvg_cairo_push_discrete_layer (ctx);
-
-    cr = render->cr;
-
-    cairo_set_antialias (cr, state->shape_rendering_type);
-
     _set_rsvg_affine (render, &state->affine);
 
     setup_cr_for_stroke (cr, ctx, state);
 
     rsvg_path_builder_add_to_cairo_context (builder, cr);
 
-    rsvg_bbox_init (&bbox, &state->affine);
+    rsvg_bbox_init (bbox, &state->affine);
 
     backup_tolerance = cairo_get_tolerance (cr);
     cairo_set_tolerance (cr, 1.0);
@@ -455,50 +501,150 @@ rsvg_cairo_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder)
         fb.rect.width -= fb.rect.x;
         fb.rect.height -= fb.rect.y;
         fb.virgin = 0;
-        rsvg_bbox_insert (&bbox, &fb);
+        rsvg_bbox_insert (bbox, &fb);
     }
 
     /* Bounding box for stroke */
-    if (state->stroke != NULL) {
+    if (state->paint->stroke != NULL) {
         RsvgBbox sb;
         rsvg_bbox_init (&sb, &state->affine);
         cairo_stroke_extents (cr, &sb.rect.x, &sb.rect.y, &sb.rect.width, &sb.rect.height);
         sb.rect.width -= sb.rect.x;
         sb.rect.height -= sb.rect.y;
         sb.virgin = 0;
-        rsvg_bbox_insert (&bbox, &sb);
+        rsvg_bbox_insert (bbox, &sb);
     }
 
     cairo_set_tolerance (cr, backup_tolerance);
+}
 
-    rsvg_bbox_insert (&render->bbox, &bbox);
+/* Whether @ps multiplies its colors by the opacity it is set up with.
+ * Patterns are rendered as they are, so they don't.
+ */
+static gboolean
+paint_server_takes_opacity (RsvgDrawingCtx *ctx, RsvgPaintServer *ps)
+{
+    RsvgNode *node;
+    gboolean takes_opacity;
+
+    if (ps->type == RSVG_PAINT_SERVER_SOLID)
+        return TRUE;
+
+    node = rsvg_drawing_ctx_acquire_node (ctx, ps->core.iri->iri_str);
+    if (node == NULL)
+        return TRUE; /* the alternate color, if any */
+
+    takes_opacity = (rsvg_node_get_type (node) == RSVG_NODE_TYPE_LINEAR_GRADIENT
+                     || rsvg_node_get_type (node) == RSVG_NODE_TYPE_RADIAL_GRADIENT);
 
-    if (state->fill != NULL) {
-        int opacity;
+    rsvg_drawing_ctx_release_node (ctx, node);
 
-        cairo_set_fill_rule (cr, state->fill_rule);
+    return takes_opacity;
+}
+
+/* Whether @state only needs a layer because of its opacity, so that the
+ * opacity can be applied to whatever gets drawn in the layer instead.
+ */
+static gboolean
+layer_is_only_for_opacity (RsvgDrawingCtx *ctx, RsvgState *state)
+{
+    gboolean lateclip = FALSE;
+
+    if (state->opacity == 0xFF
+        || state->filter || state->mask
+        || state->comp_op != CAIRO_OPERATOR_OVER
+        || state->enable_background != RSVG_ENABLE_BACKGROUND_ACCUMULATE)
+        return FALSE;
+
+    if (state->clip_path) {
+        RsvgNode *node;
+
+        node = rsvg_drawing_ctx_acquire_node_of_type (ctx, state->clip_path, RSVG_NODE_TYPE_CLIP_PATH);
+        if (node == NULL)
+            return FALSE;
+
+        lateclip = ((RsvgClipPath *) rsvg_rust_cnode_get_impl (node))->units == objectBoundingBox;
+        rsvg_drawing_ctx_release_node (ctx, node);
+    }
+
+    return !lateclip;
+}
 
-        opacity = state->fill_opacity;
+/* A shape that is only filled or only stroked covers each pixel once:
+ * cairo computes the coverage of the whole path and composites the
+ * source through it in a single step, even if the path overlaps itself.
+ * Drawing it with its alpha multiplied by the opacity is then the same
+ * as drawing it into a layer and painting the layer with that opacity,
+ * up to rounding.  With both a fill and a stroke, the stroke would show
+ * the fill through it, and patterns ignore the opacity they are given.
+ */
+static gboolean
+paints_once (RsvgDrawingCtx *ctx, RsvgPaintServer *fill, RsvgPaintServer *stroke)
+{
+    if ((fill == NULL) == (stroke == NULL))
+        return FALSE;
+
+    return paint_server_takes_opacity (ctx, fill ? fill : stroke);
+}
+
+static guint8
+multiply_opacity (guint8 a, guint8 b)
+{
+    return (a * b + 127) / 255;
+}
+
+void
+rsvg_cairo_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgState *state = rsvg_current_state (ctx);
+    cairo_t *cr;
+    RsvgBbox bbox;
+    guint8 opacity, fill_opacity, stroke_opacity;
+
+    /* The paint style may be shared with other states, so the folded
+     * opacities are kept here.  Markers are drawn after the shape and
+     * inherit from it, so put back the opacity afterwards.
+     */
+    opacity = state->opacity;
+    fill_opacity = state->paint->fill_opacity;
+    stroke_opacity = state->paint->stroke_opacity;
+
+    if (layer_is_only_for_opacity (ctx, state) && paints_once (ctx, state->paint->fill, state->paint->stroke)) {
+        fill_opacity = multiply_opacity (fill_opacity, opacity);
+        stroke_opacity = multiply_opacity (stroke_opacity, opacity);
+        state->opacity = 0xFF;
+    }
+
+    rsvg_cairo_push_discrete_layer (ctx);
+
+    cr = render->cr;
+
+    cairo_set_antialias (cr, state->paint->shape_rendering_type);
+
+    rsvg_cairo_add_path_and_get_bbox (ctx, builder, &bbox);
+
+    rsvg_bbox_insert (&render->bbox, &bbox);
+
+    if (state->paint->fill != NULL) {
+        cairo_set_fill_rule (cr, state->paint->fill_rule);
 
         if (_set_source_rsvg_paint_server (ctx,
-                                           state->current_color,
-                                           state->fill,
-                                           opacity, bbox, rsvg_current_state (ctx)->current_color)) {
-            if (state->stroke != NULL)
+                                           state->paint->current_color,
+                                           state->paint->fill,
+                                           fill_opacity, bbox, rsvg_current_state (ctx)->paint->current_color)) {
+            if (state->paint->stroke != NULL)
                 cairo_fill_preserve (cr);
             else
                 cairo_fill (cr);
         }
     }
 
-    if (state->stroke != NULL) {
-        int opacity;
-        opacity = state->stroke_opacity;
-
+    if (state->paint->stroke != NULL) {
         if (_set_source_rsvg_paint_server (ctx,
-                                           state->current_color,
-                                           state->stroke,
-                                           opacity, bbox, rsvg_current_state (ctx)->current_color)) {
+                                           state->paint->current_color,
+                                           state->paint->stroke,
+                                           stroke_opacity, bbox, rsvg_current_state (ctx)->paint->current_color)) {
             cairo_stroke (cr);
         }
     }
@@ -506,6 +652,8 @@ rsvg_cairo_render_path_builder (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder)
     cairo_new_path (cr); /* clear the path in case stroke == fill == NULL; otherwise we leave it around from computing the bounding box */
 
     rsvg_cairo_pop_discrete_layer (ctx);
+
+    state->opacity = opacity;
 }
 
 void
@@ -604,56 +752,443 @@ rsvg_cairo_set_cairo_context (RsvgDrawingCtx *ctx, cairo_t *cr)
     render->cr = cr;
 }
 
-static void
-rsvg_cairo_generate_mask (cairo_t * cr, RsvgNode *node_mask, RsvgDrawingCtx *ctx, RsvgBbox *bbox)
+/* Whether pattern tiles should be kept as vector data instead of being
+ * rasterized, i.e. whether we are drawing to a PDF, PostScript or SVG
+ * surface.  Intermediate surfaces for those are recording surfaces, too.
+ */
+gboolean
+rsvg_cairo_pattern_tile_is_recording (RsvgDrawingCtx *ctx)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+
+    switch (cairo_surface_get_type (cairo_get_target (render->cr))) {
+    case CAIRO_SURFACE_TYPE_PDF:
+    case CAIRO_SURFACE_TYPE_PS:
+    case CAIRO_SURFACE_TYPE_SVG:
+    case CAIRO_SURFACE_TYPE_RECORDING:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+/* Creates the surface to draw a pattern's tile into.  Vector backends get
+ * a recording surface, so that the tile is emitted once as vector data and
+ * referenced from each place where the pattern is used.
+ */
+cairo_surface_t *
+rsvg_cairo_create_pattern_tile (RsvgDrawingCtx *ctx, int width, int height)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+
+    if (rsvg_cairo_pattern_tile_is_recording (ctx)) {
+        cairo_rectangle_t extents;
+
+        extents.x = 0;
+        extents.y = 0;
+        extents.width = width;
+        extents.height = height;
+
+        return cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, &extents);
+    }
+
+    return cairo_surface_create_similar (cairo_get_target (render->cr),
+                                         CAIRO_CONTENT_COLOR_ALPHA,
+                                         width, height);
+}
+
+/* How many device pixels a unit of the current user space spans along
+ * each axis.  Returns %FALSE if the output is not a raster image, in which
+ * case images should be kept at their full resolution.  Renderers that
+ * only compute geometry draw no pixels at all, so they get a scale of 0.
+ */
+gboolean
+rsvg_cairo_get_raster_scale (RsvgDrawingCtx *ctx, double *scale_x, double *scale_y)
+{
+    RsvgCairoRender *render;
+    cairo_matrix_t *affine = &rsvg_current_state (ctx)->affine;
+
+    if (ctx->render->type != RSVG_RENDER_TYPE_CAIRO) {
+        *scale_x = *scale_y = 0;
+        return TRUE;
+    }
+
+    render = RSVG_CAIRO_RENDER (ctx->render);
+    if (cairo_surface_get_type (cairo_get_target (render->initial_cr)) != CAIRO_SURFACE_TYPE_IMAGE)
+        return FALSE;
+
+    *scale_x = sqrt (affine->xx * affine->xx + affine->yx * affine->yx);
+    *scale_y = sqrt (affine->xy * affine->xy + affine->yy * affine->yy);
+
+    return TRUE;
+}
+
+/* Whether the drawing operations for a node's contents can be recorded
+ * once and replayed elsewhere with a different transformation.  Only the
+ * plain cairo renderer does actual drawing, and we can't record while
+ * drawing a sub-element, since that may skip the recorded contents.
+ */
+gboolean
+rsvg_cairo_can_record (RsvgDrawingCtx *ctx)
+{
+    return ctx->render->type == RSVG_RENDER_TYPE_CAIRO && ctx->drawsub_stack == NULL;
+}
+
+static gboolean
+subtree_can_be_recorded_cb (RsvgNode *node, gpointer data)
+{
+    gboolean *recordable = data;
+
+    *recordable = rsvg_cairo_subtree_can_be_recorded (node);
+
+    return *recordable;
+}
+
+/* Whether drawing a node and its children only depends on their
+ * transformation, and not on the surface they are drawn into.  Layers are
+ * as big as the whole canvas and in device space, and clip paths may need
+ * the layer's bounding box, so they can't be recorded in a node's own
+ * coordinate system.  A <use> can pull in any other element, so we don't
+ * try to follow it.
+ */
+gboolean
+rsvg_cairo_subtree_can_be_recorded (RsvgNode *node)
+{
+    RsvgState *state = rsvg_node_get_state (node);
+    gboolean recordable = TRUE;
+
+    if (rsvg_node_get_type (node) == RSVG_NODE_TYPE_USE
+        || state->clip_path != NULL
+        || rsvg_cairo_state_needs_layer (state, FALSE))
+        return FALSE;
+
+    rsvg_node_foreach_child (node, subtree_can_be_recorded_cb, &recordable);
+
+    return recordable;
+}
+
+/* Starts recording the drawing operations instead of executing them.  The
+ * recording's coordinate system is the state's affine; bounding boxes
+ * computed while recording are kept out of the enclosing layer.
+ */
+void
+rsvg_cairo_push_recording (RsvgDrawingCtx *ctx)
 {
     RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
     cairo_surface_t *surface;
-    cairo_t *mask_cr, *save_cr;
+    cairo_matrix_t identity;
+    RsvgBbox *bbox;
+
+    surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
+
+    render->cr_stack = g_list_prepend (render->cr_stack, render->cr);
+    render->cr = cairo_create (surface);
+    cairo_surface_destroy (surface);
+
+    bbox = g_new0 (RsvgBbox, 1);
+    *bbox = render->bbox;
+    render->bb_stack = g_list_prepend (render->bb_stack, bbox);
+
+    cairo_matrix_init_identity (&identity);
+    rsvg_bbox_init (&render->bbox, &identity);
+}
+
+/* Stops the recording started by rsvg_cairo_push_recording().  Returns the
+ * recording surface, or %NULL if nothing was drawn; @extents gets the
+ * bounding box of what was drawn, in the recording's coordinates.
+ */
+cairo_surface_t *
+rsvg_cairo_pop_recording (RsvgDrawingCtx *ctx, cairo_rectangle_t *extents)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    cairo_surface_t *surface = NULL;
+
+    if (!render->bbox.virgin) {
+        surface = cairo_surface_reference (cairo_get_target (render->cr));
+        *extents = render->bbox.rect;
+    }
+
+    cairo_destroy (render->cr);
+    render->cr = (cairo_t *) render->cr_stack->data;
+    render->cr_stack = g_list_delete_link (render->cr_stack, render->cr_stack);
+
+    render->bbox = *((RsvgBbox *) render->bb_stack->data);
+    g_free (render->bb_stack->data);
+    render->bb_stack = g_list_delete_link (render->bb_stack, render->bb_stack);
+
+    return surface;
+}
+
+/* Replays a surface from rsvg_cairo_pop_recording() with the given affine,
+ * as if its contents had been drawn there directly.
+ */
+void
+rsvg_cairo_paint_recording (RsvgDrawingCtx *ctx,
+                            cairo_surface_t *surface,
+                            const cairo_rectangle_t *extents,
+                            cairo_matrix_t *affine)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgBbox bbox;
+
+    cairo_save (render->cr);
+    _set_rsvg_affine (render, affine);
+    cairo_set_source_surface (render->cr, surface, 0, 0);
+    cairo_paint (render->cr);
+    cairo_restore (render->cr);
+
+    rsvg_bbox_init (&bbox, affine);
+    bbox.rect = *extents;
+    bbox.virgin = FALSE;
+    rsvg_bbox_insert (&render->bbox, &bbox);
+}
+
+/* Clip paths and masks would otherwise be generated again for each element
+ * that references them, like all the features of a clipped map layer.
+ * Within a render, we keep the last few results for each <clipPath> and
+ * <mask>.
+ */
+struct _RsvgCairoClipMaskCache {
+    RsvgCairoClipMask entries[4];
+    guint n_entries;
+    guint next;
+};
+
+static void
+clip_mask_clear (RsvgCairoClipMask *entry)
+{
+    rsvg_state_free (entry->inherited);
+
+    if (entry->path)
+        cairo_path_destroy (entry->path);
+
+    if (entry->mask)
+        cairo_surface_destroy (entry->mask);
+
+    memset (entry, 0, sizeof (*entry));
+}
+
+void
+rsvg_cairo_clip_mask_cache_free (RsvgCairoClipMaskCache *cache)
+{
+    guint i;
+
+    for (i = 0; i < cache->n_entries; i++)
+        clip_mask_clear (&cache->entries[i]);
+
+    g_free (cache);
+}
+
+static RsvgCairoClipMaskCache *
+get_clip_mask_cache (RsvgDrawingCtx *ctx, RsvgNode *node)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgCairoClipMaskCache *cache;
+
+    if (render->clip_mask_cache == NULL)
+        render->clip_mask_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                         (GDestroyNotify) rsvg_cairo_clip_mask_cache_free);
+
+    cache = g_hash_table_lookup (render->clip_mask_cache, rsvg_node_get_state (node));
+    if (cache == NULL) {
+        cache = g_new0 (RsvgCairoClipMaskCache, 1);
+        g_hash_table_insert (render->clip_mask_cache, rsvg_node_get_state (node), cache);
+    }
+
+    return cache;
+}
+
+/* Looks for a clip path or mask generated from @node for an element with
+ * the current state's transformation and style.  @bbox is the element's
+ * bounding box if the result depends on it, and %NULL otherwise; @opacity
+ * is the opacity that masks get multiplied by.
+ */
+RsvgCairoClipMask *
+rsvg_cairo_lookup_clip_mask (RsvgDrawingCtx *ctx, RsvgNode *node, RsvgBbox *bbox, guint8 opacity)
+{
+    RsvgCairoClipMaskCache *cache;
     RsvgState *state = rsvg_current_state (ctx);
-    guint8 *pixels;
-    guint32 width = render->width, height = render->height;
-    guint32 rowstride = width * 4, row, i;
-    cairo_matrix_t affinesave;
-    double sx, sy, sw, sh;
-    gboolean nest = cr != render->initial_cr;
-    RsvgMask *self;
+    guint i;
 
-    g_assert (rsvg_node_get_type (node_mask) == RSVG_NODE_TYPE_MASK);
-    self = rsvg_rust_cnode_get_impl (node_mask);
+    cache = get_clip_mask_cache (ctx, node);
 
-    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
-    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
-        cairo_surface_destroy (surface);
-        return;
+    for (i = 0; i < cache->n_entries; i++) {
+        RsvgCairoClipMask *entry = &cache->entries[i];
+
+        if (memcmp (&entry->affine, &state->affine, sizeof (cairo_matrix_t)) == 0
+            && entry->vb_width == ctx->vb.rect.width
+            && entry->vb_height == ctx->vb.rect.height
+            && entry->opacity == opacity
+            && entry->has_bbox == (bbox != NULL)
+            && (bbox == NULL || memcmp (&entry->bbox, &bbox->rect, sizeof (cairo_rectangle_t)) == 0)
+            && rsvg_state_inherits_equal (entry->inherited, state))
+            return entry;
     }
 
-    pixels = cairo_image_surface_get_data (surface);
-    rowstride = cairo_image_surface_get_stride (surface);
+    return NULL;
+}
 
-    if (self->maskunits == objectBoundingBox)
-        rsvg_drawing_ctx_push_view_box (ctx, 1, 1);
+/* Makes room for the clip path or mask generated from @node under the
+ * conditions described in rsvg_cairo_lookup_clip_mask().  The caller
+ * fills in the result.
+ */
+RsvgCairoClipMask *
+rsvg_cairo_add_clip_mask (RsvgDrawingCtx *ctx, RsvgNode *node, RsvgBbox *bbox, guint8 opacity)
+{
+    RsvgCairoClipMaskCache *cache;
+    RsvgCairoClipMask *entry;
+    RsvgState *state = rsvg_current_state (ctx);
 
-    sx = rsvg_length_normalize (&self->x, ctx);
-    sy = rsvg_length_normalize (&self->y, ctx);
-    sw = rsvg_length_normalize (&self->width, ctx);
-    sh = rsvg_length_normalize (&self->height, ctx);
+    cache = get_clip_mask_cache (ctx, node);
 
-    if (self->maskunits == objectBoundingBox)
-        rsvg_drawing_ctx_pop_view_box (ctx);
+    entry = &cache->entries[cache->next];
+
+    if (cache->n_entries == G_N_ELEMENTS (cache->entries))
+        clip_mask_clear (entry);
+
+    cache->next = (cache->next + 1) % G_N_ELEMENTS (cache->entries);
+    cache->n_entries = MIN (cache->n_entries + 1, G_N_ELEMENTS (cache->entries));
+
+    entry->affine = state->affine;
+    entry->vb_width = ctx->vb.rect.width;
+    entry->vb_height = ctx->vb.rect.height;
+    entry->opacity = opacity;
+    entry->inherited = rsvg_state_new ();
+    rsvg_state_clone (entry->inherited, state);
+    entry->has_bbox = (bbox != NULL);
+
+    if (bbox)
+        entry->bbox = bbox->rect;
+
+    return entry;
+}
+
+/* Converts a row of ARGB32 pixels into A8 mask values, using the
+ * luminance of each pixel times @opacity.
+ *
+ * Assuming the pixel is linear RGB (not sRGB):
+ *
+ *   Y = 0.2126 R + 0.7152 G + 0.0722 B
+ *
+ * and we want Y * opacity in the most significant byte of a 32-bit
+ * value, so 0x00ffffff at full opacity yields 0xff, 0x00020202 yields
+ * 0x02, and 0x00000000 yields 0x00:
+ *
+ *   r_mult = 0xFFFFFFFF / (255.0 * 255.0) * .2126 = 14042.45  ~= 14042
+ *   g_mult = 0xFFFFFFFF / (255.0 * 255.0) * .7152 = 47239.69  ~= 47240
+ *   b_mult = 0xFFFFFFFF / (255.0 * 255.0) * .0722 =  4768.88  ~= 4769
+ *
+ * The largest possible product, 255 * 66051 * 255, still fits in 32 bits.
+ * The loop is a plain branch-free pass over each row, so that compilers can
+ * vectorize it.
+ */
+static void
+luminance_to_alpha (const guint32 *src, guint8 *dst, guint width, guint32 opacity)
+{
+    guint i;
+
+    for (i = 0; i < width; i++) {
+        guint32 pixel = src[i];
+
+        dst[i] = ((((pixel >> 16) & 0xff) * 14042 +
+                   ((pixel >>  8) & 0xff) * 47240 +
+                   ((pixel      ) & 0xff) * 4769) * opacity) >> 24;
+    }
+}
+
+/* Computes the pixels of the layer that the mask can affect: those in the
+ * mask's rectangle and, if @contents is not %NULL, in the bounding box of
+ * what was drawn in the layer, with a pixel of margin for antialiasing.
+ * Returns FALSE if there are none.
+ */
+static gboolean
+get_mask_extents (RsvgCairoRender *render, cairo_matrix_t *affine,
+                  double x, double y, double w, double h,
+                  RsvgBbox *contents, cairo_rectangle_int_t *extents)
+{
+    RsvgBbox mask_bbox, device_mask;
+    cairo_matrix_t identity;
+    double x0, y0, x1, y1;
+
+    if (contents && contents->virgin)
+        return FALSE;
+
+    cairo_matrix_init_identity (&identity);
+
+    rsvg_bbox_init (&mask_bbox, affine);
+    mask_bbox.rect.x = x;
+    mask_bbox.rect.y = y;
+    mask_bbox.rect.width = w;
+    mask_bbox.rect.height = h;
+    mask_bbox.virgin = FALSE;
+
+    rsvg_bbox_init (&device_mask, &identity);
+    rsvg_bbox_insert (&device_mask, &mask_bbox);
+
+    x0 = device_mask.rect.x;
+    y0 = device_mask.rect.y;
+    x1 = device_mask.rect.x + device_mask.rect.width;
+    y1 = device_mask.rect.y + device_mask.rect.height;
+
+    if (contents) {
+        RsvgBbox device_contents;
+
+        rsvg_bbox_init (&device_contents, &identity);
+        rsvg_bbox_insert (&device_contents, contents);
+
+        x0 = MAX (x0, device_contents.rect.x);
+        y0 = MAX (y0, device_contents.rect.y);
+        x1 = MIN (x1, device_contents.rect.x + device_contents.rect.width);
+        y1 = MIN (y1, device_contents.rect.y + device_contents.rect.height);
+    }
+
+    x0 = MAX (floor (x0) - 1, 0);
+    y0 = MAX (floor (y0) - 1, 0);
+    x1 = MIN (ceil (x1) + 1, render->width);
+    y1 = MIN (ceil (y1) + 1, render->height);
+
+    if (x1 <= x0 || y1 <= y0)
+        return FALSE;
+
+    extents->x = x0;
+    extents->y = y0;
+    extents->width = x1 - x0;
+    extents->height = y1 - y0;
+
+    return TRUE;
+}
+
+/* Renders the contents of a mask into an A8 surface covering @extents,
+ * given in canvas coordinates.
+ */
+static cairo_surface_t *
+render_mask (RsvgDrawingCtx *ctx, RsvgNode *node_mask, RsvgBbox *bbox,
+             double sx, double sy, double sw, double sh,
+             cairo_rectangle_int_t *extents)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgMask *self = rsvg_rust_cnode_get_impl (node_mask);
+    RsvgState *state = rsvg_current_state (ctx);
+    cairo_surface_t *surface, *mask;
+    cairo_t *mask_cr, *save_cr;
+    guint8 *pixels, *mask_pixels;
+    int rowstride, mask_rowstride, row;
+    cairo_matrix_t affinesave;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, extents->width, extents->height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cairo_surface_set_device_offset (surface, -extents->x, -extents->y);
 
     mask_cr = cairo_create (surface);
     save_cr = render->cr;
     render->cr = mask_cr;
 
-    if (self->maskunits == objectBoundingBox)
-        rsvg_cairo_add_clipping_rect (ctx,
-                                      sx * bbox->rect.width + bbox->rect.x,
-                                      sy * bbox->rect.height + bbox->rect.y,
-                                      sw * bbox->rect.width,
-                                      sh * bbox->rect.height);
-    else
-        rsvg_cairo_add_clipping_rect (ctx, sx, sy, sw, sh);
+    rsvg_cairo_add_clipping_rect (ctx, sx, sy, sw, sh);
 
     /* Horribly dirty hack to have the bbox premultiplied to everything */
     if (self->contentunits == objectBoundingBox) {
@@ -690,42 +1225,195 @@ rsvg_cairo_generate_mask (cairo_t * cr, RsvgNode *node_mask, RsvgDrawingCtx *ctx
 
     render->cr = save_cr;
 
-    for (row = 0; row < height; row++) {
-        guint8 *row_data = (pixels + (row * rowstride));
-        for (i = 0; i < width; i++) {
-            guint32 *pixel = (guint32 *) row_data + i;
-            /*
-             *  Assuming, the pixel is linear RGB (not sRGB)
-             *  y = luminance
-             *  Y = 0.2126 R + 0.7152 G + 0.0722 B
-             *  1.0 opacity = 255
-             *
-             *  When Y = 1.0, pixel for mask should be 0xFFFFFFFF
-             *  	(you get 1.0 luminance from 255 from R, G and B)
-             *
-             *	r_mult = 0xFFFFFFFF / (255.0 * 255.0) * .2126 = 14042.45  ~= 14042
-             *	g_mult = 0xFFFFFFFF / (255.0 * 255.0) * .7152 = 47239.69  ~= 47240
-             *	b_mult = 0xFFFFFFFF / (255.0 * 255.0) * .0722 =  4768.88  ~= 4769
-             *
-             * 	This allows for the following expected behaviour:
-             *  (we only care about the most sig byte)
-             *	if pixel = 0x00FFFFFF, pixel' = 0xFF......
-             *	if pixel = 0x00020202, pixel' = 0x02......
-             *	if pixel = 0x00000000, pixel' = 0x00......
-             */
-            *pixel = ((((*pixel & 0x00ff0000) >> 16) * 14042 +
-                       ((*pixel & 0x0000ff00) >>  8) * 47240 +
-                       ((*pixel & 0x000000ff)      ) * 4769    ) * state->opacity);
-        }
+    cairo_destroy (mask_cr);
+
+    mask = cairo_image_surface_create (CAIRO_FORMAT_A8, extents->width, extents->height);
+    if (cairo_surface_status (mask) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (mask);
+        cairo_surface_destroy (surface);
+        return NULL;
     }
 
-    cairo_destroy (mask_cr);
+    cairo_surface_flush (surface);
+    pixels = cairo_image_surface_get_data (surface);
+    rowstride = cairo_image_surface_get_stride (surface);
 
-    cairo_identity_matrix (cr);
-    cairo_mask_surface (cr, surface,
-                        nest ? 0 : render->offset_x,
-                        nest ? 0 : render->offset_y);
+    mask_pixels = cairo_image_surface_get_data (mask);
+    mask_rowstride = cairo_image_surface_get_stride (mask);
+
+    for (row = 0; row < extents->height; row++)
+        luminance_to_alpha ((guint32 *) (pixels + row * rowstride),
+                            mask_pixels + row * mask_rowstride,
+                            extents->width,
+                            state->opacity);
+
+    cairo_surface_mark_dirty (mask);
     cairo_surface_destroy (surface);
+
+    return mask;
+}
+
+static gboolean
+rectangle_contains (cairo_rectangle_int_t *outer, cairo_rectangle_int_t *inner)
+{
+    return (inner->x >= outer->x
+            && inner->y >= outer->y
+            && inner->x + inner->width <= outer->x + outer->width
+            && inner->y + inner->height <= outer->y + outer->height);
+}
+
+static void
+rsvg_cairo_generate_mask (cairo_t * cr, RsvgNode *node_mask, RsvgDrawingCtx *ctx, RsvgBbox *bbox)
+{
+    RsvgCairoRender *render = RSVG_CAIRO_RENDER (ctx->render);
+    RsvgState *state = rsvg_current_state (ctx);
+    RsvgCairoClipMask *cached;
+    cairo_surface_t *mask;
+    cairo_rectangle_int_t extents;
+    double sx, sy, sw, sh;
+    gboolean nest = cr != render->initial_cr;
+    gboolean uses_bbox;
+    RsvgMask *self;
+
+    g_assert (rsvg_node_get_type (node_mask) == RSVG_NODE_TYPE_MASK);
+    self = rsvg_rust_cnode_get_impl (node_mask);
+
+    if (self->maskunits == objectBoundingBox)
+        rsvg_drawing_ctx_push_view_box (ctx, 1, 1);
+
+    sx = rsvg_length_normalize (&self->x, ctx);
+    sy = rsvg_length_normalize (&self->y, ctx);
+    sw = rsvg_length_normalize (&self->width, ctx);
+    sh = rsvg_length_normalize (&self->height, ctx);
+
+    if (self->maskunits == objectBoundingBox)
+        rsvg_drawing_ctx_pop_view_box (ctx);
+
+    if (self->maskunits == objectBoundingBox) {
+        sx = sx * bbox->rect.width + bbox->rect.x;
+        sy = sy * bbox->rect.height + bbox->rect.y;
+        sw = sw * bbox->rect.width;
+        sh = sh * bbox->rect.height;
+    }
+
+    /* Outside of these, the mask is transparent or there is nothing to mask.
+     * Filters can paint outside of the bounding box of the layer's contents.
+     */
+    if (!get_mask_extents (render, &state->affine, sx, sy, sw, sh,
+                           state->filter ? NULL : bbox, &extents))
+        return;
+
+    uses_bbox = (self->maskunits == objectBoundingBox || self->contentunits == objectBoundingBox);
+
+    cached = rsvg_cairo_lookup_clip_mask (ctx, node_mask, uses_bbox ? bbox : NULL, state->opacity);
+
+    if (cached && rectangle_contains (&cached->extents, &extents)) {
+        mask = cairo_surface_reference (cached->mask);
+        extents = cached->extents;
+    } else {
+        /* A mask which doesn't depend on the element's bounding box is
+         * probably used by other elements, too, so the second time
+         * around we render all of it.
+         */
+        if (cached)
+            get_mask_extents (render, &state->affine, sx, sy, sw, sh, NULL, &extents);
+
+        mask = render_mask (ctx, node_mask, bbox, sx, sy, sw, sh, &extents);
+        if (mask == NULL)
+            return;
+
+        if (cached)
+            cairo_surface_destroy (cached->mask);
+        else
+            cached = rsvg_cairo_add_clip_mask (ctx, node_mask, uses_bbox ? bbox : NULL, state->opacity);
+
+        cached->mask = cairo_surface_reference (mask);
+        cached->extents = extents;
+    }
+
+    cairo_identity_matrix (cr);
+    cairo_mask_surface (cr, mask,
+                        (nest ? 0 : render->offset_x) + extents.x,
+                        (nest ? 0 : render->offset_y) + extents.y);
+    cairo_surface_destroy (mask);
+}
+
+/* Whether the current state needs to be rendered to an intermediate surface,
+ * which gets composited onto the parent layer when it is popped.  @lateclip
+ * is whether the state has a clip-path in objectBoundingBox units, which can
+ * only be applied once the layer's bounding box is known.
+ */
+gboolean
+rsvg_cairo_state_needs_layer (RsvgState *state, gboolean lateclip)
+{
+    return !(state->opacity == 0xFF
+             && !state->filter && !state->mask && !lateclip && (state->comp_op == CAIRO_OPERATOR_OVER)
+             && (state->enable_background == RSVG_ENABLE_BACKGROUND_ACCUMULATE));
+}
+
+/**
+ * rsvg_cairo_fold_group_opacity:
+ * @ctx: the drawing context, whose current state is that of a group
+ * @child: the only child of the group which draws anything
+ *
+ * Group opacity normally makes the group be drawn into a layer, which
+ * then gets painted with that opacity.  If the group has nothing else that
+ * needs a layer and its only child is a shape which paints once (see
+ * paints_once()), the opacity is moved into the fill-opacity and
+ * stroke-opacity that the child inherits, and no layer is created.
+ *
+ * The child may have an opacity or a mask of its own, since those just
+ * multiply; filters and compositing operators other than "over" don't,
+ * and groups with several children would need to know that the children
+ * don't overlap before drawing them, so those keep their layer.
+ */
+void
+rsvg_cairo_fold_group_opacity (RsvgDrawingCtx *ctx, RsvgNode *child)
+{
+    RsvgState *state = rsvg_current_state (ctx);
+    RsvgState *child_state = rsvg_node_get_state (child);
+    RsvgPaintServer *fill, *stroke;
+
+    if (!layer_is_only_for_opacity (ctx, state))
+        return;
+
+    switch (rsvg_node_get_type (child)) {
+    case RSVG_NODE_TYPE_PATH:
+    case RSVG_NODE_TYPE_LINE:
+    case RSVG_NODE_TYPE_POLYGON:
+    case RSVG_NODE_TYPE_POLYLINE:
+        if ((child_state->paint->has_startMarker ? child_state->paint->startMarker : state->paint->startMarker)
+            || (child_state->paint->has_middleMarker ? child_state->paint->middleMarker : state->paint->middleMarker)
+            || (child_state->paint->has_endMarker ? child_state->paint->endMarker : state->paint->endMarker))
+            return;
+        break;
+
+    case RSVG_NODE_TYPE_RECT:
+    case RSVG_NODE_TYPE_CIRCLE:
+    case RSVG_NODE_TYPE_ELLIPSE:
+        break;
+
+    default:
+        return;
+    }
+
+    if (child_state->filter
+        || child_state->comp_op != CAIRO_OPERATOR_OVER
+        || child_state->enable_background != RSVG_ENABLE_BACKGROUND_ACCUMULATE)
+        return;
+
+    fill = child_state->paint->has_fill_server ? child_state->paint->fill : state->paint->fill;
+    stroke = child_state->paint->has_stroke_server ? child_state->paint->stroke : state->paint->stroke;
+
+    /* The child has to inherit the opacity we fold in */
+    if ((fill && child_state->paint->has_fill_opacity)
+        || (stroke && child_state->paint->has_stroke_opacity))
+        return;
+
+    if (!paints_once (ctx, fill, stroke))
+        return;
+
+    fold_opacity (state);
 }
 
 static void
@@ -761,9 +1449,7 @@ rsvg_cairo_push_render_stack (RsvgDrawingCtx * ctx)
         }
     }
 
-    if (state->opacity == 0xFF
-        && !state->filter && !state->mask && !lateclip && (state->comp_op == CAIRO_OPERATOR_OVER)
-        && (state->enable_background == RSVG_ENABLE_BACKGROUND_ACCUMULATE))
+    if (!rsvg_cairo_state_needs_layer (state, lateclip))
         return;
 
     if (!state->filter) {
@@ -830,9 +1516,7 @@ rsvg_cairo_pop_render_stack (RsvgDrawingCtx * ctx)
         }
     }
 
-    if (state->opacity == 0xFF
-        && !state->filter && !state->mask && !lateclip && (state->comp_op == CAIRO_OPERATOR_OVER)
-        && (state->enable_background == RSVG_ENABLE_BACKGROUND_ACCUMULATE))
+    if (!rsvg_cairo_state_needs_layer (state, lateclip != NULL))
         return;
 
     surface = cairo_get_target (child_cr);
@@ -1042,6 +1726,33 @@ rsvg_cairo_surface_from_pixbuf (const GdkPixbuf *pixbuf)
     return surface;
 }
 
+/* Un-premultiplying needs a division per channel.  Instead, we look the
+ * results up in a table indexed by alpha and the premultiplied value,
+ * which is built the first time it is needed.  For valid premultiplied
+ * values it gives the same results as (c * 255 + alpha / 2) / alpha.
+ */
+static const guint8 *
+get_unpremultiply_table (void)
+{
+    static gsize table = 0;
+
+    if (g_once_init_enter (&table)) {
+        guint8 *t = g_new (guint8, 256 * 256);
+        guint alpha, c;
+
+        for (c = 0; c < 256; c++)
+            t[c] = 0;
+
+        for (alpha = 1; alpha < 256; alpha++)
+            for (c = 0; c < 256; c++)
+                t[alpha * 256 + c] = MIN ((c * 255 + alpha / 2) / alpha, 255);
+
+        g_once_init_leave (&table, (gsize) t);
+    }
+
+    return (const guint8 *) table;
+}
+
 /* Copied from gtk+/gdk/gdkpixbuf-drawable.c, LGPL 2+.
  *
  * Copyright (C) 1999 Michael Zucchi
@@ -1061,6 +1772,7 @@ convert_alpha (guchar *dest_data,
                int     width,
                int     height)
 {
+    const guint8 *unpremultiply = get_unpremultiply_table ();
     int x, y;
 
     src_data += src_stride * src_y + src_x * 4;
@@ -1069,22 +1781,17 @@ convert_alpha (guchar *dest_data,
         guint32 *src = (guint32 *) src_data;
 
         for (x = 0; x < width; x++) {
-          guint alpha = src[x] >> 24;
-
-          if (alpha == 0) {
-              dest_data[x * 4 + 0] = 0;
-              dest_data[x * 4 + 1] = 0;
-              dest_data[x * 4 + 2] = 0;
-          } else {
-              dest_data[x * 4 + 0] = (((src[x] & 0xff0000) >> 16) * 255 + alpha / 2) / alpha;
-              dest_data[x * 4 + 1] = (((src[x] & 0x00ff00) >>  8) * 255 + alpha / 2) / alpha;
-              dest_data[x * 4 + 2] = (((src[x] & 0x0000ff) >>  0) * 255 + alpha / 2) / alpha;
-          }
-          dest_data[x * 4 + 3] = alpha;
-      }
-
-      src_data += src_stride;
-      dest_data += dest_stride;
+            guint32 pixel = src[x];
+            const guint8 *row = unpremultiply + (pixel >> 24) * 256;
+
+            dest_data[x * 4 + 0] = row[(pixel >> 16) & 0xff];
+            dest_data[x * 4 + 1] = row[(pixel >>  8) & 0xff];
+            dest_data[x * 4 + 2] = row[(pixel >>  0) & 0xff];
+            dest_data[x * 4 + 3] = pixel >> 24;
+        }
+
+        src_data += src_stride;
+        dest_data += dest_stride;
     }
 }
 
@@ -1116,6 +1823,98 @@ convert_no_alpha (guchar *dest_data,
     }
 }
 
+/* The converters below read a whole source pixel before writing the
+ * destination one, and destination pixels are no bigger than source
+ * ones, so they also work in place, with @dest == @src.  They are
+ * written as simple loops over a row so that the compiler can vectorize
+ * them.
+ */
+static void
+convert_row_to_bgra_premultiplied (guint8 *dest, const guint32 *src, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        guint32 pixel = src[x];
+
+        dest[x * 4 + 0] = pixel;
+        dest[x * 4 + 1] = pixel >> 8;
+        dest[x * 4 + 2] = pixel >> 16;
+        dest[x * 4 + 3] = pixel >> 24;
+    }
+}
+
+static void
+convert_row_to_rgb565 (guint8 *dest, const guint32 *src, int width)
+{
+    guint16 *d = (guint16 *) dest;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        guint32 pixel = src[x];
+
+        d[x] = (((pixel >> 8) & 0xf800)
+                | ((pixel >> 5) & 0x07e0)
+                | ((pixel >> 3) & 0x001f));
+    }
+}
+
+static void
+convert_row_to_a8 (guint8 *dest, const guint32 *src, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        dest[x] = src[x] >> 24;
+}
+
+/* Converts premultiplied, native-endian ARGB32 pixels as produced by cairo
+ * to @format.
+ */
+void
+rsvg_cairo_convert_argb32 (guint8 *dest,
+                           int dest_stride,
+                           const guint8 *src,
+                           int src_stride,
+                           int width,
+                           int height,
+                           RsvgPixelFormat format)
+{
+    int y;
+
+    if (format == RSVG_PIXEL_FORMAT_RGBA8888) {
+        convert_alpha (dest, dest_stride, (guchar *) src, src_stride, 0, 0, width, height);
+        return;
+    }
+
+    for (y = 0; y < height; y++) {
+        const guint32 *s = (const guint32 *) (src + y * src_stride);
+        guint8 *d = dest + y * dest_stride;
+
+        switch (format) {
+        case RSVG_PIXEL_FORMAT_ARGB32:
+            if (d != (guint8 *) s)
+                memcpy (d, s, width * 4);
+            break;
+
+        case RSVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED:
+            convert_row_to_bgra_premultiplied (d, s, width);
+            break;
+
+        case RSVG_PIXEL_FORMAT_RGB565:
+            convert_row_to_rgb565 (d, s, width);
+            break;
+
+        case RSVG_PIXEL_FORMAT_A8:
+            convert_row_to_a8 (d, s, width);
+            break;
+
+        default:
+            g_assert_not_reached ();
+        }
+    }
+}
+
 GdkPixbuf *
 rsvg_cairo_surface_to_pixbuf (cairo_surface_t *surface)
 {
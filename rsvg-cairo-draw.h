@@ -32,6 +32,42 @@
 
 G_BEGIN_DECLS 
 
+/* A clip path or mask generated for an element, for reuse by other
+ * elements which reference the same node under the same conditions; see
+ * rsvg_cairo_lookup_clip_mask().
+ */
+typedef struct {
+    /* What the result depends on, besides the node itself */
+    cairo_matrix_t affine;
+    double vb_width;
+    double vb_height;
+    guint8 opacity;
+    RsvgState *inherited;
+    gboolean has_bbox;
+    cairo_rectangle_t bbox;
+
+    /* For clip paths, in canvas coordinates */
+    cairo_path_t *path;
+    cairo_fill_rule_t fill_rule;
+    gboolean is_box;
+    cairo_rectangle_t box;
+
+    /* For masks */
+    cairo_surface_t *mask;
+    cairo_rectangle_int_t extents;
+} RsvgCairoClipMask;
+
+typedef struct _RsvgCairoClipMaskCache RsvgCairoClipMaskCache;
+
+G_GNUC_INTERNAL
+void rsvg_cairo_clip_mask_cache_free (RsvgCairoClipMaskCache *cache);
+G_GNUC_INTERNAL
+RsvgCairoClipMask *rsvg_cairo_lookup_clip_mask (RsvgDrawingCtx *ctx, RsvgNode *node,
+                                                RsvgBbox *bbox, guint8 opacity);
+G_GNUC_INTERNAL
+RsvgCairoClipMask *rsvg_cairo_add_clip_mask (RsvgDrawingCtx *ctx, RsvgNode *node,
+                                             RsvgBbox *bbox, guint8 opacity);
+
 G_GNUC_INTERNAL
 PangoContext    *rsvg_cairo_create_pango_context    (RsvgDrawingCtx *ctx);
 G_GNUC_INTERNAL
@@ -42,13 +78,40 @@ G_GNUC_INTERNAL
 void         rsvg_cairo_render_path_builder     (RsvgDrawingCtx *ctx, 
                                                  RsvgPathBuilder *builder);
 G_GNUC_INTERNAL
+gboolean     rsvg_cairo_get_pango_layout_bbox   (RsvgDrawingCtx *ctx, PangoLayout *layout,
+                                                 double x, double y, RsvgBbox *bbox);
+G_GNUC_INTERNAL
+void         rsvg_cairo_add_path_and_get_bbox   (RsvgDrawingCtx *ctx, RsvgPathBuilder *builder,
+                                                 RsvgBbox *bbox);
+G_GNUC_INTERNAL
 void         rsvg_cairo_render_surface          (RsvgDrawingCtx *ctx, cairo_surface_t *surface,
                                                  double x, double y, double w, double h);
 G_GNUC_INTERNAL
 cairo_t *rsvg_cairo_get_cairo_context (RsvgDrawingCtx *ctx);
 G_GNUC_INTERNAL
 void rsvg_cairo_set_cairo_context (RsvgDrawingCtx *ctx, cairo_t *cr);
+G_GNUC_INTERNAL
+gboolean rsvg_cairo_pattern_tile_is_recording (RsvgDrawingCtx *ctx);
+G_GNUC_INTERNAL
+cairo_surface_t *rsvg_cairo_create_pattern_tile (RsvgDrawingCtx *ctx, int width, int height);
+G_GNUC_INTERNAL
+gboolean rsvg_cairo_get_raster_scale (RsvgDrawingCtx *ctx, double *scale_x, double *scale_y);
+G_GNUC_INTERNAL
+gboolean rsvg_cairo_can_record (RsvgDrawingCtx *ctx);
+G_GNUC_INTERNAL
+gboolean rsvg_cairo_subtree_can_be_recorded (RsvgNode *node);
+G_GNUC_INTERNAL
+void rsvg_cairo_push_recording (RsvgDrawingCtx *ctx);
+G_GNUC_INTERNAL
+cairo_surface_t *rsvg_cairo_pop_recording (RsvgDrawingCtx *ctx, cairo_rectangle_t *extents);
+G_GNUC_INTERNAL
+void rsvg_cairo_paint_recording (RsvgDrawingCtx *ctx, cairo_surface_t *surface,
+                                 const cairo_rectangle_t *extents, cairo_matrix_t *affine);
 
+G_GNUC_INTERNAL
+gboolean     rsvg_cairo_state_needs_layer       (RsvgState *state, gboolean lateclip);
+G_GNUC_INTERNAL
+void         rsvg_cairo_fold_group_opacity      (RsvgDrawingCtx *ctx, RsvgNode *child);
 G_GNUC_INTERNAL
 void         rsvg_cairo_push_discrete_layer	    (RsvgDrawingCtx *ctx);
 G_GNUC_INTERNAL
@@ -35,6 +35,7 @@
 #include "rsvg-defs.h"
 #include "rsvg-cairo.h"
 #include "rsvg-cairo-draw.h"
+#include "rsvg-cairo-bbox.h"
 #include "rsvg-cairo-render.h"
 #include "rsvg-styles.h"
 #include "rsvg-structure.h"
@@ -48,6 +49,11 @@ rsvg_cairo_render_free (RsvgRender * self)
     g_assert (me->bb_stack == NULL);
     g_assert (me->surfaces_stack == NULL);
 
+    if (me->clip_mask_cache) {
+        g_hash_table_destroy (me->clip_mask_cache);
+        me->clip_mask_cache = NULL;
+    }
+
     if (me->font_config_for_testing) {
         FcConfigDestroy (me->font_config_for_testing);
         me->font_config_for_testing = NULL;
@@ -86,6 +92,7 @@ rsvg_cairo_render_new (cairo_t * cr, double width, double height)
     cairo_render->cr_stack = NULL;
     cairo_render->bb_stack = NULL;
     cairo_render->surfaces_stack = NULL;
+    cairo_render->clip_mask_cache = NULL;
     cairo_render->font_config_for_testing = NULL;
     cairo_render->font_map_for_testing = NULL;
 
@@ -128,8 +135,8 @@ static void rsvg_cairo_transformed_image_bounding_box (
     *y1 = ceil (t > y11 ? t : y11);
 }
 
-RsvgDrawingCtx *
-rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
+static RsvgDrawingCtx *
+new_drawing_ctx (cairo_t * cr, RsvgHandle * handle, gboolean clip_to_target, gboolean bbox_only)
 {
     RsvgDimensionData data;
     RsvgDrawingCtx *draw;
@@ -153,7 +160,33 @@ rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
                                                data.width, data.height,
                                                &bbx0, &bby0, &bbx1, &bby1);
 
-    render = rsvg_cairo_render_new (cr, bbx1 - bbx0, bby1 - bby0);
+    /* When exporting a single element into a surface that is only as big as
+     * the element, there is no point in allocating intermediate surfaces
+     * for the whole document; limit them to what can end up in the target.
+     */
+    if (clip_to_target) {
+        double cx0, cy0, cx1, cy1;
+
+        cairo_save (cr);
+        cairo_identity_matrix (cr);
+        cairo_clip_extents (cr, &cx0, &cy0, &cx1, &cy1);
+        cairo_restore (cr);
+
+        bbx0 = MAX (bbx0, floor (cx0));
+        bby0 = MAX (bby0, floor (cy0));
+        bbx1 = MIN (bbx1, ceil (cx1));
+        bby1 = MIN (bby1, ceil (cy1));
+
+        if (bbx1 <= bbx0 || bby1 <= bby0) {
+            g_free (draw);
+            return NULL;
+        }
+    }
+
+    if (bbox_only)
+        render = rsvg_cairo_bbox_render_new (cr, bbx1 - bbx0, bby1 - bby0);
+    else
+        render = rsvg_cairo_render_new (cr, bbx1 - bbx0, bby1 - bby0);
 
     if (!render)
         return NULL;
@@ -163,6 +196,7 @@ rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
     render->offset_y = bby0;
 
     draw->state = NULL;
+    draw->free_states = NULL;
 
     draw->defs = handle->priv->defs;
     draw->dpi_x = handle->priv->dpi_x;
@@ -174,6 +208,8 @@ rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
     draw->drawsub_stack = NULL;
     draw->acquired_nodes = NULL;
     draw->is_testing = handle->priv->is_testing;
+    draw->bounds_collector = NULL;
+    draw->instances = handle->priv->finished ? handle->priv->instances : NULL;
 
     rsvg_state_push (draw);
     state = rsvg_current_state (draw);
@@ -196,6 +232,55 @@ rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
     return draw;
 }
 
+RsvgDrawingCtx *
+rsvg_cairo_new_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
+{
+    return new_drawing_ctx (cr, handle, FALSE, FALSE);
+}
+
+/* Creates a drawing context that doesn't paint anything, and only computes
+ * the bounding box of what gets drawn into it.  This is much cheaper than
+ * rendering for real when all that is needed is an element's extents.
+ */
+RsvgDrawingCtx *
+rsvg_cairo_new_bbox_drawing_ctx (cairo_t * cr, RsvgHandle * handle)
+{
+    return new_drawing_ctx (cr, handle, FALSE, TRUE);
+}
+
+/* Draws @node and its ancestors so that the top-left corner of @extents,
+ * which is in the coordinate space of the toplevel viewport, ends up at
+ * the origin of @cr's current user space.
+ */
+gboolean
+rsvg_cairo_render_node_cropped (cairo_t * cr, RsvgHandle * handle, RsvgNode * node,
+                                const cairo_rectangle_int_t * extents)
+{
+    RsvgDrawingCtx *draw;
+
+    cairo_save (cr);
+
+    cairo_rectangle (cr, 0, 0, extents->width, extents->height);
+    cairo_clip (cr);
+    cairo_translate (cr, -extents->x, -extents->y);
+
+    draw = new_drawing_ctx (cr, handle, TRUE, FALSE);
+    if (!draw) {
+        cairo_restore (cr);
+        return FALSE;
+    }
+
+    rsvg_drawing_ctx_add_node_and_ancestors_to_stack (draw, node);
+
+    rsvg_drawing_ctx_draw_node_from_stack (draw, handle->priv->treebase, 0);
+
+    rsvg_drawing_ctx_free (draw);
+
+    cairo_restore (cr);
+
+    return TRUE;
+}
+
 /**
  * rsvg_handle_render_cairo_sub:
  * @handle: A #RsvgHandle
@@ -243,9 +328,63 @@ rsvg_handle_render_cairo_sub (RsvgHandle * handle, cairo_t * cr, const char *id)
 
     rsvg_drawing_ctx_free (draw);
 
+    /* Whatever was read ahead and not drawn now belongs to elements that
+     * aren't drawn with the document, like unused <defs>; if they ever are,
+     * they can read their files themselves.
+     */
+    if (drawsub == NULL)
+        _rsvg_handle_drop_prefetches (handle);
+
     return TRUE;
 }
 
+/**
+ * rsvg_handle_render_cairo_sub_cropped:
+ * @handle: A #RsvgHandle
+ * @cr: A Cairo renderer
+ * @id: (nullable): An element's id within the SVG, or %NULL to render
+ *   the whole SVG. For example, if you have a layer called "layer1"
+ *   that you wish to render, pass "##layer1" as the id.
+ *
+ * Draws a subset of a SVG to a Cairo surface, translated so that the
+ * top-left corner of the element's bounding box is at the origin of
+ * @cr's current user space.  Only the element and its ancestors are
+ * drawn, and intermediate surfaces are limited to the element's
+ * bounding box instead of spanning the whole document.  This is
+ * useful for extracting individual icons from a sprite sheet; use
+ * rsvg_handle_get_dimensions_sub_cropped() to find out how big the
+ * target surface needs to be.
+ *
+ * Returns: %TRUE if drawing succeeded.
+ *
+ * Since: 2.42
+ */
+gboolean
+rsvg_handle_render_cairo_sub_cropped (RsvgHandle * handle, cairo_t * cr, const char *id)
+{
+    RsvgNode *node;
+    cairo_rectangle_int_t extents;
+
+    g_return_val_if_fail (handle != NULL, FALSE);
+    g_return_val_if_fail (cr != NULL, FALSE);
+
+    if (!handle->priv->finished)
+        return FALSE;
+
+    if (id && *id)
+        node = rsvg_defs_lookup (handle->priv->defs, id);
+    else
+        node = handle->priv->treebase;
+
+    if (node == NULL)
+        return FALSE;
+
+    if (!_rsvg_handle_get_node_pixel_extents (handle, node, &extents))
+        return FALSE;
+
+    return rsvg_cairo_render_node_cropped (cr, handle, node, &extents);
+}
+
 /**
  * rsvg_handle_render_cairo:
  * @handle: A #RsvgHandle
@@ -50,6 +50,8 @@ struct _RsvgCairoRender {
     GList *bb_stack;
     GList *surfaces_stack;
 
+    GHashTable *clip_mask_cache; /* RsvgState of a <clipPath> or <mask> -> RsvgCairoClipMaskCache */
+
     FcConfig *font_config_for_testing;
     PangoFontMap *font_map_for_testing;
 };
@@ -62,6 +64,11 @@ G_GNUC_INTERNAL
 void		rsvg_cairo_render_rsvg_handle	(cairo_t * cr, RsvgHandle * handle);
 G_GNUC_INTERNAL
 RsvgDrawingCtx *rsvg_cairo_new_drawing_ctx	(cairo_t * cr, RsvgHandle * handle);
+G_GNUC_INTERNAL
+RsvgDrawingCtx *rsvg_cairo_new_bbox_drawing_ctx	(cairo_t * cr, RsvgHandle * handle);
+G_GNUC_INTERNAL
+gboolean	rsvg_cairo_render_node_cropped	(cairo_t * cr, RsvgHandle * handle, RsvgNode * node,
+                                                 const cairo_rectangle_int_t * extents);
 
 G_END_DECLS
 
@@ -176,21 +176,21 @@ rsvg_eval_switch_attributes (RsvgPropertyBag * atts, gboolean * p_has_cond)
     if (atts && rsvg_property_bag_size (atts)) {
         const char *value;
 
-        if ((value = rsvg_property_bag_lookup (atts, "requiredFeatures"))) {
+        if ((value = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_REQUIRED_FEATURES))) {
             permitted =
                 rsvg_cond_fulfills_requirement (value, implemented_features,
                                                 nb_implemented_features);
             has_cond = TRUE;
         }
 
-        if (permitted && (value = rsvg_property_bag_lookup (atts, "requiredExtensions"))) {
+        if (permitted && (value = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_REQUIRED_EXTENSIONS))) {
             permitted =
                 rsvg_cond_fulfills_requirement (value, implemented_extensions,
                                                 nb_implemented_extensions);
             has_cond = TRUE;
         }
 
-        if (permitted && (value = rsvg_property_bag_lookup (atts, "systemLanguage"))) {
+        if (permitted && (value = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_SYSTEM_LANGUAGE))) {
             permitted = rsvg_cond_parse_system_language (value);
             has_cond = TRUE;
         }
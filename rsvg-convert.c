@@ -105,6 +105,218 @@ get_lookup_id_from_command_line (const char *lookup_id)
 
     return export_lookup_id;
 }
+
+static void
+get_size_data (struct RsvgSizeCallbackData *size_data,
+               int width,
+               int height,
+               double x_zoom,
+               double y_zoom,
+               int keep_aspect_ratio)
+{
+    /* if both are unspecified, assume user wants to zoom the image in at least 1 dimension */
+    if (width == -1 && height == -1) {
+        size_data->type = RSVG_SIZE_ZOOM;
+        size_data->x_zoom = x_zoom;
+        size_data->y_zoom = y_zoom;
+        size_data->keep_aspect_ratio = keep_aspect_ratio;
+    } else if (x_zoom == 1.0 && y_zoom == 1.0) {
+        /* if one parameter is unspecified, assume user wants to keep the aspect ratio */
+        if (width == -1 || height == -1) {
+            size_data->type = RSVG_SIZE_WH_MAX;
+            size_data->width = width;
+            size_data->height = height;
+            size_data->keep_aspect_ratio = keep_aspect_ratio;
+        } else {
+            size_data->type = RSVG_SIZE_WH;
+            size_data->width = width;
+            size_data->height = height;
+            size_data->keep_aspect_ratio = keep_aspect_ratio;
+        }
+    } else {
+        /* assume the user wants to zoom the image, but cap the maximum size */
+        size_data->type = RSVG_SIZE_ZOOM_MAX;
+        size_data->x_zoom = x_zoom;
+        size_data->y_zoom = y_zoom;
+        size_data->width = width;
+        size_data->height = height;
+        size_data->keep_aspect_ratio = keep_aspect_ratio;
+    }
+}
+
+static cairo_surface_t *
+create_surface (const char *format, FILE *output_file, int width, int height)
+{
+    cairo_surface_t *surface = NULL;
+
+    if (!format || !strcmp (format, "png"))
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              width, height);
+#ifdef CAIRO_HAS_PDF_SURFACE
+    else if (!strcmp (format, "pdf"))
+        surface = cairo_pdf_surface_create_for_stream (rsvg_cairo_write_func, output_file,
+                                                       width, height);
+#endif
+#ifdef CAIRO_HAS_PS_SURFACE
+    else if (!strcmp (format, "ps") || !strcmp (format, "eps")){
+        surface = cairo_ps_surface_create_for_stream (rsvg_cairo_write_func, output_file,
+                                                      width, height);
+        if(!strcmp (format, "eps"))
+            cairo_ps_surface_set_eps(surface, TRUE);
+    }
+#endif
+#ifdef CAIRO_HAS_SVG_SURFACE
+    else if (!strcmp (format, "svg"))
+        surface = cairo_svg_surface_create_for_stream (rsvg_cairo_write_func, output_file,
+                                                       width, height);
+#endif
+#ifdef CAIRO_HAS_XML_SURFACE
+    else if (!strcmp (format, "xml")) {
+        cairo_device_t *device = cairo_xml_create_for_stream (rsvg_cairo_write_func, output_file);
+        surface = cairo_xml_surface_create (device, CAIRO_CONTENT_COLOR_ALPHA,
+                                            width, height);
+        cairo_device_destroy (device);
+    }
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE (1, 10, 0)
+    else if (!strcmp (format, "recording"))
+        surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
+#endif
+#endif
+
+    return surface;
+}
+
+static void
+finish_page (const char *format, cairo_t *cr, cairo_surface_t *surface, FILE *output_file)
+{
+    if (!format || !strcmp (format, "png"))
+        cairo_surface_write_to_png_stream (surface, rsvg_cairo_write_func, output_file);
+#if CAIRO_HAS_XML_SURFACE && CAIRO_VERSION >= CAIRO_VERSION_ENCODE (1, 10, 0)
+    else if (!strcmp (format, "recording")) {
+        cairo_device_t *device = cairo_xml_create_for_stream (rsvg_cairo_write_func, output_file);
+        cairo_xml_for_recording_surface (device, surface);
+        cairo_device_destroy (device);
+    }
+#endif
+    else if (!strcmp (format, "xml"))
+      ;
+    else if (!strcmp (format, "svg") || !strcmp (format, "pdf") || !strcmp (format, "ps") || !strcmp (format, "eps"))
+        cairo_show_page (cr);
+    else
+      g_assert_not_reached ();
+}
+
+static void
+paint_background (cairo_t *cr, const char *background_color_str, int width, int height)
+{
+    RsvgCssColorSpec spec;
+    guint32 background_color;
+
+    if (!background_color_str || g_ascii_strcasecmp (background_color_str, "none") == 0)
+        return;
+
+    spec = rsvg_css_parse_color_ (background_color_str, ALLOW_INHERIT_NO, ALLOW_CURRENT_COLOR_NO);
+    if (spec.kind == RSVG_CSS_COLOR_SPEC_ARGB) {
+        background_color = spec.argb;
+    } else {
+        g_printerr (_("Invalid color specification."));
+        exit (1);
+    }
+
+    cairo_set_source_rgb (
+        cr, 
+        ((background_color >> 16) & 0xff) / 255.0, 
+        ((background_color >> 8) & 0xff) / 255.0, 
+        ((background_color >> 0) & 0xff) / 255.0);
+    cairo_rectangle (cr, 0, 0, width, height);
+    cairo_fill (cr);
+}
+
+/* Gets the size of the surface to export @lookup_id to, or the whole
+ * document if it is %NULL.  Elements are drawn cropped to their extents
+ * in whole pixels, which can be a pixel larger than their bounding box.
+ */
+static gboolean
+get_export_dimensions (RsvgHandle *rsvg, const char *lookup_id, RsvgDimensionData *dimensions)
+{
+    if (lookup_id)
+        return rsvg_handle_get_dimensions_sub_cropped (rsvg, dimensions, lookup_id);
+    else
+        return rsvg_handle_get_dimensions_sub (rsvg, dimensions, NULL);
+}
+
+/* Writes each of @lookup_ids (which have a '#' prepended to them) to its own
+ * file in @output_dir, named after the id.  The document is only parsed once.
+ */
+static void
+export_ids_to_files (RsvgHandle *rsvg,
+                     const char *filename,
+                     gchar **lookup_ids,
+                     const char *format,
+                     const char *output_dir,
+                     struct RsvgSizeCallbackData *size_data,
+                     const char *background_color_str)
+{
+    int i;
+
+    for (i = 0; lookup_ids[i] != NULL; i++) {
+        const char *lookup_id = lookup_ids[i];
+        RsvgDimensionData dimensions;
+        int scaled_width, scaled_height;
+        char *basename, *path;
+        FILE *output_file;
+        cairo_surface_t *surface;
+        cairo_t *cr;
+
+        if (!rsvg_handle_has_sub (rsvg, lookup_id)) {
+            g_printerr (_("File %s does not have an object with id \"%s\"\n"), filename, lookup_id + 1);
+            exit (1);
+        }
+
+        if (!get_export_dimensions (rsvg, lookup_id, &dimensions)) {
+            g_printerr (_("Object with id \"%s\" is empty; skipping it\n"), lookup_id + 1);
+            continue;
+        }
+
+        scaled_width = dimensions.width;
+        scaled_height = dimensions.height;
+        _rsvg_size_callback (&scaled_width, &scaled_height, size_data);
+
+        /* Don't let ids with slashes in them write outside of output_dir */
+        basename = g_strdup_printf ("%s.%s", lookup_id + 1, format ? format : "png");
+        g_strdelimit (basename, "/\\", '_');
+        path = g_build_filename (output_dir ? output_dir : ".", basename, NULL);
+        g_free (basename);
+
+        output_file = fopen (path, "wb");
+        if (!output_file) {
+            g_printerr (_("Error saving to file: %s\n"), path);
+            exit (1);
+        }
+
+        surface = create_surface (format, output_file, scaled_width, scaled_height);
+        if (!surface) {
+            g_printerr (_("Unknown output format."));
+            exit (1);
+        }
+
+        cr = cairo_create (surface);
+
+        paint_background (cr, background_color_str, scaled_width, scaled_height);
+
+        cairo_scale (cr,
+                     (double) scaled_width / dimensions.width,
+                     (double) scaled_height / dimensions.height);
+        rsvg_handle_render_cairo_sub_cropped (rsvg, cr, lookup_id);
+
+        finish_page (format, cr, surface, output_file);
+
+        cairo_destroy (cr);
+        cairo_surface_destroy (surface);
+        fclose (output_file);
+        g_free (path);
+    }
+}
  
 int
 main (int argc, char **argv)
@@ -121,8 +333,10 @@ main (int argc, char **argv)
     char *format = NULL;
     char *output = NULL;
     char *export_id = NULL;
+    char *export_ids = NULL;
+    gboolean export_all_groups = FALSE;
+    char *output_dir = NULL;
     int keep_aspect_ratio = FALSE;
-    guint32 background_color = 0;
     char *background_color_str = NULL;
     gboolean using_stdin = FALSE;
     gboolean unlimited = FALSE;
@@ -168,6 +382,12 @@ main (int argc, char **argv)
          N_("output filename [optional; defaults to stdout]"), NULL},
         {"export-id", 'i', 0, G_OPTION_ARG_STRING, &export_id,
          N_("SVG id of object to export [optional; defaults to exporting all objects]"), N_("<object id>")},
+        {"export-ids", 0, 0, G_OPTION_ARG_STRING, &export_ids,
+         N_("comma-separated SVG ids of objects to export, each to its own file named after the id"), N_("<id,id,...>")},
+        {"export-all-groups", 0, 0, G_OPTION_ARG_NONE, &export_all_groups,
+         N_("export every group with an id, each to its own file named after the id"), NULL},
+        {"output-dir", 0, 0, G_OPTION_ARG_FILENAME, &output_dir,
+         N_("directory for the files written by --export-ids and --export-all-groups [optional; defaults to the current directory]"), N_("<directory>")},
         {"keep-aspect-ratio", 'a', 0, G_OPTION_ARG_NONE, &keep_aspect_ratio,
          N_("whether to preserve the aspect ratio [optional; defaults to FALSE]"), NULL},
         {"background-color", 'b', 0, G_OPTION_ARG_STRING, &background_color_str,
@@ -201,6 +421,19 @@ main (int argc, char **argv)
         return 0;
     }
 
+    if (export_ids || export_all_groups) {
+        if (export_id || output) {
+            g_printerr (_("--export-ids and --export-all-groups write to --output-dir; "
+                          "they can't be used with --export-id or --output.\n"));
+            exit (1);
+        }
+
+        if (args && args[0] && args[1]) {
+            g_printerr (_("Only one SVG file can be given with --export-ids and --export-all-groups.\n"));
+            exit (1);
+        }
+    }
+
     if (output != NULL) {
         output_file = fopen (output, "wb");
         if (!output_file) {
@@ -280,6 +513,33 @@ main (int argc, char **argv)
             exit (1);
         }
 
+        if (export_ids || export_all_groups) {
+            struct RsvgSizeCallbackData size_data;
+            gchar **lookup_ids;
+
+            if (export_all_groups) {
+                lookup_ids = rsvg_handle_get_group_ids (rsvg);
+            } else {
+                gchar **ids = g_strsplit (export_ids, ",", -1);
+                int j;
+
+                lookup_ids = g_new0 (gchar *, g_strv_length (ids) + 1);
+                for (j = 0; ids[j] != NULL; j++)
+                    lookup_ids[j] = get_lookup_id_from_command_line (g_strstrip (ids[j]));
+
+                g_strfreev (ids);
+            }
+
+            get_size_data (&size_data, width, height, x_zoom, y_zoom, keep_aspect_ratio);
+
+            export_ids_to_files (rsvg, using_stdin ? "stdin" : args[i], lookup_ids,
+                                 format, output_dir, &size_data, background_color_str);
+
+            g_strfreev (lookup_ids);
+            g_object_unref (rsvg);
+            continue;
+        }
+
         export_lookup_id = get_lookup_id_from_command_line (export_id);
         if (export_lookup_id != NULL
             && !rsvg_handle_has_sub (rsvg, export_lookup_id)) {
@@ -290,79 +550,20 @@ main (int argc, char **argv)
         if (i == 0) {
             struct RsvgSizeCallbackData size_data;
 
-            if (!rsvg_handle_get_dimensions_sub (rsvg, &dimensions, export_lookup_id))
+            if (!get_export_dimensions (rsvg, export_lookup_id, &dimensions))
                 g_printerr ("Could not get dimensions for file %s\n", args[i]);
 
             unscaled_width = dimensions.width;
             unscaled_height = dimensions.height;
 
-            /* if both are unspecified, assume user wants to zoom the image in at least 1 dimension */
-            if (width == -1 && height == -1) {
-                size_data.type = RSVG_SIZE_ZOOM;
-                size_data.x_zoom = x_zoom;
-                size_data.y_zoom = y_zoom;
-                size_data.keep_aspect_ratio = keep_aspect_ratio;
-            } else if (x_zoom == 1.0 && y_zoom == 1.0) {
-                /* if one parameter is unspecified, assume user wants to keep the aspect ratio */
-                if (width == -1 || height == -1) {
-                    size_data.type = RSVG_SIZE_WH_MAX;
-                    size_data.width = width;
-                    size_data.height = height;
-                    size_data.keep_aspect_ratio = keep_aspect_ratio;
-                } else {
-                    size_data.type = RSVG_SIZE_WH;
-                    size_data.width = width;
-                    size_data.height = height;
-                    size_data.keep_aspect_ratio = keep_aspect_ratio;
-                }
-            } else {
-                /* assume the user wants to zoom the image, but cap the maximum size */
-                size_data.type = RSVG_SIZE_ZOOM_MAX;
-                size_data.x_zoom = x_zoom;
-                size_data.y_zoom = y_zoom;
-                size_data.width = width;
-                size_data.height = height;
-                size_data.keep_aspect_ratio = keep_aspect_ratio;
-            }
+            get_size_data (&size_data, width, height, x_zoom, y_zoom, keep_aspect_ratio);
 
             scaled_width = dimensions.width;
             scaled_height = dimensions.height;
             _rsvg_size_callback (&scaled_width, &scaled_height, &size_data);
 
-            if (!format || !strcmp (format, "png"))
-                surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                                      scaled_width, scaled_height);
-#ifdef CAIRO_HAS_PDF_SURFACE
-            else if (!strcmp (format, "pdf"))
-                surface = cairo_pdf_surface_create_for_stream (rsvg_cairo_write_func, output_file,
-                                                               scaled_width, scaled_height);
-#endif
-#ifdef CAIRO_HAS_PS_SURFACE
-            else if (!strcmp (format, "ps") || !strcmp (format, "eps")){
-                surface = cairo_ps_surface_create_for_stream (rsvg_cairo_write_func, output_file,
-                                                              scaled_width, scaled_height);
-                if(!strcmp (format, "eps"))
-                    cairo_ps_surface_set_eps(surface, TRUE);
-            }
-#endif
-#ifdef CAIRO_HAS_SVG_SURFACE
-            else if (!strcmp (format, "svg"))
-                surface = cairo_svg_surface_create_for_stream (rsvg_cairo_write_func, output_file,
-                                                               scaled_width, scaled_height);
-#endif
-#ifdef CAIRO_HAS_XML_SURFACE
-            else if (!strcmp (format, "xml")) {
-                cairo_device_t *device = cairo_xml_create_for_stream (rsvg_cairo_write_func, output_file);
-                surface = cairo_xml_surface_create (device, CAIRO_CONTENT_COLOR_ALPHA,
-                                                    scaled_width, scaled_height);
-                cairo_device_destroy (device);
-            }
-#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE (1, 10, 0)
-            else if (!strcmp (format, "recording"))
-                surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
-#endif
-#endif
-            else {
+            surface = create_surface (format, output_file, scaled_width, scaled_height);
+            if (!surface) {
                 g_printerr (_("Unknown output format."));
                 exit (1);
             }
@@ -370,61 +571,24 @@ main (int argc, char **argv)
             cr = cairo_create (surface);
         }
 
-        // Set background color
-        if (background_color_str && g_ascii_strcasecmp(background_color_str, "none") != 0) {
-            RsvgCssColorSpec spec;
-
-            spec = rsvg_css_parse_color_ (background_color_str, ALLOW_INHERIT_NO, ALLOW_CURRENT_COLOR_NO);
-            if (spec.kind == RSVG_CSS_COLOR_SPEC_ARGB) {
-                background_color = spec.argb;
-            } else {
-                g_printerr (_("Invalid color specification."));
-                exit (1);
-            }
-
-            cairo_set_source_rgb (
-                cr, 
-                ((background_color >> 16) & 0xff) / 255.0, 
-                ((background_color >> 8) & 0xff) / 255.0, 
-                ((background_color >> 0) & 0xff) / 255.0);
-            cairo_rectangle (cr, 0, 0, scaled_width, scaled_height);
-            cairo_fill (cr);
-        }
-
-        if (export_lookup_id) {
-            RsvgPositionData pos;
-
-            if (!rsvg_handle_get_position_sub (rsvg, &pos, export_lookup_id)) {
-                g_printerr (_("File %s does not have an object with id \"%s\"\n"), args[i], export_id);
-                exit (1);
-            }
-
-            /* Move the whole thing to 0, 0 so the object to export is at the origin */
-            cairo_translate (cr, -pos.x, -pos.y);
-        }
+        paint_background (cr, background_color_str, scaled_width, scaled_height);
 
         cairo_scale (cr,
                      scaled_width / unscaled_width,
                      scaled_height / unscaled_height);
-        rsvg_handle_render_cairo_sub (rsvg, cr, export_lookup_id);
+
+        if (export_lookup_id) {
+            /* Move the object to export to the origin, and only draw it
+             * and its ancestors, without allocating anything the size of
+             * the whole document.
+             */
+            rsvg_handle_render_cairo_sub_cropped (rsvg, cr, export_lookup_id);
+        } else
+            rsvg_handle_render_cairo_sub (rsvg, cr, NULL);
 
         g_free (export_lookup_id);
 
-        if (!format || !strcmp (format, "png"))
-            cairo_surface_write_to_png_stream (surface, rsvg_cairo_write_func, output_file);
-#if CAIRO_HAS_XML_SURFACE && CAIRO_VERSION >= CAIRO_VERSION_ENCODE (1, 10, 0)
-        else if (!strcmp (format, "recording")) {
-            cairo_device_t *device = cairo_xml_create_for_stream (rsvg_cairo_write_func, output_file);
-            cairo_xml_for_recording_surface (device, surface);
-            cairo_device_destroy (device);
-        }
-#endif
-        else if (!strcmp (format, "xml"))
-          ;
-        else if (!strcmp (format, "svg") || !strcmp (format, "pdf") || !strcmp (format, "ps") || !strcmp (format, "eps"))
-            cairo_show_page (cr);
-        else
-          g_assert_not_reached ();
+        finish_page (format, cr, surface, output_file);
 
         g_object_unref (rsvg);
     }
@@ -58,7 +58,7 @@ normalize_font_size (RsvgState * state, RsvgDrawingCtx * ctx)
 {
     RsvgState *parent;
 
-    switch (state->font_size.unit) {
+    switch (state->text->font_size.unit) {
     case LENGTH_UNIT_PERCENT:
     case LENGTH_UNIT_FONT_EM:
     case LENGTH_UNIT_FONT_EX:
@@ -66,11 +66,11 @@ normalize_font_size (RsvgState * state, RsvgDrawingCtx * ctx)
         if (parent) {
             double parent_size;
             parent_size = normalize_font_size (parent, ctx);
-            return state->font_size.length * parent_size;
+            return state->text->font_size.length * parent_size;
         }
         break;
     default:
-        return rsvg_length_normalize (&state->font_size, ctx);
+        return rsvg_length_normalize (&state->text->font_size, ctx);
         break;
     }
 
@@ -92,10 +92,10 @@ _rsvg_css_accumulate_baseline_shift (RsvgState * state, RsvgDrawingCtx * ctx)
 
     parent = rsvg_state_parent (state);
     if (parent) {
-        if (state->has_baseline_shift) {
+        if (state->text->has_baseline_shift) {
             double parent_font_size;
             parent_font_size = normalize_font_size (parent, ctx); /* font size from here */
-            shift = parent_font_size * state->baseline_shift;
+            shift = parent_font_size * state->text->baseline_shift;
         }
         shift += _rsvg_css_accumulate_baseline_shift (parent, ctx); /* baseline-shift for parent element */
     }
@@ -42,7 +42,8 @@ rsvg_defs_new (RsvgHandle *handle)
 {
     RsvgDefs *result = g_new0 (RsvgDefs, 1);
 
-    result->hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) rsvg_node_unref);
+    /* The ids are allocated from the handle's arena */
+    result->hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) rsvg_node_unref);
     result->externs =
         g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_object_unref);
     result->ctx = handle; /* no need to take a ref here */
@@ -130,7 +131,17 @@ rsvg_defs_register_node_by_id (RsvgDefs *defs, const char *id, RsvgNode *node)
     if (g_hash_table_lookup (defs->hash, id))
         return;
 
-    g_hash_table_insert (defs->hash, g_strdup (id), rsvg_node_ref (node));
+    g_hash_table_insert (defs->hash,
+                         rsvg_arena_strdup (defs->ctx->priv->arena, id),
+                         rsvg_node_ref (node));
+}
+
+void
+rsvg_defs_foreach (RsvgDefs *defs, GHFunc func, gpointer user_data)
+{
+    g_assert (defs != NULL);
+
+    g_hash_table_foreach (defs->hash, func, user_data);
 }
 
 void
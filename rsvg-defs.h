@@ -45,5 +45,9 @@ void	     rsvg_defs_free		(RsvgDefs * defs);
 G_GNUC_INTERNAL
 void	     rsvg_defs_register_node_by_id (RsvgDefs *defs, const char *id, RsvgNode *node);
 
+/* Calls @func with each id and node defined in the document itself, not in externs */
+G_GNUC_INTERNAL
+void	     rsvg_defs_foreach		(RsvgDefs *defs, GHFunc func, gpointer user_data);
+
 G_END_DECLS
 #endif
@@ -81,8 +81,9 @@ typedef struct _RsvgFilterPrimitive RsvgFilterPrimitive;
  *        rsvg_filter_primitive_free (impl);
  *    }
  *
- * That last call to rsvg_filter_primitive_free() will free the base RsvgFilterPrimitive's own fields,
- * and your whole structure itself, via g_free().
+ * That last call to rsvg_filter_primitive_free() will free the base RsvgFilterPrimitive's own fields.
+ * The structure itself comes from the handle's arena, like those of all the other nodes, and
+ * goes away with it.
  */
 struct _RsvgFilterPrimitive {
     RsvgLength x, y, width, height;
@@ -106,8 +107,6 @@ rsvg_filter_primitive_free (gpointer impl)
 
     g_string_free (primitive->in, TRUE);
     g_string_free (primitive->result, TRUE);
-
-    g_free (primitive);
 }
 
 static void
@@ -823,25 +822,17 @@ rsvg_filter_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int domina
     /* nothing; filters are drawn in rsvg-cairo-draw.c */
 }
 
-static void
-rsvg_filter_free (gpointer impl)
-{
-    RsvgFilter *filter = impl;
-
-    g_free (filter);
-}
-
 /**
  * rsvg_new_filter:
  *
  * Creates a blank filter and assigns default values to everything
  **/
 RsvgNode *
-rsvg_new_filter (const char *element_name, RsvgNode *parent)
+rsvg_new_filter (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilter *filter;
 
-    filter = g_new0 (RsvgFilter, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilter);
     filter->filterunits = objectBoundingBox;
     filter->primitiveunits = userSpaceOnUse;
     filter->x = rsvg_length_parse ("-10%", LENGTH_DIR_HORIZONTAL);
@@ -851,11 +842,11 @@ rsvg_new_filter (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_set_atts,
                                 rsvg_filter_draw,
-                                rsvg_filter_free);
+                                rsvg_arena_free_nothing);
 }
 
 /*************************************************************/
@@ -1069,11 +1060,11 @@ rsvg_filter_primitive_blend_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_blend (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_blend (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveBlend *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveBlend, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveBlend);
     filter->mode = normal;
     filter->super.in = g_string_new ("none");
     filter->in2 = g_string_new ("none");
@@ -1082,7 +1073,7 @@ rsvg_new_filter_primitive_blend (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_BLEND,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_blend_set_atts,
                                 rsvg_filter_draw,
@@ -1321,11 +1312,11 @@ rsvg_filter_primitive_convolve_matrix_set_atts (RsvgNode *node, gpointer impl, R
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_convolve_matrix (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_convolve_matrix (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveConvolveMatrix *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveConvolveMatrix, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveConvolveMatrix);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->KernelMatrix = NULL;
@@ -1339,7 +1330,7 @@ rsvg_new_filter_primitive_convolve_matrix (const char *element_name, RsvgNode *p
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_CONVOLVE_MATRIX,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_convolve_matrix_set_atts,
                                 rsvg_filter_draw,
@@ -1969,11 +1960,11 @@ rsvg_filter_primitive_gaussian_blur_set_atts (RsvgNode *node, gpointer impl, Rsv
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_gaussian_blur (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_gaussian_blur (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveGaussianBlur *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveGaussianBlur, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveGaussianBlur);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->sdx = 0;
@@ -1982,7 +1973,7 @@ rsvg_new_filter_primitive_gaussian_blur (const char *element_name, RsvgNode *par
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_GAUSSIAN_BLUR,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_gaussian_blur_set_atts,
                                 rsvg_filter_draw,
@@ -2092,11 +2083,11 @@ rsvg_filter_primitive_offset_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_offset (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_offset (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveOffset *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveOffset, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveOffset);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->dx = rsvg_length_parse ("0", LENGTH_DIR_HORIZONTAL);
@@ -2105,7 +2096,7 @@ rsvg_new_filter_primitive_offset (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_OFFSET,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_offset_set_atts,
                                 rsvg_filter_draw,
@@ -2191,17 +2182,17 @@ rsvg_filter_primitive_merge_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_merge (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_merge (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveMerge *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveMerge, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveMerge);
     filter->super.result = g_string_new ("none");
     filter->super.render = rsvg_filter_primitive_merge_render;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_MERGE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_merge_set_atts,
                                 rsvg_filter_draw,
@@ -2226,17 +2217,17 @@ rsvg_filter_primitive_merge_node_render (RsvgNode *node, RsvgFilterPrimitive *pr
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_merge_node (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_merge_node (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitive *filter;
 
-    filter = g_new0 (RsvgFilterPrimitive, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitive);
     filter->in = g_string_new ("none");
     filter->render = rsvg_filter_primitive_merge_node_render;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_MERGE_NODE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_merge_node_set_atts,
                                 rsvg_filter_draw,
@@ -2459,11 +2450,11 @@ rsvg_filter_primitive_color_matrix_set_atts (RsvgNode *node, gpointer impl, Rsvg
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_color_matrix (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_color_matrix (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveColorMatrix *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveColorMatrix, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveColorMatrix);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->KernelMatrix = NULL;
@@ -2471,7 +2462,7 @@ rsvg_new_filter_primitive_color_matrix (const char *element_name, RsvgNode *pare
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_COLOR_MATRIX,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_color_matrix_set_atts,
                                 rsvg_filter_draw,
@@ -2699,18 +2690,18 @@ rsvg_filter_primitive_component_transfer_set_atts (RsvgNode *node, gpointer impl
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_component_transfer (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_component_transfer (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveComponentTransfer *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveComponentTransfer, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveComponentTransfer);
     filter->super.result = g_string_new ("none");
     filter->super.in = g_string_new ("none");
     filter->super.render = rsvg_filter_primitive_component_transfer_render;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_COMPONENT_TRANSFER,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_component_transfer_set_atts,
                                 rsvg_filter_draw,
@@ -2768,12 +2759,10 @@ rsvg_node_component_transfer_function_free (gpointer impl)
 
     if (filter->nbTableValues)
         g_free (filter->tableValues);
-
-    g_free (filter);
 }
 
 RsvgNode *
-rsvg_new_node_component_transfer_function (const char *element_name, RsvgNode *parent)
+rsvg_new_node_component_transfer_function (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeComponentTransferFunc *filter;
 
@@ -2792,14 +2781,14 @@ rsvg_new_node_component_transfer_function (const char *element_name, RsvgNode *p
         channel = '\0';
     }
 
-    filter = g_new0 (RsvgNodeComponentTransferFunc, 1);
+    filter = rsvg_arena_new0 (arena, RsvgNodeComponentTransferFunc);
     filter->function = identity_component_transfer_func;
     filter->nbTableValues = 0;
     filter->channel = channel;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_COMPONENT_TRANFER_FUNCTION,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_node_component_transfer_function_set_atts,
                                 rsvg_filter_draw,
@@ -2924,11 +2913,11 @@ rsvg_filter_primitive_erode_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_erode (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_erode (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveErode *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveErode, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveErode);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->rx = 0;
@@ -2938,7 +2927,7 @@ rsvg_new_filter_primitive_erode (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_ERODE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_erode_set_atts,
                                 rsvg_filter_draw,
@@ -3140,11 +3129,11 @@ rsvg_filter_primitive_composite_set_atts (RsvgNode *node, gpointer impl, RsvgHan
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_composite (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_composite (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveComposite *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveComposite, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveComposite);
     filter->mode = COMPOSITE_MODE_OVER;
     filter->super.in = g_string_new ("none");
     filter->in2 = g_string_new ("none");
@@ -3157,7 +3146,7 @@ rsvg_new_filter_primitive_composite (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_COMPOSITE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_composite_set_atts,
                                 rsvg_filter_draw,
@@ -3182,8 +3171,8 @@ rsvg_filter_primitive_flood_render (RsvgNode *node, RsvgFilterPrimitive *primiti
 
     state = rsvg_node_get_state (node);
 
-    guint32 color = state->flood_color;
-    guint8 opacity = state->flood_opacity;
+    guint32 color = state->paint->flood_color;
+    guint8 opacity = state->paint->flood_opacity;
 
     boundarys = rsvg_filter_primitive_get_bounds (primitive, ctx);
 
@@ -3230,18 +3219,18 @@ rsvg_filter_primitive_flood_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_flood (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_flood (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitive *filter;
 
-    filter = g_new0 (RsvgFilterPrimitive, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitive);
     filter->in = g_string_new ("none");
     filter->result = g_string_new ("none");
     filter->render = rsvg_filter_primitive_flood_render;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_FLOOD,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_flood_set_atts,
                                 rsvg_filter_draw,
@@ -3412,11 +3401,11 @@ rsvg_filter_primitive_displacement_map_set_atts (RsvgNode *node, gpointer impl,
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_displacement_map (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_displacement_map (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveDisplacementMap *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveDisplacementMap, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveDisplacementMap);
     filter->super.in = g_string_new ("none");
     filter->in2 = g_string_new ("none");
     filter->super.result = g_string_new ("none");
@@ -3427,7 +3416,7 @@ rsvg_new_filter_primitive_displacement_map (const char *element_name, RsvgNode *
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_DISPLACEMENT_MAP,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_displacement_map_set_atts,
                                 rsvg_filter_draw,
@@ -3776,11 +3765,11 @@ rsvg_filter_primitive_turbulence_set_atts (RsvgNode *node, gpointer impl, RsvgHa
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_turbulence (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_turbulence (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveTurbulence *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveTurbulence, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveTurbulence);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->fBaseFreqX = 0;
@@ -3796,7 +3785,7 @@ rsvg_new_filter_primitive_turbulence (const char *element_name, RsvgNode *parent
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_TURBULENCE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_turbulence_set_atts,
                                 rsvg_filter_draw,
@@ -3987,11 +3976,11 @@ rsvg_filter_primitive_image_set_atts (RsvgNode *node, gpointer impl, RsvgHandle
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_image (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_image (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveImage *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveImage, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveImage);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->super.render = rsvg_filter_primitive_image_render;
@@ -3999,7 +3988,7 @@ rsvg_new_filter_primitive_image (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_IMAGE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_image_set_atts,
                                 rsvg_filter_draw,
@@ -4383,11 +4372,11 @@ rsvg_node_light_source_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *hand
 }
 
 RsvgNode *
-rsvg_new_node_light_source (const char *element_name, RsvgNode *parent)
+rsvg_new_node_light_source (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeLightSource *data;
 
-    data = g_new0 (RsvgNodeLightSource, 1);
+    data = rsvg_arena_new0 (arena, RsvgNodeLightSource);
 
     data->specularExponent = 1;
 
@@ -4404,11 +4393,11 @@ rsvg_new_node_light_source (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_LIGHT_SOURCE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 data,
                                 rsvg_node_light_source_set_atts,
                                 rsvg_filter_draw,
-                                g_free);                                
+                                rsvg_arena_free_nothing);
 }
 
 /*************************************************************/
@@ -4586,7 +4575,7 @@ rsvg_filter_primitive_diffuse_lighting_set_atts (RsvgNode *node, gpointer impl,
         case RSVG_CSS_COLOR_SPEC_CURRENT_COLOR:
             state = rsvg_state_new ();
             rsvg_state_reconstruct (state, node);
-            filter->lightingcolor = state->current_color;
+            filter->lightingcolor = state->paint->current_color;
             break;
 
         case RSVG_CSS_COLOR_SPEC_ARGB:
@@ -4609,11 +4598,11 @@ rsvg_filter_primitive_diffuse_lighting_set_atts (RsvgNode *node, gpointer impl,
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_diffuse_lighting (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_diffuse_lighting (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveDiffuseLighting *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveDiffuseLighting, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveDiffuseLighting);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->surfaceScale = 1;
@@ -4625,7 +4614,7 @@ rsvg_new_filter_primitive_diffuse_lighting (const char *element_name, RsvgNode *
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_DIFFUSE_LIGHTING,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_diffuse_lighting_set_atts,
                                 rsvg_filter_draw,
@@ -4773,7 +4762,7 @@ rsvg_filter_primitive_specular_lighting_set_atts (RsvgNode *node, gpointer impl,
         case RSVG_CSS_COLOR_SPEC_CURRENT_COLOR:
             state = rsvg_state_new ();
             rsvg_state_reconstruct (state, node);
-            filter->lightingcolor = state->current_color;
+            filter->lightingcolor = state->paint->current_color;
             break;
 
         case RSVG_CSS_COLOR_SPEC_ARGB:
@@ -4798,11 +4787,11 @@ rsvg_filter_primitive_specular_lighting_set_atts (RsvgNode *node, gpointer impl,
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_specular_lighting (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_specular_lighting (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveSpecularLighting *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveSpecularLighting, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveSpecularLighting);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->surfaceScale = 1;
@@ -4813,7 +4802,7 @@ rsvg_new_filter_primitive_specular_lighting (const char *element_name, RsvgNode
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_SPECULAR_LIGHTING,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_specular_lighting_set_atts,
                                 rsvg_filter_draw,
@@ -4904,18 +4893,18 @@ rsvg_filter_primitive_tile_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *
 }
 
 RsvgNode *
-rsvg_new_filter_primitive_tile (const char *element_name, RsvgNode *parent)
+rsvg_new_filter_primitive_tile (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgFilterPrimitiveTile *filter;
 
-    filter = g_new0 (RsvgFilterPrimitiveTile, 1);
+    filter = rsvg_arena_new0 (arena, RsvgFilterPrimitiveTile);
     filter->super.in = g_string_new ("none");
     filter->super.result = g_string_new ("none");
     filter->super.render = rsvg_filter_primitive_tile_render;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_FILTER_PRIMITIVE_TILE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 filter,
                                 rsvg_filter_primitive_tile_set_atts,
                                 rsvg_filter_draw,
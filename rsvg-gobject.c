@@ -38,7 +38,11 @@
 #include "config.h"
 
 #include "rsvg-private.h"
+#include "rsvg-arena.h"
 #include "rsvg-defs.h"
+#include "rsvg-spatial-index.h"
+#include "rsvg-styles.h"
+#include "rsvg-stylesheet.h"
 #include "rsvg.h"
 
 enum {
@@ -69,6 +73,7 @@ rsvg_handle_init (RsvgHandle * self)
 
     self->priv->flags = RSVG_HANDLE_FLAGS_NONE;
     self->priv->all_nodes = g_ptr_array_new ();
+    self->priv->arena = rsvg_arena_new ();
     self->priv->defs = rsvg_defs_new (self);
     self->priv->handler_nest = 0;
     self->priv->entities = g_hash_table_new_full (g_str_hash, 
@@ -78,15 +83,17 @@ rsvg_handle_init (RsvgHandle * self)
     self->priv->dpi_x = rsvg_internal_dpi_x;
     self->priv->dpi_y = rsvg_internal_dpi_y;
 
-    self->priv->css_props = g_hash_table_new_full (g_str_hash,
-                                                   g_str_equal,
-                                                   g_free,
-                                                   (GDestroyNotify) g_hash_table_destroy);
+    self->priv->stylesheets = g_ptr_array_new_with_free_func ((GDestroyNotify) rsvg_stylesheet_unref);
+    self->priv->style_ancestors = rsvg_style_ancestors_new ();
+    self->priv->paint_styles = rsvg_paint_style_table_new ();
+    self->priv->text_styles = rsvg_text_style_table_new ();
 
     self->priv->ctxt = NULL;
     self->priv->currentnode = NULL;
     self->priv->treebase = NULL;
     self->priv->element_name_stack = NULL;
+    self->priv->last_chars_node = NULL;
+    self->priv->chars_node_stack = NULL;
 
     self->priv->finished = 0;
     self->priv->data_input_stream = NULL;
@@ -95,6 +102,10 @@ rsvg_handle_init (RsvgHandle * self)
 
     self->priv->is_disposed = FALSE;
     self->priv->in_loop = FALSE;
+    self->priv->bbox_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    self->priv->element_bounds = NULL;
+    self->priv->instances = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                   (GDestroyNotify) rsvg_node_instances_free);
 
     self->priv->is_testing = FALSE;
 }
@@ -125,6 +136,8 @@ rsvg_handle_dispose (GObject *instance)
 
     self->priv->is_disposed = TRUE;
 
+    _rsvg_handle_free_prefetches (self);
+
     g_hash_table_destroy (self->priv->entities);
 
     free_nodes (self);
@@ -132,11 +145,27 @@ rsvg_handle_dispose (GObject *instance)
     rsvg_defs_free (self->priv->defs);
     self->priv->defs = NULL;
 
-    g_hash_table_destroy (self->priv->css_props);
+    g_ptr_array_unref (self->priv->stylesheets);
+    g_clear_pointer (&self->priv->imported_stylesheets, g_hash_table_destroy);
+    rsvg_style_ancestors_free (self->priv->style_ancestors);
+    g_hash_table_destroy (self->priv->paint_styles);
+    g_hash_table_destroy (self->priv->text_styles);
+
+    g_hash_table_destroy (self->priv->bbox_cache);
+    g_hash_table_destroy (self->priv->instances);
+
+    if (self->priv->element_bounds) {
+        rsvg_spatial_index_free (self->priv->element_bounds);
+        self->priv->element_bounds = NULL;
+    }
 
     self->priv->treebase = rsvg_node_unref (self->priv->treebase);
     self->priv->currentnode = rsvg_node_unref (self->priv->currentnode);
 
+    /* All the nodes are gone now, so nothing uses the arena anymore */
+    rsvg_arena_free (self->priv->arena);
+    self->priv->arena = NULL;
+
     if (self->priv->user_data_destroy)
         (*self->priv->user_data_destroy) (self->priv->user_data);
 
@@ -36,22 +36,276 @@
 #include "rsvg-css.h"
 #include "rsvg-io.h"
 #include "rsvg-styles.h"
+#include "rsvg-cairo-draw.h"
+
+/* Decoded images are shared by all the handles in the process, so an
+ * image which is referenced many times, or by many documents, only gets
+ * decoded once.  Local files are identified by their URI, modification
+ * time and size, so we don't even have to read them again; everything
+ * else, like data: URIs, by a checksum of its contents.  The least
+ * recently used images are dropped when the cache grows too big.
+ */
+#define IMAGE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+    char *key;
+    cairo_surface_t *surface;
+    gsize size;
+    GList *link;                /* in image_cache_lru */
+} RsvgImageCacheEntry;
+
+G_LOCK_DEFINE_STATIC (image_cache);
+static GHashTable *image_cache;
+static GQueue image_cache_lru = G_QUEUE_INIT; /* most recently used first */
+static gsize image_cache_size;
+
+/* The natural size of the images we have seen, so that we can tell which
+ * level of an image we need before decoding it.  These are small, so we
+ * just start over when there are too many.
+ */
+#define IMAGE_SIZES_MAX_ENTRIES 4096
+static GHashTable *image_sizes;
 
-cairo_surface_t *
-rsvg_cairo_surface_new_from_href (RsvgHandle *handle,
-                                  const char *href,
-                                  GError **error)
+static void
+image_cache_entry_free (RsvgImageCacheEntry *entry)
+{
+    g_free (entry->key);
+    cairo_surface_destroy (entry->surface);
+    g_free (entry);
+}
+
+static void
+image_cache_remove (RsvgImageCacheEntry *entry)
+{
+    g_queue_delete_link (&image_cache_lru, entry->link);
+    image_cache_size -= entry->size;
+    g_hash_table_remove (image_cache, entry->key);
+}
+
+static cairo_surface_t *
+image_cache_lookup (const char *key)
+{
+    RsvgImageCacheEntry *entry;
+    cairo_surface_t *surface = NULL;
+
+    G_LOCK (image_cache);
+
+    if (image_cache && (entry = g_hash_table_lookup (image_cache, key)) != NULL) {
+        g_queue_unlink (&image_cache_lru, entry->link);
+        g_queue_push_head_link (&image_cache_lru, entry->link);
+
+        surface = cairo_surface_reference (entry->surface);
+    }
+
+    G_UNLOCK (image_cache);
+
+    return surface;
+}
+
+static gboolean
+image_cache_contains (const char *key)
+{
+    gboolean found;
+
+    G_LOCK (image_cache);
+    found = image_cache && g_hash_table_lookup (image_cache, key) != NULL;
+    G_UNLOCK (image_cache);
+
+    return found;
+}
+
+static gboolean
+image_cache_lookup_natural_size (const char *base_key, int *width, int *height)
+{
+    int *size = NULL;
+
+    G_LOCK (image_cache);
+
+    if (image_sizes && (size = g_hash_table_lookup (image_sizes, base_key)) != NULL) {
+        *width = size[0];
+        *height = size[1];
+    }
+
+    G_UNLOCK (image_cache);
+
+    return size != NULL;
+}
+
+static void
+image_cache_insert (const char *key,
+                    const char *base_key,
+                    int natural_width,
+                    int natural_height,
+                    cairo_surface_t *surface)
+{
+    RsvgImageCacheEntry *entry;
+    gsize size;
+    int *natural_size;
+
+    G_LOCK (image_cache);
+
+    if (image_sizes == NULL || g_hash_table_size (image_sizes) >= IMAGE_SIZES_MAX_ENTRIES) {
+        if (image_sizes)
+            g_hash_table_destroy (image_sizes);
+
+        image_sizes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    }
+
+    natural_size = g_new (int, 2);
+    natural_size[0] = natural_width;
+    natural_size[1] = natural_height;
+    g_hash_table_replace (image_sizes, g_strdup (base_key), natural_size);
+
+    G_UNLOCK (image_cache);
+
+    size = (gsize) cairo_image_surface_get_stride (surface) * cairo_image_surface_get_height (surface);
+
+    /* Don't let a single huge image flush everything else */
+    if (size > IMAGE_CACHE_MAX_SIZE / 4)
+        return;
+
+    G_LOCK (image_cache);
+
+    if (image_cache == NULL)
+        image_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                             (GDestroyNotify) image_cache_entry_free);
+
+    /* Another thread may have decoded the same image in the meantime */
+    if (g_hash_table_lookup (image_cache, key) == NULL) {
+        entry = g_new (RsvgImageCacheEntry, 1);
+        entry->key = g_strdup (key);
+        entry->surface = cairo_surface_reference (surface);
+        entry->size = size;
+
+        g_queue_push_head (&image_cache_lru, entry);
+        entry->link = image_cache_lru.head;
+        g_hash_table_insert (image_cache, entry->key, entry);
+        image_cache_size += size;
+
+        while (image_cache_size > IMAGE_CACHE_MAX_SIZE)
+            image_cache_remove (g_queue_peek_tail (&image_cache_lru));
+    }
+
+    G_UNLOCK (image_cache);
+}
+
+/* Drops all the cached images; called from rsvg_cleanup() */
+void
+rsvg_image_cache_clear (void)
+{
+    G_LOCK (image_cache);
+
+    if (image_cache) {
+        g_hash_table_destroy (image_cache);
+        image_cache = NULL;
+    }
+
+    if (image_sizes) {
+        g_hash_table_destroy (image_sizes);
+        image_sizes = NULL;
+    }
+
+    g_queue_clear (&image_cache_lru);
+    image_cache_size = 0;
+
+    G_UNLOCK (image_cache);
+}
+
+static char *
+get_data_cache_key (const char *data, gsize data_len, const char *mime_type)
+{
+    char *checksum, *key;
+
+    checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) data, data_len);
+    key = g_strdup_printf ("%s %s", mime_type ? mime_type : "", checksum);
+    g_free (checksum);
+
+    return key;
+}
+
+/* Images can be decoded at a fraction of their size when they are drawn
+ * much smaller than that.  Level n is 1/2^n of the image's natural size,
+ * rounded up.
+ */
+typedef struct {
+    guint32 aspect_ratio;
+    double width, height;       /* of the viewport the image is fitted into */
+    double scale_x, scale_y;    /* device pixels per user space unit */
+    gboolean full_resolution;
+
+    int natural_width, natural_height;  /* 0 if not known yet */
+    int level;
+} RsvgImageRequest;
+
+static int
+level_size (int size, int level)
+{
+    return (size + (1 << level) - 1) >> level;
+}
+
+/* The smallest level which still has at least as many pixels as the image
+ * covers on the device.
+ */
+static int
+choose_level (RsvgImageRequest *req)
+{
+    double x = 0, y = 0, w = req->width, h = req->height;
+    double ratio;
+    int level, max_level;
+
+    if (req->full_resolution)
+        return 0;
+
+    max_level = 0;
+    while ((req->natural_width >> (max_level + 1)) > 0
+           && (req->natural_height >> (max_level + 1)) > 0)
+        max_level++;
+
+    rsvg_aspect_ratio_compute (req->aspect_ratio,
+                               req->natural_width, req->natural_height,
+                               &x, &y, &w, &h);
+
+    w *= req->scale_x;
+    h *= req->scale_y;
+
+    if (w <= 0 || h <= 0)
+        return max_level;
+
+    ratio = MIN (req->natural_width / w, req->natural_height / h);
+
+    for (level = 0; level < max_level && ratio >= 2.0; level++)
+        ratio /= 2.0;
+
+    return level;
+}
+
+static void
+size_prepared_cb (GdkPixbufLoader *loader, int width, int height, RsvgImageRequest *req)
+{
+    req->natural_width = width;
+    req->natural_height = height;
+    req->level = choose_level (req);
+
+    /* Loaders that can't decode at a smaller size get scaled afterwards */
+    if (req->level > 0)
+        gdk_pixbuf_loader_set_size (loader,
+                                    level_size (width, req->level),
+                                    level_size (height, req->level));
+}
+
+static cairo_surface_t *
+decode_image (RsvgHandle *handle,
+              const char *href,
+              char *data,
+              gsize data_len,
+              const char *mime_type,
+              RsvgImageRequest *req,
+              GError **error)
 {
-    char *data;
-    gsize data_len;
-    char *mime_type = NULL;
     GdkPixbufLoader *loader = NULL;
     GdkPixbuf *pixbuf = NULL;
     cairo_surface_t *surface = NULL;
-
-    data = _rsvg_handle_acquire_data (handle, href, &mime_type, &data_len, error);
-    if (data == NULL)
-        return NULL;
+    char *detected_mime_type = NULL;
 
     if (mime_type) {
         loader = gdk_pixbuf_loader_new_with_mime_type (mime_type, error);
@@ -62,6 +316,8 @@ rsvg_cairo_surface_new_from_href (RsvgHandle *handle,
     if (loader == NULL)
         goto out;
 
+    g_signal_connect (loader, "size-prepared", G_CALLBACK (size_prepared_cb), req);
+
     if (!gdk_pixbuf_loader_write (loader, (guchar *) data, data_len, error)) {
         gdk_pixbuf_loader_close (loader, NULL);
         goto out;
@@ -81,47 +337,280 @@ rsvg_cairo_surface_new_from_href (RsvgHandle *handle,
         goto out;
     }
 
+    if (req->natural_width == 0) {
+        req->natural_width = gdk_pixbuf_get_width (pixbuf);
+        req->natural_height = gdk_pixbuf_get_height (pixbuf);
+        req->level = 0;
+    }
+
     surface = rsvg_cairo_surface_from_pixbuf (pixbuf);
 
-    if (mime_type == NULL) {
-        /* Try to get the information from the loader */
-        GdkPixbufFormat *format;
-        char **mime_types;
+    if ((handle->priv->flags & RSVG_HANDLE_FLAG_KEEP_IMAGE_DATA) != 0) {
+        if (mime_type == NULL) {
+            /* Try to get the information from the loader */
+            GdkPixbufFormat *format;
+            char **mime_types;
+
+            if ((format = gdk_pixbuf_loader_get_format (loader)) != NULL) {
+                mime_types = gdk_pixbuf_format_get_mime_types (format);
 
-        if ((format = gdk_pixbuf_loader_get_format (loader)) != NULL) {
-            mime_types = gdk_pixbuf_format_get_mime_types (format);
+                if (mime_types != NULL)
+                    detected_mime_type = g_strdup (mime_types[0]);
+                g_strfreev (mime_types);
+            }
 
-            if (mime_types != NULL)
-                mime_type = g_strdup (mime_types[0]);
-            g_strfreev (mime_types);
+            mime_type = detected_mime_type;
         }
-    }
 
-    if ((handle->priv->flags & RSVG_HANDLE_FLAG_KEEP_IMAGE_DATA) != 0 &&
-        mime_type != NULL &&
-        cairo_surface_set_mime_data (surface, mime_type, (guchar *) data,
-                                     data_len, g_free, data) == CAIRO_STATUS_SUCCESS) {
-        data = NULL; /* transferred to the surface */
+        if (mime_type != NULL &&
+            cairo_surface_set_mime_data (surface, mime_type, (guchar *) data,
+                                         data_len, g_free, data) == CAIRO_STATUS_SUCCESS) {
+            data = NULL; /* transferred to the surface */
+        }
     }
 
   out:
     if (loader)
         g_object_unref (loader);
-    g_free (mime_type);
+    g_free (detected_mime_type);
     g_free (data);
 
     return surface;
 }
 
+static char *
+get_level_cache_key (const char *base_key, int level)
+{
+    return g_strdup_printf ("%s %d", base_key, level);
+}
+
+static cairo_surface_t *
+lookup_level (const char *base_key, RsvgImageRequest *req)
+{
+    cairo_surface_t *surface;
+    char *key;
+
+    if (req->natural_width == 0
+        && !image_cache_lookup_natural_size (base_key, &req->natural_width, &req->natural_height))
+        return NULL;
+
+    req->level = choose_level (req);
+
+    key = get_level_cache_key (base_key, req->level);
+    surface = image_cache_lookup (key);
+    g_free (key);
+
+    return surface;
+}
+
+/* Whether some level of the local file at @href is cached already, in
+ * which case reading it ahead of time is most likely wasted.
+ */
+gboolean
+rsvg_image_is_cached (RsvgHandle *handle, const char *href)
+{
+    char *uri, *base_key, *key;
+    int width, height, level;
+    gboolean found = FALSE;
+
+    uri = _rsvg_handle_resolve_allowed_uri (handle, href, NULL);
+    if (uri == NULL)
+        return FALSE;
+
+    base_key = _rsvg_io_get_file_cache_key (uri);
+    g_free (uri);
+
+    if (base_key == NULL)
+        return FALSE;
+
+    if (image_cache_lookup_natural_size (base_key, &width, &height)) {
+        for (level = 0; !found; level++) {
+            key = get_level_cache_key (base_key, level);
+            found = image_cache_contains (key);
+            g_free (key);
+
+            if ((width >> (level + 1)) == 0 || (height >> (level + 1)) == 0)
+                break;
+        }
+    }
+
+    g_free (base_key);
+
+    return found;
+}
+
+/* Loads the image at @href at the level that @req asks for, and fills in
+ * the image's natural size and the level in @req.
+ */
+static cairo_surface_t *
+load_image (RsvgHandle *handle, const char *href, RsvgImageRequest *req, GError **error)
+{
+    char *uri;
+    char *data;
+    gsize data_len;
+    char *mime_type = NULL;
+    char *base_key = NULL;
+    char *key;
+    cairo_surface_t *surface;
+
+    /* Surfaces that carry the image data for cairo are not shared, and
+     * they had better have all of it.
+     */
+    if ((handle->priv->flags & RSVG_HANDLE_FLAG_KEEP_IMAGE_DATA) != 0) {
+        req->full_resolution = TRUE;
+
+        data = _rsvg_handle_acquire_data (handle, href, &mime_type, &data_len, error);
+        if (data == NULL)
+            return NULL;
+
+        surface = decode_image (handle, href, data, data_len, mime_type, req, error);
+        g_free (mime_type);
+
+        return surface;
+    }
+
+    uri = _rsvg_handle_resolve_allowed_uri (handle, href, error);
+    if (uri == NULL)
+        return NULL;
+
+    base_key = _rsvg_io_get_file_cache_key (uri);
+    if (base_key && (surface = lookup_level (base_key, req)) != NULL) {
+        _rsvg_handle_drop_prefetch (handle, uri);
+        goto out;
+    }
+
+    data = _rsvg_handle_acquire_data (handle, uri, &mime_type, &data_len, error);
+    if (data == NULL) {
+        surface = NULL;
+        goto out;
+    }
+
+    if (base_key == NULL) {
+        base_key = get_data_cache_key (data, data_len, mime_type);
+
+        if ((surface = lookup_level (base_key, req)) != NULL) {
+            g_free (data);
+            goto out;
+        }
+    }
+
+    surface = decode_image (handle, href, data, data_len, mime_type, req, error);
+    if (surface) {
+        key = get_level_cache_key (base_key, req->level);
+        image_cache_insert (key, base_key, req->natural_width, req->natural_height, surface);
+        g_free (key);
+    }
+
+  out:
+    g_free (uri);
+    g_free (base_key);
+    g_free (mime_type);
+
+    return surface;
+}
+
+cairo_surface_t *
+rsvg_cairo_surface_new_from_href (RsvgHandle *handle,
+                                  const char *href,
+                                  GError **error)
+{
+    RsvgImageRequest req;
+
+    memset (&req, 0, sizeof (req));
+    req.full_resolution = TRUE;
+
+    return load_image (handle, href, &req, error);
+}
+
+/* Whether loading the image again would fail the same way.  A missing
+ * file or a format we can't decode won't fix itself, but the next draw
+ * can succeed after a cancelled read or running out of memory.  Loaders
+ * which fail without saying why are assumed to fail again.
+ */
+static gboolean
+load_error_is_permanent (const GError *error)
+{
+    if (error == NULL)
+        return TRUE;
+
+    return !(g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+             || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)
+             || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BUSY)
+             || g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM)
+             || g_error_matches (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY));
+}
+
+/* Returns the image's surface at a resolution which is good enough for
+ * drawing it into a viewport of @width by @height with the current
+ * transformation, decoding it if we don't have a suitable one already.
+ */
+static cairo_surface_t *
+rsvg_node_image_get_surface (RsvgNodeImage *image, RsvgDrawingCtx *ctx, double width, double height)
+{
+    RsvgImageRequest req;
+    RsvgImageLevel found;
+    cairo_surface_t *surface;
+    GError *error = NULL;
+    int i, wanted;
+
+    memset (&req, 0, sizeof (req));
+    req.aspect_ratio = image->preserve_aspect_ratio;
+    req.width = width;
+    req.height = height;
+    req.full_resolution = !rsvg_cairo_get_raster_scale (ctx, &req.scale_x, &req.scale_y);
+    req.natural_width = image->natural_width;
+    req.natural_height = image->natural_height;
+
+    if (image->natural_width > 0) {
+        wanted = choose_level (&req);
+
+        /* The level we want, or the next finer one, which has up to four
+         * times as many pixels, will do; that way zooming in and out by a
+         * little doesn't keep decoding the image again.
+         */
+        for (i = 0; i < MAX_IMAGE_LEVELS && image->levels[i].surface; i++) {
+            if (image->levels[i].level <= wanted && image->levels[i].level >= wanted - 1) {
+                found = image->levels[i];
+                memmove (&image->levels[1], &image->levels[0], i * sizeof (RsvgImageLevel));
+                image->levels[0] = found;
+
+                return found.surface;
+            }
+        }
+    }
+
+    surface = load_image (image->handle, image->href, &req, &error);
+    if (surface == NULL) {
+#ifdef G_ENABLE_DEBUG
+        g_warning ("Couldn't load image: %s: %s\n", image->href, error ? error->message : "");
+#endif
+        image->failed = load_error_is_permanent (error);
+        g_clear_error (&error);
+        return NULL;
+    }
+
+    image->natural_width = req.natural_width;
+    image->natural_height = req.natural_height;
+
+    if (image->levels[MAX_IMAGE_LEVELS - 1].surface)
+        cairo_surface_destroy (image->levels[MAX_IMAGE_LEVELS - 1].surface);
+
+    memmove (&image->levels[1], &image->levels[0], (MAX_IMAGE_LEVELS - 1) * sizeof (RsvgImageLevel));
+    image->levels[0].surface = surface;
+    image->levels[0].level = req.level;
+
+    return surface;
+}
+
 static void
 rsvg_node_image_free (gpointer impl)
 {
     RsvgNodeImage *image = impl;
+    int i;
 
-    if (image->surface)
-        cairo_surface_destroy (image->surface);
-
-    g_free (image);
+    for (i = 0; i < MAX_IMAGE_LEVELS; i++)
+        if (image->levels[i].surface)
+            cairo_surface_destroy (image->levels[i].surface);
 }
 
 static void
@@ -131,9 +620,9 @@ rsvg_node_image_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int do
     RsvgState *state;
     unsigned int aspect_ratio = z->preserve_aspect_ratio;
     gdouble x, y, w, h;
-    cairo_surface_t *surface = z->surface;
+    cairo_surface_t *surface;
 
-    if (surface == NULL)
+    if (z->href == NULL || z->failed)
         return;
 
     x = rsvg_length_normalize (&z->x, ctx);
@@ -145,6 +634,13 @@ rsvg_node_image_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int do
 
     rsvg_state_reinherit_top (ctx, state, dominate);
 
+    /* Images are only decoded when they are first drawn, at the
+     * resolution they are drawn at.
+     */
+    surface = rsvg_node_image_get_surface (z, ctx, w, h);
+    if (surface == NULL)
+        return;
+
     rsvg_push_discrete_layer (ctx);
 
     if (!rsvg_current_state (ctx)->overflow && (aspect_ratio & RSVG_ASPECT_RATIO_SLICE)) {
@@ -152,8 +648,8 @@ rsvg_node_image_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int do
     }
 
     rsvg_aspect_ratio_compute (aspect_ratio, 
-                               (double) cairo_image_surface_get_width (surface),
-                               (double) cairo_image_surface_get_height (surface), 
+                               (double) z->natural_width,
+                               (double) z->natural_height,
                                &x, &y, &w, &h);
 
     rsvg_render_surface (ctx, surface, x, y, w, h);
@@ -178,15 +674,8 @@ rsvg_node_image_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, Rsv
     /* path is used by some older adobe illustrator versions */
     if ((value = rsvg_property_bag_lookup (atts, "path"))
         || (value = rsvg_property_bag_lookup (atts, "xlink:href"))) {
-        image->surface = rsvg_cairo_surface_new_from_href (handle,
-                                                           value, 
-                                                           NULL);
-
-        if (!image->surface) {
-#ifdef G_ENABLE_DEBUG
-            g_warning ("Couldn't load image: %s\n", value);
-#endif
-        }
+        image->href = rsvg_arena_strdup (handle->priv->arena, value);
+        image->handle = handle;
     }
 
     if ((value = rsvg_property_bag_lookup (atts, "preserveAspectRatio")))
@@ -194,18 +683,17 @@ rsvg_node_image_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, Rsv
 }
 
 RsvgNode *
-rsvg_new_image (const char *element_name, RsvgNode *parent)
+rsvg_new_image (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeImage *image;
 
-    image = g_new0 (RsvgNodeImage, 1);
-    image->surface = NULL;
+    image = rsvg_arena_new0 (arena, RsvgNodeImage);
     image->preserve_aspect_ratio = RSVG_ASPECT_RATIO_XMID_YMID;
     image->x = image->y = image->w = image->h = rsvg_length_parse ("0", LENGTH_DIR_BOTH);
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_IMAGE,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 image,
                                 rsvg_node_image_set_atts,
                                 rsvg_node_image_draw,
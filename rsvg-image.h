@@ -37,18 +37,33 @@
 G_BEGIN_DECLS 
 
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_image (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_new_image (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 typedef struct _RsvgNodeImage RsvgNodeImage;
 
+#define MAX_IMAGE_LEVELS 3
+
+typedef struct {
+    cairo_surface_t *surface;   /* a cairo image surface */
+    int level;                  /* the surface is 1/2^level of the natural size */
+} RsvgImageLevel;
+
 struct _RsvgNodeImage {
     guint32 preserve_aspect_ratio;
     RsvgLength x, y, w, h;
-    cairo_surface_t *surface; /* a cairo image surface */
+    RsvgHandle *handle;         /* not owned; only used while it's alive */
+    char *href;
+    int natural_width, natural_height; /* 0 until the image is first decoded */
+    gboolean failed; /* loading it failed in a way that would only fail again */
+    RsvgImageLevel levels[MAX_IMAGE_LEVELS]; /* most recently used first */
 };
 
 G_GNUC_INTERNAL
 cairo_surface_t *rsvg_cairo_surface_new_from_href (RsvgHandle *handle, const char *href, GError ** error);
+G_GNUC_INTERNAL
+void rsvg_image_cache_clear (void);
+G_GNUC_INTERNAL
+gboolean rsvg_image_is_cached (RsvgHandle *handle, const char *href);
 
 G_END_DECLS
 
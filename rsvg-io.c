@@ -356,3 +356,36 @@ _rsvg_io_acquire_stream (const char *href,
 
     return NULL;
 }
+
+/* Identifies a local file without reading it, or returns %NULL */
+char *
+_rsvg_io_get_file_cache_key (const char *uri)
+{
+    GFile *file;
+    GFileInfo *info;
+    GTimeVal mtime;
+    char *key;
+
+    if (!g_str_has_prefix (uri, "file:"))
+        return NULL;
+
+    file = g_file_new_for_uri (uri);
+    info = g_file_query_info (file,
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                              G_FILE_QUERY_INFO_NONE,
+                              NULL,
+                              NULL);
+    g_object_unref (file);
+
+    if (info == NULL)
+        return NULL;
+
+    g_file_info_get_modification_time (info, &mtime);
+    key = g_strdup_printf ("%s %ld.%06ld %" G_GOFFSET_FORMAT,
+                           uri, mtime.tv_sec, mtime.tv_usec, g_file_info_get_size (info));
+    g_object_unref (info);
+
+    return key;
+}
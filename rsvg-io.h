@@ -43,4 +43,8 @@ GInputStream *_rsvg_io_acquire_stream (const char *uri,
                                        GCancellable *cancellable,
                                        GError **error);
 
+/* Identifies a local file without reading it, or returns %NULL */
+G_GNUC_INTERNAL
+char *_rsvg_io_get_file_cache_key (const char *uri);
+
 #endif /* RSVG_IO_H */
@@ -32,7 +32,7 @@ G_BEGIN_DECLS
 
 /* Implemented in rust/src/marker.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_marker_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_marker_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 G_END_DECLS
 
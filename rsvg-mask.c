@@ -64,11 +64,11 @@ rsvg_mask_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int dominate
 }
 
 RsvgNode *
-rsvg_new_mask (const char *element_name, RsvgNode *parent)
+rsvg_new_mask (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgMask *mask;
 
-    mask = g_new0 (RsvgMask, 1);
+    mask = rsvg_arena_new0 (arena, RsvgMask);
     mask->maskunits = objectBoundingBox;
     mask->contentunits = userSpaceOnUse;
     mask->x = rsvg_length_parse ("0", LENGTH_DIR_HORIZONTAL);
@@ -78,11 +78,11 @@ rsvg_new_mask (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_MASK,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 mask,
                                 rsvg_mask_set_atts,
                                 rsvg_mask_draw,
-                                g_free);
+                                rsvg_arena_free_nothing);
 }
 
 static void
@@ -106,18 +106,18 @@ rsvg_clip_path_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int dom
 }
 
 RsvgNode *
-rsvg_new_clip_path (const char *element_name, RsvgNode *parent)
+rsvg_new_clip_path (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgClipPath *clip_path;
 
-    clip_path = g_new0 (RsvgClipPath, 1);
+    clip_path = rsvg_arena_new0 (arena, RsvgClipPath);
     clip_path->units = userSpaceOnUse;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_CLIP_PATH,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 clip_path,
                                 rsvg_clip_path_set_atts,
                                 rsvg_clip_path_draw,
-                                g_free); 
+                                rsvg_arena_free_nothing);
 }
@@ -46,7 +46,7 @@ struct _RsvgMask {
 };
 
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_mask	    (const char *element_name, RsvgNode *node);
+RsvgNode *rsvg_new_mask	    (const char *element_name, RsvgNode *node, RsvgState *state, RsvgArena *arena);
 
 typedef struct _RsvgClipPath RsvgClipPath;
 
@@ -55,7 +55,7 @@ struct _RsvgClipPath {
 };
 
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_clip_path	(const char *element_name, RsvgNode *node);
+RsvgNode *rsvg_new_clip_path	(const char *element_name, RsvgNode *node, RsvgState *state, RsvgArena *arena);
 
 G_END_DECLS
 #endif
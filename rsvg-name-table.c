@@ -0,0 +1,100 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-name-table.c: Perfect hashes for fixed sets of names
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "rsvg-name-table.h"
+
+static inline const char *
+get_name (RsvgNameTable *table, guint i)
+{
+    return *(const char *const *) ((const guint8 *) table->entries + i * table->stride);
+}
+
+static inline guint
+hash_name (guint32 seed, const char *name, gsize len)
+{
+    guint32 h = 2166136261u ^ seed;
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (guchar) name[i];
+        h *= 16777619u;
+    }
+
+    return (h ^ (h >> 16)) & (RSVG_NAME_TABLE_SIZE - 1);
+}
+
+static void
+init_table (RsvgNameTable *table)
+{
+    guint32 seed;
+
+    g_assert (table->n_entries < 256);
+
+    for (seed = 0; ; seed++) {
+        guint i;
+
+        memset (table->slots, 0, sizeof (table->slots));
+
+        for (i = 0; i < table->n_entries; i++) {
+            const char *name = get_name (table, i);
+            guint slot = hash_name (seed, name, strlen (name));
+
+            if (table->slots[slot] != 0)
+                break;
+
+            table->slots[slot] = i + 1;
+        }
+
+        if (i == table->n_entries)
+            break;
+    }
+
+    table->seed = seed;
+}
+
+gint
+rsvg_name_table_lookup (RsvgNameTable *table, const char *name, gssize len)
+{
+    const char *candidate;
+    guint8 slot;
+
+    if (g_once_init_enter (&table->initialized)) {
+        init_table (table);
+        g_once_init_leave (&table->initialized, 1);
+    }
+
+    if (len < 0)
+        len = strlen (name);
+
+    slot = table->slots[hash_name (table->seed, name, len)];
+    if (slot == 0)
+        return -1;
+
+    candidate = get_name (table, slot - 1);
+    if (strlen (candidate) != (gsize) len || memcmp (candidate, name, len) != 0)
+        return -1;
+
+    return slot - 1;
+}
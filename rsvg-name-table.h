@@ -0,0 +1,57 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-name-table.h: Perfect hashes for fixed sets of names
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef RSVG_NAME_TABLE_H
+#define RSVG_NAME_TABLE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Maps the names of a static array to their indices.  Each entry of the
+ * array must start with its name, as a "const char *".  The seed of the
+ * hash is picked the first time the table is used, so that no two names
+ * fall into the same slot; a lookup is then one hash and one comparison.
+ */
+#define RSVG_NAME_TABLE_SIZE 1024
+
+typedef struct {
+    gconstpointer entries;
+    gsize stride;
+    guint n_entries;            /* at most 255 */
+
+    gsize initialized;
+    guint32 seed;
+    guint8 slots[RSVG_NAME_TABLE_SIZE]; /* index + 1, or 0 for empty */
+} RsvgNameTable;
+
+#define RSVG_NAME_TABLE_INIT(entries) \
+    { (entries), sizeof ((entries)[0]), G_N_ELEMENTS (entries), 0, 0, { 0 } }
+
+/* Returns the index of @name, or -1 if it is not in the table.  @len may
+ * be -1 if @name is nul-terminated.
+ */
+G_GNUC_INTERNAL
+gint rsvg_name_table_lookup (RsvgNameTable *table, const char *name, gssize len);
+
+G_END_DECLS
+
+#endif /* RSVG_NAME_TABLE_H */
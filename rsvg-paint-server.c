@@ -184,7 +184,7 @@ rsvg_paint_server_ref (RsvgPaintServer * ps)
 {
     if (ps == NULL)
         return;
-    ps->refcnt++;
+    g_atomic_int_inc (&ps->refcnt);
 }
 
 /**
@@ -198,7 +198,7 @@ rsvg_paint_server_unref (RsvgPaintServer * ps)
 {
     if (ps == NULL)
         return;
-    if (--ps->refcnt == 0) {
+    if (g_atomic_int_dec_and_test (&ps->refcnt)) {
         if (ps->type == RSVG_PAINT_SERVER_SOLID)
             g_free (ps->core.color);
         else if (ps->type == RSVG_PAINT_SERVER_IRI) {
@@ -209,6 +209,35 @@ rsvg_paint_server_unref (RsvgPaintServer * ps)
     }
 }
 
+/* Whether two paint servers paint the same, even if they come from
+ * different style declarations.
+ */
+gboolean
+rsvg_paint_server_equal (const RsvgPaintServer *a, const RsvgPaintServer *b)
+{
+    if (a == b)
+        return TRUE;
+
+    if (a == NULL || b == NULL || a->type != b->type)
+        return FALSE;
+
+    switch (a->type) {
+    case RSVG_PAINT_SERVER_SOLID:
+        return (a->core.color->currentcolor == b->core.color->currentcolor
+                && a->core.color->argb == b->core.color->argb);
+
+    case RSVG_PAINT_SERVER_IRI:
+        return (g_strcmp0 (a->core.iri->iri_str, b->core.iri->iri_str) == 0
+                && a->core.iri->has_alternate == b->core.iri->has_alternate
+                && a->core.iri->alternate.currentcolor == b->core.iri->alternate.currentcolor
+                && a->core.iri->alternate.argb == b->core.iri->alternate.argb);
+
+    default:
+        g_assert_not_reached ();
+        return FALSE;
+    }
+}
+
 static void
 rsvg_stop_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, RsvgPropertyBag *atts)
 {
@@ -250,20 +279,20 @@ rsvg_stop_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, RsvgPrope
     inherited_state = rsvg_state_new ();
     rsvg_state_reconstruct (inherited_state, node);
 
-    if (state->has_stop_color) {
-        switch (state->stop_color.kind) {
+    if (state->paint->has_stop_color) {
+        switch (state->paint->stop_color.kind) {
         case RSVG_CSS_COLOR_SPEC_INHERIT:
-            switch (inherited_state->stop_color.kind) {
+            switch (inherited_state->paint->stop_color.kind) {
             case RSVG_CSS_COLOR_SPEC_INHERIT:
                 color = 0;
                 break;
 
             case RSVG_CSS_COLOR_SPEC_CURRENT_COLOR:
-                color = inherited_state->current_color;
+                color = inherited_state->paint->current_color;
                 break;
 
             case RSVG_CSS_COLOR_SPEC_ARGB:
-                color = inherited_state->stop_color.argb;
+                color = inherited_state->paint->stop_color.argb;
                 break;
 
             case RSVG_CSS_COLOR_PARSE_ERROR:
@@ -277,11 +306,11 @@ rsvg_stop_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, RsvgPrope
             break;
 
         case RSVG_CSS_COLOR_SPEC_CURRENT_COLOR:
-            color = inherited_state->current_color;
+            color = inherited_state->paint->current_color;
             break;
 
         case RSVG_CSS_COLOR_SPEC_ARGB:
-            color = state->stop_color.argb & 0x00ffffff;
+            color = state->paint->stop_color.argb & 0x00ffffff;
             break;
 
         case RSVG_CSS_COLOR_PARSE_ERROR:
@@ -296,16 +325,16 @@ rsvg_stop_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, RsvgPrope
         color = 0;
     }
 
-    if (state->has_stop_opacity) {
-        switch (state->stop_opacity.kind) {
+    if (state->paint->has_stop_opacity) {
+        switch (state->paint->stop_opacity.kind) {
         case RSVG_OPACITY_SPECIFIED:
-            opacity = state->stop_opacity.opacity;
+            opacity = state->paint->stop_opacity.opacity;
             break;
 
         case RSVG_OPACITY_INHERIT:
-            switch (inherited_state->stop_opacity.kind) {
+            switch (inherited_state->paint->stop_opacity.kind) {
             case RSVG_OPACITY_SPECIFIED:
-                opacity = inherited_state->stop_opacity.opacity;
+                opacity = inherited_state->paint->stop_opacity.opacity;
                 break;
 
             case RSVG_OPACITY_INHERIT:
@@ -338,9 +367,9 @@ rsvg_paint_server_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int
 }
 
 RsvgNode *
-rsvg_new_stop (const char *element_name, RsvgNode *parent)
+rsvg_new_stop (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
-    RsvgGradientStop *stop = g_new0 (RsvgGradientStop, 1);
+    RsvgGradientStop *stop = rsvg_arena_new0 (arena, RsvgGradientStop);
 
     stop->offset = 0;
     stop->rgba = 0xff000000;
@@ -348,11 +377,25 @@ rsvg_new_stop (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_STOP,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 stop,
                                 rsvg_stop_set_atts,
                                 rsvg_paint_server_draw,
-                                g_free);
+                                rsvg_arena_free_nothing);
+}
+
+void
+rsvg_gradient_cache_clear (RsvgGradientCache *cache)
+{
+    if (cache->resolved) {
+        gradient_destroy (cache->resolved);
+        cache->resolved = NULL;
+    }
+
+    if (cache->pattern) {
+        cairo_pattern_destroy (cache->pattern);
+        cache->pattern = NULL;
+    }
 }
 
 static void
@@ -361,6 +404,8 @@ rsvg_linear_gradient_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle
     RsvgLinearGradient *grad = impl;
     const char *value;
 
+    rsvg_gradient_cache_clear (&grad->cache);
+
     if ((value = rsvg_property_bag_lookup (atts, "x1"))) {
         grad->x1 = rsvg_length_parse (value, LENGTH_DIR_HORIZONTAL);
         grad->hasx1 = TRUE;
@@ -387,8 +432,7 @@ rsvg_linear_gradient_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle
         }
         grad->hasspread = TRUE;
     }
-    g_free (grad->fallback);
-    grad->fallback = g_strdup (rsvg_property_bag_lookup (atts, "xlink:href"));
+    grad->fallback = rsvg_arena_strdup (handle->priv->arena, rsvg_property_bag_lookup (atts, "xlink:href"));
     if ((value = rsvg_property_bag_lookup (atts, "gradientTransform"))) {
         if (rsvg_parse_transform (&grad->affine, value)) {
             grad->hastransform = TRUE;
@@ -412,16 +456,15 @@ rsvg_linear_gradient_free (gpointer impl)
 {
     RsvgLinearGradient *self = impl;
 
-    g_free (self->fallback);
-    g_free (self);
+    rsvg_gradient_cache_clear (&self->cache);
 }
 
 RsvgNode *
-rsvg_new_linear_gradient (const char *element_name, RsvgNode *parent)
+rsvg_new_linear_gradient (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgLinearGradient *grad = NULL;
 
-    grad = g_new0 (RsvgLinearGradient, 1);
+    grad = rsvg_arena_new0 (arena, RsvgLinearGradient);
     cairo_matrix_init_identity (&grad->affine);
     grad->x1 = rsvg_length_parse ("0", LENGTH_DIR_HORIZONTAL);
     grad->y1 = grad->y2 = rsvg_length_parse ("0", LENGTH_DIR_VERTICAL);
@@ -434,7 +477,7 @@ rsvg_new_linear_gradient (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_LINEAR_GRADIENT,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 grad,
                                 rsvg_linear_gradient_set_atts,
                                 rsvg_paint_server_draw,
@@ -447,6 +490,8 @@ rsvg_radial_gradient_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle
     RsvgRadialGradient *grad = impl;
     const char *value;
 
+    rsvg_gradient_cache_clear (&grad->cache);
+
     if ((value = rsvg_property_bag_lookup (atts, "cx"))) {
         grad->cx = rsvg_length_parse (value, LENGTH_DIR_HORIZONTAL);
         grad->hascx = TRUE;
@@ -471,8 +516,7 @@ rsvg_radial_gradient_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle
         grad->fy = rsvg_length_parse (value, LENGTH_DIR_VERTICAL);
         grad->hasfy = TRUE;
     }
-    g_free (grad->fallback);
-    grad->fallback = g_strdup (rsvg_property_bag_lookup (atts, "xlink:href"));
+    grad->fallback = rsvg_arena_strdup (handle->priv->arena, rsvg_property_bag_lookup (atts, "xlink:href"));
     if ((value = rsvg_property_bag_lookup (atts, "gradientTransform"))) {
         if (rsvg_parse_transform (&grad->affine, value)) {
             grad->hastransform = TRUE;
@@ -505,14 +549,13 @@ rsvg_radial_gradient_free (gpointer impl)
 {
     RsvgRadialGradient *self = impl;
 
-    g_free (self->fallback);
-    g_free (self);
+    rsvg_gradient_cache_clear (&self->cache);
 }
 
 RsvgNode *
-rsvg_new_radial_gradient (const char *element_name, RsvgNode *parent)
+rsvg_new_radial_gradient (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
-    RsvgRadialGradient *grad = g_new0 (RsvgRadialGradient, 1);
+    RsvgRadialGradient *grad = rsvg_arena_new0 (arena, RsvgRadialGradient);
     cairo_matrix_init_identity (&grad->affine);
     grad->obj_bbox = TRUE;
     grad->spread = CAIRO_EXTEND_PAD;
@@ -523,7 +566,7 @@ rsvg_new_radial_gradient (const char *element_name, RsvgNode *parent)
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_RADIAL_GRADIENT,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 grad,
                                 rsvg_radial_gradient_set_atts,
                                 rsvg_paint_server_draw,
@@ -32,8 +32,12 @@
 
 G_BEGIN_DECLS 
 
+/* This is a Rust gradient from rust/src/gradient.rs */
+typedef struct _Gradient Gradient;
+
 typedef struct _RsvgGradientStop RsvgGradientStop;
 typedef struct _RsvgGradientStops RsvgGradientStops;
+typedef struct _RsvgGradientCache RsvgGradientCache;
 typedef struct _RsvgLinearGradient RsvgLinearGradient;
 typedef struct _RsvgRadialGradient RsvgRadialGradient;
 typedef struct _RsvgSolidColor RsvgSolidColor;
@@ -48,6 +52,21 @@ struct _RsvgGradientStop {
     gboolean is_valid;
 };
 
+/* Gradients get resolved against their fallbacks the first time they are
+ * drawn, which can only happen once the document is fully loaded.  The
+ * cairo pattern only depends on the drawing context for userSpaceOnUse
+ * gradients, and then only through what their lengths are relative to,
+ * so we keep the last one around for reuse.
+ */
+struct _RsvgGradientCache {
+    Gradient *resolved;
+    cairo_pattern_t *pattern;
+    guint8 opacity;
+    double dpi_x, dpi_y;
+    double vb_width, vb_height;
+    double font_size;
+};
+
 struct _RsvgLinearGradient {
     gboolean obj_bbox;
     cairo_matrix_t affine; /* user space to actual at time of gradient def */
@@ -61,6 +80,7 @@ struct _RsvgLinearGradient {
     gboolean hastransform;
     gboolean hasspread;
     char *fallback;
+    RsvgGradientCache cache;
 };
 
 struct _RsvgRadialGradient {
@@ -77,10 +97,9 @@ struct _RsvgRadialGradient {
     gboolean hastransform;
     gboolean hasspread;
     char *fallback;
+    RsvgGradientCache cache;
 };
 
-/* This is a Rust gradient from rust/src/gradient.rs */
-typedef struct _Gradient Gradient;
 
 /* Implemented in rust/src/gradient.rs */
 G_GNUC_INTERNAL
@@ -117,17 +136,29 @@ void gradient_add_color_stop (Gradient *gradient,
 
 /* Implemented in rust/src/gradient.rs */
 G_GNUC_INTERNAL
-void gradient_resolve_fallbacks_and_set_pattern (Gradient       *gradient,
-                                                 RsvgDrawingCtx *draw_ctx,
-                                                 guint8          opacity,
-                                                 RsvgBbox        bbox);
+Gradient *gradient_resolve_fallbacks (Gradient       *gradient,
+                                      RsvgDrawingCtx *draw_ctx);
+
+/* Implemented in rust/src/gradient.rs */
+G_GNUC_INTERNAL
+gboolean gradient_is_user_space_on_use (Gradient *resolved_gradient);
+
+/* Implemented in rust/src/gradient.rs */
+G_GNUC_INTERNAL
+void gradient_set_pattern (Gradient       *resolved_gradient,
+                           RsvgDrawingCtx *draw_ctx,
+                           guint8          opacity,
+                           RsvgBbox        bbox);
+
+G_GNUC_INTERNAL
+void rsvg_gradient_cache_clear (RsvgGradientCache *cache);
 
 G_GNUC_INTERNAL
 Gradient *rsvg_gradient_node_to_rust_gradient (RsvgNode *node);
 
 /* Implemented in rust/src/pattern.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_pattern_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_pattern_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/pattern.rs */
 G_GNUC_INTERNAL
@@ -174,13 +205,15 @@ G_GNUC_INTERNAL
 void                 rsvg_paint_server_ref      (RsvgPaintServer * ps);
 G_GNUC_INTERNAL
 void                 rsvg_paint_server_unref    (RsvgPaintServer * ps);
+G_GNUC_INTERNAL
+gboolean             rsvg_paint_server_equal    (const RsvgPaintServer *a, const RsvgPaintServer *b);
 
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_linear_gradient  (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_new_linear_gradient  (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_radial_gradient  (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_new_radial_gradient  (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 G_GNUC_INTERNAL
-RsvgNode *rsvg_new_stop	        (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_new_stop	        (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 
 G_END_DECLS
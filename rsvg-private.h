@@ -31,6 +31,7 @@
 
 #include "rsvg.h"
 #include "rsvg-path-builder.h"
+#include "rsvg-arena.h"
 
 #include <libxml/SAX.h>
 #include <libxml/xmlmemory.h>
@@ -48,12 +49,13 @@ G_BEGIN_DECLS
 typedef struct RsvgSaxHandler RsvgSaxHandler;
 typedef struct RsvgDrawingCtx RsvgDrawingCtx;
 typedef struct RsvgRender RsvgRender;
-typedef GHashTable RsvgPropertyBag;
+typedef struct _RsvgPropertyBag RsvgPropertyBag;
 typedef struct _RsvgState RsvgState;
 typedef struct _RsvgDefs RsvgDefs;
 typedef struct _RsvgNode RsvgNode;
 typedef struct _RsvgFilter RsvgFilter;
 typedef struct _RsvgNodeChars RsvgNodeChars;
+typedef struct _RsvgBoundsCollector RsvgBoundsCollector;
 
 /* prepare for gettext */
 #ifndef _
@@ -134,6 +136,7 @@ struct RsvgHandlePrivate {
     GDestroyNotify user_data_destroy;
 
     GPtrArray *all_nodes;
+    struct _RsvgArena *arena;   /* states, C implementations and strings of the nodes */
 
     RsvgDefs *defs; /* lookup table for nodes that have an id="foo" attribute */
     RsvgNode *currentnode;
@@ -146,7 +149,17 @@ struct RsvgHandlePrivate {
      */
     GSList *element_name_stack;
 
-    GHashTable *css_props;
+    /* The CHARS node at the end of the current element, to which more text
+     * is appended, and those of the elements that enclose it.
+     */
+    RsvgNode *last_chars_node;
+    GSList *chars_node_stack;
+
+    GPtrArray *stylesheets;     /* RsvgStylesheet, in the order in which they apply */
+    GHashTable *imported_stylesheets; /* resolved URIs of the @imports that were added; created on demand */
+    struct _RsvgStyleAncestors *style_ancestors; /* open elements, for matching selectors */
+    GHashTable *paint_styles;   /* shared RsvgPaintStyle blocks of the nodes */
+    GHashTable *text_styles;    /* shared RsvgTextStyle blocks of the nodes */
 
     /* not a handler stack. each nested handler keeps
      * track of its parent
@@ -174,6 +187,11 @@ struct RsvgHandlePrivate {
 
     gboolean in_loop;		/* see get_dimension() */
 
+    GHashTable *bbox_cache;     /* RsvgState of a node -> RsvgNodeBboxCache, see _rsvg_handle_get_node_bbox() */
+    struct _RsvgSpatialIndex *element_bounds; /* see rsvg_handle_get_element_bounds() */
+    GHashTable *instances;      /* RsvgState of a node -> RsvgNodeInstances, see rsvg_drawing_ctx_lookup_instance() */
+    GHashTable *prefetches;     /* resolved URI -> resource being read in the background, see _rsvg_handle_prefetch(); created on demand */
+
     gboolean first_write;
     GInputStream *data_input_stream; /* for rsvg_handle_write of svgz data */
 
@@ -191,6 +209,7 @@ typedef struct {
 struct RsvgDrawingCtx {
     RsvgRender *render;
     RsvgState *state;
+    RsvgState *free_states;     /* popped states, chained by their parent, for reuse */
     GError **error;
     RsvgDefs *defs;
     PangoContext *pango_context;
@@ -200,6 +219,8 @@ struct RsvgDrawingCtx {
     GSList *drawsub_stack;
     GSList *acquired_nodes;
     gboolean is_testing;
+    RsvgBoundsCollector *bounds_collector; /* see rsvg_handle_get_element_bounds() */
+    GHashTable *instances;      /* owned by the handle; NULL if elements are not to be instanced */
 };
 
 /*Abstract base class for context for our backends (one as yet)*/
@@ -210,7 +231,8 @@ typedef enum {
   RSVG_RENDER_TYPE_BASE,
 
   RSVG_RENDER_TYPE_CAIRO = 8,
-  RSVG_RENDER_TYPE_CAIRO_CLIP
+  RSVG_RENDER_TYPE_CAIRO_CLIP,
+  RSVG_RENDER_TYPE_CAIRO_BBOX
 } RsvgRenderType;
 
 struct RsvgRender {
@@ -420,19 +442,161 @@ struct _RsvgNodeChars {
     GString *contents;
 };
 
+/* Attributes that are looked up for most elements.  Property bags
+ * tag each attribute with one of these when they are created, so that
+ * looking them up doesn't need string comparisons.
+ */
+typedef enum {
+    /* Presentation attributes, in the order rsvg_parse_style_pairs() applies them */
+    RSVG_ATTRIBUTE_BASELINE_SHIFT,
+    RSVG_ATTRIBUTE_CLIP_PATH,
+    RSVG_ATTRIBUTE_CLIP_RULE,
+    RSVG_ATTRIBUTE_COLOR,
+    RSVG_ATTRIBUTE_DIRECTION,
+    RSVG_ATTRIBUTE_DISPLAY,
+    RSVG_ATTRIBUTE_ENABLE_BACKGROUND,
+    RSVG_ATTRIBUTE_COMP_OP,
+    RSVG_ATTRIBUTE_FILL,
+    RSVG_ATTRIBUTE_FILL_OPACITY,
+    RSVG_ATTRIBUTE_FILL_RULE,
+    RSVG_ATTRIBUTE_FILTER,
+    RSVG_ATTRIBUTE_FLOOD_COLOR,
+    RSVG_ATTRIBUTE_FLOOD_OPACITY,
+    RSVG_ATTRIBUTE_FONT_FAMILY,
+    RSVG_ATTRIBUTE_FONT_SIZE,
+    RSVG_ATTRIBUTE_FONT_STRETCH,
+    RSVG_ATTRIBUTE_FONT_STYLE,
+    RSVG_ATTRIBUTE_FONT_VARIANT,
+    RSVG_ATTRIBUTE_FONT_WEIGHT,
+    RSVG_ATTRIBUTE_MARKER_END,
+    RSVG_ATTRIBUTE_MASK,
+    RSVG_ATTRIBUTE_MARKER_MID,
+    RSVG_ATTRIBUTE_MARKER_START,
+    RSVG_ATTRIBUTE_OPACITY,
+    RSVG_ATTRIBUTE_OVERFLOW,
+    RSVG_ATTRIBUTE_SHAPE_RENDERING,
+    RSVG_ATTRIBUTE_STOP_COLOR,
+    RSVG_ATTRIBUTE_STOP_OPACITY,
+    RSVG_ATTRIBUTE_STROKE,
+    RSVG_ATTRIBUTE_STROKE_DASHARRAY,
+    RSVG_ATTRIBUTE_STROKE_DASHOFFSET,
+    RSVG_ATTRIBUTE_STROKE_LINECAP,
+    RSVG_ATTRIBUTE_STROKE_LINEJOIN,
+    RSVG_ATTRIBUTE_STROKE_MITERLIMIT,
+    RSVG_ATTRIBUTE_STROKE_OPACITY,
+    RSVG_ATTRIBUTE_STROKE_WIDTH,
+    RSVG_ATTRIBUTE_TEXT_ANCHOR,
+    RSVG_ATTRIBUTE_TEXT_DECORATION,
+    RSVG_ATTRIBUTE_UNICODE_BIDI,
+    RSVG_ATTRIBUTE_LETTER_SPACING,
+    RSVG_ATTRIBUTE_VISIBILITY,
+    RSVG_ATTRIBUTE_WRITING_MODE,
+    RSVG_ATTRIBUTE_XML_LANG,
+    RSVG_ATTRIBUTE_XML_SPACE,
+
+    RSVG_ATTRIBUTE_N_PRESENTATION,
+
+    /* Properties that can only be set from style sheets */
+    RSVG_ATTRIBUTE_MARKER = RSVG_ATTRIBUTE_N_PRESENTATION,
+    RSVG_ATTRIBUTE_TEXT_RENDERING,
+
+    RSVG_ATTRIBUTE_N_PROPERTIES,
+
+    RSVG_ATTRIBUTE_CLASS = RSVG_ATTRIBUTE_N_PROPERTIES,
+    RSVG_ATTRIBUTE_ID,
+    RSVG_ATTRIBUTE_STYLE,
+    RSVG_ATTRIBUTE_TRANSFORM,
+    RSVG_ATTRIBUTE_REQUIRED_FEATURES,
+    RSVG_ATTRIBUTE_REQUIRED_EXTENSIONS,
+    RSVG_ATTRIBUTE_SYSTEM_LANGUAGE,
+    RSVG_ATTRIBUTE_XLINK_HREF,
+
+    /* Element-specific attributes that are looked up often */
+    RSVG_ATTRIBUTE_CX,
+    RSVG_ATTRIBUTE_CY,
+    RSVG_ATTRIBUTE_D,
+    RSVG_ATTRIBUTE_DX,
+    RSVG_ATTRIBUTE_DY,
+    RSVG_ATTRIBUTE_FX,
+    RSVG_ATTRIBUTE_FY,
+    RSVG_ATTRIBUTE_GRADIENT_TRANSFORM,
+    RSVG_ATTRIBUTE_GRADIENT_UNITS,
+    RSVG_ATTRIBUTE_HEIGHT,
+    RSVG_ATTRIBUTE_IN,
+    RSVG_ATTRIBUTE_MARKER_HEIGHT,
+    RSVG_ATTRIBUTE_MARKER_UNITS,
+    RSVG_ATTRIBUTE_MARKER_WIDTH,
+    RSVG_ATTRIBUTE_OFFSET,
+    RSVG_ATTRIBUTE_ORIENT,
+    RSVG_ATTRIBUTE_PATTERN_CONTENT_UNITS,
+    RSVG_ATTRIBUTE_PATTERN_TRANSFORM,
+    RSVG_ATTRIBUTE_PATTERN_UNITS,
+    RSVG_ATTRIBUTE_POINTS,
+    RSVG_ATTRIBUTE_PRESERVE_ASPECT_RATIO,
+    RSVG_ATTRIBUTE_R,
+    RSVG_ATTRIBUTE_REF_X,
+    RSVG_ATTRIBUTE_REF_Y,
+    RSVG_ATTRIBUTE_RESULT,
+    RSVG_ATTRIBUTE_RX,
+    RSVG_ATTRIBUTE_RY,
+    RSVG_ATTRIBUTE_SPREAD_METHOD,
+    RSVG_ATTRIBUTE_TYPE,
+    RSVG_ATTRIBUTE_VIEW_BOX,
+    RSVG_ATTRIBUTE_WIDTH,
+    RSVG_ATTRIBUTE_X,
+    RSVG_ATTRIBUTE_X1,
+    RSVG_ATTRIBUTE_X2,
+    RSVG_ATTRIBUTE_Y,
+    RSVG_ATTRIBUTE_Y1,
+    RSVG_ATTRIBUTE_Y2,
+
+    RSVG_ATTRIBUTE_UNKNOWN
+} RsvgAttribute;
+
+typedef struct {
+    RsvgAttribute attr;
+    const char *key;
+    const char *value;
+} RsvgPropertyBagEntry;
+
+#define RSVG_PROPERTY_BAG_N_INLINE_ENTRIES 8
+
+/* The attributes of an element, in document order.  Bags that come from
+ * rsvg_property_bag_new() or rsvg_property_bag_init() point to the
+ * strings that were passed to them; rsvg_property_bag_dup() copies them.
+ */
+struct _RsvgPropertyBag {
+    RsvgPropertyBagEntry *entries;
+    guint n_entries;
+    gboolean owns_strings;
+    RsvgPropertyBagEntry inline_entries[RSVG_PROPERTY_BAG_N_INLINE_ENTRIES];
+};
+
 typedef void (*RsvgPropertyBagEnumFunc) (const char *key, const char *value, gpointer user_data);
 
 G_GNUC_INTERNAL
 RsvgPropertyBag	    *rsvg_property_bag_new       (const char **atts);
 G_GNUC_INTERNAL
+void                 rsvg_property_bag_init      (RsvgPropertyBag * bag, const char **atts);
+G_GNUC_INTERNAL
+void                 rsvg_property_bag_clear     (RsvgPropertyBag * bag);
+G_GNUC_INTERNAL
 RsvgPropertyBag	    *rsvg_property_bag_dup       (RsvgPropertyBag * bag);
 G_GNUC_INTERNAL
 void                 rsvg_property_bag_free      (RsvgPropertyBag * bag);
 G_GNUC_INTERNAL
 const char          *rsvg_property_bag_lookup    (RsvgPropertyBag * bag, const char *key);
 G_GNUC_INTERNAL
+const char          *rsvg_property_bag_lookup_len (RsvgPropertyBag * bag, const char *key, gssize key_len);
+G_GNUC_INTERNAL
+const char          *rsvg_property_bag_lookup_attribute (RsvgPropertyBag * bag, RsvgAttribute attr);
+G_GNUC_INTERNAL
 guint                rsvg_property_bag_size	     (RsvgPropertyBag * bag);
 G_GNUC_INTERNAL
+RsvgAttribute        rsvg_attribute_from_name    (const char *name, gssize len);
+G_GNUC_INTERNAL
+const char          *rsvg_attribute_get_name     (RsvgAttribute attr);
+G_GNUC_INTERNAL
 void                 rsvg_property_bag_enumerate (RsvgPropertyBag * bag, RsvgPropertyBagEnumFunc func,
                                                   gpointer user_data);
 /* for some reason this one's public... */
@@ -462,6 +626,19 @@ void rsvg_drawing_ctx_add_node_and_ancestors_to_stack (RsvgDrawingCtx *draw_ctx,
 G_GNUC_INTERNAL
 void rsvg_drawing_ctx_draw_node_from_stack            (RsvgDrawingCtx *ctx, RsvgNode *node, int dominate);
 
+typedef struct _RsvgNodeInstances RsvgNodeInstances;
+
+G_GNUC_INTERNAL
+void rsvg_node_instances_free (RsvgNodeInstances *instances);
+G_GNUC_INTERNAL
+gboolean rsvg_drawing_ctx_can_instance    (RsvgDrawingCtx *ctx, RsvgNode *node);
+G_GNUC_INTERNAL
+gboolean rsvg_drawing_ctx_lookup_instance (RsvgDrawingCtx *ctx, RsvgNode *node, double scale,
+                                           cairo_surface_t **surface, cairo_rectangle_t *extents);
+G_GNUC_INTERNAL
+void rsvg_drawing_ctx_add_instance        (RsvgDrawingCtx *ctx, RsvgNode *node, double scale,
+                                           cairo_surface_t *surface, const cairo_rectangle_t *extents);
+
 G_GNUC_INTERNAL
 void rsvg_render_path_builder   (RsvgDrawingCtx * ctx, RsvgPathBuilder *builder);
 G_GNUC_INTERNAL
@@ -487,6 +664,9 @@ cairo_surface_t *rsvg_cairo_surface_from_pixbuf (const GdkPixbuf *pixbuf);
 G_GNUC_INTERNAL
 GdkPixbuf *rsvg_cairo_surface_to_pixbuf (cairo_surface_t *surface);
 G_GNUC_INTERNAL
+void rsvg_cairo_convert_argb32 (guint8 *dest, int dest_stride, const guint8 *src, int src_stride,
+                                int width, int height, RsvgPixelFormat format);
+G_GNUC_INTERNAL
 cairo_surface_t *rsvg_get_surface_of_node (RsvgDrawingCtx * ctx, RsvgNode * drawable, double w, double h);
 
 G_GNUC_INTERNAL
@@ -549,6 +729,18 @@ G_GNUC_INTERNAL
 void rsvg_return_if_fail_warning (const char *pretty_function,
                                   const char *expression, GError ** error);
 
+G_GNUC_INTERNAL
+char *_rsvg_handle_resolve_allowed_uri (RsvgHandle *handle,
+                                        const char *uri,
+                                        GError **error);
+G_GNUC_INTERNAL
+void _rsvg_handle_prefetch (RsvgHandle *handle, const char *url);
+G_GNUC_INTERNAL
+void _rsvg_handle_drop_prefetch (RsvgHandle *handle, const char *uri);
+G_GNUC_INTERNAL
+void _rsvg_handle_drop_prefetches (RsvgHandle *handle);
+G_GNUC_INTERNAL
+void _rsvg_handle_free_prefetches (RsvgHandle *handle);
 G_GNUC_INTERNAL
 char *_rsvg_handle_acquire_data (RsvgHandle *handle,
                                  const char *uri,
@@ -561,6 +753,13 @@ GInputStream *_rsvg_handle_acquire_stream (RsvgHandle *handle,
                                            char **content_type,
                                            GError **error);
 
+G_GNUC_INTERNAL
+gboolean _rsvg_handle_get_node_bbox (RsvgHandle *handle, RsvgNode *node, RsvgBbox *bbox);
+G_GNUC_INTERNAL
+gboolean _rsvg_handle_get_node_pixel_extents (RsvgHandle *handle,
+                                              RsvgNode *node,
+                                              cairo_rectangle_int_t *extents);
+
 
 #define rsvg_return_if_fail(expr, error)    G_STMT_START{			\
      if G_LIKELY(expr) { } else                                     \
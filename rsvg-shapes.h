@@ -36,31 +36,31 @@ G_BEGIN_DECLS
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_path_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_path_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_polygon_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_polygon_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_polyline_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_polyline_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_line_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_line_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_rect_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_rect_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_circle_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_circle_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/shapes.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_ellipse_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_ellipse_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 G_END_DECLS
 
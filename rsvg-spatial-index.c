@@ -0,0 +1,267 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-spatial-index.c: Find rectangles that intersect an area
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+/* This is a uniform grid over the extents of all the items.  Each cell
+ * keeps the indices of the items which overlap it, so a query only has
+ * to look at the items in the cells that the query area touches.  The
+ * grid gets built lazily on the first query, since its size depends on
+ * the number of items and on their overall extents.
+ */
+
+#include "config.h"
+#include "rsvg-spatial-index.h"
+
+#include <math.h>
+
+/* Don't let the grid grow without bounds for huge documents */
+#define MAX_GRID_SIZE 128
+
+typedef struct {
+    cairo_rectangle_t rect;
+    gpointer data;
+    guint stamp;
+} Item;
+
+struct _RsvgSpatialIndex {
+    GArray *items;
+    GDestroyNotify data_destroy;
+
+    gboolean built;
+    double x0, y0, x1, y1;
+    double cell_width, cell_height;
+    guint cols, rows;
+    GArray **cells;
+
+    /* Used to avoid returning items more than once when they span several cells */
+    guint stamp;
+};
+
+RsvgSpatialIndex *
+rsvg_spatial_index_new (GDestroyNotify data_destroy)
+{
+    RsvgSpatialIndex *self = g_new0 (RsvgSpatialIndex, 1);
+
+    self->items = g_array_new (FALSE, FALSE, sizeof (Item));
+    self->data_destroy = data_destroy;
+
+    return self;
+}
+
+static void
+free_cells (RsvgSpatialIndex *self)
+{
+    guint i;
+
+    if (!self->cells)
+        return;
+
+    for (i = 0; i < self->cols * self->rows; i++)
+        g_array_free (self->cells[i], TRUE);
+
+    g_free (self->cells);
+    self->cells = NULL;
+    self->built = FALSE;
+}
+
+void
+rsvg_spatial_index_free (RsvgSpatialIndex *self)
+{
+    guint i;
+
+    if (self->data_destroy) {
+        for (i = 0; i < self->items->len; i++)
+            self->data_destroy (g_array_index (self->items, Item, i).data);
+    }
+
+    g_array_free (self->items, TRUE);
+    free_cells (self);
+    g_free (self);
+}
+
+void
+rsvg_spatial_index_insert (RsvgSpatialIndex *self, const cairo_rectangle_t *rect, gpointer data)
+{
+    Item item;
+
+    item.rect = *rect;
+    item.data = data;
+    item.stamp = 0;
+
+    g_array_append_val (self->items, item);
+
+    free_cells (self);
+}
+
+void
+rsvg_spatial_index_foreach (RsvgSpatialIndex *self, RsvgSpatialIndexFunc func, gpointer user_data)
+{
+    guint i;
+
+    for (i = 0; i < self->items->len; i++) {
+        Item *item = &g_array_index (self->items, Item, i);
+
+        func (&item->rect, item->data, user_data);
+    }
+}
+
+static void
+get_cell_range (RsvgSpatialIndex *self, const cairo_rectangle_t *rect,
+                guint *col0, guint *row0, guint *col1, guint *row1)
+{
+    double c0, r0, c1, r1;
+
+    c0 = floor ((rect->x - self->x0) / self->cell_width);
+    r0 = floor ((rect->y - self->y0) / self->cell_height);
+    c1 = floor ((rect->x + rect->width - self->x0) / self->cell_width);
+    r1 = floor ((rect->y + rect->height - self->y0) / self->cell_height);
+
+    *col0 = (guint) CLAMP (c0, 0, self->cols - 1);
+    *row0 = (guint) CLAMP (r0, 0, self->rows - 1);
+    *col1 = (guint) CLAMP (c1, 0, self->cols - 1);
+    *row1 = (guint) CLAMP (r1, 0, self->rows - 1);
+}
+
+static void
+build (RsvgSpatialIndex *self)
+{
+    guint i, col, row, col0, row0, col1, row1;
+    guint size;
+
+    g_assert (self->items->len > 0);
+
+    for (i = 0; i < self->items->len; i++) {
+        cairo_rectangle_t *rect = &g_array_index (self->items, Item, i).rect;
+
+        if (i == 0 || rect->x < self->x0)
+            self->x0 = rect->x;
+        if (i == 0 || rect->y < self->y0)
+            self->y0 = rect->y;
+        if (i == 0 || rect->x + rect->width > self->x1)
+            self->x1 = rect->x + rect->width;
+        if (i == 0 || rect->y + rect->height > self->y1)
+            self->y1 = rect->y + rect->height;
+    }
+
+    /* About one item per cell, if they were evenly distributed */
+    size = (guint) ceil (sqrt (self->items->len));
+    size = CLAMP (size, 1, MAX_GRID_SIZE);
+
+    self->cols = self->rows = size;
+    self->cell_width = (self->x1 - self->x0) / size;
+    self->cell_height = (self->y1 - self->y0) / size;
+
+    if (self->cell_width <= 0.0)
+        self->cell_width = 1.0;
+    if (self->cell_height <= 0.0)
+        self->cell_height = 1.0;
+
+    self->cells = g_new (GArray *, size * size);
+    for (i = 0; i < size * size; i++)
+        self->cells[i] = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    for (i = 0; i < self->items->len; i++) {
+        get_cell_range (self, &g_array_index (self->items, Item, i).rect, &col0, &row0, &col1, &row1);
+
+        for (row = row0; row <= row1; row++)
+            for (col = col0; col <= col1; col++)
+                g_array_append_val (self->cells[row * self->cols + col], i);
+    }
+
+    self->built = TRUE;
+}
+
+static gboolean
+rectangles_intersect (const cairo_rectangle_t *a, const cairo_rectangle_t *b)
+{
+    /* Edges count as inside, so that picking a point on an item's border
+     * or with a zero-sized area hits it.
+     */
+    return (a->x <= b->x + b->width && b->x <= a->x + a->width
+            && a->y <= b->y + b->height && b->y <= a->y + a->height);
+}
+
+static gint
+compare_indices_descending (gconstpointer a, gconstpointer b)
+{
+    guint ia = *(const guint *) a;
+    guint ib = *(const guint *) b;
+
+    return (ia < ib) - (ia > ib);
+}
+
+void
+rsvg_spatial_index_query (RsvgSpatialIndex *self, const cairo_rectangle_t *area, GPtrArray *results)
+{
+    cairo_rectangle_t extents;
+    GArray *hits;
+    guint i, col, row, col0, row0, col1, row1;
+
+    if (self->items->len == 0)
+        return;
+
+    if (!self->built)
+        build (self);
+
+    extents.x = self->x0;
+    extents.y = self->y0;
+    extents.width = self->x1 - self->x0;
+    extents.height = self->y1 - self->y0;
+
+    if (!rectangles_intersect (area, &extents))
+        return;
+
+    self->stamp++;
+    if (self->stamp == 0) {
+        for (i = 0; i < self->items->len; i++)
+            g_array_index (self->items, Item, i).stamp = 0;
+        self->stamp = 1;
+    }
+
+    hits = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    get_cell_range (self, area, &col0, &row0, &col1, &row1);
+
+    for (row = row0; row <= row1; row++) {
+        for (col = col0; col <= col1; col++) {
+            GArray *cell = self->cells[row * self->cols + col];
+
+            for (i = 0; i < cell->len; i++) {
+                guint item_index = g_array_index (cell, guint, i);
+                Item *item = &g_array_index (self->items, Item, item_index);
+
+                if (item->stamp == self->stamp)
+                    continue;
+
+                item->stamp = self->stamp;
+
+                if (rectangles_intersect (area, &item->rect))
+                    g_array_append_val (hits, item_index);
+            }
+        }
+    }
+
+    g_array_sort (hits, compare_indices_descending);
+
+    for (i = 0; i < hits->len; i++)
+        g_ptr_array_add (results, g_array_index (self->items, Item, g_array_index (hits, guint, i)).data);
+
+    g_array_free (hits, TRUE);
+}
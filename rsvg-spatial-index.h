@@ -0,0 +1,56 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-spatial-index.h: Find rectangles that intersect an area
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef RSVG_SPATIAL_INDEX_H
+#define RSVG_SPATIAL_INDEX_H
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS 
+
+typedef struct _RsvgSpatialIndex RsvgSpatialIndex;
+
+typedef void (*RsvgSpatialIndexFunc) (const cairo_rectangle_t *rect, gpointer data, gpointer user_data);
+
+G_GNUC_INTERNAL
+RsvgSpatialIndex *rsvg_spatial_index_new    (GDestroyNotify data_destroy);
+G_GNUC_INTERNAL
+void              rsvg_spatial_index_free   (RsvgSpatialIndex *self);
+
+/* Items must be inserted in painting order, i.e. the last one is on top */
+G_GNUC_INTERNAL
+void              rsvg_spatial_index_insert (RsvgSpatialIndex *self, const cairo_rectangle_t *rect,
+                                             gpointer data);
+
+/* Calls @func with the items in the order they were inserted */
+G_GNUC_INTERNAL
+void              rsvg_spatial_index_foreach (RsvgSpatialIndex *self, RsvgSpatialIndexFunc func,
+                                              gpointer user_data);
+
+/* Appends the data of the items which intersect @area to @results, topmost first */
+G_GNUC_INTERNAL
+void              rsvg_spatial_index_query  (RsvgSpatialIndex *self, const cairo_rectangle_t *area,
+                                             GPtrArray *results);
+
+G_END_DECLS
+
+#endif
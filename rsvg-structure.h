@@ -36,27 +36,27 @@ G_BEGIN_DECLS
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_group_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_group_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_defs_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_defs_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_switch_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_switch_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_svg_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_svg_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_use_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_use_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
-RsvgNode *rsvg_node_symbol_new (const char *element_name, RsvgNode *parent);
+RsvgNode *rsvg_node_symbol_new (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 
 /* Implemented in rust/src/structure.rs */
 G_GNUC_INTERNAL
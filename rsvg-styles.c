@@ -37,6 +37,9 @@
 #include "rsvg-shapes.h"
 #include "rsvg-mask.h"
 #include "rsvg-marker.h"
+#include "rsvg-stylesheet.h"
+#include "rsvg-io.h"
+#include "rsvg-name-table.h"
 
 #include <libcroco/libcroco.h>
 
@@ -56,34 +59,402 @@ enum {
   TEXT_RENDERING_GEOMETRIC_PRECISION = CAIRO_ANTIALIAS_DEFAULT
 };
 
-typedef struct _StyleValueData {
-    gchar *value;
-    gboolean important;
-} StyleValueData;
+static RsvgTextStyle *
+text_style_ref (RsvgTextStyle *style)
+{
+    g_atomic_int_inc (&style->ref_count);
+    return style;
+}
+
+static void
+text_style_unref (RsvgTextStyle *style)
+{
+    if (!g_atomic_int_dec_and_test (&style->ref_count))
+        return;
+
+    if (style->unspecified)
+        text_style_unref (style->unspecified);
+
+    g_free (style->font_family);
+    g_free (style->lang);
+    g_slice_free (RsvgTextStyle, style);
+}
+
+static RsvgTextStyle *
+text_style_copy (const RsvgTextStyle *src)
+{
+    RsvgTextStyle *style;
+
+    style = g_slice_new (RsvgTextStyle);
+    *style = *src;
+    style->ref_count = 1;
+    style->unspecified = NULL;
+    style->font_family = g_strdup (src->font_family);
+    style->lang = g_strdup (src->lang);
+
+    return style;
+}
+
+/* The initial values are shared by all the states in the process */
+static RsvgTextStyle *
+text_style_get_default (void)
+{
+    static RsvgTextStyle *default_style;
+
+    if (g_once_init_enter (&default_style)) {
+        RsvgTextStyle *style;
+
+        style = g_slice_new0 (RsvgTextStyle);
+        style->ref_count = 1;
+        style->font_family = g_strdup (RSVG_DEFAULT_FONT);
+        style->font_size = rsvg_length_parse ("12.0", LENGTH_DIR_BOTH);
+        style->font_style = PANGO_STYLE_NORMAL;
+        style->font_variant = PANGO_VARIANT_NORMAL;
+        style->font_weight = PANGO_WEIGHT_NORMAL;
+        style->font_stretch = PANGO_STRETCH_NORMAL;
+        style->font_decor = TEXT_NORMAL;
+        style->text_dir = PANGO_DIRECTION_LTR;
+        style->text_gravity = PANGO_GRAVITY_SOUTH;
+        style->unicode_bidi = UNICODE_BIDI_NORMAL;
+        style->text_anchor = TEXT_ANCHOR_START;
+        style->letter_spacing = rsvg_length_parse ("0.0", LENGTH_DIR_HORIZONTAL);
+        style->baseline_shift = 0.;
+        style->text_rendering_type = TEXT_RENDERING_AUTO;
+
+        g_once_init_leave (&default_style, style);
+    }
+
+    return text_style_ref (default_style);
+}
+
+/* Returns the text style of @state so that it can be modified, after
+ * making a private copy of it if it is shared with other states.
+ */
+static RsvgTextStyle *
+state_get_text_style_for_write (RsvgState *state)
+{
+    if (g_atomic_int_get (&state->text->ref_count) > 1) {
+        RsvgTextStyle *style = text_style_copy (state->text);
+
+        text_style_unref (state->text);
+        state->text = style;
+    }
+
+    return state->text;
+}
+
+static gboolean
+length_equal (const RsvgLength *a, const RsvgLength *b)
+{
+    return a->length == b->length && a->unit == b->unit && a->dir == b->dir;
+}
 
-static StyleValueData *
-style_value_data_new (const gchar *value, gboolean important)
+#define SAME(field) (a->field == b->field)
+#define SAME_PROP(prop) (SAME (has_##prop) && SAME (prop))
+#define SAME_STRING_PROP(prop) (SAME (has_##prop) && g_strcmp0 (a->prop, b->prop) == 0)
+
+static gboolean
+text_style_equal (const RsvgTextStyle *a, const RsvgTextStyle *b)
 {
-    StyleValueData *ret;
+    if (a == b)
+        return TRUE;
+
+    return (SAME (has_font_size) && length_equal (&a->font_size, &b->font_size)
+            && SAME_STRING_PROP (font_family)
+            && SAME_STRING_PROP (lang)
+            && SAME_PROP (font_style)
+            && SAME_PROP (font_variant)
+            && SAME_PROP (font_weight)
+            && SAME_PROP (font_stretch)
+            && SAME_PROP (font_decor)
+            && SAME_PROP (text_dir)
+            && SAME_PROP (text_gravity)
+            && SAME_PROP (unicode_bidi)
+            && SAME_PROP (text_anchor)
+            && SAME (has_letter_spacing) && length_equal (&a->letter_spacing, &b->letter_spacing)
+            && SAME_PROP (baseline_shift)
+            && SAME_PROP (text_rendering_type)
+            && SAME_PROP (space_preserve));
+}
 
-    ret = g_new0 (StyleValueData, 1);
-    ret->value = g_strdup (value);
-    ret->important = important;
+#undef SAME
+#undef SAME_PROP
+#undef SAME_STRING_PROP
 
-    return ret;
+static gboolean
+text_style_equal_func (gconstpointer a, gconstpointer b)
+{
+    return text_style_equal (a, b);
+}
+
+static guint
+text_style_hash (gconstpointer p)
+{
+    const RsvgTextStyle *style = p;
+    guint h;
+
+    h = style->font_family ? g_str_hash (style->font_family) : 0;
+    h = h * 31 + (style->lang ? g_str_hash (style->lang) : 0);
+    h = h * 31 + style->font_style;
+    h = h * 31 + style->font_weight;
+    h = h * 31 + style->text_anchor;
+    h = h * 31 + (style->has_font_size << 2 | style->has_font_family << 1 | style->has_text_anchor);
+
+    return h;
+}
+
+/* A set of text styles; each of them holds a reference */
+GHashTable *
+rsvg_text_style_table_new (void)
+{
+    return g_hash_table_new_full (text_style_hash, text_style_equal_func,
+                                  (GDestroyNotify) text_style_unref, NULL);
+}
+
+/* Makes @state use the block from @text_styles which is equal to its
+ * text style, so that all the nodes with the same font and text
+ * properties share a single one.
+ */
+void
+rsvg_state_share_text_style (RsvgState *state, GHashTable *text_styles)
+{
+    RsvgTextStyle *shared;
+
+    shared = g_hash_table_lookup (text_styles, state->text);
+    if (shared == state->text)
+        return;
+
+    if (shared == NULL) {
+        g_hash_table_add (text_styles, text_style_ref (state->text));
+        return;
+    }
+
+    text_style_unref (state->text);
+    state->text = text_style_ref (shared);
+}
+
+static RsvgPaintStyle *
+paint_style_ref (RsvgPaintStyle *style)
+{
+    g_atomic_int_inc (&style->ref_count);
+    return style;
 }
 
 static void
-style_value_data_free (StyleValueData *value)
+paint_style_unref (RsvgPaintStyle *style)
+{
+    if (!g_atomic_int_dec_and_test (&style->ref_count))
+        return;
+
+    if (style->unspecified)
+        paint_style_unref (style->unspecified);
+
+    rsvg_paint_server_unref (style->fill);
+    rsvg_paint_server_unref (style->stroke);
+    g_free (style->dash.dash);
+    g_free (style->startMarker);
+    g_free (style->middleMarker);
+    g_free (style->endMarker);
+    g_slice_free (RsvgPaintStyle, style);
+}
+
+static RsvgPaintStyle *
+paint_style_copy (const RsvgPaintStyle *src)
+{
+    RsvgPaintStyle *style;
+
+    style = g_slice_new (RsvgPaintStyle);
+    *style = *src;
+    style->ref_count = 1;
+    style->unspecified = NULL;
+
+    rsvg_paint_server_ref (style->fill);
+    rsvg_paint_server_ref (style->stroke);
+
+    if (src->dash.n_dash > 0)
+        style->dash.dash = g_memdup (src->dash.dash, src->dash.n_dash * sizeof (double));
+    else
+        style->dash.dash = NULL;
+
+    style->startMarker = g_strdup (src->startMarker);
+    style->middleMarker = g_strdup (src->middleMarker);
+    style->endMarker = g_strdup (src->endMarker);
+
+    return style;
+}
+
+/* The initial values are shared by all the states in the process */
+static RsvgPaintStyle *
+paint_style_get_default (void)
+{
+    static RsvgPaintStyle *default_style;
+
+    if (g_once_init_enter (&default_style)) {
+        RsvgPaintStyle *style;
+
+        style = g_slice_new0 (RsvgPaintStyle);
+        style->ref_count = 1;
+        style->current_color = 0xff000000; /* See bgo#764808; we don't inherit CSS
+                                            * from the public API, so start off with
+                                            * opaque black instead of transparent.
+                                            */
+        style->fill = rsvg_paint_server_parse (NULL, "#000");
+        style->fill_opacity = 0xff;
+        style->stroke_opacity = 0xff;
+        style->stroke_width = rsvg_length_parse ("1", LENGTH_DIR_BOTH);
+        style->miter_limit = 4;
+        style->cap = CAIRO_LINE_CAP_BUTT;
+        style->join = CAIRO_LINE_JOIN_MITER;
+
+        /* The following two start as INHERIT, even though has_stop_color and
+         * has_stop_opacity are FALSE.  This is so that the first pass of
+         * rsvg_state_inherit_run(), called from rsvg_state_reconstruct() from
+         * the "stop" element code, will correctly initialize the destination
+         * state from the toplevel element.
+         */
+        style->stop_color.kind = RSVG_CSS_COLOR_SPEC_INHERIT;
+        style->stop_opacity.kind = RSVG_OPACITY_INHERIT;
+
+        style->fill_rule = CAIRO_FILL_RULE_WINDING;
+        style->clip_rule = CAIRO_FILL_RULE_WINDING;
+        style->flood_color = 0;
+        style->flood_opacity = 255;
+        style->shape_rendering_type = SHAPE_RENDERING_AUTO;
+
+        g_once_init_leave (&default_style, style);
+    }
+
+    return paint_style_ref (default_style);
+}
+
+/* Like state_get_text_style_for_write(), for the paint style */
+static RsvgPaintStyle *
+state_get_paint_style_for_write (RsvgState *state)
+{
+    if (g_atomic_int_get (&state->paint->ref_count) > 1) {
+        RsvgPaintStyle *style = paint_style_copy (state->paint);
+
+        paint_style_unref (state->paint);
+        state->paint = style;
+    }
+
+    return state->paint;
+}
+
+static gboolean
+dash_equal (const RsvgVpathDash *a, const RsvgVpathDash *b)
+{
+    gint i;
+
+    if (a->n_dash != b->n_dash || !length_equal (&a->offset, &b->offset))
+        return FALSE;
+
+    for (i = 0; i < a->n_dash; i++)
+        if (a->dash[i] != b->dash[i])
+            return FALSE;
+
+    return TRUE;
+}
+
+#define SAME(field) (a->field == b->field)
+#define SAME_PROP(prop) (SAME (has_##prop) && SAME (prop))
+#define SAME_STRING_PROP(prop) (SAME (has_##prop) && g_strcmp0 (a->prop, b->prop) == 0)
+
+static gboolean
+paint_style_equal (const RsvgPaintStyle *a, const RsvgPaintStyle *b)
+{
+    if (a == b)
+        return TRUE;
+
+    return (SAME_PROP (current_color)
+            && SAME_PROP (flood_color)
+            && SAME_PROP (flood_opacity)
+            && SAME (has_fill_server) && rsvg_paint_server_equal (a->fill, b->fill)
+            && SAME_PROP (fill_opacity)
+            && SAME_PROP (fill_rule)
+            && SAME_PROP (clip_rule)
+            && SAME (has_stroke_server) && rsvg_paint_server_equal (a->stroke, b->stroke)
+            && SAME_PROP (stroke_opacity)
+            && SAME (has_stroke_width) && length_equal (&a->stroke_width, &b->stroke_width)
+            && SAME_PROP (miter_limit)
+            && SAME_PROP (cap)
+            && SAME_PROP (join)
+            && SAME (has_stop_color) && SAME (stop_color.kind) && SAME (stop_color.argb)
+            && SAME (has_stop_opacity) && SAME (stop_opacity.kind) && SAME (stop_opacity.opacity)
+            && SAME_STRING_PROP (startMarker)
+            && SAME_STRING_PROP (middleMarker)
+            && SAME_STRING_PROP (endMarker)
+            && SAME_PROP (shape_rendering_type)
+            && SAME (has_dash) && SAME (has_dashoffset) && dash_equal (&a->dash, &b->dash));
+}
+
+#undef SAME
+#undef SAME_PROP
+#undef SAME_STRING_PROP
+
+static gboolean
+paint_style_equal_func (gconstpointer a, gconstpointer b)
+{
+    return paint_style_equal (a, b);
+}
+
+static guint
+paint_server_hash (const RsvgPaintServer *ps)
+{
+    if (ps == NULL)
+        return 0;
+
+    if (ps->type == RSVG_PAINT_SERVER_SOLID)
+        return ps->core.color->argb ^ ps->core.color->currentcolor;
+
+    return ps->core.iri->iri_str ? g_str_hash (ps->core.iri->iri_str) : 0;
+}
+
+static guint
+paint_style_hash (gconstpointer p)
+{
+    const RsvgPaintStyle *style = p;
+    guint h;
+
+    h = paint_server_hash (style->fill);
+    h = h * 31 + paint_server_hash (style->stroke);
+    h = h * 31 + g_double_hash (&style->stroke_width.length);
+    h = h * 31 + (style->fill_opacity << 16 | style->stroke_opacity << 8 | style->flood_opacity);
+    h = h * 31 + style->current_color;
+    h = h * 31 + (style->has_fill_server << 2 | style->has_stroke_server << 1 | style->has_stroke_width);
+
+    return h;
+}
+
+/* A set of paint styles; each of them holds a reference */
+GHashTable *
+rsvg_paint_style_table_new (void)
 {
-    if (!value)
+    return g_hash_table_new_full (paint_style_hash, paint_style_equal_func,
+                                  (GDestroyNotify) paint_style_unref, NULL);
+}
+
+/* Like rsvg_state_share_text_style(), for the paint style */
+void
+rsvg_state_share_paint_style (RsvgState *state, GHashTable *paint_styles)
+{
+    RsvgPaintStyle *shared;
+
+    shared = g_hash_table_lookup (paint_styles, state->paint);
+    if (shared == state->paint)
         return;
-    g_free (value->value);
-    g_free (value);
+
+    if (shared == NULL) {
+        g_hash_table_add (paint_styles, paint_style_ref (state->paint));
+        return;
+    }
+
+    paint_style_unref (state->paint);
+    state->paint = paint_style_ref (shared);
 }
 
 static void
-rsvg_state_init (RsvgState * state)
+rsvg_state_init_defaults (RsvgState * state)
 {
     memset (state, 0, sizeof (RsvgState));
 
@@ -92,101 +463,52 @@ rsvg_state_init (RsvgState * state)
     cairo_matrix_init_identity (&state->personal_affine);
     state->mask = NULL;
     state->opacity = 0xff;
-    state->baseline_shift = 0.;
-    state->current_color = 0xff000000; /* See bgo#764808; we don't inherit CSS
-                                        * from the public API, so start off with
-                                        * opaque black instead of transparent.
-                                        */
-    state->fill = rsvg_paint_server_parse (NULL, "#000");
-    state->fill_opacity = 0xff;
-    state->stroke_opacity = 0xff;
-    state->stroke_width = rsvg_length_parse ("1", LENGTH_DIR_BOTH);
-    state->miter_limit = 4;
-    state->cap = CAIRO_LINE_CAP_BUTT;
-    state->join = CAIRO_LINE_JOIN_MITER;
-
-    /* The following two start as INHERIT, even though has_stop_color and
-     * has_stop_opacity get initialized to FALSE below.  This is so that the
-     * first pass of rsvg_state_inherit_run(), called from
-     * rsvg_state_reconstruct() from the "stop" element code, will correctly
-     * initialize the destination state from the toplevel element.
-     *
-     */
-    state->stop_color.kind = RSVG_CSS_COLOR_SPEC_INHERIT;
-    state->stop_opacity.kind = RSVG_OPACITY_INHERIT;
 
-    state->fill_rule = CAIRO_FILL_RULE_WINDING;
-    state->clip_rule = CAIRO_FILL_RULE_WINDING;
     state->enable_background = RSVG_ENABLE_BACKGROUND_ACCUMULATE;
     state->comp_op = CAIRO_OPERATOR_OVER;
     state->overflow = FALSE;
-    state->flood_color = 0;
-    state->flood_opacity = 255;
-
-    state->font_family = g_strdup (RSVG_DEFAULT_FONT);
-    state->font_size = rsvg_length_parse ("12.0", LENGTH_DIR_BOTH);
-    state->font_style = PANGO_STYLE_NORMAL;
-    state->font_variant = PANGO_VARIANT_NORMAL;
-    state->font_weight = PANGO_WEIGHT_NORMAL;
-    state->font_stretch = PANGO_STRETCH_NORMAL;
-    state->text_dir = PANGO_DIRECTION_LTR;
-    state->text_gravity = PANGO_GRAVITY_SOUTH;
-    state->unicode_bidi = UNICODE_BIDI_NORMAL;
-    state->text_anchor = TEXT_ANCHOR_START;
-    state->letter_spacing = rsvg_length_parse ("0.0", LENGTH_DIR_HORIZONTAL);
+
+    state->paint = paint_style_get_default ();
+    state->text = text_style_get_default ();
+
     state->visible = TRUE;
     state->cond_true = TRUE;
     state->filter = NULL;
     state->clip_path = NULL;
-    state->startMarker = NULL;
-    state->middleMarker = NULL;
-    state->endMarker = NULL;
-
-    state->has_baseline_shift = FALSE;
-    state->has_current_color = FALSE;
-    state->has_flood_color = FALSE;
-    state->has_flood_opacity = FALSE;
-    state->has_fill_server = FALSE;
-    state->has_fill_opacity = FALSE;
-    state->has_fill_rule = FALSE;
-    state->has_clip_rule = FALSE;
-    state->has_stroke_server = FALSE;
-    state->has_stroke_opacity = FALSE;
-    state->has_stroke_width = FALSE;
-    state->has_miter_limit = FALSE;
-    state->has_cap = FALSE;
-    state->has_join = FALSE;
-    state->has_dash = FALSE;
-    state->has_dashoffset = FALSE;
+
     state->has_visible = FALSE;
     state->has_cond = FALSE;
-    state->has_stop_color = FALSE;
-    state->has_stop_opacity = FALSE;
-    state->has_font_size = FALSE;
-    state->has_font_family = FALSE;
-    state->has_lang = FALSE;
-    state->has_font_style = FALSE;
-    state->has_font_variant = FALSE;
-    state->has_font_weight = FALSE;
-    state->has_font_stretch = FALSE;
-    state->has_font_decor = FALSE;
-    state->has_text_dir = FALSE;
-    state->has_text_gravity = FALSE;
-    state->has_unicode_bidi = FALSE;
-    state->has_text_anchor = FALSE;
-    state->has_letter_spacing = FALSE;
-    state->has_startMarker = FALSE;
-    state->has_middleMarker = FALSE;
-    state->has_endMarker = FALSE;
     state->has_overflow = FALSE;
 
-    state->shape_rendering_type = SHAPE_RENDERING_AUTO;
-    state->has_shape_rendering_type = FALSE;
-    state->text_rendering_type = TEXT_RENDERING_AUTO;
-    state->has_text_rendering_type = FALSE;
+    state->specified = 0;
+    state->important = 0;
+}
+
+/* Every node and every level of the drawing stack starts with the
+ * initial values, so they are parsed once and copied from here.
+ */
+static const RsvgState *
+get_default_state (void)
+{
+    static RsvgState *default_state;
 
-    state->styles = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                           g_free, (GDestroyNotify) style_value_data_free);
+    if (g_once_init_enter (&default_state)) {
+        RsvgState *state = g_slice_new (RsvgState);
+
+        rsvg_state_init_defaults (state);
+        g_once_init_leave (&default_state, state);
+    }
+
+    return default_state;
+}
+
+static void
+rsvg_state_init (RsvgState * state)
+{
+    *state = *get_default_state ();
+
+    paint_style_ref (state->paint);
+    text_style_ref (state->text);
 }
 
 RsvgState *
@@ -200,6 +522,19 @@ rsvg_state_new (void)
     return state;
 }
 
+/* For the states of nodes, which live as long as the handle */
+RsvgState *
+rsvg_state_new_in_arena (RsvgArena *arena)
+{
+    RsvgState *state;
+
+    state = rsvg_arena_alloc (arena, sizeof (RsvgState));
+    rsvg_state_init (state);
+    state->in_arena = TRUE;
+
+    return state;
+}
+
 static void
 rsvg_state_finalize (RsvgState * state)
 {
@@ -212,36 +547,14 @@ rsvg_state_finalize (RsvgState * state)
     g_free (state->clip_path);
     state->clip_path = NULL;
 
-    g_free (state->font_family);
-    state->font_family = NULL;
-
-    g_free (state->lang);
-    state->lang = NULL;
-
-    g_free (state->startMarker);
-    state->startMarker = NULL;
-
-    g_free (state->middleMarker);
-    state->middleMarker = NULL;
-
-    g_free (state->endMarker);
-    state->endMarker = NULL;
-
-    rsvg_paint_server_unref (state->fill);
-    state->fill = NULL;
-
-    rsvg_paint_server_unref (state->stroke);
-    state->stroke = NULL;
-
-    if (state->dash.n_dash != 0) {
-        g_free (state->dash.dash);
-        state->dash.n_dash = 0;
-        state->dash.dash = NULL;
+    if (state->paint) {
+        paint_style_unref (state->paint);
+        state->paint = NULL;
     }
 
-    if (state->styles) {
-        g_hash_table_unref (state->styles);
-        state->styles = NULL;
+    if (state->text) {
+        text_style_unref (state->text);
+        state->text = NULL;
     }
 }
 
@@ -251,16 +564,20 @@ rsvg_state_free (RsvgState *state)
     g_assert (state != NULL);
 
     rsvg_state_finalize (state);
-    g_slice_free (RsvgState, state);
+
+    if (!state->in_arena)
+        g_slice_free (RsvgState, state);
 }
 
 void
 rsvg_state_reinit (RsvgState * state)
 {
     RsvgState *parent = state->parent;
+    gboolean in_arena = state->in_arena;
     rsvg_state_finalize (state);
     rsvg_state_init (state);
     state->parent = parent;
+    state->in_arena = in_arena;
 }
 
 typedef int (*InheritanceFunction) (int dst, int src);
@@ -268,31 +585,19 @@ typedef int (*InheritanceFunction) (int dst, int src);
 void
 rsvg_state_clone (RsvgState * dst, const RsvgState * src)
 {
-    gint i;
     RsvgState *parent = dst->parent;
+    gboolean in_arena = dst->in_arena;
 
     rsvg_state_finalize (dst);
 
     *dst = *src;
     dst->parent = parent;
+    dst->in_arena = in_arena;
     dst->filter = g_strdup (src->filter);
     dst->mask = g_strdup (src->mask);
     dst->clip_path = g_strdup (src->clip_path);
-    dst->font_family = g_strdup (src->font_family);
-    dst->lang = g_strdup (src->lang);
-    dst->startMarker = g_strdup (src->startMarker);
-    dst->middleMarker = g_strdup (src->middleMarker);
-    dst->endMarker = g_strdup (src->endMarker);
-    rsvg_paint_server_ref (dst->fill);
-    rsvg_paint_server_ref (dst->stroke);
-
-    dst->styles = g_hash_table_ref (src->styles);
-
-    if (src->dash.n_dash > 0) {
-        dst->dash.dash = g_new0 (gdouble, src->dash.n_dash);
-        for (i = 0; i < src->dash.n_dash; i++)
-            dst->dash.dash[i] = src->dash.dash[i];
-    }
+    dst->paint = paint_style_ref (src->paint);
+    dst->text = text_style_ref (src->text);
 }
 
 /*
@@ -302,131 +607,234 @@ rsvg_state_clone (RsvgState * dst, const RsvgState * src)
   not be inherited are copied streight over, or ignored.
 */
 
+static gboolean
+text_style_has_specified (const RsvgTextStyle *style)
+{
+    return (style->has_font_size || style->has_font_family || style->has_lang
+            || style->has_font_style || style->has_font_variant || style->has_font_weight
+            || style->has_font_stretch || style->has_font_decor || style->has_text_dir
+            || style->has_text_gravity || style->has_unicode_bidi || style->has_text_anchor
+            || style->has_letter_spacing || style->has_baseline_shift
+            || style->has_text_rendering_type || style->has_space_preserve);
+}
+
+/* Each level of the drawing stack inherits the values of the one below
+ * without having specified them; that block is remembered in @src so
+ * that drawing its descendants doesn't make a copy for each of them.
+ */
+static RsvgTextStyle *
+text_style_get_unspecified (RsvgTextStyle *src, const RsvgTextStyle *inherited)
+{
+    RsvgTextStyle *style;
+
+    style = g_atomic_pointer_get (&src->unspecified);
+    if (style && text_style_equal (style, inherited))
+        return text_style_ref (style);
+
+    style = text_style_copy (inherited);
+
+    if (!g_atomic_pointer_compare_and_exchange (&src->unspecified, NULL, style))
+        return style;
+
+    return text_style_ref (style);
+}
+
+/* The text style part of rsvg_state_inherit_run().  The result is
+ * worked out without touching the block of @dst, which may be shared,
+ * and a new block is only made if it differs from both @dst and @src.
+ */
 static void
-rsvg_state_inherit_run (RsvgState * dst, const RsvgState * src,
-                        const InheritanceFunction function, const gboolean inherituninheritables)
+text_style_inherit_run (RsvgState * dst, const RsvgState * src,
+                        const InheritanceFunction function)
 {
-    gint i;
+    const RsvgTextStyle *s = src->text;
+    RsvgTextStyle *old;
+    RsvgTextStyle t;
 
-    if (function (dst->has_baseline_shift, src->has_baseline_shift))
-        dst->baseline_shift = src->baseline_shift;
-    if (function (dst->has_current_color, src->has_current_color))
-        dst->current_color = src->current_color;
-    if (function (dst->has_flood_color, src->has_flood_color))
-        dst->flood_color = src->flood_color;
-    if (function (dst->has_flood_opacity, src->has_flood_opacity))
-        dst->flood_opacity = src->flood_opacity;
-    if (function (dst->has_fill_server, src->has_fill_server)) {
-        rsvg_paint_server_ref (src->fill);
-        if (dst->fill)
-            rsvg_paint_server_unref (dst->fill);
-        dst->fill = src->fill;
-    }
-    if (function (dst->has_fill_opacity, src->has_fill_opacity))
-        dst->fill_opacity = src->fill_opacity;
-    if (function (dst->has_fill_rule, src->has_fill_rule))
-        dst->fill_rule = src->fill_rule;
-    if (function (dst->has_clip_rule, src->has_clip_rule))
-        dst->clip_rule = src->clip_rule;
-    if (function (dst->overflow, src->overflow))
-        dst->overflow = src->overflow;
-    if (function (dst->has_stroke_server, src->has_stroke_server)) {
-        rsvg_paint_server_ref (src->stroke);
-        if (dst->stroke)
-            rsvg_paint_server_unref (dst->stroke);
-        dst->stroke = src->stroke;
-    }
-    if (function (dst->has_stroke_opacity, src->has_stroke_opacity))
-        dst->stroke_opacity = src->stroke_opacity;
-    if (function (dst->has_stroke_width, src->has_stroke_width))
-        dst->stroke_width = src->stroke_width;
-    if (function (dst->has_miter_limit, src->has_miter_limit))
-        dst->miter_limit = src->miter_limit;
-    if (function (dst->has_cap, src->has_cap))
-        dst->cap = src->cap;
-    if (function (dst->has_join, src->has_join))
-        dst->join = src->join;
-    if (function (dst->has_stop_color, src->has_stop_color)) {
-        if (dst->stop_color.kind == RSVG_CSS_COLOR_SPEC_INHERIT) {
-            dst->stop_color = src->stop_color;
+    if (dst->text == s)
+        return;
+
+    t = *dst->text;
+
+    if (function (t.has_font_size, s->has_font_size))
+        t.font_size = s->font_size;
+    if (function (t.has_font_family, s->has_font_family))
+        t.font_family = s->font_family;
+    if (function (t.has_lang, s->has_lang))
+        t.lang = s->lang;
+    if (function (t.has_font_style, s->has_font_style))
+        t.font_style = s->font_style;
+    if (function (t.has_font_variant, s->has_font_variant))
+        t.font_variant = s->font_variant;
+    if (function (t.has_font_weight, s->has_font_weight))
+        t.font_weight = s->font_weight;
+    if (function (t.has_font_stretch, s->has_font_stretch))
+        t.font_stretch = s->font_stretch;
+    if (function (t.has_font_decor, s->has_font_decor))
+        t.font_decor = s->font_decor;
+    if (function (t.has_text_dir, s->has_text_dir))
+        t.text_dir = s->text_dir;
+    if (function (t.has_text_gravity, s->has_text_gravity))
+        t.text_gravity = s->text_gravity;
+    if (function (t.has_unicode_bidi, s->has_unicode_bidi))
+        t.unicode_bidi = s->unicode_bidi;
+    if (function (t.has_text_anchor, s->has_text_anchor))
+        t.text_anchor = s->text_anchor;
+    if (function (t.has_letter_spacing, s->has_letter_spacing))
+        t.letter_spacing = s->letter_spacing;
+    if (function (t.has_baseline_shift, s->has_baseline_shift))
+        t.baseline_shift = s->baseline_shift;
+    if (function (t.has_text_rendering_type, s->has_text_rendering_type))
+        t.text_rendering_type = s->text_rendering_type;
+    if (function (t.has_space_preserve, s->has_space_preserve))
+        t.space_preserve = s->space_preserve;
+
+    if (text_style_equal (&t, dst->text))
+        return;
+
+    /* @t may still point to the strings of the old block */
+    old = dst->text;
+
+    if (text_style_equal (&t, s))
+        dst->text = text_style_ref ((RsvgTextStyle *) s);
+    else if (!text_style_has_specified (&t))
+        dst->text = text_style_get_unspecified ((RsvgTextStyle *) s, &t);
+    else
+        dst->text = text_style_copy (&t);
+
+    text_style_unref (old);
+}
+
+static gboolean
+paint_style_has_specified (const RsvgPaintStyle *style)
+{
+    return (style->has_fill_server || style->has_fill_opacity || style->has_fill_rule
+            || style->has_clip_rule || style->has_stroke_server || style->has_stroke_opacity
+            || style->has_stroke_width || style->has_miter_limit || style->has_cap
+            || style->has_join || style->has_stop_color || style->has_stop_opacity
+            || style->has_dash || style->has_dashoffset || style->has_current_color
+            || style->has_flood_color || style->has_flood_opacity || style->has_startMarker
+            || style->has_middleMarker || style->has_endMarker
+            || style->has_shape_rendering_type);
+}
+
+/* Like text_style_get_unspecified(), for the paint style */
+static RsvgPaintStyle *
+paint_style_get_unspecified (RsvgPaintStyle *src, const RsvgPaintStyle *inherited)
+{
+    RsvgPaintStyle *style;
+
+    style = g_atomic_pointer_get (&src->unspecified);
+    if (style && paint_style_equal (style, inherited))
+        return paint_style_ref (style);
+
+    style = paint_style_copy (inherited);
+
+    if (!g_atomic_pointer_compare_and_exchange (&src->unspecified, NULL, style))
+        return style;
+
+    return paint_style_ref (style);
+}
+
+/* The paint style part of rsvg_state_inherit_run(); this works like
+ * text_style_inherit_run().
+ */
+static void
+paint_style_inherit_run (RsvgState * dst, const RsvgState * src,
+                         const InheritanceFunction function)
+{
+    const RsvgPaintStyle *s = src->paint;
+    RsvgPaintStyle *old;
+    RsvgPaintStyle t;
+
+    if (dst->paint == s)
+        return;
+
+    t = *dst->paint;
+
+    if (function (t.has_current_color, s->has_current_color))
+        t.current_color = s->current_color;
+    if (function (t.has_flood_color, s->has_flood_color))
+        t.flood_color = s->flood_color;
+    if (function (t.has_flood_opacity, s->has_flood_opacity))
+        t.flood_opacity = s->flood_opacity;
+    if (function (t.has_fill_server, s->has_fill_server))
+        t.fill = s->fill;
+    if (function (t.has_fill_opacity, s->has_fill_opacity))
+        t.fill_opacity = s->fill_opacity;
+    if (function (t.has_fill_rule, s->has_fill_rule))
+        t.fill_rule = s->fill_rule;
+    if (function (t.has_clip_rule, s->has_clip_rule))
+        t.clip_rule = s->clip_rule;
+    if (function (t.has_stroke_server, s->has_stroke_server))
+        t.stroke = s->stroke;
+    if (function (t.has_stroke_opacity, s->has_stroke_opacity))
+        t.stroke_opacity = s->stroke_opacity;
+    if (function (t.has_stroke_width, s->has_stroke_width))
+        t.stroke_width = s->stroke_width;
+    if (function (t.has_miter_limit, s->has_miter_limit))
+        t.miter_limit = s->miter_limit;
+    if (function (t.has_cap, s->has_cap))
+        t.cap = s->cap;
+    if (function (t.has_join, s->has_join))
+        t.join = s->join;
+    if (function (t.has_stop_color, s->has_stop_color)) {
+        if (t.stop_color.kind == RSVG_CSS_COLOR_SPEC_INHERIT) {
+            t.stop_color = s->stop_color;
         }
     }
-    if (function (dst->has_stop_opacity, src->has_stop_opacity)) {
-        if (dst->stop_opacity.kind == RSVG_OPACITY_INHERIT) {
-            dst->stop_opacity = src->stop_opacity;
+    if (function (t.has_stop_opacity, s->has_stop_opacity)) {
+        if (t.stop_opacity.kind == RSVG_OPACITY_INHERIT) {
+            t.stop_opacity = s->stop_opacity;
         }
     }
-    if (function (dst->has_cond, src->has_cond))
-        dst->cond_true = src->cond_true;
-    if (function (dst->has_font_size, src->has_font_size))
-        dst->font_size = src->font_size;
-    if (function (dst->has_font_style, src->has_font_style))
-        dst->font_style = src->font_style;
-    if (function (dst->has_font_variant, src->has_font_variant))
-        dst->font_variant = src->font_variant;
-    if (function (dst->has_font_weight, src->has_font_weight))
-        dst->font_weight = src->font_weight;
-    if (function (dst->has_font_stretch, src->has_font_stretch))
-        dst->font_stretch = src->font_stretch;
-    if (function (dst->has_font_decor, src->has_font_decor))
-        dst->font_decor = src->font_decor;
-    if (function (dst->has_text_dir, src->has_text_dir))
-        dst->text_dir = src->text_dir;
-    if (function (dst->has_text_gravity, src->has_text_gravity))
-        dst->text_gravity = src->text_gravity;
-    if (function (dst->has_unicode_bidi, src->has_unicode_bidi))
-        dst->unicode_bidi = src->unicode_bidi;
-    if (function (dst->has_text_anchor, src->has_text_anchor))
-        dst->text_anchor = src->text_anchor;
-    if (function (dst->has_letter_spacing, src->has_letter_spacing))
-        dst->letter_spacing = src->letter_spacing;
-    if (function (dst->has_startMarker, src->has_startMarker)) {
-        g_free (dst->startMarker);
-        dst->startMarker = g_strdup (src->startMarker);
-    }
-    if (function (dst->has_middleMarker, src->has_middleMarker)) {
-        g_free (dst->middleMarker);
-        dst->middleMarker = g_strdup (src->middleMarker);
-    }
-    if (function (dst->has_endMarker, src->has_endMarker)) {
-        g_free (dst->endMarker);
-        dst->endMarker = g_strdup (src->endMarker);
-    }
-    if (function (dst->has_shape_rendering_type, src->has_shape_rendering_type))
-            dst->shape_rendering_type = src->shape_rendering_type;
-    if (function (dst->has_text_rendering_type, src->has_text_rendering_type))
-            dst->text_rendering_type = src->text_rendering_type;
-
-    if (function (dst->has_font_family, src->has_font_family)) {
-        g_free (dst->font_family);      /* font_family is always set to something */
-        dst->font_family = g_strdup (src->font_family);
-    }
-
-    if (function (dst->has_space_preserve, src->has_space_preserve))
-        dst->space_preserve = src->space_preserve;
-
-    if (function (dst->has_visible, src->has_visible))
-        dst->visible = src->visible;
+    if (function (t.has_startMarker, s->has_startMarker))
+        t.startMarker = s->startMarker;
+    if (function (t.has_middleMarker, s->has_middleMarker))
+        t.middleMarker = s->middleMarker;
+    if (function (t.has_endMarker, s->has_endMarker))
+        t.endMarker = s->endMarker;
+    if (function (t.has_shape_rendering_type, s->has_shape_rendering_type))
+        t.shape_rendering_type = s->shape_rendering_type;
+
+    if (s->dash.n_dash > 0 && (function (t.has_dash, s->has_dash))) {
+        t.dash.dash = s->dash.dash;
+        t.dash.n_dash = s->dash.n_dash;
+    }
 
-    if (function (dst->has_lang, src->has_lang)) {
-        if (dst->has_lang)
-            g_free (dst->lang);
-        dst->lang = g_strdup (src->lang);
+    if (function (t.has_dashoffset, s->has_dashoffset)) {
+        t.dash.offset = s->dash.offset;
     }
 
-    if (src->dash.n_dash > 0 && (function (dst->has_dash, src->has_dash))) {
-        if (dst->has_dash)
-            g_free (dst->dash.dash);
+    if (paint_style_equal (&t, dst->paint))
+        return;
 
-        dst->dash.dash = g_new0 (gdouble, src->dash.n_dash);
-        dst->dash.n_dash = src->dash.n_dash;
-        for (i = 0; i < src->dash.n_dash; i++)
-            dst->dash.dash[i] = src->dash.dash[i];
-    }
+    /* @t may still point to the paint servers and strings of the old block */
+    old = dst->paint;
 
-    if (function (dst->has_dashoffset, src->has_dashoffset)) {
-        dst->dash.offset = src->dash.offset;
-    }
+    if (paint_style_equal (&t, s))
+        dst->paint = paint_style_ref ((RsvgPaintStyle *) s);
+    else if (!paint_style_has_specified (&t))
+        dst->paint = paint_style_get_unspecified ((RsvgPaintStyle *) s, &t);
+    else
+        dst->paint = paint_style_copy (&t);
+
+    paint_style_unref (old);
+}
+
+static void
+rsvg_state_inherit_run (RsvgState * dst, const RsvgState * src,
+                        const InheritanceFunction function, const gboolean inherituninheritables)
+{
+    if (function (dst->overflow, src->overflow))
+        dst->overflow = src->overflow;
+    if (function (dst->has_cond, src->has_cond))
+        dst->cond_true = src->cond_true;
+    if (function (dst->has_visible, src->has_visible))
+        dst->visible = src->visible;
+
+    paint_style_inherit_run (dst, src, function);
+    text_style_inherit_run (dst, src, function);
 
     if (inherituninheritables) {
         g_free (dst->clip_path);
@@ -517,50 +925,79 @@ rsvg_state_inherit (RsvgState * dst, const RsvgState * src)
     rsvg_state_inherit_run (dst, src, inheritfunction, 1);
 }
 
+#define SAME(field) (a->field == b->field)
+#define SAME_PROP(prop) (SAME (has_##prop) && SAME (prop))
+
+/*
+  Whether a child would end up with the same style when inheriting from
+  either state.  This compares everything that rsvg_state_inherit_run()
+  copies between states, and also whether it was specified, since that
+  matters for domination in <use>.  The transform and the properties
+  which are not inherited are not compared.
+*/
+gboolean
+rsvg_state_inherits_equal (const RsvgState * a, const RsvgState * b)
+{
+    return (paint_style_equal (a->paint, b->paint)
+            && text_style_equal (a->text, b->text)
+            && SAME_PROP (overflow)
+            && SAME (has_cond) && SAME (cond_true)
+            && SAME_PROP (visible));
+}
+
+#undef SAME
+#undef SAME_PROP
+
 /* Parse a CSS2 style argument, setting the SVG context attributes. */
 static void
 rsvg_parse_style_pair (RsvgState * state,
-                       const gchar * name,
+                       RsvgAttribute attr,
                        const gchar * value,
                        gboolean important)
 {
-    StyleValueData *data;
+    guint64 bit;
 
-    data = g_hash_table_lookup (state->styles, name);
-    if (data && data->important && !important)
+    if (attr >= RSVG_ATTRIBUTE_N_PROPERTIES || value == NULL)
         return;
 
-    if (name == NULL || value == NULL)
+    bit = G_GUINT64_CONSTANT (1) << attr;
+
+    if ((state->important & bit) && !important)
         return;
 
-    g_hash_table_insert (state->styles,
-                         (gpointer) g_strdup (name),
-                         (gpointer) style_value_data_new (value, important));
+    state->specified |= bit;
+    if (important)
+        state->important |= bit;
 
-    if (g_str_equal (name, "color")) {
+    switch (attr) {
+    case RSVG_ATTRIBUTE_COLOR: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
         RsvgCssColorSpec spec;
 
         spec = rsvg_css_parse_color (value, ALLOW_INHERIT_YES, ALLOW_CURRENT_COLOR_NO);
         switch (spec.kind) {
         case RSVG_CSS_COLOR_SPEC_INHERIT:
             /* FIXME: we should inherit; see how stop-color is handled in rsvg-styles.c */
-            state->has_current_color = FALSE;
+            paint->has_current_color = FALSE;
             break;
 
         case RSVG_CSS_COLOR_SPEC_ARGB:
-            state->current_color = spec.argb;
-            state->has_current_color = TRUE;
+            paint->current_color = spec.argb;
+            paint->has_current_color = TRUE;
             break;
 
         case RSVG_CSS_COLOR_PARSE_ERROR:
             /* FIXME: no error handling */
-            state->has_current_color = FALSE;
+            paint->has_current_color = FALSE;
             break;
 
         default:
             g_assert_not_reached ();
         }
-    } else if (g_str_equal (name, "opacity")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_OPACITY: {
         RsvgOpacitySpec spec;
 
         spec = rsvg_css_parse_opacity (value);
@@ -570,81 +1007,115 @@ rsvg_parse_style_pair (RsvgState * state,
             state->opacity = 0;
             /* FIXME: handle INHERIT and PARSE_ERROR */
         }
-    } else if (g_str_equal (name, "flood-color")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FLOOD_COLOR: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
         RsvgCssColorSpec spec;
 
         spec = rsvg_css_parse_color (value, ALLOW_INHERIT_YES, ALLOW_CURRENT_COLOR_YES);
         switch (spec.kind) {
         case RSVG_CSS_COLOR_SPEC_INHERIT:
             /* FIXME: we should inherit; see how stop-color is handled in rsvg-styles.c */
-            state->has_current_color = FALSE;
+            paint->has_current_color = FALSE;
             break;
 
         case RSVG_CSS_COLOR_SPEC_CURRENT_COLOR:
             /* FIXME: in the caller, fix up the current color */
-            state->has_flood_color = FALSE;
+            paint->has_flood_color = FALSE;
             break;
 
         case RSVG_CSS_COLOR_SPEC_ARGB:
-            state->flood_color = spec.argb;
-            state->has_flood_color = TRUE;
+            paint->flood_color = spec.argb;
+            paint->has_flood_color = TRUE;
             break;
 
         case RSVG_CSS_COLOR_PARSE_ERROR:
             /* FIXME: no error handling */
-            state->has_current_color = FALSE;
+            paint->has_current_color = FALSE;
             break;
 
         default:
             g_assert_not_reached ();
         }
-    } else if (g_str_equal (name, "flood-opacity")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FLOOD_OPACITY: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
         RsvgOpacitySpec spec;
 
         spec = rsvg_css_parse_opacity (value);
         if (spec.kind == RSVG_OPACITY_SPECIFIED) {
-            state->flood_opacity = spec.opacity;
+            paint->flood_opacity = spec.opacity;
         } else {
-            state->flood_opacity = 0;
+            paint->flood_opacity = 0;
             /* FIXME: handle INHERIT and PARSE_ERROR */
         }
 
-        state->has_flood_opacity = TRUE;
-    } else if (g_str_equal (name, "filter")) {
+        paint->has_flood_opacity = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FILTER: {
         g_free (state->filter);
         state->filter = rsvg_get_url_string (value, NULL);
-    } else if (g_str_equal (name, "mask")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_MASK: {
         g_free (state->mask);
         state->mask = rsvg_get_url_string (value, NULL);
-    } else if (g_str_equal (name, "baseline-shift")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_BASELINE_SHIFT: {
         /* These values come from Inkscape's SP_CSS_BASELINE_SHIFT_(SUB/SUPER/BASELINE);
          * see sp_style_merge_baseline_shift_from_parent()
          */
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
         if (g_str_equal (value, "sub")) {
-           state->has_baseline_shift = TRUE;
-           state->baseline_shift = -0.2;
+           text->has_baseline_shift = TRUE;
+           text->baseline_shift = -0.2;
         } else if (g_str_equal (value, "super")) {
-           state->has_baseline_shift = TRUE;
-           state->baseline_shift = 0.4;
+           text->has_baseline_shift = TRUE;
+           text->baseline_shift = 0.4;
         } else if (g_str_equal (value, "baseline")) {
-           state->has_baseline_shift = TRUE;
-           state->baseline_shift = 0.;
+           text->has_baseline_shift = TRUE;
+           text->baseline_shift = 0.;
         } else {
           g_warning ("value \'%s\' for attribute \'baseline-shift\' is not supported; only 'sub', 'super', and 'baseline' are supported\n", value);
         }
-    } else if (g_str_equal (name, "clip-path")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_CLIP_PATH: {
         g_free (state->clip_path);
         state->clip_path = rsvg_get_url_string (value, NULL);
-    } else if (g_str_equal (name, "overflow")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_OVERFLOW: {
         if (!g_str_equal (value, "inherit")) {
-            state->overflow = rsvg_css_parse_overflow (value, &state->has_overflow);
+            gboolean has_overflow;
+
+            state->overflow = rsvg_css_parse_overflow (value, &has_overflow);
+            state->has_overflow = has_overflow;
         }
-    } else if (g_str_equal (name, "enable-background")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_ENABLE_BACKGROUND: {
         if (g_str_equal (value, "new"))
             state->enable_background = RSVG_ENABLE_BACKGROUND_NEW;
         else
             state->enable_background = RSVG_ENABLE_BACKGROUND_ACCUMULATE;
-    } else if (g_str_equal (name, "comp-op")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_COMP_OP: {
         if (g_str_equal (value, "clear"))
             state->comp_op = CAIRO_OPERATOR_CLEAR;
         else if (g_str_equal (value, "src"))
@@ -695,7 +1166,10 @@ rsvg_parse_style_pair (RsvgState * state,
             state->comp_op = CAIRO_OPERATOR_EXCLUSION;
         else
             state->comp_op = CAIRO_OPERATOR_OVER;
-    } else if (g_str_equal (name, "display")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_DISPLAY: {
         state->has_visible = TRUE;
         if (g_str_equal (value, "none"))
             state->visible = FALSE;
@@ -703,15 +1177,23 @@ rsvg_parse_style_pair (RsvgState * state,
             state->visible = TRUE;
         else
             state->has_visible = FALSE;
-	} else if (g_str_equal (name, "xml:space")) {
-        state->has_space_preserve = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_XML_SPACE: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->has_space_preserve = TRUE;
         if (g_str_equal (value, "default"))
-            state->space_preserve = FALSE;
+            text->space_preserve = FALSE;
         else if (!g_str_equal (value, "preserve") == 0)
-            state->space_preserve = TRUE;
+            text->space_preserve = TRUE;
         else
-            state->space_preserve = FALSE;
-    } else if (g_str_equal (name, "visibility")) {
+            text->space_preserve = FALSE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_VISIBILITY: {
         state->has_visible = TRUE;
         if (g_str_equal (value, "visible"))
             state->visible = TRUE;
@@ -719,246 +1201,419 @@ rsvg_parse_style_pair (RsvgState * state,
             state->visible = FALSE;     /* collapse or hidden */
         else
             state->has_visible = FALSE;
-    } else if (g_str_equal (name, "fill")) {
-        RsvgPaintServer *fill = state->fill;
-        state->fill =
-            rsvg_paint_server_parse (&state->has_fill_server, value);
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FILL: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+        RsvgPaintServer *fill = paint->fill;
+        gboolean has_fill_server;
+
+        paint->fill =
+            rsvg_paint_server_parse (&has_fill_server, value);
+        paint->has_fill_server = has_fill_server;
         rsvg_paint_server_unref (fill);
-    } else if (g_str_equal (name, "fill-opacity")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FILL_OPACITY: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
         RsvgOpacitySpec spec;
 
         spec = rsvg_css_parse_opacity (value);
         if (spec.kind == RSVG_OPACITY_SPECIFIED) {
-            state->fill_opacity = spec.opacity;
+            paint->fill_opacity = spec.opacity;
         } else {
-            state->fill_opacity = 0;
+            paint->fill_opacity = 0;
             /* FIXME: handle INHERIT and PARSE_ERROR */
         }
 
-        state->has_fill_opacity = TRUE;
-    } else if (g_str_equal (name, "fill-rule")) {
-        state->has_fill_rule = TRUE;
+        paint->has_fill_opacity = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FILL_RULE: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_fill_rule = TRUE;
         if (g_str_equal (value, "nonzero"))
-            state->fill_rule = CAIRO_FILL_RULE_WINDING;
+            paint->fill_rule = CAIRO_FILL_RULE_WINDING;
         else if (g_str_equal (value, "evenodd"))
-            state->fill_rule = CAIRO_FILL_RULE_EVEN_ODD;
+            paint->fill_rule = CAIRO_FILL_RULE_EVEN_ODD;
         else
-            state->has_fill_rule = FALSE;
-    } else if (g_str_equal (name, "clip-rule")) {
-        state->has_clip_rule = TRUE;
+            paint->has_fill_rule = FALSE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_CLIP_RULE: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_clip_rule = TRUE;
         if (g_str_equal (value, "nonzero"))
-            state->clip_rule = CAIRO_FILL_RULE_WINDING;
+            paint->clip_rule = CAIRO_FILL_RULE_WINDING;
         else if (g_str_equal (value, "evenodd"))
-            state->clip_rule = CAIRO_FILL_RULE_EVEN_ODD;
+            paint->clip_rule = CAIRO_FILL_RULE_EVEN_ODD;
         else
-            state->has_clip_rule = FALSE;
-    } else if (g_str_equal (name, "stroke")) {
-        RsvgPaintServer *stroke = state->stroke;
+            paint->has_clip_rule = FALSE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+        RsvgPaintServer *stroke = paint->stroke;
+        gboolean has_stroke_server;
 
-        state->stroke =
-            rsvg_paint_server_parse (&state->has_stroke_server, value);
+        paint->stroke =
+            rsvg_paint_server_parse (&has_stroke_server, value);
+        paint->has_stroke_server = has_stroke_server;
 
         rsvg_paint_server_unref (stroke);
-    } else if (g_str_equal (name, "stroke-width")) {
-        state->stroke_width = rsvg_length_parse (value, LENGTH_DIR_BOTH);
-        state->has_stroke_width = TRUE;
-    } else if (g_str_equal (name, "stroke-linecap")) {
-        state->has_cap = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_WIDTH: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->stroke_width = rsvg_length_parse (value, LENGTH_DIR_BOTH);
+        paint->has_stroke_width = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_LINECAP: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_cap = TRUE;
         if (g_str_equal (value, "butt"))
-            state->cap = CAIRO_LINE_CAP_BUTT;
+            paint->cap = CAIRO_LINE_CAP_BUTT;
         else if (g_str_equal (value, "round"))
-            state->cap = CAIRO_LINE_CAP_ROUND;
+            paint->cap = CAIRO_LINE_CAP_ROUND;
         else if (g_str_equal (value, "square"))
-            state->cap = CAIRO_LINE_CAP_SQUARE;
+            paint->cap = CAIRO_LINE_CAP_SQUARE;
         else
             g_warning (_("unknown line cap style %s\n"), value);
-    } else if (g_str_equal (name, "stroke-opacity")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_OPACITY: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
         RsvgOpacitySpec spec;
 
         spec = rsvg_css_parse_opacity (value);
         if (spec.kind == RSVG_OPACITY_SPECIFIED) {
-            state->stroke_opacity = spec.opacity;
+            paint->stroke_opacity = spec.opacity;
         } else {
-            state->stroke_opacity = 0;
+            paint->stroke_opacity = 0;
             /* FIXME: handle INHERIT and PARSE_ERROR */
         }
 
-        state->has_stroke_opacity = TRUE;
-    } else if (g_str_equal (name, "stroke-linejoin")) {
-        state->has_join = TRUE;
+        paint->has_stroke_opacity = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_LINEJOIN: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_join = TRUE;
         if (g_str_equal (value, "miter"))
-            state->join = CAIRO_LINE_JOIN_MITER;
+            paint->join = CAIRO_LINE_JOIN_MITER;
         else if (g_str_equal (value, "round"))
-            state->join = CAIRO_LINE_JOIN_ROUND;
+            paint->join = CAIRO_LINE_JOIN_ROUND;
         else if (g_str_equal (value, "bevel"))
-            state->join = CAIRO_LINE_JOIN_BEVEL;
+            paint->join = CAIRO_LINE_JOIN_BEVEL;
         else
             g_warning (_("unknown line join style %s\n"), value);
-    } else if (g_str_equal (name, "font-size")) {
-        state->font_size = rsvg_length_parse (value, LENGTH_DIR_BOTH);
-        state->has_font_size = TRUE;
-    } else if (g_str_equal (name, "font-family")) {
-        char *save = g_strdup (rsvg_css_parse_font_family (value, &state->has_font_family));
-        g_free (state->font_family);
-        state->font_family = save;
-    } else if (g_str_equal (name, "xml:lang")) {
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_SIZE: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->font_size = rsvg_length_parse (value, LENGTH_DIR_BOTH);
+        text->has_font_size = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_FAMILY: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+        gboolean has_font_family;
+        char *save = g_strdup (rsvg_css_parse_font_family (value, &has_font_family));
+        g_free (text->font_family);
+        text->font_family = save;
+        text->has_font_family = has_font_family;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_XML_LANG: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
         char *save = g_strdup (value);
-        g_free (state->lang);
-        state->lang = save;
-        state->has_lang = TRUE;
-    } else if (g_str_equal (name, "font-style")) {
-        state->font_style = rsvg_css_parse_font_style (value, &state->has_font_style);
-    } else if (g_str_equal (name, "font-variant")) {
-        state->font_variant = rsvg_css_parse_font_variant (value, &state->has_font_variant);
-    } else if (g_str_equal (name, "font-weight")) {
-        state->font_weight = rsvg_css_parse_font_weight (value, &state->has_font_weight);
-    } else if (g_str_equal (name, "font-stretch")) {
-        state->font_stretch = rsvg_css_parse_font_stretch (value, &state->has_font_stretch);
-    } else if (g_str_equal (name, "text-decoration")) {
+        g_free (text->lang);
+        text->lang = save;
+        text->has_lang = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_STYLE: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+        gboolean has_font_style;
+
+        text->font_style = rsvg_css_parse_font_style (value, &has_font_style);
+        text->has_font_style = has_font_style;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_VARIANT: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+        gboolean has_font_variant;
+
+        text->font_variant = rsvg_css_parse_font_variant (value, &has_font_variant);
+        text->has_font_variant = has_font_variant;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_WEIGHT: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+        gboolean has_font_weight;
+
+        text->font_weight = rsvg_css_parse_font_weight (value, &has_font_weight);
+        text->has_font_weight = has_font_weight;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_FONT_STRETCH: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+        gboolean has_font_stretch;
+
+        text->font_stretch = rsvg_css_parse_font_stretch (value, &has_font_stretch);
+        text->has_font_stretch = has_font_stretch;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_TEXT_DECORATION: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
         if (g_str_equal (value, "inherit")) {
-            state->has_font_decor = FALSE;
-            state->font_decor = TEXT_NORMAL;
+            text->has_font_decor = FALSE;
+            text->font_decor = TEXT_NORMAL;
         } else {
             if (strstr (value, "underline"))
-                state->font_decor |= TEXT_UNDERLINE;
+                text->font_decor |= TEXT_UNDERLINE;
             if (strstr (value, "overline"))
-                state->font_decor |= TEXT_OVERLINE;
+                text->font_decor |= TEXT_OVERLINE;
             if (strstr (value, "strike") || strstr (value, "line-through"))     /* strike though or line-through */
-                state->font_decor |= TEXT_STRIKE;
-            state->has_font_decor = TRUE;
+                text->font_decor |= TEXT_STRIKE;
+            text->has_font_decor = TRUE;
         }
-    } else if (g_str_equal (name, "direction")) {
-        state->has_text_dir = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_DIRECTION: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->has_text_dir = TRUE;
         if (g_str_equal (value, "inherit")) {
-            state->text_dir = PANGO_DIRECTION_LTR;
-            state->has_text_dir = FALSE;
+            text->text_dir = PANGO_DIRECTION_LTR;
+            text->has_text_dir = FALSE;
         } else if (g_str_equal (value, "rtl"))
-            state->text_dir = PANGO_DIRECTION_RTL;
+            text->text_dir = PANGO_DIRECTION_RTL;
         else                    /* ltr */
-            state->text_dir = PANGO_DIRECTION_LTR;
-    } else if (g_str_equal (name, "unicode-bidi")) {
-        state->has_unicode_bidi = TRUE;
+            text->text_dir = PANGO_DIRECTION_LTR;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_UNICODE_BIDI: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->has_unicode_bidi = TRUE;
         if (g_str_equal (value, "inherit")) {
-            state->unicode_bidi = UNICODE_BIDI_NORMAL;
-            state->has_unicode_bidi = FALSE;
+            text->unicode_bidi = UNICODE_BIDI_NORMAL;
+            text->has_unicode_bidi = FALSE;
         } else if (g_str_equal (value, "embed"))
-            state->unicode_bidi = UNICODE_BIDI_EMBED;
+            text->unicode_bidi = UNICODE_BIDI_EMBED;
         else if (g_str_equal (value, "bidi-override"))
-            state->unicode_bidi = UNICODE_BIDI_OVERRIDE;
+            text->unicode_bidi = UNICODE_BIDI_OVERRIDE;
         else                    /* normal */
-            state->unicode_bidi = UNICODE_BIDI_NORMAL;
-    } else if (g_str_equal (name, "writing-mode")) {
+            text->unicode_bidi = UNICODE_BIDI_NORMAL;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_WRITING_MODE: {
         /* TODO: these aren't quite right... */
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
 
-        state->has_text_dir = TRUE;
-        state->has_text_gravity = TRUE;
+        text->has_text_dir = TRUE;
+        text->has_text_gravity = TRUE;
         if (g_str_equal (value, "inherit")) {
-            state->text_dir = PANGO_DIRECTION_LTR;
-            state->has_text_dir = FALSE;
-            state->text_gravity = PANGO_GRAVITY_SOUTH;
-            state->has_text_gravity = FALSE;
+            text->text_dir = PANGO_DIRECTION_LTR;
+            text->has_text_dir = FALSE;
+            text->text_gravity = PANGO_GRAVITY_SOUTH;
+            text->has_text_gravity = FALSE;
         } else if (g_str_equal (value, "lr-tb") || g_str_equal (value, "lr")) {
-            state->text_dir = PANGO_DIRECTION_LTR;
-            state->text_gravity = PANGO_GRAVITY_SOUTH;
+            text->text_dir = PANGO_DIRECTION_LTR;
+            text->text_gravity = PANGO_GRAVITY_SOUTH;
         } else if (g_str_equal (value, "rl-tb") || g_str_equal (value, "rl")) {
-            state->text_dir = PANGO_DIRECTION_RTL;
-            state->text_gravity = PANGO_GRAVITY_SOUTH;
+            text->text_dir = PANGO_DIRECTION_RTL;
+            text->text_gravity = PANGO_GRAVITY_SOUTH;
         } else if (g_str_equal (value, "tb-rl") || g_str_equal (value, "tb")) {
-            state->text_dir = PANGO_DIRECTION_LTR;
-            state->text_gravity = PANGO_GRAVITY_EAST;
+            text->text_dir = PANGO_DIRECTION_LTR;
+            text->text_gravity = PANGO_GRAVITY_EAST;
         }
-    } else if (g_str_equal (name, "text-anchor")) {
-        state->has_text_anchor = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_TEXT_ANCHOR: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->has_text_anchor = TRUE;
         if (g_str_equal (value, "inherit")) {
-            state->text_anchor = TEXT_ANCHOR_START;
-            state->has_text_anchor = FALSE;
+            text->text_anchor = TEXT_ANCHOR_START;
+            text->has_text_anchor = FALSE;
         } else {
             if (strstr (value, "start"))
-                state->text_anchor = TEXT_ANCHOR_START;
+                text->text_anchor = TEXT_ANCHOR_START;
             else if (strstr (value, "middle"))
-                state->text_anchor = TEXT_ANCHOR_MIDDLE;
+                text->text_anchor = TEXT_ANCHOR_MIDDLE;
             else if (strstr (value, "end"))
-                state->text_anchor = TEXT_ANCHOR_END;
+                text->text_anchor = TEXT_ANCHOR_END;
         }
-    } else if (g_str_equal (name, "letter-spacing")) {
-	state->has_letter_spacing = TRUE;
-	state->letter_spacing = rsvg_length_parse (value, LENGTH_DIR_HORIZONTAL);
-    } else if (g_str_equal (name, "stop-color")) {
-        state->has_stop_color = TRUE;
-        state->stop_color = rsvg_css_parse_color (value, ALLOW_INHERIT_YES, ALLOW_CURRENT_COLOR_YES);
-    } else if (g_str_equal (name, "stop-opacity")) {
-        state->stop_opacity = rsvg_css_parse_opacity (value);
-        state->has_stop_opacity = TRUE;
-    } else if (g_str_equal (name, "marker-start")) {
-        g_free (state->startMarker);
-        state->startMarker = rsvg_get_url_string (value, NULL);
-        state->has_startMarker = TRUE;
-    } else if (g_str_equal (name, "marker-mid")) {
-        g_free (state->middleMarker);
-        state->middleMarker = rsvg_get_url_string (value, NULL);
-        state->has_middleMarker = TRUE;
-    } else if (g_str_equal (name, "marker-end")) {
-        g_free (state->endMarker);
-        state->endMarker = rsvg_get_url_string (value, NULL);
-        state->has_endMarker = TRUE;
-    } else if (g_str_equal (name, "marker")) {
-        if (!state->has_startMarker) {
-            g_free (state->startMarker);
-            state->startMarker = rsvg_get_url_string (value, NULL);
-            state->has_startMarker = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_LETTER_SPACING: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+	text->has_letter_spacing = TRUE;
+	text->letter_spacing = rsvg_length_parse (value, LENGTH_DIR_HORIZONTAL);
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STOP_COLOR: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_stop_color = TRUE;
+        paint->stop_color = rsvg_css_parse_color (value, ALLOW_INHERIT_YES, ALLOW_CURRENT_COLOR_YES);
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STOP_OPACITY: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->stop_opacity = rsvg_css_parse_opacity (value);
+        paint->has_stop_opacity = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_MARKER_START: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        g_free (paint->startMarker);
+        paint->startMarker = rsvg_get_url_string (value, NULL);
+        paint->has_startMarker = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_MARKER_MID: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        g_free (paint->middleMarker);
+        paint->middleMarker = rsvg_get_url_string (value, NULL);
+        paint->has_middleMarker = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_MARKER_END: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        g_free (paint->endMarker);
+        paint->endMarker = rsvg_get_url_string (value, NULL);
+        paint->has_endMarker = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_MARKER: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        if (!paint->has_startMarker) {
+            g_free (paint->startMarker);
+            paint->startMarker = rsvg_get_url_string (value, NULL);
+            paint->has_startMarker = TRUE;
         }
 
-        if (!state->has_middleMarker) {
-            g_free (state->middleMarker);
-            state->middleMarker = rsvg_get_url_string (value, NULL);
-            state->has_middleMarker = TRUE;
+        if (!paint->has_middleMarker) {
+            g_free (paint->middleMarker);
+            paint->middleMarker = rsvg_get_url_string (value, NULL);
+            paint->has_middleMarker = TRUE;
         }
 
-        if (!state->has_endMarker) {
-            g_free (state->endMarker);
-            state->endMarker = rsvg_get_url_string (value, NULL);
-            state->has_endMarker = TRUE;
+        if (!paint->has_endMarker) {
+            g_free (paint->endMarker);
+            paint->endMarker = rsvg_get_url_string (value, NULL);
+            paint->has_endMarker = TRUE;
         }
-    } else if (g_str_equal (name, "stroke-miterlimit")) {
-        state->has_miter_limit = TRUE;
-        state->miter_limit = g_ascii_strtod (value, NULL);
-    } else if (g_str_equal (name, "stroke-dashoffset")) {
-        state->has_dashoffset = TRUE;
-        state->dash.offset = rsvg_length_parse (value, LENGTH_DIR_BOTH);
-        if (state->dash.offset.length < 0.)
-            state->dash.offset.length = 0.;
-    } else if (g_str_equal (name, "shape-rendering")) {
-        state->has_shape_rendering_type = TRUE;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_MITERLIMIT: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_miter_limit = TRUE;
+        paint->miter_limit = g_ascii_strtod (value, NULL);
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_DASHOFFSET: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_dashoffset = TRUE;
+        paint->dash.offset = rsvg_length_parse (value, LENGTH_DIR_BOTH);
+        if (paint->dash.offset.length < 0.)
+            paint->dash.offset.length = 0.;
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_SHAPE_RENDERING: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
+
+        paint->has_shape_rendering_type = TRUE;
 
         if (g_str_equal (value, "auto") || g_str_equal (value, "default"))
-            state->shape_rendering_type = SHAPE_RENDERING_AUTO;
+            paint->shape_rendering_type = SHAPE_RENDERING_AUTO;
         else if (g_str_equal (value, "optimizeSpeed"))
-            state->shape_rendering_type = SHAPE_RENDERING_OPTIMIZE_SPEED;
+            paint->shape_rendering_type = SHAPE_RENDERING_OPTIMIZE_SPEED;
         else if (g_str_equal (value, "crispEdges"))
-            state->shape_rendering_type = SHAPE_RENDERING_CRISP_EDGES;
+            paint->shape_rendering_type = SHAPE_RENDERING_CRISP_EDGES;
         else if (g_str_equal (value, "geometricPrecision"))
-            state->shape_rendering_type = SHAPE_RENDERING_GEOMETRIC_PRECISION;
+            paint->shape_rendering_type = SHAPE_RENDERING_GEOMETRIC_PRECISION;
+
+        break;
+    }
 
-    } else if (g_str_equal (name, "text-rendering")) {
-        state->has_text_rendering_type = TRUE;
+    case RSVG_ATTRIBUTE_TEXT_RENDERING: {
+        RsvgTextStyle *text = state_get_text_style_for_write (state);
+
+        text->has_text_rendering_type = TRUE;
 
         if (g_str_equal (value, "auto") || g_str_equal (value, "default"))
-            state->text_rendering_type = TEXT_RENDERING_AUTO;
+            text->text_rendering_type = TEXT_RENDERING_AUTO;
         else if (g_str_equal (value, "optimizeSpeed"))
-            state->text_rendering_type = TEXT_RENDERING_OPTIMIZE_SPEED;
+            text->text_rendering_type = TEXT_RENDERING_OPTIMIZE_SPEED;
         else if (g_str_equal (value, "optimizeLegibility"))
-            state->text_rendering_type = TEXT_RENDERING_OPTIMIZE_LEGIBILITY;
+            text->text_rendering_type = TEXT_RENDERING_OPTIMIZE_LEGIBILITY;
         else if (g_str_equal (value, "geometricPrecision"))
-            state->text_rendering_type = TEXT_RENDERING_GEOMETRIC_PRECISION;
+            text->text_rendering_type = TEXT_RENDERING_GEOMETRIC_PRECISION;
+
+        break;
+    }
+
+    case RSVG_ATTRIBUTE_STROKE_DASHARRAY: {
+        RsvgPaintStyle *paint = state_get_paint_style_for_write (state);
 
-    } else if (g_str_equal (name, "stroke-dasharray")) {
-        state->has_dash = TRUE;
+        paint->has_dash = TRUE;
         if (g_str_equal (value, "none")) {
-            if (state->dash.n_dash != 0) {
+            if (paint->dash.n_dash != 0) {
                 /* free any cloned dash data */
-                g_free (state->dash.dash);
-                state->dash.dash = NULL;
-                state->dash.n_dash = 0;
+                g_free (paint->dash.dash);
+                paint->dash.dash = NULL;
+                paint->dash.n_dash = 0;
             }
         } else {
             gchar **dashes = g_strsplit (value, ",", -1);
@@ -971,93 +1626,63 @@ rsvg_parse_style_pair (RsvgState * state,
                 for (n_dashes = 0; dashes[n_dashes] != NULL; n_dashes++);
 
                 is_even = (n_dashes % 2 == 0);
-                state->dash.n_dash = (is_even ? n_dashes : n_dashes * 2);
-                state->dash.dash = g_new0 (double, state->dash.n_dash);
+                g_free (paint->dash.dash);
+                paint->dash.n_dash = (is_even ? n_dashes : n_dashes * 2);
+                paint->dash.dash = g_new0 (double, paint->dash.n_dash);
 
                 /* TODO: handle negative value == error case */
 
                 /* the even and base case */
                 for (i = 0; i < n_dashes; i++) {
-                    state->dash.dash[i] = g_ascii_strtod (dashes[i], NULL);
-                    total += state->dash.dash[i];
+                    paint->dash.dash[i] = g_ascii_strtod (dashes[i], NULL);
+                    total += paint->dash.dash[i];
                 }
                 /* if an odd number of dashes is found, it gets repeated */
                 if (!is_even)
-                    for (; i < state->dash.n_dash; i++)
-                        state->dash.dash[i] = state->dash.dash[i - n_dashes];
+                    for (; i < paint->dash.n_dash; i++)
+                        paint->dash.dash[i] = paint->dash.dash[i - n_dashes];
 
                 g_strfreev (dashes);
                 /* If the dashes add up to 0, then it should 
                    be ignored */
                 if (total == 0) {
-                    g_free (state->dash.dash);
-                    state->dash.dash = NULL;
-                    state->dash.n_dash = 0;
+                    g_free (paint->dash.dash);
+                    paint->dash.dash = NULL;
+                    paint->dash.n_dash = 0;
                 }
             }
         }
+        break;
     }
-}
-
-static void
-rsvg_lookup_parse_style_pair (RsvgState * state,
-                              const char *key, RsvgPropertyBag * atts)
-{
-    const char *value;
 
-    if ((value = rsvg_property_bag_lookup (atts, key)) != NULL)
-        rsvg_parse_style_pair (state, key, value, FALSE);
+    default:
+        break;
+    }
 }
 
 /* take a pair of the form (fill="#ff00ff") and parse it as a style */
 void
 rsvg_parse_style_pairs (RsvgState * state, RsvgPropertyBag * atts)
 {
-    rsvg_lookup_parse_style_pair (state, "baseline-shift", atts);
-    rsvg_lookup_parse_style_pair (state, "clip-path", atts);
-    rsvg_lookup_parse_style_pair (state, "clip-rule", atts);
-    rsvg_lookup_parse_style_pair (state, "color", atts);
-    rsvg_lookup_parse_style_pair (state, "direction", atts);
-    rsvg_lookup_parse_style_pair (state, "display", atts);
-    rsvg_lookup_parse_style_pair (state, "enable-background", atts);
-    rsvg_lookup_parse_style_pair (state, "comp-op", atts);
-    rsvg_lookup_parse_style_pair (state, "fill", atts);
-    rsvg_lookup_parse_style_pair (state, "fill-opacity", atts);
-    rsvg_lookup_parse_style_pair (state, "fill-rule", atts);
-    rsvg_lookup_parse_style_pair (state, "filter", atts);
-    rsvg_lookup_parse_style_pair (state, "flood-color", atts);
-    rsvg_lookup_parse_style_pair (state, "flood-opacity", atts);
-    rsvg_lookup_parse_style_pair (state, "font-family", atts);
-    rsvg_lookup_parse_style_pair (state, "font-size", atts);
-    rsvg_lookup_parse_style_pair (state, "font-stretch", atts);
-    rsvg_lookup_parse_style_pair (state, "font-style", atts);
-    rsvg_lookup_parse_style_pair (state, "font-variant", atts);
-    rsvg_lookup_parse_style_pair (state, "font-weight", atts);
-    rsvg_lookup_parse_style_pair (state, "marker-end", atts);
-    rsvg_lookup_parse_style_pair (state, "mask", atts);
-    rsvg_lookup_parse_style_pair (state, "marker-mid", atts);
-    rsvg_lookup_parse_style_pair (state, "marker-start", atts);
-    rsvg_lookup_parse_style_pair (state, "opacity", atts);
-    rsvg_lookup_parse_style_pair (state, "overflow", atts);
-    rsvg_lookup_parse_style_pair (state, "shape-rendering", atts);
-    rsvg_lookup_parse_style_pair (state, "stop-color", atts);
-    rsvg_lookup_parse_style_pair (state, "stop-opacity", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-dasharray", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-dashoffset", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-linecap", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-linejoin", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-miterlimit", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-opacity", atts);
-    rsvg_lookup_parse_style_pair (state, "stroke-width", atts);
-    rsvg_lookup_parse_style_pair (state, "text-anchor", atts);
-    rsvg_lookup_parse_style_pair (state, "text-decoration", atts);
-    rsvg_lookup_parse_style_pair (state, "unicode-bidi", atts);
-    rsvg_lookup_parse_style_pair (state, "letter-spacing", atts);
-    rsvg_lookup_parse_style_pair (state, "visibility", atts);
-    rsvg_lookup_parse_style_pair (state, "writing-mode", atts);
-    rsvg_lookup_parse_style_pair (state, "xml:lang", atts);
-    rsvg_lookup_parse_style_pair (state, "xml:space", atts);
+    const char *values[RSVG_ATTRIBUTE_N_PRESENTATION];
+    guint64 present = 0;
+    guint i;
+
+    for (i = 0; i < atts->n_entries; i++) {
+        RsvgAttribute attr = atts->entries[i].attr;
+
+        if (attr < RSVG_ATTRIBUTE_N_PRESENTATION) {
+            values[attr] = atts->entries[i].value;
+            present |= G_GUINT64_CONSTANT (1) << attr;
+        }
+    }
+
+    /* Apply them in a fixed order, not in document order, since some
+     * properties touch the same fields (e.g. color and flood-color) */
+    for (i = 0; present != 0; i++, present >>= 1) {
+        if (present & 1)
+            rsvg_parse_style_pair (state, i, values[i], FALSE);
+    }
 
     {
         /* TODO: this conditional behavior isn't quite correct, and i'm not sure it should reside here */
@@ -1137,7 +1762,7 @@ rsvg_parse_style (RsvgHandle * ctx, RsvgState * state, const char *str)
 
             if (parse_style_value (second_value, &style_value, &important))
                 rsvg_parse_style_pair (state,
-                                       g_strstrip (first_value),
+                                       rsvg_attribute_from_name (g_strstrip (first_value), -1),
                                        style_value,
                                        important);
             g_free (style_value);
@@ -1148,45 +1773,15 @@ rsvg_parse_style (RsvgHandle * ctx, RsvgState * state, const char *str)
     g_strfreev (styles);
 }
 
-static void
-rsvg_css_define_style (RsvgHandle * ctx,
-                       const gchar * selector,
-                       const gchar * style_name,
-                       const gchar * style_value,
-                       gboolean important)
-{
-    GHashTable *styles;
-    gboolean need_insert = FALSE;
-
-    /* push name/style pair into HT */
-    styles = g_hash_table_lookup (ctx->priv->css_props, selector);
-    if (styles == NULL) {
-        styles = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                        g_free, (GDestroyNotify) style_value_data_free);
-        g_hash_table_insert (ctx->priv->css_props, (gpointer) g_strdup (selector), styles);
-        need_insert = TRUE;
-    } else {
-        StyleValueData *current_value;
-        current_value = g_hash_table_lookup (styles, style_name);
-        if (current_value == NULL || !current_value->important)
-            need_insert = TRUE;
-    }
-    if (need_insert) {
-        g_hash_table_insert (styles,
-                             (gpointer) g_strdup (style_name),
-                             (gpointer) style_value_data_new (style_value, important));
-    }
-}
-
 typedef struct _CSSUserData {
-    RsvgHandle *ctx;
+    RsvgStylesheet *sheet;
     CRSelector *selector;
 } CSSUserData;
 
 static void
-css_user_data_init (CSSUserData * user_data, RsvgHandle * ctx)
+css_user_data_init (CSSUserData * user_data, RsvgStylesheet * sheet)
 {
-    user_data->ctx = ctx;
+    user_data->sheet = sheet;
     user_data->selector = NULL;
 }
 
@@ -1228,26 +1823,30 @@ ccss_property (CRDocHandler * a_handler, CRString * a_name, CRTerm * a_expr, gbo
 
     if (a_name && a_expr && user_data->selector) {
         CRSelector *cur;
+        RsvgAttribute attr;
+        gchar *style_value;
+
+        name = (gchar *) cr_string_peek_raw_str (a_name);
+        len = cr_string_peek_raw_str_len (a_name);
+
+        /* Properties that we don't know about can't affect anything */
+        attr = rsvg_attribute_from_name (name, len);
+        if (attr >= RSVG_ATTRIBUTE_N_PROPERTIES)
+            return;
+
+        style_value = (gchar *) cr_term_to_string (a_expr);
+
         for (cur = user_data->selector; cur; cur = cur->next) {
             if (cur->simple_sel) {
-                gchar *selector = (gchar *) cr_simple_sel_to_string (cur->simple_sel);
-                if (selector) {
-                    gchar *style_name, *style_value;
-                    name = (gchar *) cr_string_peek_raw_str (a_name);
-                    len = cr_string_peek_raw_str_len (a_name);
-                    style_name = g_strndup (name, len);
-                    style_value = (gchar *)cr_term_to_string (a_expr);
-                    rsvg_css_define_style (user_data->ctx,
-                                           selector,
-                                           style_name,
-                                           style_value,
-                                           a_important);
-                    g_free (selector);
-                    g_free (style_name);
-                    g_free (style_value);
-                }
+                rsvg_stylesheet_add_declaration (user_data->sheet,
+                                                 cur->simple_sel,
+                                                 attr,
+                                                 style_value,
+                                                 a_important);
             }
         }
+
+        g_free (style_value);
     }
 }
 
@@ -1294,27 +1893,27 @@ init_sac_handler (CRDocHandler * a_handler)
     a_handler->unrecoverable_error = ccss_unrecoverable_error;
 }
 
-void
-rsvg_parse_cssbuffer (RsvgHandle * ctx, const char *buff, size_t buflen)
+static RsvgStylesheet *
+compile_stylesheet (const char *buff, size_t buflen)
 {
+    RsvgStylesheet *sheet;
     CRParser *parser = NULL;
     CRDocHandler *css_handler = NULL;
     CSSUserData user_data;
 
-    if (buff == NULL || buflen == 0)
-        return;
+    sheet = rsvg_stylesheet_new ();
 
     css_handler = cr_doc_handler_new ();
     init_sac_handler (css_handler);
 
-    css_user_data_init (&user_data, ctx);
+    css_user_data_init (&user_data, sheet);
     css_handler->app_data = &user_data;
 
     /* TODO: fix libcroco to take in const strings */
     parser = cr_parser_new_from_buf ((guchar *) buff, (gulong) buflen, CR_UTF_8, FALSE);
     if (parser == NULL) {
         cr_doc_handler_unref (css_handler);
-        return;
+        return sheet;
     }
 
     cr_parser_set_sac_handler (parser, css_handler);
@@ -1328,6 +1927,133 @@ rsvg_parse_cssbuffer (RsvgHandle * ctx, const char *buff, size_t buflen)
      */
 
     cr_parser_destroy (parser);
+
+    return sheet;
+}
+
+/* Returns the compiled form of the style sheet in @buff, from the cache
+ * if some handle has seen the same one already.
+ */
+static RsvgStylesheet *
+get_stylesheet_for_buffer (const char *buff, size_t buflen)
+{
+    RsvgStylesheet *sheet;
+    char *checksum, *key;
+
+    checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) buff, buflen);
+    key = g_strconcat ("css ", checksum, NULL);
+    g_free (checksum);
+
+    sheet = rsvg_stylesheet_cache_lookup (key);
+    if (sheet == NULL) {
+        sheet = compile_stylesheet (buff, buflen);
+        rsvg_stylesheet_cache_insert (key, sheet);
+    }
+
+    g_free (key);
+
+    return sheet;
+}
+
+/* Each style sheet is only imported once per handle, which also stops
+ * import cycles; this guards against long chains of distinct URIs.
+ */
+#define MAX_IMPORT_DEPTH 16
+
+static void add_stylesheet (RsvgHandle *ctx, RsvgStylesheet *sheet, guint depth);
+
+static void
+import_stylesheet (RsvgHandle *ctx, const char *href, guint depth)
+{
+    RsvgStylesheet *sheet = NULL;
+    char *uri;
+    char *file_key = NULL;
+
+    if (depth > MAX_IMPORT_DEPTH)
+        return;
+
+    uri = _rsvg_handle_resolve_allowed_uri (ctx, href, NULL);
+    if (uri == NULL)
+        return;
+
+    if (ctx->priv->imported_stylesheets == NULL)
+        ctx->priv->imported_stylesheets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    if (g_hash_table_contains (ctx->priv->imported_stylesheets, uri)) {
+        g_free (uri);
+        return;
+    }
+
+    g_hash_table_add (ctx->priv->imported_stylesheets, uri);
+
+    /* Local files can be identified without reading them */
+    file_key = _rsvg_io_get_file_cache_key (uri);
+    if (file_key) {
+        char *key = g_strconcat ("css-import ", file_key, NULL);
+
+        g_free (file_key);
+        file_key = key;
+
+        sheet = rsvg_stylesheet_cache_lookup (file_key);
+    }
+
+    if (sheet == NULL) {
+        char *stylesheet_data;
+        gsize stylesheet_data_len;
+        char *mime_type = NULL;
+
+        stylesheet_data = _rsvg_handle_acquire_data (ctx,
+                                                     href,
+                                                     &mime_type,
+                                                     &stylesheet_data_len,
+                                                     NULL);
+        if (stylesheet_data != NULL &&
+            mime_type != NULL &&
+            strcmp (mime_type, "text/css") == 0 &&
+            stylesheet_data_len > 0) {
+            sheet = get_stylesheet_for_buffer (stylesheet_data, stylesheet_data_len);
+
+            if (file_key)
+                rsvg_stylesheet_cache_insert (file_key, sheet);
+        }
+
+        g_free (stylesheet_data);
+        g_free (mime_type);
+    }
+
+    if (sheet) {
+        add_stylesheet (ctx, sheet, depth);
+        rsvg_stylesheet_unref (sheet);
+    }
+
+    g_free (file_key);
+}
+
+/* Makes the rules of @sheet apply to the elements that are parsed from
+ * now on, after the style sheets that it imports.
+ */
+static void
+add_stylesheet (RsvgHandle *ctx, RsvgStylesheet *sheet, guint depth)
+{
+    guint i;
+
+    for (i = 0; i < rsvg_stylesheet_get_n_imports (sheet); i++)
+        import_stylesheet (ctx, rsvg_stylesheet_get_import (sheet, i), depth + 1);
+
+    g_ptr_array_add (ctx->priv->stylesheets, rsvg_stylesheet_ref (sheet));
+}
+
+void
+rsvg_parse_cssbuffer (RsvgHandle * ctx, const char *buff, size_t buflen)
+{
+    RsvgStylesheet *sheet;
+
+    if (buff == NULL || buflen == 0)
+        return;
+
+    sheet = get_stylesheet_for_buffer (buff, buflen);
+    add_stylesheet (ctx, sheet, 0);
+    rsvg_stylesheet_unref (sheet);
 }
 
 static void
@@ -1336,29 +2062,12 @@ ccss_import_style (CRDocHandler * a_this,
                    CRString * a_uri, CRString * a_uri_default_ns, CRParsingLocation * a_location)
 {
     CSSUserData *user_data = (CSSUserData *) a_this->app_data;
-    char *stylesheet_data;
-    gsize stylesheet_data_len;
-    char *mime_type = NULL;
 
     if (a_uri == NULL)
         return;
 
-    stylesheet_data = _rsvg_handle_acquire_data (user_data->ctx,
-                                                 cr_string_peek_raw_str (a_uri),
-                                                 &mime_type,
-                                                 &stylesheet_data_len,
-                                                 NULL);
-    if (stylesheet_data == NULL || 
-        mime_type == NULL || 
-        strcmp (mime_type, "text/css") != 0) {
-        g_free (stylesheet_data);
-        g_free (mime_type);
-        return;
-    }
-
-    rsvg_parse_cssbuffer (user_data->ctx, stylesheet_data, stylesheet_data_len);
-    g_free (stylesheet_data);
-    g_free (mime_type);
+    /* Imports are resolved by each handle that uses the style sheet */
+    rsvg_stylesheet_add_import (user_data->sheet, cr_string_peek_raw_str (a_uri));
 }
 
 /**
@@ -1383,34 +2092,12 @@ rsvg_parse_transform_attr (RsvgHandle * ctx, RsvgState * state, const char *str)
     }
 }
 
-typedef struct _StylesData {
-    RsvgHandle *ctx;
-    RsvgState *state;
-} StylesData;
-
 static void
-apply_style (const gchar *key, StyleValueData *value, gpointer user_data)
-{
-    StylesData *data = (StylesData *) user_data;
-    rsvg_parse_style_pair (data->state, key, value->value, value->important);
-}
-
-static gboolean
-rsvg_lookup_apply_css_style (RsvgHandle * ctx, const char *target, RsvgState * state)
+apply_style (RsvgAttribute attr, const char *value, gboolean important, gpointer user_data)
 {
-    GHashTable *styles;
-
-    styles = g_hash_table_lookup (ctx->priv->css_props, target);
+    RsvgState *state = user_data;
 
-    if (styles != NULL) {
-        StylesData *data = g_new0 (StylesData, 1);
-        data->ctx = ctx;
-        data->state = state;
-        g_hash_table_foreach (styles, (GHFunc) apply_style, data);
-        g_free (data);
-        return TRUE;
-    }
-    return FALSE;
+    rsvg_parse_style_pair (state, attr, value, important);
 }
 
 /**
@@ -1429,10 +2116,6 @@ rsvg_parse_style_attrs (RsvgHandle *ctx,
                         RsvgNode *node,
                         const char *tag, const char *klazz, const char *id, RsvgPropertyBag * atts)
 {
-    int i = 0, j = 0;
-    char *target = NULL;
-    gboolean found = FALSE;
-    GString *klazz_list = NULL;
     RsvgState *state;
 
     state = rsvg_node_get_state (node);
@@ -1440,87 +2123,18 @@ rsvg_parse_style_attrs (RsvgHandle *ctx,
     if (rsvg_property_bag_size (atts) > 0)
         rsvg_parse_style_pairs (state, atts);
 
-    /* Try to properly support all of the following, including inheritance:
-     * *
-     * #id
-     * tag
-     * tag#id
-     * tag.class
-     * tag.class#id
-     *
-     * This is basically a semi-compliant CSS2 selection engine
-     */
-
-    /* * */
-    rsvg_lookup_apply_css_style (ctx, "*", state);
-
-    /* tag */
-    if (tag != NULL) {
-        rsvg_lookup_apply_css_style (ctx, tag, state);
-    }
-
-    if (klazz != NULL) {
-        i = strlen (klazz);
-        while (j < i) {
-            found = FALSE;
-            klazz_list = g_string_new (".");
-
-            while (j < i && g_ascii_isspace (klazz[j]))
-                j++;
-
-            while (j < i && !g_ascii_isspace (klazz[j]))
-                g_string_append_c (klazz_list, klazz[j++]);
-
-            /* tag.class#id */
-            if (tag != NULL && klazz_list->len != 1 && id != NULL) {
-                target = g_strdup_printf ("%s%s#%s", tag, klazz_list->str, id);
-                found = found || rsvg_lookup_apply_css_style (ctx, target, state);
-                g_free (target);
-            }
-
-            /* class#id */
-            if (klazz_list->len != 1 && id != NULL) {
-                target = g_strdup_printf ("%s#%s", klazz_list->str, id);
-                found = found || rsvg_lookup_apply_css_style (ctx, target, state);
-                g_free (target);
-            }
-
-            /* tag.class */
-            if (tag != NULL && klazz_list->len != 1) {
-                target = g_strdup_printf ("%s%s", tag, klazz_list->str);
-                found = found || rsvg_lookup_apply_css_style (ctx, target, state);
-                g_free (target);
-            }
-
-            /* didn't find anything more specific, just apply the class style */
-            if (!found) {
-                found = found || rsvg_lookup_apply_css_style (ctx, klazz_list->str, state);
-            }
-            g_string_free (klazz_list, TRUE);
-        }
-    }
-
-    /* #id */
-    if (id != NULL) {
-        target = g_strdup_printf ("#%s", id);
-        rsvg_lookup_apply_css_style (ctx, target, state);
-        g_free (target);
-    }
-
-    /* tag#id */
-    if (tag != NULL && id != NULL) {
-        target = g_strdup_printf ("%s#%s", tag, id);
-        rsvg_lookup_apply_css_style (ctx, target, state);
-        g_free (target);
-    }
+    rsvg_stylesheets_apply ((RsvgStylesheet * const *) ctx->priv->stylesheets->pdata,
+                            ctx->priv->stylesheets->len,
+                            ctx->priv->style_ancestors,
+                            tag, klazz, id, apply_style, state);
 
     if (rsvg_property_bag_size (atts) > 0) {
         const char *value;
 
-        if ((value = rsvg_property_bag_lookup (atts, "style")) != NULL)
+        if ((value = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_STYLE)) != NULL)
             rsvg_parse_style (ctx, state, value);
 
-        if ((value = rsvg_property_bag_lookup (atts, "transform")) != NULL) {
+        if ((value = rsvg_property_bag_lookup_attribute (atts, RSVG_ATTRIBUTE_TRANSFORM)) != NULL) {
             if (!rsvg_parse_transform_attr (ctx, state, value)) {
                 rsvg_node_set_attribute_parse_error (node,
                                                      "transform",
@@ -1528,6 +2142,9 @@ rsvg_parse_style_attrs (RsvgHandle *ctx,
             }
         }
     }
+
+    rsvg_state_share_paint_style (state, ctx->priv->paint_styles);
+    rsvg_state_share_text_style (state, ctx->priv->text_styles);
 }
 
 RsvgState *
@@ -1554,6 +2171,180 @@ rsvg_state_free_all (RsvgState * state)
     }
 }
 
+static const char *const attribute_names[] = {
+    "baseline-shift",
+    "clip-path",
+    "clip-rule",
+    "color",
+    "direction",
+    "display",
+    "enable-background",
+    "comp-op",
+    "fill",
+    "fill-opacity",
+    "fill-rule",
+    "filter",
+    "flood-color",
+    "flood-opacity",
+    "font-family",
+    "font-size",
+    "font-stretch",
+    "font-style",
+    "font-variant",
+    "font-weight",
+    "marker-end",
+    "mask",
+    "marker-mid",
+    "marker-start",
+    "opacity",
+    "overflow",
+    "shape-rendering",
+    "stop-color",
+    "stop-opacity",
+    "stroke",
+    "stroke-dasharray",
+    "stroke-dashoffset",
+    "stroke-linecap",
+    "stroke-linejoin",
+    "stroke-miterlimit",
+    "stroke-opacity",
+    "stroke-width",
+    "text-anchor",
+    "text-decoration",
+    "unicode-bidi",
+    "letter-spacing",
+    "visibility",
+    "writing-mode",
+    "xml:lang",
+    "xml:space",
+    "marker",
+    "text-rendering",
+    "class",
+    "id",
+    "style",
+    "transform",
+    "requiredFeatures",
+    "requiredExtensions",
+    "systemLanguage",
+    "xlink:href",
+
+    "cx",
+    "cy",
+    "d",
+    "dx",
+    "dy",
+    "fx",
+    "fy",
+    "gradientTransform",
+    "gradientUnits",
+    "height",
+    "in",
+    "markerHeight",
+    "markerUnits",
+    "markerWidth",
+    "offset",
+    "orient",
+    "patternContentUnits",
+    "patternTransform",
+    "patternUnits",
+    "points",
+    "preserveAspectRatio",
+    "r",
+    "refX",
+    "refY",
+    "result",
+    "rx",
+    "ry",
+    "spreadMethod",
+    "type",
+    "viewBox",
+    "width",
+    "x",
+    "x1",
+    "x2",
+    "y",
+    "y1",
+    "y2",
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (attribute_names) == RSVG_ATTRIBUTE_UNKNOWN);
+G_STATIC_ASSERT (RSVG_ATTRIBUTE_N_PROPERTIES <= 64); /* see RsvgState.specified */
+
+/* Attribute names are mapped to RsvgAttribute with a perfect hash */
+static RsvgNameTable attribute_table = RSVG_NAME_TABLE_INIT (attribute_names);
+
+RsvgAttribute
+rsvg_attribute_from_name (const char *name, gssize len)
+{
+    gint i;
+
+    i = rsvg_name_table_lookup (&attribute_table, name, len);
+
+    return i < 0 ? RSVG_ATTRIBUTE_UNKNOWN : (RsvgAttribute) i;
+}
+
+const char *
+rsvg_attribute_get_name (RsvgAttribute attr)
+{
+    g_return_val_if_fail (attr < RSVG_ATTRIBUTE_UNKNOWN, NULL);
+
+    return attribute_names[attr];
+}
+
+/**
+ * rsvg_property_bag_init:
+ * @bag: property bag to initialize, usually on the stack
+ * @atts: (array zero-terminated=1): list of alternating attributes
+ *   and values
+ *
+ * Like rsvg_property_bag_new(), but for a bag that the caller allocates.
+ * Call rsvg_property_bag_clear() on it when done.
+ */
+void
+rsvg_property_bag_init (RsvgPropertyBag * bag, const char **atts)
+{
+    guint n, i;
+
+    n = 0;
+    if (atts != NULL) {
+        while (atts[n * 2] != NULL)
+            n++;
+    }
+
+    if (n <= RSVG_PROPERTY_BAG_N_INLINE_ENTRIES)
+        bag->entries = bag->inline_entries;
+    else
+        bag->entries = g_new (RsvgPropertyBagEntry, n);
+
+    bag->n_entries = n;
+    bag->owns_strings = FALSE;
+
+    for (i = 0; i < n; i++) {
+        bag->entries[i].attr = rsvg_attribute_from_name (atts[i * 2], -1);
+        bag->entries[i].key = atts[i * 2];
+        bag->entries[i].value = atts[i * 2 + 1];
+    }
+}
+
+void
+rsvg_property_bag_clear (RsvgPropertyBag * bag)
+{
+    if (bag->owns_strings) {
+        guint i;
+
+        for (i = 0; i < bag->n_entries; i++) {
+            g_free ((char *) bag->entries[i].key);
+            g_free ((char *) bag->entries[i].value);
+        }
+    }
+
+    if (bag->entries != bag->inline_entries)
+        g_free (bag->entries);
+
+    bag->entries = NULL;
+    bag->n_entries = 0;
+}
+
 /**
  * rsvg_property_bag_new:
  * @atts: (array zero-terminated=1): list of alternating attributes
@@ -1568,14 +2359,9 @@ RsvgPropertyBag *
 rsvg_property_bag_new (const char **atts)
 {
     RsvgPropertyBag *bag;
-    int i;
 
-    bag = g_hash_table_new (g_str_hash, g_str_equal);
-
-    if (atts != NULL) {
-        for (i = 0; atts[i] != NULL; i += 2)
-            g_hash_table_insert (bag, (gpointer) atts[i], (gpointer) atts[i + 1]);
-    }
+    bag = g_new (RsvgPropertyBag, 1);
+    rsvg_property_bag_init (bag, atts);
 
     return bag;
 }
@@ -1592,16 +2378,23 @@ RsvgPropertyBag *
 rsvg_property_bag_dup (RsvgPropertyBag * bag)
 {
     RsvgPropertyBag *dup;
-    GHashTableIter iter;
-    gpointer key, value;
+    guint i;
 
-    dup = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    dup = g_new (RsvgPropertyBag, 1);
 
-    g_hash_table_iter_init (&iter, bag);
-    while (g_hash_table_iter_next (&iter, &key, &value))
-      g_hash_table_insert (dup, 
-                           (gpointer) g_strdup ((char *) key),
-                           (gpointer) g_strdup ((char *) value));
+    if (bag->n_entries <= RSVG_PROPERTY_BAG_N_INLINE_ENTRIES)
+        dup->entries = dup->inline_entries;
+    else
+        dup->entries = g_new (RsvgPropertyBagEntry, bag->n_entries);
+
+    dup->n_entries = bag->n_entries;
+    dup->owns_strings = TRUE;
+
+    for (i = 0; i < bag->n_entries; i++) {
+        dup->entries[i].attr = bag->entries[i].attr;
+        dup->entries[i].key = g_strdup (bag->entries[i].key);
+        dup->entries[i].value = g_strdup (bag->entries[i].value);
+    }
 
     return dup;
 }
@@ -1609,26 +2402,78 @@ rsvg_property_bag_dup (RsvgPropertyBag * bag)
 void
 rsvg_property_bag_free (RsvgPropertyBag * bag)
 {
-    g_hash_table_unref (bag);
+    rsvg_property_bag_clear (bag);
+    g_free (bag);
 }
 
 const char *
 rsvg_property_bag_lookup (RsvgPropertyBag * bag, const char *key)
 {
-    return (const char *) g_hash_table_lookup (bag, (gconstpointer) key);
+    return rsvg_property_bag_lookup_len (bag, key, -1);
+}
+
+/**
+ * rsvg_property_bag_lookup_len:
+ * @bag: property bag
+ * @key: name of the attribute
+ * @key_len: length of @key, or -1 if it is nul-terminated
+ *
+ * Like rsvg_property_bag_lookup(), for callers whose strings aren't
+ * nul-terminated.  Known attributes are found by comparing atoms.
+ *
+ * Returns: (nullable): the value of the attribute
+ */
+const char *
+rsvg_property_bag_lookup_len (RsvgPropertyBag * bag, const char *key, gssize key_len)
+{
+    RsvgAttribute attr;
+    guint i;
+
+    attr = rsvg_attribute_from_name (key, key_len);
+    if (attr != RSVG_ATTRIBUTE_UNKNOWN)
+        return rsvg_property_bag_lookup_attribute (bag, attr);
+
+    if (key_len < 0)
+        key_len = strlen (key);
+
+    for (i = 0; i < bag->n_entries; i++) {
+        const char *entry_key = bag->entries[i].key;
+
+        if (bag->entries[i].attr == RSVG_ATTRIBUTE_UNKNOWN
+            && strlen (entry_key) == (gsize) key_len && memcmp (entry_key, key, key_len) == 0)
+            return bag->entries[i].value;
+    }
+
+    return NULL;
+}
+
+const char *
+rsvg_property_bag_lookup_attribute (RsvgPropertyBag * bag, RsvgAttribute attr)
+{
+    guint i;
+
+    for (i = 0; i < bag->n_entries; i++) {
+        if (bag->entries[i].attr == attr)
+            return bag->entries[i].value;
+    }
+
+    return NULL;
 }
 
 guint
 rsvg_property_bag_size (RsvgPropertyBag * bag)
 {
-    return g_hash_table_size (bag);
+    return bag->n_entries;
 }
 
 void
 rsvg_property_bag_enumerate (RsvgPropertyBag * bag, RsvgPropertyBagEnumFunc func,
                              gpointer user_data)
 {
-    g_hash_table_foreach (bag, (GHFunc) func, user_data);
+    guint i;
+
+    for (i = 0; i < bag->n_entries; i++)
+        func (bag->entries[i].key, bag->entries[i].value, user_data);
 }
 
 void
@@ -1638,7 +2483,19 @@ rsvg_state_push (RsvgDrawingCtx * ctx)
     RsvgState *baseon;
 
     baseon = ctx->state;
-    data = rsvg_state_new ();
+
+    /* States are pushed and popped for every element that is drawn, so
+     * the popped ones are kept for reuse instead of going back to the
+     * allocator.
+     */
+    if (ctx->free_states) {
+        data = ctx->free_states;
+        ctx->free_states = data->parent;
+    } else {
+        data = g_slice_new (RsvgState);
+    }
+
+    rsvg_state_init (data);
 
     if (baseon) {
         rsvg_state_reinherit (data, baseon);
@@ -1656,7 +2513,24 @@ rsvg_state_pop (RsvgDrawingCtx * ctx)
 
     ctx->state = dead_state->parent;
 
-    rsvg_state_free (dead_state);
+    rsvg_state_finalize (dead_state);
+    dead_state->parent = ctx->free_states;
+    ctx->free_states = dead_state;
+}
+
+/* Frees the state stack of @ctx, and the states kept for reuse */
+void
+rsvg_state_free_stack (RsvgDrawingCtx * ctx)
+{
+    rsvg_state_free_all (ctx->state);
+    ctx->state = NULL;
+
+    while (ctx->free_states) {
+        RsvgState *state = ctx->free_states;
+
+        ctx->free_states = state->parent;
+        g_slice_free (RsvgState, state);
+    }
 }
 
 /*
@@ -1739,8 +2613,8 @@ rsvg_state_get_cond_true (RsvgState *state)
 RsvgCssColorSpec *
 rsvg_state_get_stop_color (RsvgState *state)
 {
-    if (state->has_stop_color) {
-        return &state->stop_color;
+    if (state->paint->has_stop_color) {
+        return &state->paint->stop_color;
     } else {
         return NULL;
     }
@@ -1749,5 +2623,5 @@ rsvg_state_get_stop_color (RsvgState *state)
 guint32
 rsvg_state_get_current_color (RsvgState *state)
 {
-    return state->current_color;
+    return state->paint->current_color;
 }
@@ -31,6 +31,7 @@
 #include "rsvg.h"
 #include "rsvg-css.h"
 #include "rsvg-paint-server.h"
+#include "rsvg-arena.h"
 
 #include <libxml/SAX.h>
 
@@ -70,122 +71,166 @@ struct _RsvgVpathDash {
     double *dash;
 };
 
-struct _RsvgState {
-    RsvgState *parent;
-    cairo_matrix_t affine;
-    cairo_matrix_t personal_affine;
-
-    char *filter;
-    char *mask;
-    char *clip_path;
-    guint8 opacity;             /* 0..255 */
-    double baseline_shift;
-    gboolean has_baseline_shift;
+typedef struct _RsvgTextStyle RsvgTextStyle;
 
-    RsvgPaintServer *fill;
-    gboolean has_fill_server;
-    guint8 fill_opacity;        /* 0..255 */
-    gboolean has_fill_opacity;
-    gint fill_rule;
-    gboolean has_fill_rule;
-    gint clip_rule;
-    gboolean has_clip_rule;
+/* The font and text properties.  Most elements never set any of them,
+ * so they live in a separate block that is shared by all the states
+ * that have equal values; see rsvg_state_share_text_style().  A block
+ * is immutable while it is shared, and copied when one of the states
+ * that use it is modified.
+ */
+struct _RsvgTextStyle {
+    gint ref_count;
 
-    gboolean overflow;
-    gboolean has_overflow;
-
-    RsvgPaintServer *stroke;
-    gboolean has_stroke_server;
-    guint8 stroke_opacity;      /* 0..255 */
-    gboolean has_stroke_opacity;
-    RsvgLength stroke_width;
-    gboolean has_stroke_width;
-    double miter_limit;
-    gboolean has_miter_limit;
-
-    cairo_line_cap_t cap;
-    gboolean has_cap;
-    cairo_line_join_t join;
-    gboolean has_join;
+    /* Equal to this one but with nothing specified, which is what the
+     * levels of the drawing stack inherit; made when first needed. */
+    RsvgTextStyle *unspecified;
 
     RsvgLength font_size;
-    gboolean has_font_size;
     char *font_family;
-    gboolean has_font_family;
     char *lang;
-    gboolean has_lang;
     PangoStyle font_style;
-    gboolean has_font_style;
     PangoVariant font_variant;
-    gboolean has_font_variant;
     PangoWeight font_weight;
-    gboolean has_font_weight;
     PangoStretch font_stretch;
-    gboolean has_font_stretch;
     TextDecoration font_decor;
-    gboolean has_font_decor;
     PangoDirection text_dir;
-    gboolean has_text_dir;
     PangoGravity text_gravity;
-    gboolean has_text_gravity;
     UnicodeBidi unicode_bidi;
-    gboolean has_unicode_bidi;
     TextAnchor text_anchor;
-    gboolean has_text_anchor;
     RsvgLength letter_spacing;
-    gboolean has_letter_spacing;
-
-    guint text_offset;
-
-    RsvgCssColorSpec stop_color;
-    gboolean has_stop_color;
+    double baseline_shift;
+    cairo_antialias_t text_rendering_type;
 
-    RsvgOpacitySpec stop_opacity;
-    gboolean has_stop_opacity;
+    guint space_preserve : 1;
+
+    guint has_font_size : 1;
+    guint has_font_family : 1;
+    guint has_lang : 1;
+    guint has_font_style : 1;
+    guint has_font_variant : 1;
+    guint has_font_weight : 1;
+    guint has_font_stretch : 1;
+    guint has_font_decor : 1;
+    guint has_text_dir : 1;
+    guint has_text_gravity : 1;
+    guint has_unicode_bidi : 1;
+    guint has_text_anchor : 1;
+    guint has_letter_spacing : 1;
+    guint has_baseline_shift : 1;
+    guint has_text_rendering_type : 1;
+    guint has_space_preserve : 1;
+};
 
-    gboolean visible;
-    gboolean has_visible;
+typedef struct _RsvgPaintStyle RsvgPaintStyle;
 
-    gboolean space_preserve;
-    gboolean has_space_preserve;
+/* The inherited properties for painting shapes: the paint servers, the
+ * fill and stroke parameters, their opacities and the colors.  Like the
+ * text style, a block is shared by all the states with equal values;
+ * see rsvg_state_share_paint_style().
+ */
+struct _RsvgPaintStyle {
+    gint ref_count;
 
-    gboolean has_cond;
-    gboolean cond_true;
+    /* Equal to this one but with nothing specified; see RsvgTextStyle */
+    RsvgPaintStyle *unspecified;
 
+    RsvgPaintServer *fill;
+    RsvgPaintServer *stroke;
+    RsvgLength stroke_width;
+    double miter_limit;
     RsvgVpathDash dash;
-    gboolean has_dash;
-    gboolean has_dashoffset;
 
+    guint8 fill_opacity;        /* 0..255 */
+    guint8 stroke_opacity;      /* 0..255 */
+    guchar flood_opacity;
     guint32 current_color;
-    gboolean has_current_color;
-
     guint32 flood_color;
-    gboolean has_flood_color;
 
-    guchar flood_opacity;
-    gboolean has_flood_opacity;
+    gint fill_rule;
+    gint clip_rule;
+    cairo_line_cap_t cap;
+    cairo_line_join_t join;
+    cairo_antialias_t shape_rendering_type;
+
+    RsvgCssColorSpec stop_color;
+    RsvgOpacitySpec stop_opacity;
 
     char *startMarker;
     char *middleMarker;
     char *endMarker;
-    gboolean has_startMarker;
-    gboolean has_middleMarker;
-    gboolean has_endMarker;
 
+    guint has_fill_server : 1;
+    guint has_fill_opacity : 1;
+    guint has_fill_rule : 1;
+    guint has_clip_rule : 1;
+    guint has_stroke_server : 1;
+    guint has_stroke_opacity : 1;
+    guint has_stroke_width : 1;
+    guint has_miter_limit : 1;
+    guint has_cap : 1;
+    guint has_join : 1;
+    guint has_stop_color : 1;
+    guint has_stop_opacity : 1;
+    guint has_dash : 1;
+    guint has_dashoffset : 1;
+    guint has_current_color : 1;
+    guint has_flood_color : 1;
+    guint has_flood_opacity : 1;
+    guint has_startMarker : 1;
+    guint has_middleMarker : 1;
+    guint has_endMarker : 1;
+    guint has_shape_rendering_type : 1;
+};
+
+/* What stays inline is the transform, which every level of the drawing
+ * stack computes for itself, and the properties which are not inherited.
+ */
+struct _RsvgState {
+    RsvgState *parent;
+    cairo_matrix_t affine;
+    cairo_matrix_t personal_affine;
+
+    char *filter;
+    char *mask;
+    char *clip_path;
+
+    guint8 opacity;             /* 0..255 */
     cairo_operator_t comp_op;
     RsvgEnableBackgroundType enable_background;
 
-    cairo_antialias_t shape_rendering_type;
-    gboolean has_shape_rendering_type;
+    RsvgPaintStyle *paint;
+    RsvgTextStyle *text;
 
-    cairo_antialias_t text_rendering_type;
-    gboolean has_text_rendering_type;
+    guint overflow : 1;
+    guint visible : 1;
+    guint cond_true : 1;
+
+    guint in_arena : 1;         /* the memory of a node's state belongs to the handle */
+
+    guint has_overflow : 1;
+    guint has_visible : 1;
+    guint has_cond : 1;
 
-    GHashTable *styles;
+    /* Bits indexed by RsvgAttribute, for the properties that were set on
+     * this element, and for those that were set with !important */
+    guint64 specified;
+    guint64 important;
 };
 
 G_GNUC_INTERNAL
 RsvgState *rsvg_state_new (void);
+G_GNUC_INTERNAL
+RsvgState *rsvg_state_new_in_arena (RsvgArena *arena);
+
+G_GNUC_INTERNAL
+GHashTable *rsvg_text_style_table_new (void);
+G_GNUC_INTERNAL
+void rsvg_state_share_text_style (RsvgState *state, GHashTable *text_styles);
+G_GNUC_INTERNAL
+GHashTable *rsvg_paint_style_table_new (void);
+G_GNUC_INTERNAL
+void rsvg_state_share_paint_style (RsvgState *state, GHashTable *paint_styles);
 
 G_GNUC_INTERNAL
 void rsvg_state_free (RsvgState *state);
@@ -198,9 +243,13 @@ G_GNUC_INTERNAL
 void rsvg_state_inherit     (RsvgState * dst, const RsvgState * src);
 G_GNUC_INTERNAL
 void rsvg_state_reinherit   (RsvgState * dst, const RsvgState * src);
+G_GNUC_INTERNAL
+gboolean rsvg_state_inherits_equal (const RsvgState * a, const RsvgState * b);
 
 G_GNUC_INTERNAL
 void rsvg_state_free_all    (RsvgState * state);
+G_GNUC_INTERNAL
+void rsvg_state_free_stack  (RsvgDrawingCtx * ctx);
 
 G_GNUC_INTERNAL
 void rsvg_parse_style_pairs (RsvgState * state, RsvgPropertyBag * atts);
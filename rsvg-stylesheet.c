@@ -0,0 +1,1249 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-stylesheet.c: Index of the CSS rules of a document
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rsvg-stylesheet.h"
+
+/* The rules of a style sheet are compiled into blocks of declarations,
+ * keyed by the kind of selector and by the atoms of the element name,
+ * class and id that it names.  Matching an element is then a handful of
+ * lookups with integer keys, and doesn't build any selector strings.
+ *
+ * Simple selectors must have one of the forms below.  Selectors with
+ * descendant or child combinators are indexed by their rightmost simple
+ * selector, which must have one of these forms as well; the rest of the
+ * selector is checked against the element's ancestors.
+ */
+typedef enum {
+    SELECTOR_UNIVERSAL,         /* * */
+    SELECTOR_TAG,               /* tag */
+    SELECTOR_TAG_CLASS_ID,      /* tag.class#id */
+    SELECTOR_CLASS_ID,          /* .class#id */
+    SELECTOR_TAG_CLASS,         /* tag.class */
+    SELECTOR_CLASS,             /* .class */
+    SELECTOR_ID,                /* #id */
+    SELECTOR_TAG_ID             /* tag#id */
+} SelectorKind;
+
+typedef struct {
+    SelectorKind kind;
+    guint tag;
+    guint klass;
+    guint id;
+} SelectorKey;
+
+typedef struct {
+    RsvgAttribute attr;
+    char *value;
+    gboolean important;
+} Declaration;
+
+/* One of the simple selectors to the left of a combinator */
+typedef struct {
+    gboolean is_child;          /* relation to the selector on its right: '>' or ' ' */
+    char *tag;                  /* NULL for any element */
+    char *id;                   /* NULL for any id */
+    char **classes;             /* NULL-terminated */
+} CompoundSelector;
+
+typedef struct {
+    char *text;                 /* for merging the declarations of equal selectors */
+    CompoundSelector *ancestors; /* nearest first */
+    guint n_ancestors;
+    guint32 *hashes;            /* names that the ancestors must have, for the bloom filter */
+    guint n_hashes;
+    guint specificity;
+    guint order;
+    GArray *declarations;
+} ComplexRule;
+
+struct _RsvgStylesheet {
+    volatile gint ref_count;
+
+    GPtrArray *imports;         /* hrefs of the @import rules, in order */
+
+    GHashTable *atoms;          /* element, class and id names -> atom, starting at 1 */
+    GHashTable *blocks;         /* SelectorKey -> GArray of Declaration, in declaration order */
+
+    GPtrArray *complex_rules;   /* ComplexRule, in source order */
+    GHashTable *complex_by_text; /* selector text -> ComplexRule */
+    GHashTable *complex_index;  /* SelectorKey of the rightmost simple selector -> GPtrArray of ComplexRule */
+};
+
+/* Ancestors of the element being matched, with a counting bloom filter
+ * of their names (as in WebKit's SelectorFilter), so that most rules
+ * with combinators can be rejected without walking up the tree.
+ */
+#define BLOOM_KEY_BITS 12
+#define BLOOM_SIZE (1 << BLOOM_KEY_BITS)
+#define BLOOM_KEY_MASK (BLOOM_SIZE - 1)
+
+typedef struct {
+    const char *tag;
+    char *klazz;
+    char *id;
+} Ancestor;
+
+struct _RsvgStyleAncestors {
+    GArray *stack;              /* Ancestor; the parent is last */
+    guint8 counts[BLOOM_SIZE];
+};
+
+static guint
+selector_key_hash (gconstpointer p)
+{
+    const SelectorKey *key = p;
+
+    return ((key->kind * 31 + key->tag) * 31 + key->klass) * 31 + key->id;
+}
+
+static gboolean
+selector_key_equal (gconstpointer a, gconstpointer b)
+{
+    const SelectorKey *ka = a;
+    const SelectorKey *kb = b;
+
+    return (ka->kind == kb->kind
+            && ka->tag == kb->tag
+            && ka->klass == kb->klass
+            && ka->id == kb->id);
+}
+
+static void
+declaration_clear (gpointer p)
+{
+    Declaration *decl = p;
+
+    g_free (decl->value);
+}
+
+static GArray *
+declarations_new (void)
+{
+    GArray *decls;
+
+    decls = g_array_new (FALSE, FALSE, sizeof (Declaration));
+    g_array_set_clear_func (decls, declaration_clear);
+
+    return decls;
+}
+
+static void
+complex_rule_free (ComplexRule *rule)
+{
+    guint i;
+
+    for (i = 0; i < rule->n_ancestors; i++) {
+        g_free (rule->ancestors[i].tag);
+        g_free (rule->ancestors[i].id);
+        g_strfreev (rule->ancestors[i].classes);
+    }
+
+    g_free (rule->text);
+    g_free (rule->ancestors);
+    g_free (rule->hashes);
+    g_array_unref (rule->declarations);
+    g_free (rule);
+}
+
+static guint32
+name_hash (char kind, const char *name, gsize len)
+{
+    guint32 h = 5381;
+    gsize i;
+
+    h = h * 33 + (guchar) kind;
+    for (i = 0; i < len; i++)
+        h = h * 33 + (guchar) name[i];
+
+    return h;
+}
+
+RsvgStylesheet *
+rsvg_stylesheet_new (void)
+{
+    RsvgStylesheet *sheet;
+
+    sheet = g_new (RsvgStylesheet, 1);
+    sheet->ref_count = 1;
+    sheet->imports = g_ptr_array_new_with_free_func (g_free);
+    sheet->atoms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    sheet->blocks = g_hash_table_new_full (selector_key_hash, selector_key_equal,
+                                           g_free, (GDestroyNotify) g_array_unref);
+
+    sheet->complex_rules = g_ptr_array_new_with_free_func ((GDestroyNotify) complex_rule_free);
+    sheet->complex_by_text = g_hash_table_new (g_str_hash, g_str_equal);
+    sheet->complex_index = g_hash_table_new_full (selector_key_hash, selector_key_equal,
+                                                  g_free, (GDestroyNotify) g_ptr_array_unref);
+
+    return sheet;
+}
+
+RsvgStylesheet *
+rsvg_stylesheet_ref (RsvgStylesheet *sheet)
+{
+    g_atomic_int_inc (&sheet->ref_count);
+    return sheet;
+}
+
+void
+rsvg_stylesheet_unref (RsvgStylesheet *sheet)
+{
+    if (!g_atomic_int_dec_and_test (&sheet->ref_count))
+        return;
+
+    g_ptr_array_unref (sheet->imports);
+    g_hash_table_destroy (sheet->atoms);
+    g_hash_table_destroy (sheet->blocks);
+    g_hash_table_destroy (sheet->complex_index);
+    g_hash_table_destroy (sheet->complex_by_text);
+    g_ptr_array_unref (sheet->complex_rules);
+    g_free (sheet);
+}
+
+void
+rsvg_stylesheet_add_import (RsvgStylesheet *sheet, const char *href)
+{
+    g_ptr_array_add (sheet->imports, g_strdup (href));
+}
+
+guint
+rsvg_stylesheet_get_n_imports (RsvgStylesheet *sheet)
+{
+    return sheet->imports->len;
+}
+
+const char *
+rsvg_stylesheet_get_import (RsvgStylesheet *sheet, guint i)
+{
+    g_return_val_if_fail (i < sheet->imports->len, NULL);
+
+    return g_ptr_array_index (sheet->imports, i);
+}
+
+/* Compiled style sheets are immutable, so they are shared by all the
+ * handles in the process: icon themes embed the same <style> in every
+ * icon, and @import the same files.  The least recently used ones are
+ * dropped when there are too many.
+ */
+#define STYLESHEET_CACHE_MAX_ENTRIES 256
+
+typedef struct {
+    char *key;
+    RsvgStylesheet *sheet;
+    GList *link;                /* in stylesheet_cache_lru */
+} StylesheetCacheEntry;
+
+G_LOCK_DEFINE_STATIC (stylesheet_cache);
+static GHashTable *stylesheet_cache;
+static GQueue stylesheet_cache_lru = G_QUEUE_INIT; /* most recently used first */
+
+static void
+stylesheet_cache_entry_free (StylesheetCacheEntry *entry)
+{
+    g_free (entry->key);
+    rsvg_stylesheet_unref (entry->sheet);
+    g_free (entry);
+}
+
+RsvgStylesheet *
+rsvg_stylesheet_cache_lookup (const char *key)
+{
+    StylesheetCacheEntry *entry;
+    RsvgStylesheet *sheet = NULL;
+
+    G_LOCK (stylesheet_cache);
+
+    if (stylesheet_cache && (entry = g_hash_table_lookup (stylesheet_cache, key)) != NULL) {
+        g_queue_unlink (&stylesheet_cache_lru, entry->link);
+        g_queue_push_head_link (&stylesheet_cache_lru, entry->link);
+
+        sheet = rsvg_stylesheet_ref (entry->sheet);
+    }
+
+    G_UNLOCK (stylesheet_cache);
+
+    return sheet;
+}
+
+void
+rsvg_stylesheet_cache_insert (const char *key, RsvgStylesheet *sheet)
+{
+    StylesheetCacheEntry *entry;
+
+    G_LOCK (stylesheet_cache);
+
+    if (stylesheet_cache == NULL)
+        stylesheet_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                                  (GDestroyNotify) stylesheet_cache_entry_free);
+
+    /* Another thread may have compiled the same style sheet in the meantime */
+    if (g_hash_table_lookup (stylesheet_cache, key) == NULL) {
+        entry = g_new (StylesheetCacheEntry, 1);
+        entry->key = g_strdup (key);
+        entry->sheet = rsvg_stylesheet_ref (sheet);
+
+        g_queue_push_head (&stylesheet_cache_lru, entry);
+        entry->link = stylesheet_cache_lru.head;
+        g_hash_table_insert (stylesheet_cache, entry->key, entry);
+
+        while (g_hash_table_size (stylesheet_cache) > STYLESHEET_CACHE_MAX_ENTRIES) {
+            StylesheetCacheEntry *oldest = g_queue_pop_tail (&stylesheet_cache_lru);
+
+            g_hash_table_remove (stylesheet_cache, oldest->key);
+        }
+    }
+
+    G_UNLOCK (stylesheet_cache);
+}
+
+/* Drops all the cached style sheets; called from rsvg_cleanup() */
+void
+rsvg_stylesheet_cache_clear (void)
+{
+    G_LOCK (stylesheet_cache);
+
+    if (stylesheet_cache) {
+        g_hash_table_destroy (stylesheet_cache);
+        stylesheet_cache = NULL;
+    }
+
+    g_queue_clear (&stylesheet_cache_lru);
+
+    G_UNLOCK (stylesheet_cache);
+}
+
+static guint
+intern_atom (RsvgStylesheet *sheet, const char *name)
+{
+    guint atom;
+
+    atom = GPOINTER_TO_UINT (g_hash_table_lookup (sheet->atoms, name));
+    if (atom == 0) {
+        atom = g_hash_table_size (sheet->atoms) + 1;
+        g_hash_table_insert (sheet->atoms, g_strdup (name), GUINT_TO_POINTER (atom));
+    }
+
+    return atom;
+}
+
+/* Returns 0 if no rule mentions @name */
+static guint
+lookup_atom (RsvgStylesheet *sheet, const char *name)
+{
+    return GPOINTER_TO_UINT (g_hash_table_lookup (sheet->atoms, name));
+}
+
+static guint
+lookup_atom_len (RsvgStylesheet *sheet, const char *name, gsize len)
+{
+    char buf[128];
+    char *str;
+    guint atom;
+
+    if (len < sizeof (buf)) {
+        memcpy (buf, name, len);
+        buf[len] = '\0';
+        return lookup_atom (sheet, buf);
+    }
+
+    str = g_strndup (name, len);
+    atom = lookup_atom (sheet, str);
+    g_free (str);
+
+    return atom;
+}
+
+static gboolean
+compile_selector (RsvgStylesheet *sheet, CRSimpleSel *selector, SelectorKey *key)
+{
+    CRAdditionalSel *add_sel;
+
+    key->tag = 0;
+    key->klass = 0;
+    key->id = 0;
+
+    if ((selector->type_mask & TYPE_SELECTOR) && selector->name != NULL)
+        key->tag = intern_atom (sheet, cr_string_peek_raw_str (selector->name));
+
+    for (add_sel = selector->add_sel; add_sel != NULL; add_sel = add_sel->next) {
+        switch (add_sel->type) {
+        case CLASS_ADD_SELECTOR:
+            if (key->klass != 0 || add_sel->content.class_name == NULL)
+                return FALSE;
+
+            key->klass = intern_atom (sheet, cr_string_peek_raw_str (add_sel->content.class_name));
+            break;
+
+        case ID_ADD_SELECTOR:
+            if (key->id != 0 || add_sel->content.id_name == NULL)
+                return FALSE;
+
+            key->id = intern_atom (sheet, cr_string_peek_raw_str (add_sel->content.id_name));
+            break;
+
+        default:
+            return FALSE;
+        }
+    }
+
+    if (key->klass != 0) {
+        if (key->id != 0)
+            key->kind = key->tag ? SELECTOR_TAG_CLASS_ID : SELECTOR_CLASS_ID;
+        else
+            key->kind = key->tag ? SELECTOR_TAG_CLASS : SELECTOR_CLASS;
+    } else if (key->id != 0) {
+        key->kind = key->tag ? SELECTOR_TAG_ID : SELECTOR_ID;
+    } else if (key->tag != 0) {
+        key->kind = SELECTOR_TAG;
+    } else if (selector->type_mask & UNIVERSAL_SELECTOR) {
+        key->kind = SELECTOR_UNIVERSAL;
+    } else {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+add_to_declarations (GArray *decls, RsvgAttribute attr, const char *value, gboolean important)
+{
+    Declaration decl;
+    guint i;
+
+    /* A later declaration of a property replaces an earlier one, unless
+     * the earlier one is !important */
+    for (i = 0; i < decls->len; i++) {
+        Declaration *old = &g_array_index (decls, Declaration, i);
+
+        if (old->attr == attr) {
+            if (!old->important) {
+                g_free (old->value);
+                old->value = g_strdup (value);
+                old->important = important;
+            }
+
+            return;
+        }
+    }
+
+    decl.attr = attr;
+    decl.value = g_strdup (value);
+    decl.important = important;
+    g_array_append_val (decls, decl);
+}
+
+static guint
+key_specificity (const SelectorKey *key)
+{
+    return (key->id ? 10000 : 0) + (key->klass ? 100 : 0) + (key->tag ? 1 : 0);
+}
+
+static gboolean
+compile_compound (CRSimpleSel *selector, CompoundSelector *compound, guint *specificity)
+{
+    CRAdditionalSel *add_sel;
+    GPtrArray *classes;
+
+    /* selector->next is the simple selector on the right */
+    switch (selector->next->combinator) {
+    case COMB_WS:
+        compound->is_child = FALSE;
+        break;
+
+    case COMB_GT:
+        compound->is_child = TRUE;
+        break;
+
+    default:
+        /* sibling combinators are not supported */
+        return FALSE;
+    }
+
+    compound->tag = NULL;
+    compound->id = NULL;
+    compound->classes = NULL;
+
+    classes = g_ptr_array_new ();
+
+    if ((selector->type_mask & TYPE_SELECTOR) && selector->name != NULL) {
+        compound->tag = g_strdup (cr_string_peek_raw_str (selector->name));
+        *specificity += 1;
+    }
+
+    for (add_sel = selector->add_sel; add_sel != NULL; add_sel = add_sel->next) {
+        if (add_sel->type == CLASS_ADD_SELECTOR && add_sel->content.class_name != NULL) {
+            g_ptr_array_add (classes, g_strdup (cr_string_peek_raw_str (add_sel->content.class_name)));
+            *specificity += 100;
+        } else if (add_sel->type == ID_ADD_SELECTOR && add_sel->content.id_name != NULL
+                   && compound->id == NULL) {
+            compound->id = g_strdup (cr_string_peek_raw_str (add_sel->content.id_name));
+            *specificity += 10000;
+        } else {
+            break;
+        }
+    }
+
+    g_ptr_array_add (classes, NULL);
+    compound->classes = (char **) g_ptr_array_free (classes, FALSE);
+
+    if (add_sel != NULL) {
+        g_free (compound->tag);
+        g_free (compound->id);
+        g_strfreev (compound->classes);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+add_compound_hashes (GArray *hashes, const CompoundSelector *compound)
+{
+    guint32 h;
+    guint i;
+
+    if (compound->tag) {
+        h = name_hash ('t', compound->tag, strlen (compound->tag));
+        g_array_append_val (hashes, h);
+    }
+
+    if (compound->id) {
+        h = name_hash ('#', compound->id, strlen (compound->id));
+        g_array_append_val (hashes, h);
+    }
+
+    for (i = 0; compound->classes[i]; i++) {
+        h = name_hash ('.', compound->classes[i], strlen (compound->classes[i]));
+        g_array_append_val (hashes, h);
+    }
+}
+
+static ComplexRule *
+compile_complex_rule (RsvgStylesheet *sheet, CRSimpleSel *subject, const SelectorKey *key)
+{
+    ComplexRule *rule;
+    GArray *compounds;
+    GArray *hashes;
+    CRSimpleSel *sel;
+    guint specificity;
+    gboolean ok = TRUE;
+
+    compounds = g_array_new (FALSE, FALSE, sizeof (CompoundSelector));
+    hashes = g_array_new (FALSE, FALSE, sizeof (guint32));
+    specificity = key_specificity (key);
+
+    for (sel = subject->prev; sel != NULL; sel = sel->prev) {
+        CompoundSelector compound;
+
+        if (!compile_compound (sel, &compound, &specificity)) {
+            ok = FALSE;
+            break;
+        }
+
+        g_array_append_val (compounds, compound);
+        add_compound_hashes (hashes, &compound);
+    }
+
+    if (!ok) {
+        guint i;
+
+        for (i = 0; i < compounds->len; i++) {
+            CompoundSelector *compound = &g_array_index (compounds, CompoundSelector, i);
+
+            g_free (compound->tag);
+            g_free (compound->id);
+            g_strfreev (compound->classes);
+        }
+
+        g_array_free (compounds, TRUE);
+        g_array_free (hashes, TRUE);
+        return NULL;
+    }
+
+    rule = g_new0 (ComplexRule, 1);
+    rule->n_ancestors = compounds->len;
+    rule->ancestors = (CompoundSelector *) g_array_free (compounds, FALSE);
+    rule->n_hashes = hashes->len;
+    rule->hashes = (guint32 *) g_array_free (hashes, FALSE);
+    rule->specificity = specificity;
+    rule->order = sheet->complex_rules->len;
+    rule->declarations = declarations_new ();
+
+    return rule;
+}
+
+static gboolean
+add_complex_declaration (RsvgStylesheet *sheet,
+                         CRSimpleSel    *first,
+                         RsvgAttribute   attr,
+                         const char     *value,
+                         gboolean        important)
+{
+    CRSimpleSel *subject;
+    SelectorKey key;
+    ComplexRule *rule;
+    char *text;
+
+    text = (char *) cr_simple_sel_to_string (first);
+    if (text == NULL)
+        return FALSE;
+
+    rule = g_hash_table_lookup (sheet->complex_by_text, text);
+    if (rule == NULL) {
+        GPtrArray *rules;
+
+        for (subject = first; subject->next != NULL; subject = subject->next)
+            ;
+
+        if (!compile_selector (sheet, subject, &key)) {
+            g_free (text);
+            return FALSE;
+        }
+
+        rule = compile_complex_rule (sheet, subject, &key);
+        if (rule == NULL) {
+            g_free (text);
+            return FALSE;
+        }
+
+        rule->text = text;
+        text = NULL;
+
+        g_ptr_array_add (sheet->complex_rules, rule);
+        g_hash_table_insert (sheet->complex_by_text, rule->text, rule);
+
+        rules = g_hash_table_lookup (sheet->complex_index, &key);
+        if (rules == NULL) {
+            rules = g_ptr_array_new ();
+            g_hash_table_insert (sheet->complex_index, g_memdup (&key, sizeof (key)), rules);
+        }
+
+        g_ptr_array_add (rules, rule);
+    }
+
+    g_free (text);
+
+    add_to_declarations (rule->declarations, attr, value, important);
+
+    return TRUE;
+}
+
+gboolean
+rsvg_stylesheet_add_declaration (RsvgStylesheet *sheet,
+                                 CRSimpleSel    *selector,
+                                 RsvgAttribute   attr,
+                                 const char     *value,
+                                 gboolean        important)
+{
+    SelectorKey key;
+    GArray *decls;
+
+    if (selector->next != NULL)
+        return add_complex_declaration (sheet, selector, attr, value, important);
+
+    if (!compile_selector (sheet, selector, &key))
+        return FALSE;
+
+    decls = g_hash_table_lookup (sheet->blocks, &key);
+    if (decls == NULL) {
+        decls = declarations_new ();
+        g_hash_table_insert (sheet->blocks, g_memdup (&key, sizeof (key)), decls);
+    }
+
+    add_to_declarations (decls, attr, value, important);
+
+    return TRUE;
+}
+
+static void
+apply_declarations (GArray *decls, RsvgStylesheetFunc func, gpointer user_data)
+{
+    guint i;
+
+    for (i = 0; i < decls->len; i++) {
+        Declaration *decl = &g_array_index (decls, Declaration, i);
+
+        func (decl->attr, decl->value, decl->important, user_data);
+    }
+}
+
+static gboolean
+apply_block (RsvgStylesheet    *sheet,
+             SelectorKind       kind,
+             guint              tag,
+             guint              klass,
+             guint              id,
+             RsvgStylesheetFunc func,
+             gpointer           user_data)
+{
+    SelectorKey key;
+    GArray *decls;
+
+    key.kind = kind;
+    key.tag = tag;
+    key.klass = klass;
+    key.id = id;
+
+    decls = g_hash_table_lookup (sheet->blocks, &key);
+    if (decls == NULL)
+        return FALSE;
+
+    apply_declarations (decls, func, user_data);
+
+    return TRUE;
+}
+
+RsvgStyleAncestors *
+rsvg_style_ancestors_new (void)
+{
+    RsvgStyleAncestors *ancestors;
+
+    ancestors = g_new0 (RsvgStyleAncestors, 1);
+    ancestors->stack = g_array_new (FALSE, FALSE, sizeof (Ancestor));
+
+    return ancestors;
+}
+
+void
+rsvg_style_ancestors_free (RsvgStyleAncestors *ancestors)
+{
+    rsvg_style_ancestors_clear (ancestors);
+    g_array_free (ancestors->stack, TRUE);
+    g_free (ancestors);
+}
+
+static void
+bloom_add (RsvgStyleAncestors *ancestors, guint32 hash)
+{
+    guint8 *a = &ancestors->counts[hash & BLOOM_KEY_MASK];
+    guint8 *b = &ancestors->counts[(hash >> BLOOM_KEY_BITS) & BLOOM_KEY_MASK];
+
+    /* Saturated counters stay so forever */
+    if (*a < G_MAXUINT8)
+        (*a)++;
+    if (*b < G_MAXUINT8)
+        (*b)++;
+}
+
+static void
+bloom_remove (RsvgStyleAncestors *ancestors, guint32 hash)
+{
+    guint8 *a = &ancestors->counts[hash & BLOOM_KEY_MASK];
+    guint8 *b = &ancestors->counts[(hash >> BLOOM_KEY_BITS) & BLOOM_KEY_MASK];
+
+    if (*a < G_MAXUINT8)
+        (*a)--;
+    if (*b < G_MAXUINT8)
+        (*b)--;
+}
+
+static gboolean
+bloom_may_contain (const RsvgStyleAncestors *ancestors, guint32 hash)
+{
+    return (ancestors->counts[hash & BLOOM_KEY_MASK] != 0
+            && ancestors->counts[(hash >> BLOOM_KEY_BITS) & BLOOM_KEY_MASK] != 0);
+}
+
+static void
+update_bloom (RsvgStyleAncestors *ancestors,
+              const Ancestor *ancestor,
+              void (* update) (RsvgStyleAncestors *ancestors, guint32 hash))
+{
+    if (ancestor->tag)
+        update (ancestors, name_hash ('t', ancestor->tag, strlen (ancestor->tag)));
+
+    if (ancestor->id)
+        update (ancestors, name_hash ('#', ancestor->id, strlen (ancestor->id)));
+
+    if (ancestor->klazz) {
+        const char *p = ancestor->klazz;
+
+        while (*p) {
+            const char *start;
+
+            while (*p && g_ascii_isspace (*p))
+                p++;
+
+            start = p;
+            while (*p && !g_ascii_isspace (*p))
+                p++;
+
+            if (p > start)
+                update (ancestors, name_hash ('.', start, p - start));
+        }
+    }
+}
+
+void
+rsvg_style_ancestors_push (RsvgStyleAncestors *ancestors,
+                           const char         *tag,
+                           const char         *klazz,
+                           const char         *id)
+{
+    Ancestor ancestor;
+
+    ancestor.tag = tag;
+    ancestor.klazz = g_strdup (klazz);
+    ancestor.id = g_strdup (id);
+
+    g_array_append_val (ancestors->stack, ancestor);
+    update_bloom (ancestors, &ancestor, bloom_add);
+}
+
+void
+rsvg_style_ancestors_pop (RsvgStyleAncestors *ancestors)
+{
+    Ancestor *ancestor;
+
+    g_return_if_fail (ancestors->stack->len > 0);
+
+    ancestor = &g_array_index (ancestors->stack, Ancestor, ancestors->stack->len - 1);
+    update_bloom (ancestors, ancestor, bloom_remove);
+
+    g_free (ancestor->klazz);
+    g_free (ancestor->id);
+    g_array_set_size (ancestors->stack, ancestors->stack->len - 1);
+}
+
+void
+rsvg_style_ancestors_clear (RsvgStyleAncestors *ancestors)
+{
+    while (ancestors->stack->len > 0)
+        rsvg_style_ancestors_pop (ancestors);
+
+    memset (ancestors->counts, 0, sizeof (ancestors->counts));
+}
+
+static gboolean
+class_list_contains (const char *klazz, const char *name)
+{
+    gsize len = strlen (name);
+    const char *p = klazz;
+
+    while (*p) {
+        const char *start;
+
+        while (*p && g_ascii_isspace (*p))
+            p++;
+
+        start = p;
+        while (*p && !g_ascii_isspace (*p))
+            p++;
+
+        if ((gsize) (p - start) == len && strncmp (start, name, len) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+compound_matches (const CompoundSelector *compound, const Ancestor *ancestor)
+{
+    guint i;
+
+    if (compound->tag && (ancestor->tag == NULL || strcmp (compound->tag, ancestor->tag) != 0))
+        return FALSE;
+
+    if (compound->id && (ancestor->id == NULL || strcmp (compound->id, ancestor->id) != 0))
+        return FALSE;
+
+    for (i = 0; compound->classes[i]; i++) {
+        if (ancestor->klazz == NULL || !class_list_contains (ancestor->klazz, compound->classes[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Matches rule->ancestors[i] and the ones after it, given that the
+ * selector to its right matched the element at @index in the stack
+ * (or the element itself if @index is the length of the stack).
+ */
+static gboolean
+ancestors_match (const ComplexRule *rule, guint i, const GArray *stack, guint index)
+{
+    const CompoundSelector *compound;
+
+    if (i == rule->n_ancestors)
+        return TRUE;
+
+    compound = &rule->ancestors[i];
+
+    while (index > 0) {
+        index--;
+
+        if (compound_matches (compound, &g_array_index (stack, Ancestor, index))
+            && ancestors_match (rule, i + 1, stack, index))
+            return TRUE;
+
+        if (compound->is_child)
+            break;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+complex_rule_matches (const ComplexRule *rule, const RsvgStyleAncestors *ancestors)
+{
+    guint i;
+
+    for (i = 0; i < rule->n_hashes; i++) {
+        if (!bloom_may_contain (ancestors, rule->hashes[i]))
+            return FALSE;
+    }
+
+    return ancestors_match (rule, 0, ancestors->stack, ancestors->stack->len);
+}
+
+#define N_INLINE_MATCHES 16
+
+typedef struct {
+    const ComplexRule *rule;
+    guint sheet_index;
+} MatchedRule;
+
+typedef struct {
+    MatchedRule inline_rules[N_INLINE_MATCHES];
+    MatchedRule *rules;
+    guint n_rules;
+    guint n_allocated;
+} MatchedRules;
+
+static void
+matched_rules_add (MatchedRules *matched, const ComplexRule *rule, guint sheet_index)
+{
+    guint i;
+
+    for (i = 0; i < matched->n_rules; i++) {
+        if (matched->rules[i].rule == rule)
+            return;
+    }
+
+    if (matched->n_rules == matched->n_allocated) {
+        matched->n_allocated *= 2;
+
+        if (matched->rules == matched->inline_rules) {
+            matched->rules = g_new (MatchedRule, matched->n_allocated);
+            memcpy (matched->rules, matched->inline_rules, sizeof (matched->inline_rules));
+        } else {
+            matched->rules = g_renew (MatchedRule, matched->rules, matched->n_allocated);
+        }
+    }
+
+    matched->rules[matched->n_rules].rule = rule;
+    matched->rules[matched->n_rules].sheet_index = sheet_index;
+    matched->n_rules++;
+}
+
+/* Atoms of the element being matched, in one of the style sheets */
+typedef struct {
+    RsvgStylesheet *sheet;
+    guint index;
+    guint tag;
+    guint klass;
+    guint id;
+} SheetAtoms;
+
+static void
+collect_complex_rules (const SheetAtoms         *atoms,
+                       const RsvgStyleAncestors *ancestors,
+                       SelectorKind              kind,
+                       guint                     tag,
+                       guint                     klass,
+                       guint                     id,
+                       MatchedRules             *matched)
+{
+    SelectorKey key;
+    GPtrArray *rules;
+    guint i;
+
+    key.kind = kind;
+    key.tag = tag;
+    key.klass = klass;
+    key.id = id;
+
+    rules = g_hash_table_lookup (atoms->sheet->complex_index, &key);
+    if (rules == NULL)
+        return;
+
+    for (i = 0; i < rules->len; i++) {
+        const ComplexRule *rule = g_ptr_array_index (rules, i);
+
+        if (complex_rule_matches (rule, ancestors))
+            matched_rules_add (matched, rule, atoms->index);
+    }
+}
+
+static int
+compare_rules (gconstpointer a, gconstpointer b)
+{
+    const MatchedRule *ma = a;
+    const MatchedRule *mb = b;
+
+    if (ma->rule->specificity != mb->rule->specificity)
+        return ma->rule->specificity < mb->rule->specificity ? -1 : 1;
+
+    if (ma->sheet_index != mb->sheet_index)
+        return ma->sheet_index < mb->sheet_index ? -1 : 1;
+
+    return ma->rule->order < mb->rule->order ? -1 : (ma->rule->order > mb->rule->order ? 1 : 0);
+}
+
+/* Applies the matched rules whose specificity is in [min, max) */
+static void
+apply_complex_rules (MatchedRules       *matched,
+                     guint               min_specificity,
+                     guint               max_specificity,
+                     RsvgStylesheetFunc  func,
+                     gpointer            user_data)
+{
+    guint i;
+
+    if (matched->n_rules > 1)
+        qsort (matched->rules, matched->n_rules, sizeof (MatchedRule), compare_rules);
+
+    for (i = 0; i < matched->n_rules; i++) {
+        const ComplexRule *rule = matched->rules[i].rule;
+
+        if (rule->specificity >= min_specificity && rule->specificity < max_specificity)
+            apply_declarations (rule->declarations, func, user_data);
+    }
+}
+
+#define N_INLINE_SHEETS 4
+
+/* Try to properly support all of the following, including inheritance:
+ * *
+ * #id
+ * tag
+ * tag#id
+ * tag.class
+ * tag.class#id
+ *
+ * This is basically a semi-compliant CSS2 selection engine.
+ *
+ * Each step is done for all the style sheets in order, so that the
+ * result is the same as if they were a single one.  Rules with
+ * combinators go in by specificity, right after the steps that are
+ * no more specific than them, so "g rect" beats "rect" but not ".class".
+ * Those with ids go after everything else.
+ */
+void
+rsvg_stylesheets_apply (RsvgStylesheet * const  *sheets,
+                        guint                    n_sheets,
+                        const RsvgStyleAncestors *ancestors,
+                        const char               *tag,
+                        const char               *klazz,
+                        const char               *id,
+                        RsvgStylesheetFunc        func,
+                        gpointer                  user_data)
+{
+    SheetAtoms inline_atoms[N_INLINE_SHEETS];
+    SheetAtoms *atoms;
+    guint n, i;
+    gboolean has_complex_rules = FALSE;
+    MatchedRules matched;
+
+    if (n_sheets == 0)
+        return;
+
+    atoms = n_sheets <= N_INLINE_SHEETS ? inline_atoms : g_new (SheetAtoms, n_sheets);
+
+    n = 0;
+    for (i = 0; i < n_sheets; i++) {
+        RsvgStylesheet *sheet = sheets[i];
+
+        if (g_hash_table_size (sheet->blocks) == 0 && sheet->complex_rules->len == 0)
+            continue;
+
+        atoms[n].sheet = sheet;
+        atoms[n].index = i;
+        atoms[n].tag = tag ? lookup_atom (sheet, tag) : 0;
+        atoms[n].klass = 0;
+        atoms[n].id = id ? lookup_atom (sheet, id) : 0;
+        n++;
+
+        if (sheet->complex_rules->len > 0)
+            has_complex_rules = TRUE;
+    }
+
+    if (n == 0)
+        goto out;
+
+    if (!has_complex_rules || ancestors == NULL || ancestors->stack->len == 0)
+        ancestors = NULL;
+
+    matched.rules = matched.inline_rules;
+    matched.n_rules = 0;
+    matched.n_allocated = N_INLINE_MATCHES;
+
+    /* * */
+    for (i = 0; i < n; i++) {
+        apply_block (atoms[i].sheet, SELECTOR_UNIVERSAL, 0, 0, 0, func, user_data);
+        if (ancestors)
+            collect_complex_rules (&atoms[i], ancestors, SELECTOR_UNIVERSAL, 0, 0, 0, &matched);
+    }
+
+    /* Rules without names or classes, like "* *", can only have matched
+     * by now; the same goes for the tag-only ones after the next step.
+     */
+    apply_complex_rules (&matched, 0, 1, func, user_data);
+
+    /* tag */
+    for (i = 0; i < n; i++) {
+        if (atoms[i].tag == 0)
+            continue;
+
+        apply_block (atoms[i].sheet, SELECTOR_TAG, atoms[i].tag, 0, 0, func, user_data);
+        if (ancestors)
+            collect_complex_rules (&atoms[i], ancestors, SELECTOR_TAG, atoms[i].tag, 0, 0, &matched);
+    }
+
+    apply_complex_rules (&matched, 1, 100, func, user_data);
+
+    if (klazz != NULL) {
+        const char *p = klazz;
+
+        while (*p) {
+            const char *start;
+            gboolean found = FALSE, found_before;
+            gboolean any_class = FALSE;
+
+            while (*p && g_ascii_isspace (*p))
+                p++;
+
+            start = p;
+            while (*p && !g_ascii_isspace (*p))
+                p++;
+
+            if (p == start)
+                break;
+
+            for (i = 0; i < n; i++) {
+                atoms[i].klass = lookup_atom_len (atoms[i].sheet, start, p - start);
+                any_class = any_class || atoms[i].klass != 0;
+            }
+
+            if (!any_class)
+                continue;
+
+            /* Each step applies the blocks of all the style sheets, and
+             * is skipped if an earlier step matched in any of them.
+             */
+
+            /* tag.class#id */
+            for (i = 0; i < n; i++) {
+                if (atoms[i].tag && atoms[i].klass && atoms[i].id)
+                    found |= apply_block (atoms[i].sheet, SELECTOR_TAG_CLASS_ID,
+                                          atoms[i].tag, atoms[i].klass, atoms[i].id,
+                                          func, user_data);
+            }
+            found_before = found;
+
+            /* class#id */
+            for (i = 0; !found_before && i < n; i++) {
+                if (atoms[i].klass && atoms[i].id)
+                    found |= apply_block (atoms[i].sheet, SELECTOR_CLASS_ID,
+                                          0, atoms[i].klass, atoms[i].id,
+                                          func, user_data);
+            }
+            found_before = found;
+
+            /* tag.class */
+            for (i = 0; !found_before && i < n; i++) {
+                if (atoms[i].tag && atoms[i].klass)
+                    found |= apply_block (atoms[i].sheet, SELECTOR_TAG_CLASS,
+                                          atoms[i].tag, atoms[i].klass, 0,
+                                          func, user_data);
+            }
+            found_before = found;
+
+            /* didn't find anything more specific, just apply the class style */
+            for (i = 0; !found_before && i < n; i++) {
+                if (atoms[i].klass)
+                    apply_block (atoms[i].sheet, SELECTOR_CLASS, 0, atoms[i].klass, 0,
+                                 func, user_data);
+            }
+
+            for (i = 0; ancestors && i < n; i++) {
+                const SheetAtoms *a = &atoms[i];
+
+                if (a->klass == 0)
+                    continue;
+
+                collect_complex_rules (a, ancestors, SELECTOR_CLASS, 0, a->klass, 0, &matched);
+
+                if (a->tag)
+                    collect_complex_rules (a, ancestors, SELECTOR_TAG_CLASS, a->tag, a->klass, 0, &matched);
+
+                if (a->id)
+                    collect_complex_rules (a, ancestors, SELECTOR_CLASS_ID, 0, a->klass, a->id, &matched);
+
+                if (a->tag && a->id)
+                    collect_complex_rules (a, ancestors, SELECTOR_TAG_CLASS_ID,
+                                           a->tag, a->klass, a->id, &matched);
+            }
+        }
+    }
+
+    for (i = 0; ancestors && i < n; i++) {
+        const SheetAtoms *a = &atoms[i];
+
+        if (a->id == 0)
+            continue;
+
+        collect_complex_rules (a, ancestors, SELECTOR_ID, 0, 0, a->id, &matched);
+
+        if (a->tag)
+            collect_complex_rules (a, ancestors, SELECTOR_TAG_ID, a->tag, 0, a->id, &matched);
+    }
+
+    apply_complex_rules (&matched, 100, 10000, func, user_data);
+
+    /* #id */
+    for (i = 0; i < n; i++) {
+        if (atoms[i].id)
+            apply_block (atoms[i].sheet, SELECTOR_ID, 0, 0, atoms[i].id, func, user_data);
+    }
+
+    /* tag#id */
+    for (i = 0; i < n; i++) {
+        if (atoms[i].tag && atoms[i].id)
+            apply_block (atoms[i].sheet, SELECTOR_TAG_ID, atoms[i].tag, 0, atoms[i].id,
+                         func, user_data);
+    }
+
+    apply_complex_rules (&matched, 10000, G_MAXUINT, func, user_data);
+
+    if (matched.rules != matched.inline_rules)
+        g_free (matched.rules);
+
+  out:
+    if (atoms != inline_atoms)
+        g_free (atoms);
+}
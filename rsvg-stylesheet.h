@@ -0,0 +1,109 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set sw=4 sts=4 expandtab: */
+/*
+   rsvg-stylesheet.h: Index of the CSS rules of a document
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef RSVG_STYLESHEET_H
+#define RSVG_STYLESHEET_H
+
+#include <glib.h>
+#include <libcroco/libcroco.h>
+
+#include "rsvg-private.h"
+
+G_BEGIN_DECLS
+
+typedef struct _RsvgStylesheet RsvgStylesheet;
+typedef struct _RsvgStyleAncestors RsvgStyleAncestors;
+
+typedef void (*RsvgStylesheetFunc) (RsvgAttribute attr, const char *value, gboolean important, gpointer user_data);
+
+/* Style sheets are only modified while they are being compiled; after
+ * that they may be shared between handles and threads.
+ */
+G_GNUC_INTERNAL
+RsvgStylesheet *rsvg_stylesheet_new     (void);
+G_GNUC_INTERNAL
+RsvgStylesheet *rsvg_stylesheet_ref     (RsvgStylesheet *sheet);
+G_GNUC_INTERNAL
+void            rsvg_stylesheet_unref   (RsvgStylesheet *sheet);
+
+/* The @import rules are kept as they were written; they are resolved by
+ * each handle that uses the style sheet.
+ */
+G_GNUC_INTERNAL
+void            rsvg_stylesheet_add_import    (RsvgStylesheet *sheet, const char *href);
+G_GNUC_INTERNAL
+guint           rsvg_stylesheet_get_n_imports (RsvgStylesheet *sheet);
+G_GNUC_INTERNAL
+const char     *rsvg_stylesheet_get_import    (RsvgStylesheet *sheet, guint i);
+
+/* Process-wide cache of compiled style sheets */
+G_GNUC_INTERNAL
+RsvgStylesheet *rsvg_stylesheet_cache_lookup (const char *key);
+G_GNUC_INTERNAL
+void            rsvg_stylesheet_cache_insert (const char *key, RsvgStylesheet *sheet);
+G_GNUC_INTERNAL
+void            rsvg_stylesheet_cache_clear  (void);
+
+/* Returns FALSE if @selector is of a kind that is not supported; the
+ * declaration is ignored then.
+ */
+G_GNUC_INTERNAL
+gboolean        rsvg_stylesheet_add_declaration (RsvgStylesheet *sheet,
+                                                 CRSimpleSel    *selector,
+                                                 RsvgAttribute   attr,
+                                                 const char     *value,
+                                                 gboolean        important);
+
+/* Calls @func for each declaration of @sheets that applies to an element,
+ * in the order in which they must be applied.  @ancestors may be %NULL if
+ * the element has no ancestors.
+ */
+G_GNUC_INTERNAL
+void            rsvg_stylesheets_apply  (RsvgStylesheet * const   *sheets,
+                                         guint                     n_sheets,
+                                         const RsvgStyleAncestors *ancestors,
+                                         const char               *tag,
+                                         const char               *klazz,
+                                         const char               *id,
+                                         RsvgStylesheetFunc        func,
+                                         gpointer                  user_data);
+
+/* The elements that are open while parsing, for matching selectors with
+ * combinators.  The strings of @klazz and @id are copied; @tag must stay
+ * alive until the element is popped.
+ */
+G_GNUC_INTERNAL
+RsvgStyleAncestors *rsvg_style_ancestors_new   (void);
+G_GNUC_INTERNAL
+void                rsvg_style_ancestors_free  (RsvgStyleAncestors *ancestors);
+G_GNUC_INTERNAL
+void                rsvg_style_ancestors_push  (RsvgStyleAncestors *ancestors,
+                                                const char         *tag,
+                                                const char         *klazz,
+                                                const char         *id);
+G_GNUC_INTERNAL
+void                rsvg_style_ancestors_pop   (RsvgStyleAncestors *ancestors);
+G_GNUC_INTERNAL
+void                rsvg_style_ancestors_clear (RsvgStyleAncestors *ancestors);
+
+G_END_DECLS
+
+#endif /* RSVG_STYLESHEET_H */
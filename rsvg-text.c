@@ -51,42 +51,29 @@ struct _RsvgNodeTref {
     char *link;
 };
 
-char *
-rsvg_make_valid_utf8 (const char *str, int len)
+void
+rsvg_string_append_valid_utf8 (GString *string, const char *str, int len)
 {
-    GString *string;
-    const char *remainder, *invalid;
-    int remaining_bytes, valid_bytes;
-
-    string = NULL;
-    remainder = str;
+    const char *invalid;
+    gsize remaining_bytes, valid_bytes;
 
     if (len < 0)
         remaining_bytes = strlen (str);
     else
         remaining_bytes = len;
 
-    while (remaining_bytes != 0) {
-        if (g_utf8_validate (remainder, remaining_bytes, &invalid))
-            break;
-        valid_bytes = invalid - remainder;
-
-        if (string == NULL)
-            string = g_string_sized_new (remaining_bytes);
+    /* Invalid bytes are replaced with '?' as they are found */
+    while (!g_utf8_validate (str, remaining_bytes, &invalid)) {
+        valid_bytes = invalid - str;
 
-        g_string_append_len (string, remainder, valid_bytes);
+        g_string_append_len (string, str, valid_bytes);
         g_string_append_c (string, '?');
 
         remaining_bytes -= valid_bytes + 1;
-        remainder = invalid + 1;
+        str = invalid + 1;
     }
 
-    if (string == NULL)
-        return len < 0 ? g_strndup (str, len) : g_strdup (str);
-
-    g_string_append (string, remainder);
-
-    return g_string_free (string, FALSE);
+    g_string_append_len (string, str, remaining_bytes);
 }
 
 static GString *
@@ -96,7 +83,7 @@ _rsvg_text_chomp (RsvgState *state, GString * in, gboolean * lastwasspace)
     guint i;
     out = g_string_new (in->str);
 
-    if (!state->space_preserve) {
+    if (!state->text->space_preserve) {
         for (i = 0; i < out->len;) {
             if (out->str[i] == '\n')
                 g_string_erase (out, i, 1);
@@ -358,22 +345,22 @@ rsvg_node_text_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int dom
     dx = rsvg_length_normalize (&text->dx, ctx);
     dy = rsvg_length_normalize (&text->dy, ctx);
 
-    if (rsvg_current_state (ctx)->text_anchor != TEXT_ANCHOR_START) {
+    if (rsvg_current_state (ctx)->text->text_anchor != TEXT_ANCHOR_START) {
         _rsvg_node_text_length_children (node, ctx, &length, &lastwasspace, FALSE);
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
             length /= 2;
     }
-    if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text_gravity)) {
+    if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text->text_gravity)) {
         y -= length;
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
             dy /= 2;
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_END)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_END)
             dy = 0;
     } else {
         x -= length;
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
             dx /= 2;
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_END)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_END)
             dx = 0;
     }
     x += dx;
@@ -384,20 +371,20 @@ rsvg_node_text_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int dom
 }
 
 RsvgNode *
-rsvg_new_text (const char *element_name, RsvgNode *parent)
+rsvg_new_text (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeText *text;
 
-    text = g_new0 (RsvgNodeText, 1);
+    text = rsvg_arena_new0 (arena, RsvgNodeText);
     text->x = text->y = text->dx = text->dy = rsvg_length_parse ("0", LENGTH_DIR_BOTH);
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_TEXT,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 text,
                                 rsvg_node_text_set_atts,
                                 rsvg_node_text_draw,
-                                g_free);                                
+                                rsvg_arena_free_nothing);
 }
 
 static void
@@ -412,20 +399,20 @@ _rsvg_node_text_type_tspan (RsvgNode *node, RsvgNodeText *self, RsvgDrawingCtx *
     dx = rsvg_length_normalize (&self->dx, ctx);
     dy = rsvg_length_normalize (&self->dy, ctx);
 
-    if (rsvg_current_state (ctx)->text_anchor != TEXT_ANCHOR_START) {
+    if (rsvg_current_state (ctx)->text->text_anchor != TEXT_ANCHOR_START) {
         gboolean lws = *lastwasspace;
         _rsvg_node_text_length_children (node, ctx, &length, &lws, usetextonly);
-        if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+        if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
             length /= 2;
     }
 
     if (self->x_specified) {
         *x = rsvg_length_normalize (&self->x, ctx);
-        if (!PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text_gravity)) {
+        if (!PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text->text_gravity)) {
             *x -= length;
-            if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+            if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
                 dx /= 2;
-            if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_END)
+            if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_END)
                 dx = 0;
         }
     }
@@ -433,11 +420,11 @@ _rsvg_node_text_type_tspan (RsvgNode *node, RsvgNodeText *self, RsvgDrawingCtx *
 
     if (self->y_specified) {
         *y = rsvg_length_normalize (&self->y, ctx);
-        if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text_gravity)) {
+        if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text->text_gravity)) {
             *y -= length;
-            if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_MIDDLE)
+            if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_MIDDLE)
                 dy /= 2;
-            if (rsvg_current_state (ctx)->text_anchor == TEXT_ANCHOR_END)
+            if (rsvg_current_state (ctx)->text->text_anchor == TEXT_ANCHOR_END)
                 dy = 0;
         }
     }
@@ -456,7 +443,7 @@ _rsvg_node_text_length_tspan (RsvgNode *node,
     if (self->x_specified || self->y_specified)
         return TRUE;
 
-    if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text_gravity))
+    if (PANGO_GRAVITY_IS_VERTICAL (rsvg_current_state (ctx)->text->text_gravity))
         *length += rsvg_length_normalize (&self->dy, ctx);
     else
         *length += rsvg_length_normalize (&self->dx, ctx);
@@ -480,20 +467,20 @@ rsvg_node_tspan_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int do
 }
 
 RsvgNode *
-rsvg_new_tspan (const char *element_name, RsvgNode *parent)
+rsvg_new_tspan (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeText *text;
 
-    text = g_new0 (RsvgNodeText, 1);
+    text = rsvg_arena_new0 (arena, RsvgNodeText);
     text->dx = text->dy = rsvg_length_parse ("0", LENGTH_DIR_BOTH);
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_TSPAN,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 text,
                                 rsvg_node_tspan_set_atts,
                                 rsvg_node_tspan_draw,
-                                g_free);
+                                rsvg_arena_free_nothing);
 }
 
 static void
@@ -534,25 +521,14 @@ _rsvg_node_text_length_tref (RsvgNodeTref * self, RsvgDrawingCtx * ctx, gdouble
     return result;
 }
 
-static void
-rsvg_node_tref_free (gpointer impl)
-{
-    RsvgNodeTref *self = impl;
-
-    g_free (self->link);
-    g_free (self);
-}
-
 static void
 rsvg_node_tref_set_atts (RsvgNode *node, gpointer impl, RsvgHandle *handle, RsvgPropertyBag *atts)
 {
     RsvgNodeTref *text = impl;
     const char *value;
 
-    if ((value = rsvg_property_bag_lookup (atts, "xlink:href"))) {
-        g_free (text->link);
-        text->link = g_strdup (value);
-    }
+    if ((value = rsvg_property_bag_lookup (atts, "xlink:href")))
+        text->link = rsvg_arena_strdup (handle->priv->arena, value);
 }
 
 static void
@@ -562,20 +538,20 @@ rsvg_node_tref_draw (RsvgNode *node, gpointer impl, RsvgDrawingCtx *ctx, int dom
 }
 
 RsvgNode *
-rsvg_new_tref (const char *element_name, RsvgNode *parent)
+rsvg_new_tref (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena)
 {
     RsvgNodeTref *text;
 
-    text = g_new0 (RsvgNodeTref, 1);
+    text = rsvg_arena_new0 (arena, RsvgNodeTref);
     text->link = NULL;
 
     return rsvg_rust_cnode_new (RSVG_NODE_TYPE_TREF,
                                 parent,
-                                rsvg_state_new (),
+                                state,
                                 text,
                                 rsvg_node_tref_set_atts,
                                 rsvg_node_tref_draw,
-                                rsvg_node_tref_free);
+                                rsvg_arena_free_nothing);
 }
 
 typedef struct _RsvgTextLayout RsvgTextLayout;
@@ -606,24 +582,24 @@ rsvg_text_create_layout (RsvgDrawingCtx * ctx, const char *text, PangoContext *
 
     state = rsvg_current_state (ctx);
 
-    if (state->lang)
-        pango_context_set_language (context, pango_language_from_string (state->lang));
+    if (state->text->lang)
+        pango_context_set_language (context, pango_language_from_string (state->text->lang));
 
-    if (state->unicode_bidi == UNICODE_BIDI_OVERRIDE || state->unicode_bidi == UNICODE_BIDI_EMBED)
-        pango_context_set_base_dir (context, state->text_dir);
+    if (state->text->unicode_bidi == UNICODE_BIDI_OVERRIDE || state->text->unicode_bidi == UNICODE_BIDI_EMBED)
+        pango_context_set_base_dir (context, state->text->text_dir);
 
-    if (PANGO_GRAVITY_IS_VERTICAL (state->text_gravity))
-        pango_context_set_base_gravity (context, state->text_gravity);
+    if (PANGO_GRAVITY_IS_VERTICAL (state->text->text_gravity))
+        pango_context_set_base_gravity (context, state->text->text_gravity);
 
     font_desc = pango_font_description_copy (pango_context_get_font_description (context));
 
-    if (state->font_family)
-        pango_font_description_set_family_static (font_desc, state->font_family);
+    if (state->text->font_family)
+        pango_font_description_set_family_static (font_desc, state->text->font_family);
 
-    pango_font_description_set_style (font_desc, state->font_style);
-    pango_font_description_set_variant (font_desc, state->font_variant);
-    pango_font_description_set_weight (font_desc, state->font_weight);
-    pango_font_description_set_stretch (font_desc, state->font_stretch);
+    pango_font_description_set_style (font_desc, state->text->font_style);
+    pango_font_description_set_variant (font_desc, state->text->font_variant);
+    pango_font_description_set_weight (font_desc, state->text->font_weight);
+    pango_font_description_set_stretch (font_desc, state->text->font_stretch);
 
     rsvg_drawing_ctx_get_dpi (ctx, NULL, &dpi_y);
     pango_font_description_set_size (font_desc,
@@ -634,19 +610,19 @@ rsvg_text_create_layout (RsvgDrawingCtx * ctx, const char *text, PangoContext *
     pango_font_description_free (font_desc);
 
     attr_list = pango_attr_list_new ();
-    attribute = pango_attr_letter_spacing_new (rsvg_length_normalize (&state->letter_spacing, ctx) * PANGO_SCALE);
+    attribute = pango_attr_letter_spacing_new (rsvg_length_normalize (&state->text->letter_spacing, ctx) * PANGO_SCALE);
     attribute->start_index = 0;
     attribute->end_index = G_MAXINT;
     pango_attr_list_insert (attr_list, attribute);
 
-    if (state->has_font_decor && text) {
-        if (state->font_decor & TEXT_UNDERLINE) {
+    if (state->text->has_font_decor && text) {
+        if (state->text->font_decor & TEXT_UNDERLINE) {
             attribute = pango_attr_underline_new (PANGO_UNDERLINE_SINGLE);
             attribute->start_index = 0;
             attribute->end_index = -1;
             pango_attr_list_insert (attr_list, attribute);
         }
-	if (state->font_decor & TEXT_STRIKE) {
+	if (state->text->font_decor & TEXT_STRIKE) {
             attribute = pango_attr_strikethrough_new (TRUE);
             attribute->start_index = 0;
             attribute->end_index = -1;
@@ -662,7 +638,7 @@ rsvg_text_create_layout (RsvgDrawingCtx * ctx, const char *text, PangoContext *
     else
         pango_layout_set_text (layout, NULL, 0);
 
-    pango_layout_set_alignment (layout, (state->text_dir == PANGO_DIRECTION_LTR) ?
+    pango_layout_set_alignment (layout, (state->text->text_dir == PANGO_DIRECTION_LTR) ?
                                 PANGO_ALIGN_LEFT : PANGO_ALIGN_RIGHT);
 
     return layout;
@@ -685,7 +661,7 @@ rsvg_text_layout_new (RsvgDrawingCtx * ctx, const char *text)
     layout->layout = rsvg_text_create_layout (ctx, text, ctx->pango_context);
     layout->ctx = ctx;
 
-    layout->anchor = state->text_anchor;
+    layout->anchor = state->text->text_anchor;
 
     return layout;
 }
@@ -703,7 +679,7 @@ rsvg_text_render_text (RsvgDrawingCtx * ctx, const char *text, gdouble * x, gdou
     state = rsvg_current_state (ctx);
 
     /* Do not render the text if the font size is zero. See bug #581491. */
-    if (state->font_size.length == 0)
+    if (state->text->font_size.length == 0)
         return;
 
     context = ctx->render->create_pango_context (ctx);
@@ -712,7 +688,7 @@ rsvg_text_render_text (RsvgDrawingCtx * ctx, const char *text, gdouble * x, gdou
     iter = pango_layout_get_iter (layout);
     offset = pango_layout_iter_get_baseline (iter) / (double) PANGO_SCALE;
     offset += _rsvg_css_accumulate_baseline_shift (state, ctx);
-    if (PANGO_GRAVITY_IS_VERTICAL (state->text_gravity)) {
+    if (PANGO_GRAVITY_IS_VERTICAL (state->text->text_gravity)) {
         offset_x = -offset;
         offset_y = 0;
     } else {
@@ -721,7 +697,7 @@ rsvg_text_render_text (RsvgDrawingCtx * ctx, const char *text, gdouble * x, gdou
     }
     pango_layout_iter_free (iter);
     ctx->render->render_pango_layout (ctx, layout, *x - offset_x, *y - offset_y);
-    if (PANGO_GRAVITY_IS_VERTICAL (state->text_gravity))
+    if (PANGO_GRAVITY_IS_VERTICAL (state->text->text_gravity))
         *y += w / (double)PANGO_SCALE;
     else
         *x += w / (double)PANGO_SCALE;
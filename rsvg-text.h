@@ -33,13 +33,13 @@
 G_BEGIN_DECLS 
 
 G_GNUC_INTERNAL
-RsvgNode    *rsvg_new_text	    (const char *element_name, RsvgNode *parent);
+RsvgNode    *rsvg_new_text	    (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 G_GNUC_INTERNAL
-RsvgNode    *rsvg_new_tspan	    (const char *element_name, RsvgNode *parent);
+RsvgNode    *rsvg_new_tspan	    (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 G_GNUC_INTERNAL
-RsvgNode    *rsvg_new_tref	    (const char *element_name, RsvgNode *parent);
+RsvgNode    *rsvg_new_tref	    (const char *element_name, RsvgNode *parent, RsvgState *state, RsvgArena *arena);
 G_GNUC_INTERNAL
-char	    *rsvg_make_valid_utf8   (const char *str, int len);
+void	     rsvg_string_append_valid_utf8 (GString *string, const char *str, int len);
 
 G_END_DECLS
 
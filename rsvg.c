@@ -29,6 +29,7 @@
 #include "rsvg.h"
 #include "rsvg-private.h"
 #include "rsvg-css.h"
+#include "rsvg-defs.h"
 #include "rsvg-styles.h"
 #include "rsvg-shapes.h"
 #include "rsvg-image.h"
@@ -43,6 +44,7 @@
 
 #include "rsvg-cairo.h"
 #include "rsvg-cairo-draw.h"
+#include "rsvg-cairo-render.h"
 
 /**
  * rsvg_handle_get_pixbuf_sub:
@@ -101,6 +103,267 @@ rsvg_handle_get_pixbuf_sub (RsvgHandle * handle, const char *id)
     return output;
 }
 
+/**
+ * rsvg_handle_get_pixbuf_sub_cropped:
+ * @handle: An #RsvgHandle
+ * @id: (nullable): The id of an element inside the SVG, or %NULL to
+ * render the whole SVG. For example, if you have a layer called
+ * "layer1" that you wish to render, pass "##layer1" as the id.
+ *
+ * Like rsvg_handle_get_pixbuf_sub(), but the returned pixbuf is only as
+ * big as the bounding box of the element, rounded out to whole pixels,
+ * and the element is positioned at its top-left corner.  Unlike
+ * rsvg_handle_get_pixbuf_sub(), this never allocates surfaces the size
+ * of the whole document, so it is suitable for extracting small
+ * elements out of large documents.
+ *
+ * Returns: (transfer full) (nullable): a pixbuf with the rendered
+ * element, or %NULL if @id doesn't exist or has an empty bounding box.
+ *
+ * Since: 2.42
+ **/
+GdkPixbuf *
+rsvg_handle_get_pixbuf_sub_cropped (RsvgHandle * handle, const char *id)
+{
+    RsvgNode *node;
+    cairo_rectangle_int_t extents;
+    GdkPixbuf *output = NULL;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    g_return_val_if_fail (handle != NULL, NULL);
+
+    if (!handle->priv->finished)
+        return NULL;
+
+    if (id && *id)
+        node = rsvg_defs_lookup (handle->priv->defs, id);
+    else
+        node = handle->priv->treebase;
+
+    if (node == NULL)
+        return NULL;
+
+    if (!_rsvg_handle_get_node_pixel_extents (handle, node, &extents))
+        return NULL;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                          extents.width, extents.height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cr = cairo_create (surface);
+
+    if (!rsvg_cairo_render_node_cropped (cr, handle, node, &extents)) {
+        cairo_destroy (cr);
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cairo_destroy (cr);
+
+    output = rsvg_cairo_surface_to_pixbuf (surface);
+    cairo_surface_destroy (surface);
+
+    return output;
+}
+
+/**
+ * rsvg_handle_foreach_pixbuf_sub_cropped:
+ * @handle: An #RsvgHandle
+ * @ids: (array zero-terminated=1): a %NULL-terminated array of element
+ *   ids, with a "#" prepended to each, like the ones returned by
+ *   rsvg_handle_get_group_ids()
+ * @func: (scope call): function to call with each rendered element
+ * @user_data: data to pass to @func
+ *
+ * Renders each of the elements in @ids with
+ * rsvg_handle_get_pixbuf_sub_cropped(), and passes the resulting pixbufs
+ * to @func in the same order as @ids.  If @func returns %FALSE, no more
+ * elements get rendered.
+ *
+ * The document is only parsed once, so this is a lot cheaper than
+ * loading the file once per element.  The pixbufs are not kept around
+ * after @func returns, unless @func takes a reference to them.
+ *
+ * Returns: %FALSE if @handle is not finished loading, or if @func asked
+ * to stop; %TRUE otherwise.
+ *
+ * Since: 2.42
+ **/
+gboolean
+rsvg_handle_foreach_pixbuf_sub_cropped (RsvgHandle * handle,
+                                        const char * const *ids,
+                                        RsvgPixbufSubFunc func,
+                                        gpointer user_data)
+{
+    int i;
+
+    g_return_val_if_fail (handle != NULL, FALSE);
+    g_return_val_if_fail (ids != NULL, FALSE);
+    g_return_val_if_fail (func != NULL, FALSE);
+
+    if (!handle->priv->finished)
+        return FALSE;
+
+    for (i = 0; ids[i] != NULL; i++) {
+        GdkPixbuf *pixbuf;
+        gboolean keep_going;
+
+        pixbuf = rsvg_handle_get_pixbuf_sub_cropped (handle, ids[i]);
+        keep_going = (* func) (ids[i], pixbuf, user_data);
+
+        if (pixbuf)
+            g_object_unref (pixbuf);
+
+        if (!keep_going)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int
+bytes_per_pixel (RsvgPixelFormat format)
+{
+    switch (format) {
+    case RSVG_PIXEL_FORMAT_RGB565:
+        return 2;
+
+    case RSVG_PIXEL_FORMAT_A8:
+        return 1;
+
+    default:
+        return 4;
+    }
+}
+
+/* The cairo format that has the same layout as @format, or
+ * %CAIRO_FORMAT_INVALID if we need to convert cairo's output.
+ */
+static cairo_format_t
+get_cairo_format (RsvgPixelFormat format)
+{
+    switch (format) {
+    case RSVG_PIXEL_FORMAT_ARGB32:
+        return CAIRO_FORMAT_ARGB32;
+
+    case RSVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED:
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+        return CAIRO_FORMAT_ARGB32;
+#else
+        return CAIRO_FORMAT_INVALID;
+#endif
+
+    case RSVG_PIXEL_FORMAT_RGB565:
+        return CAIRO_FORMAT_RGB16_565;
+
+    case RSVG_PIXEL_FORMAT_A8:
+        return CAIRO_FORMAT_A8;
+
+    default:
+        return CAIRO_FORMAT_INVALID;
+    }
+}
+
+/**
+ * rsvg_handle_render_to_buffer:
+ * @handle: An #RsvgHandle
+ * @data: (array): memory for @height rows of @stride bytes each
+ * @stride: the number of bytes between the starts of consecutive rows
+ * @width: width of the image in pixels
+ * @height: height of the image in pixels
+ * @format: the layout of the pixels to write
+ *
+ * Renders the whole SVG into @data, scaled to @width by @height pixels.
+ * The previous contents of @data are overwritten.
+ *
+ * When @format is laid out like one of cairo's formats, cairo draws into
+ * @data directly.  For %RSVG_PIXEL_FORMAT_RGBA8888, it draws into @data
+ * and the pixels are converted in place.  Other formats, or strides
+ * which are not a multiple of 4, need a temporary image.  In all cases
+ * this is cheaper than getting a #GdkPixbuf or an image surface and
+ * converting it afterwards.
+ *
+ * Returns: %TRUE if the SVG was rendered, %FALSE if @handle is not
+ * finished loading or has no size.
+ *
+ * Since: 2.42
+ **/
+gboolean
+rsvg_handle_render_to_buffer (RsvgHandle *handle,
+                              guint8 *data,
+                              int stride,
+                              int width,
+                              int height,
+                              RsvgPixelFormat format)
+{
+    RsvgDimensionData dimensions;
+    cairo_format_t cairo_format;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gboolean converts;
+    gboolean result;
+    int y;
+
+    g_return_val_if_fail (handle != NULL, FALSE);
+    g_return_val_if_fail (data != NULL, FALSE);
+    g_return_val_if_fail (width > 0 && height > 0, FALSE);
+    g_return_val_if_fail (stride >= width * bytes_per_pixel (format), FALSE);
+
+    if (!handle->priv->finished)
+        return FALSE;
+
+    rsvg_handle_get_dimensions (handle, &dimensions);
+    if (!(dimensions.width && dimensions.height))
+        return FALSE;
+
+    cairo_format = get_cairo_format (format);
+    converts = (cairo_format == CAIRO_FORMAT_INVALID);
+
+    /* Formats with 4 bytes per pixel can be converted in place */
+    if (converts && bytes_per_pixel (format) == 4)
+        cairo_format = CAIRO_FORMAT_ARGB32;
+
+    if (cairo_format != CAIRO_FORMAT_INVALID && stride % 4 == 0) {
+        for (y = 0; y < height; y++)
+            memset (data + y * stride, 0, width * bytes_per_pixel (format));
+
+        surface = cairo_image_surface_create_for_data (data, cairo_format, width, height, stride);
+    } else {
+        converts = TRUE;
+        surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+    }
+
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return FALSE;
+    }
+
+    cr = cairo_create (surface);
+    cairo_scale (cr,
+                 (double) width / dimensions.width,
+                 (double) height / dimensions.height);
+
+    result = rsvg_handle_render_cairo (handle, cr);
+
+    cairo_destroy (cr);
+    cairo_surface_flush (surface);
+
+    if (result && converts)
+        rsvg_cairo_convert_argb32 (data, stride,
+                                   cairo_image_surface_get_data (surface),
+                                   cairo_image_surface_get_stride (surface),
+                                   width, height,
+                                   format);
+
+    cairo_surface_destroy (surface);
+
+    return result;
+}
+
 /**
  * rsvg_handle_get_pixbuf:
  * @handle: An #RsvgHandle
@@ -75,6 +75,7 @@ typedef struct RsvgHandlePrivate RsvgHandlePrivate;
 typedef struct _RsvgHandleClass RsvgHandleClass;
 typedef struct _RsvgDimensionData RsvgDimensionData;
 typedef struct _RsvgPositionData RsvgPositionData;
+typedef struct _RsvgRectangle RsvgRectangle;
 
 /**
  * RsvgHandleClass:
@@ -125,6 +126,24 @@ struct _RsvgPositionData {
     int y;
 };
 
+/**
+ * RsvgRectangle:
+ * @x: X coordinate of the left side of the rectangle
+ * @y: Y coordinate of the top side of the rectangle
+ * @width: width of the rectangle
+ * @height: height of the rectangle
+ *
+ * A rectangle in floating-point coordinates.
+ *
+ * Since: 2.42
+ */
+struct _RsvgRectangle {
+    double x;
+    double y;
+    double width;
+    double height;
+};
+
 void rsvg_cleanup (void);
 
 void rsvg_set_default_dpi	(double dpi);
@@ -139,6 +158,60 @@ gboolean     rsvg_handle_write		(RsvgHandle * handle, const guchar * buf,
 gboolean     rsvg_handle_close		(RsvgHandle * handle, GError ** error);
 GdkPixbuf   *rsvg_handle_get_pixbuf	(RsvgHandle * handle);
 GdkPixbuf   *rsvg_handle_get_pixbuf_sub (RsvgHandle * handle, const char *id);
+GdkPixbuf   *rsvg_handle_get_pixbuf_sub_cropped (RsvgHandle * handle, const char *id);
+
+/**
+ * RsvgPixbufSubFunc:
+ * @id: the id of the element, as passed to rsvg_handle_foreach_pixbuf_sub_cropped()
+ * @pixbuf: (nullable): the rendered element, or %NULL if there is no
+ *   element with that id or it doesn't paint anything
+ * @user_data: user data
+ *
+ * Function that receives the elements rendered by
+ * rsvg_handle_foreach_pixbuf_sub_cropped().
+ *
+ * Returns: %TRUE to keep rendering the rest of the elements, %FALSE to stop.
+ *
+ * Since: 2.42
+ */
+typedef gboolean (*RsvgPixbufSubFunc) (const char *id, GdkPixbuf *pixbuf, gpointer user_data);
+
+gboolean     rsvg_handle_foreach_pixbuf_sub_cropped (RsvgHandle * handle,
+                                                     const char * const *ids,
+                                                     RsvgPixbufSubFunc func,
+                                                     gpointer user_data);
+
+/**
+ * RsvgPixelFormat:
+ * @RSVG_PIXEL_FORMAT_ARGB32: premultiplied ARGB in native-endian 32-bit
+ *   units, like %CAIRO_FORMAT_ARGB32
+ * @RSVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED: bytes in B, G, R, A order,
+ *   with premultiplied alpha
+ * @RSVG_PIXEL_FORMAT_RGBA8888: bytes in R, G, B, A order, with
+ *   non-premultiplied alpha, like a #GdkPixbuf with an alpha channel
+ * @RSVG_PIXEL_FORMAT_RGB565: native-endian 16-bit units with 5 bits of red
+ *   in the most significant bits, 6 of green and 5 of blue, like
+ *   %CAIRO_FORMAT_RGB16_565.  The image is composited over black.
+ * @RSVG_PIXEL_FORMAT_A8: only the alpha channel, one byte per pixel
+ *
+ * Layouts of the pixels that rsvg_handle_render_to_buffer() can write.
+ *
+ * Since: 2.42
+ */
+typedef enum {
+    RSVG_PIXEL_FORMAT_ARGB32,
+    RSVG_PIXEL_FORMAT_BGRA8888_PREMULTIPLIED,
+    RSVG_PIXEL_FORMAT_RGBA8888,
+    RSVG_PIXEL_FORMAT_RGB565,
+    RSVG_PIXEL_FORMAT_A8
+} RsvgPixelFormat;
+
+gboolean     rsvg_handle_render_to_buffer (RsvgHandle *handle,
+                                           guint8 *data,
+                                           int stride,
+                                           int width,
+                                           int height,
+                                           RsvgPixelFormat format);
 
 const char  *rsvg_handle_get_base_uri (RsvgHandle * handle);
 void         rsvg_handle_set_base_uri (RsvgHandle * handle, const char *base_uri);
@@ -146,9 +219,13 @@ void         rsvg_handle_set_base_uri (RsvgHandle * handle, const char *base_uri
 void rsvg_handle_get_dimensions (RsvgHandle * handle, RsvgDimensionData * dimension_data);
 
 gboolean rsvg_handle_get_dimensions_sub (RsvgHandle * handle, RsvgDimensionData * dimension_data, const char *id);
+gboolean rsvg_handle_get_dimensions_sub_cropped (RsvgHandle * handle, RsvgDimensionData * dimension_data, const char *id);
 gboolean rsvg_handle_get_position_sub (RsvgHandle * handle, RsvgPositionData * position_data, const char *id);
 
 gboolean rsvg_handle_has_sub (RsvgHandle * handle, const char *id);
+gchar  **rsvg_handle_get_group_ids (RsvgHandle * handle);
+GHashTable *rsvg_handle_get_element_bounds (RsvgHandle * handle);
+gchar  **rsvg_handle_pick (RsvgHandle * handle, const RsvgRectangle * area);
 
 /* GIO APIs */
 
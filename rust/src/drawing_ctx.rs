@@ -6,6 +6,8 @@ extern crate libc;
 
 use self::glib::translate::*;
 
+use std::ptr;
+
 use color::*;
 use node::RsvgNode;
 use node::NodeType;
@@ -56,8 +58,25 @@ extern "C" {
                                               node:     *const RsvgNode,
                                               dominate: i32);
 
+    fn rsvg_drawing_ctx_can_instance (draw_ctx: *const RsvgDrawingCtx,
+                                      node:     *const RsvgNode) -> glib_sys::gboolean;
+
+    fn rsvg_drawing_ctx_lookup_instance (draw_ctx:    *const RsvgDrawingCtx,
+                                         node:        *const RsvgNode,
+                                         scale:       f64,
+                                         out_surface: *mut *mut cairo_sys::cairo_surface_t,
+                                         out_extents: *mut cairo::Rectangle) -> glib_sys::gboolean;
+
+    fn rsvg_drawing_ctx_add_instance (draw_ctx: *const RsvgDrawingCtx,
+                                      node:     *const RsvgNode,
+                                      scale:    f64,
+                                      surface:  *mut cairo_sys::cairo_surface_t,
+                                      extents:  *const cairo::Rectangle);
+
     fn rsvg_current_state (draw_ctx: *const RsvgDrawingCtx) -> *mut RsvgState;
     fn rsvg_state_new () -> *mut RsvgState;
+    fn rsvg_state_clone (dst: *mut RsvgState, src: *const RsvgState);
+    fn rsvg_state_inherits_equal (a: *const RsvgState, b: *const RsvgState) -> glib_sys::gboolean;
     fn rsvg_state_reinit (state: *mut RsvgState);
     fn rsvg_state_reconstruct (state: *mut RsvgState, node: *const RsvgNode);
     fn rsvg_state_is_overflow (state: *const RsvgState) -> glib_sys::gboolean;
@@ -81,6 +100,23 @@ extern "C" {
 
     fn rsvg_cairo_get_cairo_context (draw_ctx: *const RsvgDrawingCtx) -> *mut cairo_sys::cairo_t;
     fn rsvg_cairo_set_cairo_context (draw_ctx: *const RsvgDrawingCtx, cr: *const cairo_sys::cairo_t);
+
+    fn rsvg_cairo_pattern_tile_is_recording (draw_ctx: *const RsvgDrawingCtx) -> glib_sys::gboolean;
+    fn rsvg_cairo_create_pattern_tile (draw_ctx: *const RsvgDrawingCtx,
+                                       width:    libc::c_int,
+                                       height:   libc::c_int) -> *mut cairo_sys::cairo_surface_t;
+
+    fn rsvg_cairo_can_record (draw_ctx: *const RsvgDrawingCtx) -> glib_sys::gboolean;
+    fn rsvg_cairo_subtree_can_be_recorded (node: *const RsvgNode) -> glib_sys::gboolean;
+    fn rsvg_cairo_push_recording (draw_ctx: *const RsvgDrawingCtx);
+    fn rsvg_cairo_pop_recording (draw_ctx:    *const RsvgDrawingCtx,
+                                 out_extents: *mut cairo::Rectangle) -> *mut cairo_sys::cairo_surface_t;
+    fn rsvg_cairo_paint_recording (draw_ctx: *const RsvgDrawingCtx,
+                                   surface:  *mut cairo_sys::cairo_surface_t,
+                                   extents:  *const cairo::Rectangle,
+                                   affine:   *const cairo::Matrix);
+
+    fn rsvg_cairo_fold_group_opacity (draw_ctx: *const RsvgDrawingCtx, child: *const RsvgNode);
 }
 
 pub fn get_dpi (draw_ctx: *const RsvgDrawingCtx) -> (f64, f64) {
@@ -170,6 +206,100 @@ pub fn set_cairo_context (draw_ctx: *const RsvgDrawingCtx, cr: &cairo::Context)
     }
 }
 
+pub fn pattern_tile_is_recording (draw_ctx: *const RsvgDrawingCtx) -> bool {
+    unsafe { from_glib (rsvg_cairo_pattern_tile_is_recording (draw_ctx)) }
+}
+
+pub fn create_pattern_tile (draw_ctx: *const RsvgDrawingCtx, width: i32, height: i32) -> cairo::Surface {
+    unsafe {
+        let raw_surface = rsvg_cairo_create_pattern_tile (draw_ctx, width, height);
+
+        cairo::Surface::from_glib_full (raw_surface)
+    }
+}
+
+pub fn can_record (draw_ctx: *const RsvgDrawingCtx) -> bool {
+    unsafe { from_glib (rsvg_cairo_can_record (draw_ctx)) }
+}
+
+pub fn subtree_can_be_recorded (node: *const RsvgNode) -> bool {
+    unsafe { from_glib (rsvg_cairo_subtree_can_be_recorded (node)) }
+}
+
+pub fn push_recording (draw_ctx: *const RsvgDrawingCtx) {
+    unsafe { rsvg_cairo_push_recording (draw_ctx); }
+}
+
+// Returns None if nothing was drawn while recording
+pub fn pop_recording (draw_ctx: *const RsvgDrawingCtx) -> Option<(cairo::Surface, cairo::Rectangle)> {
+    let mut extents = cairo::Rectangle { x: 0.0, y: 0.0, width: 0.0, height: 0.0 };
+
+    unsafe {
+        let raw_surface = rsvg_cairo_pop_recording (draw_ctx, &mut extents);
+
+        if raw_surface.is_null () {
+            None
+        } else {
+            Some ((cairo::Surface::from_glib_full (raw_surface), extents))
+        }
+    }
+}
+
+pub fn paint_recording (draw_ctx: *const RsvgDrawingCtx,
+                        surface:  &cairo::Surface,
+                        extents:  &cairo::Rectangle,
+                        affine:   &cairo::Matrix) {
+    unsafe {
+        rsvg_cairo_paint_recording (draw_ctx, surface.to_glib_none ().0, extents, affine);
+    }
+}
+
+pub fn fold_group_opacity (draw_ctx: *const RsvgDrawingCtx, child: *const RsvgNode) {
+    unsafe { rsvg_cairo_fold_group_opacity (draw_ctx, child); }
+}
+
+pub fn can_instance (draw_ctx: *const RsvgDrawingCtx, node: *const RsvgNode) -> bool {
+    unsafe { from_glib (rsvg_drawing_ctx_can_instance (draw_ctx, node)) }
+}
+
+// Returns None if there is no recording for this scale and the current
+// inherited style; Some (None) if there is one, but the node draws nothing.
+pub fn lookup_instance (draw_ctx: *const RsvgDrawingCtx,
+                        node:     *const RsvgNode,
+                        scale:    f64) -> Option<Option<(cairo::Surface, cairo::Rectangle)>> {
+    let mut raw_surface: *mut cairo_sys::cairo_surface_t = ptr::null_mut ();
+    let mut extents = cairo::Rectangle { x: 0.0, y: 0.0, width: 0.0, height: 0.0 };
+
+    unsafe {
+        let found: bool = from_glib (rsvg_drawing_ctx_lookup_instance (draw_ctx, node, scale, &mut raw_surface, &mut extents));
+
+        if !found {
+            None
+        } else if raw_surface.is_null () {
+            Some (None)
+        } else {
+            Some (Some ((cairo::Surface::from_glib_none (raw_surface), extents)))
+        }
+    }
+}
+
+pub fn add_instance (draw_ctx: *const RsvgDrawingCtx,
+                     node:     *const RsvgNode,
+                     scale:    f64,
+                     contents: &Option<(cairo::Surface, cairo::Rectangle)>) {
+    unsafe {
+        match *contents {
+            Some ((ref surface, ref extents)) => {
+                rsvg_drawing_ctx_add_instance (draw_ctx, node, scale, surface.to_glib_none ().0, extents);
+            },
+
+            None => {
+                rsvg_drawing_ctx_add_instance (draw_ctx, node, scale, ptr::null_mut (), ptr::null ());
+            }
+        }
+    }
+}
+
 pub fn get_current_state_affine (draw_ctx: *const RsvgDrawingCtx) -> cairo::Matrix {
     unsafe {
         rsvg_drawing_ctx_get_current_state_affine (draw_ctx)
@@ -204,6 +334,18 @@ pub fn state_new () -> *mut RsvgState {
     unsafe { rsvg_state_new () }
 }
 
+pub fn state_copy (src: *const RsvgState) -> *mut RsvgState {
+    unsafe {
+        let state = rsvg_state_new ();
+        rsvg_state_clone (state, src);
+        state
+    }
+}
+
+pub fn state_inherits_equal (a: *const RsvgState, b: *const RsvgState) -> bool {
+    unsafe { from_glib (rsvg_state_inherits_equal (a, b)) }
+}
+
 pub fn state_reinit (state: *mut RsvgState) {
     unsafe { rsvg_state_reinit (state); }
 }
@@ -611,18 +611,37 @@ pub extern fn gradient_add_color_stop (raw_gradient: *mut Gradient,
 }
 
 #[no_mangle]
-pub extern fn gradient_resolve_fallbacks_and_set_pattern (raw_gradient: *mut Gradient,
-                                                          draw_ctx:     *mut RsvgDrawingCtx,
-                                                          opacity:      u8,
-                                                          bbox:         RsvgBbox) {
+pub extern fn gradient_resolve_fallbacks (raw_gradient: *const Gradient,
+                                          draw_ctx:     *mut RsvgDrawingCtx) -> *mut Gradient {
     assert! (!raw_gradient.is_null ());
-    let gradient: &mut Gradient = unsafe { &mut (*raw_gradient) };
+    let gradient: &Gradient = unsafe { &*raw_gradient };
 
     let mut fallback_source = NodeFallbackSource::new (draw_ctx);
 
     let resolved = resolve_gradient (gradient, &mut fallback_source);
 
-    set_pattern_on_draw_context (&resolved,
+    Box::into_raw (Box::new (resolved))
+}
+
+#[no_mangle]
+pub extern fn gradient_is_user_space_on_use (raw_gradient: *const Gradient) -> glib_sys::gboolean {
+    assert! (!raw_gradient.is_null ());
+    let gradient: &Gradient = unsafe { &*raw_gradient };
+
+    assert! (gradient.is_resolved ());
+
+    (gradient.common.units.unwrap () == PaintServerUnits::UserSpaceOnUse).to_glib ()
+}
+
+#[no_mangle]
+pub extern fn gradient_set_pattern (raw_gradient: *const Gradient,
+                                    draw_ctx:     *mut RsvgDrawingCtx,
+                                    opacity:      u8,
+                                    bbox:         RsvgBbox) {
+    assert! (!raw_gradient.is_null ());
+    let gradient: &Gradient = unsafe { &*raw_gradient };
+
+    set_pattern_on_draw_context (gradient,
                                  draw_ctx,
                                  opacity,
                                  &bbox);
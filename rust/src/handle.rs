@@ -1 +1,2 @@
 pub enum RsvgHandle {}
+pub enum RsvgArena {}
@@ -7,6 +7,7 @@ use self::glib::translate::*;
 use self::cairo::MatrixTrait;
 
 use std::cell::Cell;
+use std::cell::RefCell;
 use std::f64::consts::*;
 use std::str::FromStr;
 
@@ -15,6 +16,7 @@ use drawing_ctx;
 use drawing_ctx::RsvgDrawingCtx;
 use error::*;
 use handle::RsvgHandle;
+use handle::RsvgArena;
 use length::*;
 use node::*;
 use path_builder::*;
@@ -22,6 +24,7 @@ use parsers;
 use parsers::ParseError;
 use property_bag;
 use property_bag::*;
+use state::RsvgState;
 use util::*;
 use viewbox::*;
 
@@ -80,6 +83,36 @@ impl FromStr for MarkerOrient {
 
 // NodeMarker
 
+// Everything that the recorded contents of a marker depend on, besides the
+// marker's children themselves.  The vertex position, the orientation and the
+// stroke width only change the affine with which the recording is painted.
+struct RecordingKey {
+    scale:    f64,
+    content:  cairo::Matrix,
+    size:     (f64, f64),
+    view_box: (f64, f64),
+    dpi:      (f64, f64)
+}
+
+impl RecordingKey {
+    fn matches (&self, other: &RecordingKey) -> bool {
+        self.scale == other.scale &&
+            matrix_equal (&self.content, &other.content) &&
+            self.size == other.size &&
+            self.view_box == other.view_box &&
+            self.dpi == other.dpi
+    }
+}
+
+struct MarkerRecording {
+    key:      RecordingKey,
+    contents: Option<(cairo::Surface, cairo::Rectangle)> // None if the marker draws nothing
+}
+
+// Markers are usually drawn at a single scale, but keep a few recordings for
+// documents where the same marker is used with different stroke widths.
+const MAX_RECORDINGS: usize = 4;
+
 struct NodeMarker {
     units:  Cell<MarkerUnits>,
     ref_x:  Cell<RsvgLength>,
@@ -88,7 +121,12 @@ struct NodeMarker {
     height: Cell<RsvgLength>,
     orient: Cell<MarkerOrient>,
     aspect: Cell<AspectRatio>,
-    vbox:   Cell<RsvgViewBox>
+    vbox:   Cell<RsvgViewBox>,
+
+    // Whether the marker's contents can be recorded once and replayed at
+    // each vertex; computed on first use
+    recordable: Cell<Option<bool>>,
+    recordings: RefCell<Vec<MarkerRecording>>
 }
 
 impl NodeMarker {
@@ -101,7 +139,10 @@ impl NodeMarker {
             height: Cell::new (NodeMarker::get_default_size ()),
             orient: Cell::new (MarkerOrient::default ()),
             aspect: Cell::new (AspectRatio::default ()),
-            vbox:   Cell::new (RsvgViewBox::default ())
+            vbox:   Cell::new (RsvgViewBox::default ()),
+
+            recordable: Cell::new (None),
+            recordings: RefCell::new (Vec::new ())
         }
     }
 
@@ -110,6 +151,18 @@ impl NodeMarker {
         RsvgLength::parse ("3", LengthDir::Both).unwrap ()
     }
 
+    fn is_recordable (&self, node: &RsvgNode, draw_ctx: *const RsvgDrawingCtx) -> bool {
+        if !drawing_ctx::can_record (draw_ctx) {
+            return false;
+        }
+
+        if self.recordable.get ().is_none () {
+            self.recordable.set (Some (drawing_ctx::subtree_can_be_recorded (node as *const RsvgNode)));
+        }
+
+        self.recordable.get ().unwrap ()
+    }
+
     fn render (&self,
                node:           &RsvgNode,
                c_node:         *const RsvgNode,
@@ -139,6 +192,10 @@ impl NodeMarker {
             affine.scale (line_width, line_width);
         }
 
+        // From the marker's coordinate system to that of its contents
+
+        let mut content = cairo::Matrix::identity ();
+
         let vbox = self.vbox.get ();
 
         if vbox.is_active () {
@@ -146,13 +203,96 @@ impl NodeMarker {
                                                            0.0, 0.0,
                                                            marker_width, marker_height);
 
-            affine.scale (w / vbox.rect.width, h / vbox.rect.height);
+            content.scale (w / vbox.rect.width, h / vbox.rect.height);
 
             drawing_ctx::push_view_box (draw_ctx, vbox.rect.width, vbox.rect.height);
         }
 
-        affine.translate (-self.ref_x.get ().normalize (draw_ctx),
-                          -self.ref_y.get ().normalize (draw_ctx));
+        content.translate (-self.ref_x.get ().normalize (draw_ctx),
+                           -self.ref_y.get ().normalize (draw_ctx));
+
+        if self.is_recordable (node, draw_ctx) {
+            self.paint_recording (node, c_node, draw_ctx, &affine, &content, marker_width, marker_height);
+        } else {
+            self.draw_contents (node, c_node, draw_ctx,
+                                cairo::Matrix::multiply (&content, &affine),
+                                marker_width, marker_height);
+        }
+
+        if vbox.is_active () {
+            drawing_ctx::pop_view_box (draw_ctx);
+        }
+    }
+
+    // Records the contents with only the uniform part of the marker's scale,
+    // so that the recording can be reused for any position and orientation.
+    fn paint_recording (&self,
+                        node:          &RsvgNode,
+                        c_node:        *const RsvgNode,
+                        draw_ctx:      *const RsvgDrawingCtx,
+                        affine:        &cairo::Matrix,
+                        content:       &cairo::Matrix,
+                        marker_width:  f64,
+                        marker_height: f64) {
+        let scale = (affine.xx * affine.yy - affine.xy * affine.yx).abs ().sqrt ();
+
+        if scale < DBL_EPSILON {
+            return;
+        }
+
+        let key = RecordingKey {
+            scale:    scale,
+            content:  *content,
+            size:     (marker_width, marker_height),
+            view_box: drawing_ctx::get_view_box_size (draw_ctx),
+            dpi:      drawing_ctx::get_dpi (draw_ctx)
+        };
+
+        let cached = self.recordings.borrow ().iter ().position (|r| r.key.matches (&key));
+
+        let index = match cached {
+            Some (i) => i,
+
+            None => {
+                let mut record_affine = cairo::Matrix::identity ();
+                record_affine.scale (scale, scale);
+
+                drawing_ctx::push_recording (draw_ctx);
+                self.draw_contents (node, c_node, draw_ctx,
+                                    cairo::Matrix::multiply (content, &record_affine),
+                                    marker_width, marker_height);
+                let contents = drawing_ctx::pop_recording (draw_ctx);
+
+                let mut recordings = self.recordings.borrow_mut ();
+
+                if recordings.len () == MAX_RECORDINGS {
+                    recordings.remove (0);
+                }
+
+                recordings.push (MarkerRecording { key:      key,
+                                                   contents: contents });
+                recordings.len () - 1
+            }
+        };
+
+        let recordings = self.recordings.borrow ();
+
+        if let Some ((ref surface, ref extents)) = recordings[index].contents {
+            let mut stamp = *affine;
+            stamp.scale (1.0 / scale, 1.0 / scale);
+
+            drawing_ctx::paint_recording (draw_ctx, surface, extents, &stamp);
+        }
+    }
+
+    fn draw_contents (&self,
+                      node:          &RsvgNode,
+                      c_node:        *const RsvgNode,
+                      draw_ctx:      *const RsvgDrawingCtx,
+                      affine:        cairo::Matrix,
+                      marker_width:  f64,
+                      marker_height: f64) {
+        let vbox = self.vbox.get ();
 
         drawing_ctx::state_push (draw_ctx);
 
@@ -187,10 +327,6 @@ impl NodeMarker {
         drawing_ctx::pop_discrete_layer (draw_ctx);
 
         drawing_ctx::state_pop (draw_ctx);
-
-        if vbox.is_active () {
-            drawing_ctx::pop_view_box (draw_ctx);
-        }
     }
 }
 
@@ -211,6 +347,9 @@ impl NodeTrait for NodeMarker {
         self.vbox.set   (property_bag::parse_or_default (pbag, "viewBox")?);
         self.aspect.set (property_bag::parse_or_default (pbag, "preserveAspectRatio")?);
 
+        self.recordable.set (None);
+        self.recordings.borrow_mut ().clear ();
+
         Ok (())
     }
 
@@ -224,9 +363,10 @@ impl NodeTrait for NodeMarker {
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_marker_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_marker_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Marker,
                     raw_parent,
+                    state,
                     Box::new (NodeMarker::new ()))
 }
 
@@ -204,10 +204,47 @@ impl Node {
         }
     }
 
+    // Elements which never draw anything when they are the child of a group
+    fn is_drawn (&self) -> bool {
+        match self.node_type {
+            NodeType::Chars |
+            NodeType::ClipPath |
+            NodeType::Defs |
+            NodeType::Filter |
+            NodeType::LinearGradient |
+            NodeType::Marker |
+            NodeType::Mask |
+            NodeType::Pattern |
+            NodeType::RadialGradient |
+            NodeType::Symbol => false,
+
+            _ => true
+        }
+    }
+
+    // The child that draws something, if there is exactly one
+    fn only_drawn_child (&self) -> Option<Rc<Node>> {
+        let children = self.children.borrow ();
+        let mut drawn = children.iter ().filter (|c| c.is_drawn ());
+
+        match (drawn.next (), drawn.next ()) {
+            (Some (child), None) => Some (child.clone ()),
+            _ => None
+        }
+    }
+
     pub fn draw_children (&self, draw_ctx: *const RsvgDrawingCtx, dominate: i32) {
         if dominate != -1 {
             drawing_ctx::state_reinherit_top (draw_ctx, self.state, dominate);
 
+            if let Some (child) = self.only_drawn_child () {
+                let boxed_child = box_node (child);
+
+                drawing_ctx::fold_group_opacity (draw_ctx, boxed_child);
+
+                rsvg_node_unref (boxed_child);
+            }
+
             drawing_ctx::push_discrete_layer (draw_ctx);
         }
 
@@ -251,10 +288,11 @@ pub fn node_ptr_to_weak (raw_parent: *const RsvgNode) -> Option<Weak<Node>> {
 
 pub fn boxed_node_new (node_type:  NodeType,
                        raw_parent: *const RsvgNode,
+                       state:      *mut RsvgState,
                        node_impl: Box<NodeTrait>) -> *mut RsvgNode {
     box_node (Rc::new (Node::new (node_type,
                                   node_ptr_to_weak (raw_parent),
-                                  drawing_ctx::state_new (),
+                                  state,
                                   node_impl)))
 }
 
@@ -15,11 +15,13 @@ use drawing_ctx;
 use drawing_ctx::RsvgDrawingCtx;
 use error::*;
 use handle::RsvgHandle;
+use handle::RsvgArena;
 use length::*;
 use node::*;
 use paint_server::*;
 use property_bag;
 use property_bag::*;
+use state::RsvgState;
 use util::*;
 use viewbox::*;
 
@@ -180,20 +182,79 @@ impl Pattern {
     }
 }
 
+// Everything that the contents of a pattern's tile depend on, besides the
+// pattern's children themselves, which can't change once the document is loaded,
+// and the inherited state, which PatternTile compares separately.
+struct TileKey {
+    width:     i32,
+    height:    i32,
+    caffine:   cairo::Matrix,
+    view_box:  (f64, f64),
+    dpi:       (f64, f64),
+    font_size: f64,
+    recording: bool
+}
+
+impl TileKey {
+    fn matches (&self, other: &TileKey) -> bool {
+        self.width == other.width &&
+            self.height == other.height &&
+            matrix_equal (&self.caffine, &other.caffine) &&
+            self.view_box == other.view_box &&
+            self.dpi == other.dpi &&
+            self.font_size == other.font_size &&
+            self.recording == other.recording
+    }
+}
+
+struct PatternTile {
+    key:     TileKey,
+
+    // A copy of the state that the tile's contents inherited from; a shape
+    // with a different stroke, color, etc. gets a tile of its own.
+    inherited: *mut RsvgState,
+
+    surface: cairo::Surface
+}
+
+// See the comment on Node's Drop impl; tiles are only created while drawing,
+// which doesn't happen in testing mode.
+#[cfg(not(test))]
+impl Drop for PatternTile {
+    fn drop (&mut self) {
+        extern "C" {
+            fn rsvg_state_free (state: *mut RsvgState);
+        }
+        unsafe { rsvg_state_free (self.inherited); }
+    }
+}
+
 struct NodePattern {
-    pattern: RefCell<Pattern>
+    pattern: RefCell<Pattern>,
+
+    // The pattern with its fallbacks resolved, computed on first use
+    resolved: RefCell<Option<Pattern>>,
+
+    // The last tile we rendered.  Lots of shapes which are filled with the
+    // same pattern at the same scale can share it.
+    tile: RefCell<Option<PatternTile>>
 }
 
 impl NodePattern {
     fn new () -> NodePattern {
         NodePattern {
-            pattern: RefCell::new (Pattern::default ())
+            pattern:  RefCell::new (Pattern::default ()),
+            resolved: RefCell::new (None),
+            tile:     RefCell::new (None)
         }
     }
 }
 
 impl NodeTrait for NodePattern {
     fn set_atts (&self, node: &RsvgNode, _: *const RsvgHandle, pbag: *const RsvgPropertyBag) -> NodeResult {
+        *self.resolved.borrow_mut () = None;
+        *self.tile.borrow_mut () = None;
+
         let mut p = self.pattern.borrow_mut ();
 
         p.node = Some (Rc::downgrade (node));
@@ -289,9 +350,10 @@ impl FallbackSource for NodeFallbackSource {
     }
 }
 
-fn set_pattern_on_draw_context (pattern: &Pattern,
-                                draw_ctx: *mut RsvgDrawingCtx,
-                                bbox:     &RsvgBbox) -> bool {
+fn set_pattern_on_draw_context (pattern:    &Pattern,
+                                draw_ctx:   *mut RsvgDrawingCtx,
+                                bbox:       &RsvgBbox,
+                                tile_cache: &RefCell<Option<PatternTile>>) -> bool {
     assert! (pattern.is_resolved ());
 
     if !node_has_children (&pattern.node) {
@@ -420,28 +482,54 @@ fn set_pattern_on_draw_context (pattern: &Pattern,
         affine = cairo::Matrix::multiply (&scalematrix, &affine);
     }
 
-    // Draw to another surface
-
     let cr_save = drawing_ctx::get_cairo_context (draw_ctx);
-    drawing_ctx::state_push (draw_ctx);
 
-    let surface = cr_save.get_target ().create_similar (Content::ColorAlpha, pw, ph);
+    let key = TileKey {
+        width:     pw,
+        height:    ph,
+        caffine:   caffine,
+        view_box:  drawing_ctx::get_view_box_size (draw_ctx),
+        dpi:       drawing_ctx::get_dpi (draw_ctx),
+        font_size: drawing_ctx::get_normalized_font_size (draw_ctx),
+        recording: drawing_ctx::pattern_tile_is_recording (draw_ctx)
+    };
 
-    let cr_pattern = cairo::Context::new (&surface);
+    let state = drawing_ctx::get_current_state (draw_ctx);
 
-    drawing_ctx::set_cairo_context (draw_ctx, &cr_pattern);
+    let is_cached = match *tile_cache.borrow () {
+        Some (ref tile) => tile.key.matches (&key) && drawing_ctx::state_inherits_equal (tile.inherited, state),
+        None            => false
+    };
 
-    // Set up transformations to be determined by the contents units
-    drawing_ctx::set_current_state_affine (draw_ctx, caffine);
+    if !is_cached {
+        // Draw to another surface
 
-    // Draw everything
-    let pattern_node = pattern.node.clone ().unwrap ().upgrade ().unwrap ();
-    pattern_node.draw_children (draw_ctx, 2);
+        drawing_ctx::state_push (draw_ctx);
 
-    // Return to the original coordinate system and rendering context
+        let surface = drawing_ctx::create_pattern_tile (draw_ctx, pw, ph);
 
-    drawing_ctx::state_pop (draw_ctx);
-    drawing_ctx::set_cairo_context (draw_ctx, &cr_save);
+        {
+            let cr_pattern = cairo::Context::new (&surface);
+
+            drawing_ctx::set_cairo_context (draw_ctx, &cr_pattern);
+
+            // Set up transformations to be determined by the contents units
+            drawing_ctx::set_current_state_affine (draw_ctx, caffine);
+
+            // Draw everything
+            let pattern_node = pattern.node.clone ().unwrap ().upgrade ().unwrap ();
+            pattern_node.draw_children (draw_ctx, 2);
+
+            // Return to the original coordinate system and rendering context
+
+            drawing_ctx::state_pop (draw_ctx);
+            drawing_ctx::set_cairo_context (draw_ctx, &cr_save);
+        }
+
+        *tile_cache.borrow_mut () = Some (PatternTile { key:       key,
+                                                        inherited: drawing_ctx::state_copy (state),
+                                                        surface:   surface });
+    }
 
     if pushed_view_box {
         drawing_ctx::pop_view_box (draw_ctx);
@@ -449,7 +537,8 @@ fn set_pattern_on_draw_context (pattern: &Pattern,
 
     // Set the final surface as a Cairo pattern into the Cairo context
 
-    let surface_pattern = SurfacePattern::create (&surface);
+    let tile = tile_cache.borrow ();
+    let surface_pattern = SurfacePattern::create (&tile.as_ref ().unwrap ().surface);
     surface_pattern.set_extend (Extend::Repeat);
 
     let mut matrix = affine;
@@ -463,20 +552,11 @@ fn set_pattern_on_draw_context (pattern: &Pattern,
     true
 }
 
-fn resolve_fallbacks_and_set_pattern (pattern:  &Pattern,
-                                      draw_ctx: *mut RsvgDrawingCtx,
-                                      bbox:     RsvgBbox) -> bool {
-    let mut fallback_source = NodeFallbackSource::new (draw_ctx);
-
-    let resolved = resolve_pattern (pattern, &mut fallback_source);
-
-    set_pattern_on_draw_context (&resolved, draw_ctx, &bbox)
-}
-
 #[no_mangle]
-pub extern fn rsvg_node_pattern_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_pattern_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Pattern,
                     raw_parent,
+                    state,
                     Box::new (NodePattern::new ()))
 }
 
@@ -492,8 +572,22 @@ pub extern fn pattern_resolve_fallbacks_and_set_pattern (raw_node: *const RsvgNo
     let mut did_set_pattern = false;
 
     node.with_impl (|node_pattern: &NodePattern| {
-        let pattern = &*node_pattern.pattern.borrow ();
-        did_set_pattern = resolve_fallbacks_and_set_pattern (pattern, draw_ctx, bbox);
+        // The document can't change once it is loaded, so the fallbacks
+        // only need to be resolved the first time the pattern is used.
+        if node_pattern.resolved.borrow ().is_none () {
+            let mut fallback_source = NodeFallbackSource::new (draw_ctx);
+
+            let resolved = resolve_pattern (&*node_pattern.pattern.borrow (), &mut fallback_source);
+
+            *node_pattern.resolved.borrow_mut () = Some (resolved);
+        }
+
+        let resolved = node_pattern.resolved.borrow ();
+
+        did_set_pattern = set_pattern_on_draw_context (resolved.as_ref ().unwrap (),
+                                                       draw_ctx,
+                                                       &bbox,
+                                                       &node_pattern.tile);
     });
 
     did_set_pattern.to_glib ()
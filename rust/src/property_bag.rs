@@ -15,14 +15,20 @@ use transform::*;
 pub enum RsvgPropertyBag {}
 
 extern "C" {
-    fn rsvg_property_bag_lookup (pbag: *const RsvgPropertyBag, key: *const libc::c_char) -> *const libc::c_char;
+    fn rsvg_property_bag_lookup_len (pbag: *const RsvgPropertyBag,
+                                     key: *const libc::c_char,
+                                     key_len: isize) -> *const libc::c_char;
     fn rsvg_property_bag_dup (pbag: *const RsvgPropertyBag) -> *mut RsvgPropertyBag;
     fn rsvg_property_bag_free (pbag: *mut RsvgPropertyBag);
 }
 
 pub fn lookup (pbag: *const RsvgPropertyBag, key: &str) -> Option<String> {
+    // The key is passed with its length, so that it doesn't have to be
+    // copied into a nul-terminated string.
     unsafe {
-        let c_value = rsvg_property_bag_lookup (pbag, key.to_glib_none ().0);
+        let c_value = rsvg_property_bag_lookup_len (pbag,
+                                                    key.as_ptr () as *const libc::c_char,
+                                                    key.len () as isize);
         from_glib_none (c_value)
     }
 }
@@ -6,6 +6,7 @@ use drawing_ctx;
 use drawing_ctx::*;
 use error::*;
 use handle::RsvgHandle;
+use handle::RsvgArena;
 use length::*;
 use marker;
 use node::*;
@@ -512,50 +513,57 @@ impl NodeTrait for NodeEllipse {
 /***** C Prototypes *****/
 
 #[no_mangle]
-pub extern fn rsvg_node_path_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_path_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Path,
                     raw_parent,
+                    state,
                     Box::new (NodePath::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_polygon_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_polygon_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Path,
                     raw_parent,
+                    state,
                     Box::new (NodePoly::new (PolyKind::Closed)))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_polyline_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_polyline_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Path,
                     raw_parent,
+                    state,
                     Box::new (NodePoly::new (PolyKind::Open)))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_line_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_line_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Line,
                     raw_parent,
+                    state,
                     Box::new (NodeLine::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_rect_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_rect_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Rect,
                     raw_parent,
+                    state,
                     Box::new (NodeRect::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_circle_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_circle_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Circle,
                     raw_parent,
+                    state,
                     Box::new (NodeCircle::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_ellipse_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_ellipse_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Ellipse,
                     raw_parent,
+                    state,
                     Box::new (NodeEllipse::new ()))
 }
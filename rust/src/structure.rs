@@ -13,10 +13,12 @@ use drawing_ctx::RsvgDrawingCtx;
 use drawing_ctx;
 use error::*;
 use handle::RsvgHandle;
+use handle::RsvgArena;
 use length::*;
 use node::*;
 use property_bag;
 use property_bag::*;
+use state::RsvgState;
 use util::*;
 use viewbox::*;
 
@@ -371,7 +373,7 @@ impl NodeTrait for NodeUse {
             let boxed_child = box_node (child.clone ());
 
             drawing_ctx::push_discrete_layer (draw_ctx);
-            drawing_ctx::draw_node_from_stack (draw_ctx, boxed_child, 1);
+            draw_instance (draw_ctx, raw_child, || drawing_ctx::draw_node_from_stack (draw_ctx, boxed_child, 1));
             drawing_ctx::pop_discrete_layer (draw_ctx);
         } else {
             child.with_impl (|symbol: &NodeSymbol| {
@@ -409,11 +411,13 @@ impl NodeTrait for NodeUse {
                     drawing_ctx::push_discrete_layer (draw_ctx);
                 }
 
-                drawing_ctx::state_push (draw_ctx);
+                draw_instance (draw_ctx, raw_child, || {
+                    drawing_ctx::state_push (draw_ctx);
 
-                child.draw_children (draw_ctx, 1);
+                    child.draw_children (draw_ctx, 1);
 
-                drawing_ctx::state_pop (draw_ctx);
+                    drawing_ctx::state_pop (draw_ctx);
+                });
                 drawing_ctx::pop_discrete_layer (draw_ctx);
 
                 if vbox.is_active () {
@@ -430,6 +434,46 @@ impl NodeTrait for NodeUse {
     }
 }
 
+// Draws the element referenced by a <use> with draw_fn, or replays a recording
+// of it.  The recording is made in the <use>'s coordinate system scaled by the
+// uniform part of the current transformation, so it can be reused for any
+// position and orientation; it is keyed by that scale and by the style that
+// the element inherits from the <use>.
+fn draw_instance<F> (draw_ctx: *const RsvgDrawingCtx, raw_child: *const RsvgNode, draw_fn: F) where F: Fn () {
+    let affine = drawing_ctx::get_current_state_affine (draw_ctx);
+    let scale = (affine.xx * affine.yy - affine.xy * affine.yx).abs ().sqrt ();
+
+    if scale < DBL_EPSILON || !drawing_ctx::can_instance (draw_ctx, raw_child) {
+        draw_fn ();
+        return;
+    }
+
+    let contents = match drawing_ctx::lookup_instance (draw_ctx, raw_child, scale) {
+        Some (contents) => contents,
+
+        None => {
+            let mut record_affine = cairo::Matrix::identity ();
+            record_affine.scale (scale, scale);
+
+            drawing_ctx::set_current_state_affine (draw_ctx, record_affine);
+            drawing_ctx::push_recording (draw_ctx);
+            draw_fn ();
+            let contents = drawing_ctx::pop_recording (draw_ctx);
+            drawing_ctx::set_current_state_affine (draw_ctx, affine);
+
+            drawing_ctx::add_instance (draw_ctx, raw_child, scale, &contents);
+            contents
+        }
+    };
+
+    if let Some ((surface, extents)) = contents {
+        let mut stamp = affine;
+        stamp.scale (1.0 / scale, 1.0 / scale);
+
+        drawing_ctx::paint_recording (draw_ctx, &surface, &extents, &stamp);
+    }
+}
+
 /***** NodeSymbol *****/
 
 struct NodeSymbol {
@@ -466,44 +510,50 @@ impl NodeTrait for NodeSymbol {
 /***** C Prototypes *****/
 
 #[no_mangle]
-pub extern fn rsvg_node_group_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_group_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Group,
                     raw_parent,
+                    state,
                     Box::new (NodeGroup::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_defs_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_defs_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Defs,
                     raw_parent,
+                    state,
                     Box::new (NodeDefs::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_switch_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_switch_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Switch,
                     raw_parent,
+                    state,
                     Box::new (NodeSwitch::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_svg_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_svg_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Svg,
                     raw_parent,
+                    state,
                     Box::new (NodeSvg::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_use_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_use_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Use,
                     raw_parent,
+                    state,
                     Box::new (NodeUse::new ()))
 }
 
 #[no_mangle]
-pub extern fn rsvg_node_symbol_new (_: *const libc::c_char, raw_parent: *const RsvgNode) -> *const RsvgNode {
+pub extern fn rsvg_node_symbol_new (_: *const libc::c_char, raw_parent: *const RsvgNode, state: *mut RsvgState, _: *mut RsvgArena) -> *const RsvgNode {
     boxed_node_new (NodeType::Symbol,
                     raw_parent,
+                    state,
                     Box::new (NodeSymbol::new ()))
 }
 
@@ -1,3 +1,5 @@
+extern crate cairo;
+
 // In paint servers (patterns, gradients, etc.), we have an
 // Option<String> for fallback names.  This is a utility function to
 // clone one of those.
@@ -14,3 +16,9 @@ pub const DBL_EPSILON: f64 = 1e-10;
 pub fn double_equals (a: f64, b: f64) -> bool {
     (a - b).abs () < DBL_EPSILON
 }
+
+// Exact comparison, for cache keys; two matrices computed the same way
+// from the same inputs compare equal.
+pub fn matrix_equal (a: &cairo::Matrix, b: &cairo::Matrix) -> bool {
+    a.xx == b.xx && a.yx == b.yx && a.xy == b.xy && a.yy == b.yy && a.x0 == b.x0 && a.y0 == b.y0
+}
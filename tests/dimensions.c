@@ -22,6 +22,7 @@ test_dimensions (FixtureData *fixture)
     RsvgDimensionData dimension;
     gchar *target_file;
     GError *error = NULL;
+    int i;
 
     target_file = g_build_filename (test_utils_get_test_data_path (),
                                     fixture->file_path, NULL);
@@ -29,14 +30,63 @@ test_dimensions (FixtureData *fixture)
     g_free (target_file);
     g_assert_no_error (error);
 
-    if (fixture->id) {
-        gboolean got_sub;
+    /* The second time around, the bounding boxes come from the handle's cache */
+    for (i = 0; i < 2; i++) {
+        if (fixture->id) {
+            gboolean got_sub;
 
-        got_sub = rsvg_handle_get_dimensions_sub (handle, &dimension, fixture->id);
-        g_assert (got_sub);
-        g_message ("w=%d h=%d", dimension.width, dimension.height);
-    } else
-        rsvg_handle_get_dimensions (handle, &dimension);
+            got_sub = rsvg_handle_get_dimensions_sub (handle, &dimension, fixture->id);
+            g_assert (got_sub);
+            g_message ("w=%d h=%d", dimension.width, dimension.height);
+        } else
+            rsvg_handle_get_dimensions (handle, &dimension);
+
+        g_assert_cmpint (fixture->width,  ==, dimension.width);
+        g_assert_cmpint (fixture->height, ==, dimension.height);
+    }
+
+    g_object_unref (handle);
+}
+
+static void
+test_cropped_pixbuf (FixtureData *fixture)
+{
+    RsvgHandle *handle;
+    GdkPixbuf *pixbuf;
+    gchar *target_file;
+    GError *error = NULL;
+
+    target_file = g_build_filename (test_utils_get_test_data_path (),
+                                    fixture->file_path, NULL);
+    handle = rsvg_handle_new_from_file (target_file, &error);
+    g_free (target_file);
+    g_assert_no_error (error);
+
+    pixbuf = rsvg_handle_get_pixbuf_sub_cropped (handle, fixture->id);
+    g_assert (pixbuf != NULL);
+
+    g_assert_cmpint (fixture->width,  ==, gdk_pixbuf_get_width (pixbuf));
+    g_assert_cmpint (fixture->height, ==, gdk_pixbuf_get_height (pixbuf));
+
+    g_object_unref (pixbuf);
+    g_object_unref (handle);
+}
+
+static void
+test_cropped_dimensions (FixtureData *fixture)
+{
+    RsvgHandle *handle;
+    RsvgDimensionData dimension;
+    gchar *target_file;
+    GError *error = NULL;
+
+    target_file = g_build_filename (test_utils_get_test_data_path (),
+                                    fixture->file_path, NULL);
+    handle = rsvg_handle_new_from_file (target_file, &error);
+    g_free (target_file);
+    g_assert_no_error (error);
+
+    g_assert (rsvg_handle_get_dimensions_sub_cropped (handle, &dimension, fixture->id));
 
     g_assert_cmpint (fixture->width,  ==, dimension.width);
     g_assert_cmpint (fixture->height, ==, dimension.height);
@@ -44,12 +94,169 @@ test_dimensions (FixtureData *fixture)
     g_object_unref (handle);
 }
 
+/* Elements at fractional positions cover one more pixel than their size */
+static FixtureData cropped_fixtures[] =
+{
+    {"/dimensions/cropped/rect no unit", "dimensions/sub-rect-no-unit.svg", "#rect-no-unit", 44, 45},
+    {"/dimensions/cropped/fractional position", "dimensions/sub-rect-fractional.svg", "#fractional", 21, 11},
+};
+
+static const gint n_cropped_fixtures = G_N_ELEMENTS (cropped_fixtures);
+
+static gboolean
+check_sprite_size (const char *id, GdkPixbuf *pixbuf, gpointer data)
+{
+    int *n_sprites = data;
+
+    g_assert (pixbuf != NULL);
+
+    if (g_str_equal (id, "#first")) {
+        g_assert_cmpint (gdk_pixbuf_get_width (pixbuf), ==, 16);
+        g_assert_cmpint (gdk_pixbuf_get_height (pixbuf), ==, 16);
+    } else if (g_str_equal (id, "#second")) {
+        g_assert_cmpint (gdk_pixbuf_get_width (pixbuf), ==, 20);
+        g_assert_cmpint (gdk_pixbuf_get_height (pixbuf), ==, 10);
+    }
+
+    (*n_sprites)++;
+
+    return TRUE;
+}
+
+static void
+test_group_ids (void)
+{
+    RsvgHandle *handle;
+    gchar *target_file;
+    gchar **ids;
+    int n_sprites = 0;
+    GError *error = NULL;
+
+    target_file = g_build_filename (test_utils_get_test_data_path (),
+                                    "dimensions/sprites.svg", NULL);
+    handle = rsvg_handle_new_from_file (target_file, &error);
+    g_free (target_file);
+    g_assert_no_error (error);
+
+    ids = rsvg_handle_get_group_ids (handle);
+    g_assert_cmpint (g_strv_length (ids), ==, 3);
+    g_assert_cmpstr (ids[0], ==, "#first");
+    g_assert_cmpstr (ids[1], ==, "#nested");
+    g_assert_cmpstr (ids[2], ==, "#second");
+
+    g_assert (rsvg_handle_foreach_pixbuf_sub_cropped (handle, (const char * const *) ids,
+                                                      check_sprite_size, &n_sprites));
+    g_assert_cmpint (n_sprites, ==, 3);
+
+    g_strfreev (ids);
+    g_object_unref (handle);
+}
+
+static void
+check_bounds (GHashTable *table, const char *id, double x, double y, double width, double height)
+{
+    RsvgRectangle *bounds;
+
+    bounds = g_hash_table_lookup (table, id);
+    g_assert (bounds != NULL);
+
+    g_assert_cmpfloat (bounds->x, ==, x);
+    g_assert_cmpfloat (bounds->y, ==, y);
+    g_assert_cmpfloat (bounds->width, ==, width);
+    g_assert_cmpfloat (bounds->height, ==, height);
+}
+
+static void
+test_element_bounds (void)
+{
+    RsvgHandle *handle;
+    gchar *target_file;
+    GHashTable *table;
+    RsvgRectangle area;
+    gchar **ids;
+    GError *error = NULL;
+
+    target_file = g_build_filename (test_utils_get_test_data_path (),
+                                    "dimensions/sprites.svg", NULL);
+    handle = rsvg_handle_new_from_file (target_file, &error);
+    g_free (target_file);
+    g_assert_no_error (error);
+
+    table = rsvg_handle_get_element_bounds (handle);
+    g_assert (table != NULL);
+    g_assert_cmpint (g_hash_table_size (table), ==, 4);
+    check_bounds (table, "#first", 10, 10, 16, 16);
+    check_bounds (table, "#nested", 20, 20, 4, 4);
+    check_bounds (table, "#second", 50, 60, 20, 10);
+    check_bounds (table, "#not-a-group", 80, 80, 5, 5);
+    g_hash_table_destroy (table);
+
+    area.x = 22;
+    area.y = 22;
+    area.width = area.height = 0;
+    ids = rsvg_handle_pick (handle, &area);
+    g_assert_cmpint (g_strv_length (ids), ==, 2);
+    g_assert_cmpstr (ids[0], ==, "#nested");
+    g_assert_cmpstr (ids[1], ==, "#first");
+    g_strfreev (ids);
+
+    area.x = area.y = 0;
+    ids = rsvg_handle_pick (handle, &area);
+    g_assert_cmpint (g_strv_length (ids), ==, 0);
+    g_strfreev (ids);
+
+    area.x = 40;
+    area.y = 40;
+    area.width = area.height = 60;
+    ids = rsvg_handle_pick (handle, &area);
+    g_assert_cmpint (g_strv_length (ids), ==, 2);
+    g_assert_cmpstr (ids[0], ==, "#not-a-group");
+    g_assert_cmpstr (ids[1], ==, "#second");
+    g_strfreev (ids);
+
+    g_object_unref (handle);
+}
+
+static void
+test_render_to_buffer (void)
+{
+    RsvgHandle *handle;
+    gchar *target_file;
+    guint8 *data;
+    GError *error = NULL;
+
+    target_file = g_build_filename (test_utils_get_test_data_path (),
+                                    "dimensions/sprites.svg", NULL);
+    handle = rsvg_handle_new_from_file (target_file, &error);
+    g_free (target_file);
+    g_assert_no_error (error);
+
+    /* Half size, with padding at the end of the rows, so that the
+     * #first rectangle covers (5, 5) to (13, 13).
+     */
+    data = g_malloc (52 * 4 * 50);
+
+    g_assert (rsvg_handle_render_to_buffer (handle, data, 52 * 4, 50, 50, RSVG_PIXEL_FORMAT_RGBA8888));
+    g_assert_cmpint (data[8 * 52 * 4 + 8 * 4 + 0], ==, 0);
+    g_assert_cmpint (data[8 * 52 * 4 + 8 * 4 + 3], ==, 255);
+    g_assert_cmpint (data[2 * 52 * 4 + 2 * 4 + 3], ==, 0);
+
+    /* A stride which cairo can't use directly */
+    g_assert (rsvg_handle_render_to_buffer (handle, data, 51, 50, 50, RSVG_PIXEL_FORMAT_A8));
+    g_assert_cmpint (data[8 * 51 + 8], ==, 255);
+    g_assert_cmpint (data[2 * 51 + 2], ==, 0);
+
+    g_free (data);
+    g_object_unref (handle);
+}
+
 static FixtureData fixtures[] =
 {
     {"/dimensions/no viewbox, width and height", "dimensions/bug608102.svg", NULL, 16, 16},
     {"/dimensions/100% width and height", "dimensions/bug612951.svg", NULL, 47, 47},
     {"/dimensions/viewbox only", "dimensions/bug614018.svg", NULL, 972, 546},
     {"/dimensions/sub/rect no unit", "dimensions/sub-rect-no-unit.svg", "#rect-no-unit", 44, 45},
+    {"/dimensions/sub/fractional position", "dimensions/sub-rect-fractional.svg", "#fractional", 20, 10},
     /* {"/dimensions/sub/rect with transform", "dimensions/bug564527.svg", "#back", 144, 203} */
 };
 
@@ -67,6 +274,20 @@ main (int argc, char *argv[])
     for (i = 0; i < n_fixtures; i++)
         g_test_add_data_func (fixtures[i].test_name, &fixtures[i], (void*)test_dimensions);
 
+    for (i = 0; i < n_cropped_fixtures; i++) {
+        char *name;
+
+        g_test_add_data_func (cropped_fixtures[i].test_name, &cropped_fixtures[i], (void*)test_cropped_pixbuf);
+
+        name = g_strconcat (cropped_fixtures[i].test_name, " dimensions", NULL);
+        g_test_add_data_func (name, &cropped_fixtures[i], (void*)test_cropped_dimensions);
+        g_free (name);
+    }
+
+    g_test_add_func ("/dimensions/group ids", test_group_ids);
+    g_test_add_func ("/dimensions/element bounds", test_element_bounds);
+    g_test_add_func ("/dimensions/render to buffer", test_render_to_buffer);
+
     result = g_test_run ();
 
     rsvg_cleanup ();
@@ -0,0 +1,371 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/* vim: set ts=4 nowrap ai expandtab sw=4: */
+
+/* Benchmarks; these only run with "-m perf", e.g.
+ *
+ *   ./performance -m perf --verbose
+ */
+
+#include <string.h>
+#include <glib.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+#include "rsvg.h"
+#include "rsvg-compat.h"
+#include "test-utils.h"
+
+#define N_ELEMENTS 50000
+
+/* Returns the resident set size of the process, or 0 if it can't be known */
+static gsize
+get_resident_bytes (void)
+{
+    gsize resident = 0;
+#ifdef G_OS_UNIX
+    gchar *contents;
+
+    if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL)) {
+        gchar **fields = g_strsplit (contents, " ", -1);
+
+        if (fields[0] != NULL && fields[1] != NULL)
+            resident = g_ascii_strtoull (fields[1], NULL, 10) * sysconf (_SC_PAGESIZE);
+
+        g_strfreev (fields);
+        g_free (contents);
+    }
+#endif
+
+    return resident;
+}
+
+static gchar *
+make_styled_document (guint n_elements)
+{
+    GString *str;
+    guint i;
+
+    str = g_string_new ("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n");
+
+    for (i = 0; i < n_elements; i++) {
+        g_string_append_printf (str,
+                                "<rect id=\"r%u\" x=\"%u\" y=\"%u\" width=\"10\" height=\"10\""
+                                " fill=\"#%06x\" stroke=\"black\" stroke-width=\"0.5\""
+                                " style=\"opacity: 0.9; fill-opacity: 0.5 !important\"/>\n",
+                                i, i % 1000, i / 1000, i * 2654435761u & 0xffffff);
+    }
+
+    g_string_append (str, "</svg>\n");
+
+    return g_string_free (str, FALSE);
+}
+
+/* Map-like document: labels which share a handful of fonts */
+static gchar *
+make_text_document (guint n_elements)
+{
+    static const char *const families[] = { "Sans", "Serif", "DejaVu Sans Condensed" };
+    GString *str;
+    guint i;
+
+    str = g_string_new ("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n"
+                        "<g font-family=\"Sans\" font-size=\"8\">\n");
+
+    for (i = 0; i < n_elements; i++) {
+        g_string_append_printf (str,
+                                "<text x=\"%u\" y=\"%u\" font-family=\"%s\" font-size=\"%u\""
+                                " text-anchor=\"middle\" fill=\"#%06x\">Label %u</text>\n",
+                                i % 1000, i / 1000, families[i % G_N_ELEMENTS (families)],
+                                8 + i % 3, i * 2654435761u & 0xffffff, i);
+    }
+
+    g_string_append (str, "</g>\n</svg>\n");
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+measure_parse_memory (const gchar *data, guint n_elements, const char *what)
+{
+    RsvgHandle *handle;
+    gsize before, after;
+    double grown;
+    GError *error = NULL;
+
+    before = get_resident_bytes ();
+    if (before == 0) {
+        g_test_skip ("resident memory can't be measured on this platform");
+        return;
+    }
+
+    g_test_timer_start ();
+
+    handle = rsvg_handle_new_from_data ((const guint8 *) data, strlen (data), &error);
+    g_assert_no_error (error);
+    g_assert (handle != NULL);
+
+    g_test_minimized_result (g_test_timer_elapsed (), "parsed %u %s in %.3f s",
+                             n_elements, what, g_test_timer_last ());
+
+    after = get_resident_bytes ();
+
+    /* The process may give memory back while parsing */
+    grown = (double) after - (double) before;
+
+    g_test_minimized_result (grown / n_elements,
+                             "%.0f bytes resident per element",
+                             grown / n_elements);
+
+    g_object_unref (handle);
+}
+
+static void
+test_parse_memory (void)
+{
+    gchar *data;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_styled_document (N_ELEMENTS);
+    measure_parse_memory (data, N_ELEMENTS, "styled elements");
+    g_free (data);
+}
+
+static void
+test_parse_text_memory (void)
+{
+    gchar *data;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_text_document (N_ELEMENTS);
+    measure_parse_memory (data, N_ELEMENTS, "text labels");
+    g_free (data);
+}
+
+/* Report-like document: one text element with many runs, whose character
+ * data libxml delivers in several pieces because of the entities.
+ */
+static gchar *
+make_long_text_document (guint n_elements)
+{
+    GString *str;
+    guint i;
+
+    str = g_string_new ("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n"
+                        "<text x=\"0\" y=\"10\">\n");
+
+    for (i = 0; i < n_elements; i++) {
+        if (i % 2 == 0)
+            g_string_append_printf (str, "<tspan font-weight=\"bold\">%u</tspan>", i);
+        else
+            g_string_append_printf (str, "A &amp; B &lt; %u &gt; C ", i);
+    }
+
+    g_string_append (str, "\n</text>\n</svg>\n");
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+test_parse_long_text (void)
+{
+    gchar *data;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_long_text_document (N_ELEMENTS);
+    measure_parse_memory (data, N_ELEMENTS, "text runs");
+    g_free (data);
+}
+
+#define N_RULES 5000
+
+static gchar *
+make_stylesheet_document (guint n_rules, guint n_elements)
+{
+    GString *str;
+    guint i;
+
+    str = g_string_new ("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\">\n"
+                        "<style type=\"text/css\">\n");
+
+    for (i = 0; i < n_rules; i++) {
+        switch (i % 4) {
+        case 0:
+            g_string_append_printf (str, ".c%u { fill: #%06x; }\n", i, i * 2654435761u & 0xffffff);
+            break;
+        case 1:
+            g_string_append_printf (str, "rect.c%u { stroke: blue; stroke-width: %u; }\n", i, i % 7);
+            break;
+        case 2:
+            g_string_append_printf (str, "#r%u { opacity: 0.5; }\n", i);
+            break;
+        default:
+            g_string_append_printf (str, "rect#r%u { fill-opacity: 0.25 !important; }\n", i);
+            break;
+        }
+    }
+
+    g_string_append (str, "</style>\n");
+
+    for (i = 0; i < n_elements; i++) {
+        g_string_append_printf (str,
+                                "<rect id=\"r%u\" class=\"c%u c%u\" x=\"%u\" y=\"%u\" width=\"10\" height=\"10\"/>\n",
+                                i, i % n_rules, (i + 1) % n_rules, i % 1000, i / 1000);
+    }
+
+    g_string_append (str, "</svg>\n");
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+test_parse_stylesheet (void)
+{
+    RsvgHandle *handle;
+    gchar *data;
+    GError *error = NULL;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_stylesheet_document (N_RULES, N_ELEMENTS);
+
+    g_test_timer_start ();
+
+    handle = rsvg_handle_new_from_data ((const guint8 *) data, strlen (data), &error);
+    g_assert_no_error (error);
+    g_assert (handle != NULL);
+
+    g_test_minimized_result (g_test_timer_elapsed (), "parsed %d elements against %d rules in %.3f s",
+                             N_ELEMENTS, N_RULES, g_test_timer_last ());
+
+    g_object_unref (handle);
+    g_free (data);
+}
+
+static void
+test_free_handle (void)
+{
+    RsvgHandle *handle;
+    gchar *data;
+    GError *error = NULL;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_styled_document (N_ELEMENTS);
+
+    handle = rsvg_handle_new_from_data ((const guint8 *) data, strlen (data), &error);
+    g_assert_no_error (error);
+    g_assert (handle != NULL);
+
+    g_test_timer_start ();
+
+    g_object_unref (handle);
+
+    g_test_minimized_result (g_test_timer_elapsed (), "freed %d elements in %.3f s",
+                             N_ELEMENTS, g_test_timer_last ());
+
+    g_free (data);
+}
+
+#define N_LEVELS 100
+
+/* Groups nested N_LEVELS deep, with a shape at each level */
+static gchar *
+make_deep_document (guint n_elements)
+{
+    GString *str;
+    guint i, j;
+
+    str = g_string_new ("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"100\" height=\"100\">\n");
+
+    for (i = 0; i < n_elements / (2 * N_LEVELS); i++) {
+        for (j = 0; j < N_LEVELS; j++)
+            g_string_append_printf (str, "<g font-size=\"%u\" stroke-width=\"0.1\">"
+                                    "<rect x=\"%u\" y=\"%u\" width=\"1\" height=\"1\" fill=\"#%06x\"/>\n",
+                                    8 + j % 4, j, i % 100, (i * N_LEVELS + j) * 2654435761u & 0xffffff);
+
+        for (j = 0; j < N_LEVELS; j++)
+            g_string_append (str, "</g>");
+
+        g_string_append (str, "\n");
+    }
+
+    g_string_append (str, "</svg>\n");
+
+    return g_string_free (str, FALSE);
+}
+
+static void
+test_render_deep (void)
+{
+    RsvgHandle *handle;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gchar *data;
+    GError *error = NULL;
+
+    if (!g_test_perf ()) {
+        g_test_skip ("only runs with -m perf");
+        return;
+    }
+
+    data = make_deep_document (N_ELEMENTS);
+
+    handle = rsvg_handle_new_from_data ((const guint8 *) data, strlen (data), &error);
+    g_assert_no_error (error);
+    g_assert (handle != NULL);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 100, 100);
+    cr = cairo_create (surface);
+
+    g_test_timer_start ();
+
+    g_assert (rsvg_handle_render_cairo (handle, cr));
+
+    g_test_minimized_result (g_test_timer_elapsed (), "rendered %d elements nested %d deep in %.3f s",
+                             N_ELEMENTS, N_LEVELS, g_test_timer_last ());
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (surface);
+    g_object_unref (handle);
+    g_free (data);
+}
+
+int
+main (int argc, char *argv[])
+{
+    int result;
+
+    RSVG_G_TYPE_INIT;
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/performance/parse memory", test_parse_memory);
+    g_test_add_func ("/performance/parse text memory", test_parse_text_memory);
+    g_test_add_func ("/performance/parse long text", test_parse_long_text);
+    g_test_add_func ("/performance/parse with stylesheet", test_parse_stylesheet);
+    g_test_add_func ("/performance/free handle", test_free_handle);
+    g_test_add_func ("/performance/render deep", test_render_deep);
+
+    result = g_test_run ();
+
+    rsvg_cleanup ();
+
+    return result;
+}
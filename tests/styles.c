@@ -41,11 +41,11 @@ static void
 assert_equal_value (FixtureData *fixture, RsvgNode *node)
 {
     if (g_str_equal (fixture->target_name, "stroke"))
-	assert_equal_color (fixture->expected.color, rsvg_node_get_state (node)->stroke->core.color->argb);
+	assert_equal_color (fixture->expected.color, rsvg_node_get_state (node)->paint->stroke->core.color->argb);
     else if (g_str_equal (fixture->target_name, "fill"))
-        assert_equal_color (fixture->expected.color, rsvg_node_get_state (node)->fill->core.color->argb);
+        assert_equal_color (fixture->expected.color, rsvg_node_get_state (node)->paint->fill->core.color->argb);
     else if (g_str_equal (fixture->target_name, "stroke-width"))
-        assert_equal_length (&fixture->expected.length, &rsvg_node_get_state (node)->stroke_width);
+        assert_equal_length (&fixture->expected.length, &rsvg_node_get_state (node)->paint->stroke_width);
     else
         g_assert_not_reached ();
 }
@@ -105,7 +105,7 @@ static const FixtureData fixtures[] =
     {"/styles/!important/class prior than type", NULL, "styles/important.svg", "#blue", "fill", .expected.color = 0xff0000ff },
     {"/styles/!important/presentation attribute is invalid", NULL, "styles/important.svg", "#white", "fill", .expected.color = 0xffffffff },
     {"/styles/!important/style prior than class", NULL, "styles/important.svg", "#pink", "fill", .expected.color = 0xffffc0cb },
-    /* {"/styles/selectors/descendant", "338160", "styles/bug338160.svg", "#base_shadow", "stroke-width", .expected.length = {2., LENGTH_UNIT_DEFAULT}}, */
+    {"/styles/selectors/descendant", "338160", "styles/bug338160.svg", "#base_shadow", "stroke-width", .expected.length = {2., LENGTH_UNIT_DEFAULT}},
 };
 static const gint n_fixtures = G_N_ELEMENTS (fixtures);
 